@@ -0,0 +1,76 @@
+// sendCommands() against a fake broker and a fake device that remembers
+// command IDs the way the firmware does (hardware/command_pipeline.h): the
+// last 16 IDs are acked "duplicate" and not applied, across backend restarts.
+const mockSeenIds: string[] = [];
+
+jest.mock('mqtt', () => ({
+  connect: () => {
+    // eslint-disable-next-line @typescript-eslint/no-require-imports
+    const { EventEmitter } = require('events');
+    const client = new EventEmitter();
+    client.subscribe = () => undefined;
+    client.publish = (topic: string, message: string) => {
+      const match = /^([^:]+):cmd:([^:]+):(.*)$/.exec(message);
+      if (!match) {
+        return;
+      }
+      const [, houseId, id, items] = match;
+      const total = items.split(';').length;
+      const duplicate = mockSeenIds.includes(id);
+      if (!duplicate) {
+        mockSeenIds.push(id);
+        if (mockSeenIds.length > 16) {
+          mockSeenIds.shift();
+        }
+      }
+      const ack = duplicate ? `${id}:duplicate:0/${total}:0` : `${id}:ok:${total}/${total}:350`;
+      setImmediate(() => client.emit('message', `yolouno/${houseId}/acks`, Buffer.from(ack)));
+    };
+    return client;
+  },
+}));
+
+type Hardware = typeof import('./hardware');
+
+// A fresh module instance: the backend process started again.
+function startBackend(): Hardware {
+  let hardware: Hardware;
+  jest.isolateModules(() => {
+    // eslint-disable-next-line @typescript-eslint/no-require-imports
+    hardware = require('./hardware');
+  });
+  return hardware;
+}
+
+describe('sendCommands', () => {
+  beforeAll(() => {
+    jest.spyOn(console, 'log').mockImplementation(() => undefined);
+  });
+
+  it('makes command IDs the device accepts, none repeated', () => {
+    const hardware = startBackend();
+    const ids = new Set<string>();
+    for (let i = 0; i < 1000; i++) {
+      const id = hardware.newCommandId();
+      expect(id).toMatch(/^[0-9a-z]{1,12}$/);
+      ids.add(id);
+    }
+    expect(ids.size).toBe(1000);
+  });
+
+  it('has the first batch after a backend restart applied, not taken as a duplicate', async () => {
+    const fan = [{ deviceType: 'fan', deviceId: 11, command: 'ON' }];
+    const before = startBackend();
+    for (let i = 0; i < 3; i++) {
+      expect((await before.sendCommands('house1', fan)).result).toBe('ok');
+    }
+
+    const after = startBackend();
+    const ack = await after.sendCommands('house1', [
+      { deviceType: 'door', deviceId: 7, command: 'OPEN' },
+      { deviceType: 'rgb', deviceId: 14, command: '0,255,0' },
+    ]);
+    expect(ack.result).toBe('ok');
+    expect(ack.applied).toBe(2);
+  });
+});
@@ -1,3 +1,4 @@
+import { randomBytes } from 'crypto';
 import * as mqtt from 'mqtt';
 
 // Các định nghĩa cho device IDs
@@ -6,8 +7,8 @@ const TEMP_HUMI_ID_MAX = 3;
 const LIGHT_ID_MIN = 4;
 const LIGHT_ID_MAX = 6;
 const DOOR_ID_MIN = 7;
-const DOOR_ID_MAX = 9;
-const FAN_ID_MIN = 10;
+const DOOR_ID_MAX = 10;
+const FAN_ID_MIN = 11;
 const FAN_ID_MAX = 13;
 const RGB_ID_MIN = 14;
 const RGB_ID_MAX = 16;
@@ -47,8 +48,178 @@ mqttClient.on('connect', () => {
   mqttClient.subscribe('yolouno/+/sensors');
   mqttClient.subscribe('yolouno/+/status/#');
   mqttClient.subscribe('yolouno/+/sensor/#'); // Thêm subscription cho dữ liệu cảm biến cụ thể
+  mqttClient.subscribe('yolouno/+/sensors/frame'); // Frame nhị phân (SENSOR_PUBLISH_FRAME)
+  mqttClient.subscribe('yolouno/+/sensors/backlog'); // Mẫu gửi bù sau khi mất kết nối
+  mqttClient.subscribe('yolouno/+/sensors/rollup'); // Thống kê theo cửa sổ 1 phút / 15 phút
+  mqttClient.subscribe('yolouno/+/acks', { qos: 1 }); // Xác nhận lô lệnh (sendCommands)
 });
 
+// Lô lệnh có command ID (xem hardware/command_pipeline.h). Thiết bị trả lời trên
+// yolouno/HOUSEID/acks: "<id>:<ok|partial|rejected|duplicate>:<applied>/<total>:<latency_us>"
+const COMMAND_BATCH_MAX = 8;
+const COMMAND_ACK_TIMEOUT_MS = 5000;
+
+export interface DeviceCommand {
+  deviceType: string;
+  deviceId: number;
+  command: string; // trạng thái tuyệt đối: OPEN/CLOSED, ON/OFF hoặc r,g,b
+}
+
+export interface CommandAck {
+  commandId: string;
+  result: 'ok' | 'partial' | 'rejected' | 'duplicate' | 'timeout';
+  applied: number;
+  total: number;
+  deviceLatencyUs: number; // từ lúc thiết bị nhận đến khi cơ cấu chấp hành xong
+  roundTripMs: number; // đo tại backend, gồm cả broker
+}
+
+interface PendingCommand {
+  sentAt: number;
+  resolve: (ack: CommandAck) => void;
+  timer: NodeJS.Timeout;
+}
+
+// Lệnh đang chờ ack theo nhà và command ID
+const pendingCommands: Record<string, Map<string, PendingCommand>> = {};
+
+// Command ID duy nhất qua các lần khởi động lại và giữa nhiều backend: thiết bị
+// nhớ 16 ID gần nhất trong 60 s, ID lặp lại bị ack "duplicate" và không áp dụng.
+// 8 ký tự thời gian (ms, base 36) + 4 ký tự hex ngẫu nhiên = CMD_ID_MAX (12).
+export function newCommandId(): string {
+  return Date.now().toString(36) + randomBytes(2).toString('hex');
+}
+
+export function parseCommandAck(text: string): Omit<CommandAck, 'roundTripMs'> | null {
+  const match = /^([^:]+):(ok|partial|rejected|duplicate):(\d+)\/(\d+):(\d+)$/.exec(text);
+  if (!match) {
+    return null;
+  }
+  return {
+    commandId: match[1],
+    result: match[2] as CommandAck['result'],
+    applied: parseInt(match[3]),
+    total: parseInt(match[4]),
+    deviceLatencyUs: parseInt(match[5]),
+  };
+}
+
+// Frame cảm biến nhị phân v1 từ ESP32 (xem hardware/sensor_frame.h), 18 byte little-endian
+const SENSOR_FRAME_VERSION = 1;
+const SENSOR_FRAME_SIZE = 18;
+const SENSOR_FRAME_FLAG_CLIMATE_VALID = 0x01;
+
+interface SensorFrame {
+  seq: number;
+  timestampMs: number;
+  temp?: number;
+  humi?: number;
+  light: number[];
+}
+
+export function decodeSensorFrame(buf: Buffer): SensorFrame | null {
+  if (buf.length !== SENSOR_FRAME_SIZE || buf.readUInt8(0) !== SENSOR_FRAME_VERSION) {
+    return null;
+  }
+  const flags = buf.readUInt8(1);
+  const frame: SensorFrame = {
+    seq: buf.readUInt16LE(2),
+    timestampMs: buf.readUInt32LE(4),
+    light: [buf.readUInt16LE(12), buf.readUInt16LE(14), buf.readUInt16LE(16)],
+  };
+  if (flags & SENSOR_FRAME_FLAG_CLIMATE_VALID) {
+    frame.temp = buf.readInt16LE(8) / 100;
+    frame.humi = buf.readUInt16LE(10) / 100;
+  }
+  return frame;
+}
+
+// Lô mẫu đo gửi bù sau khi mất kết nối (xem hardware/sensor_frame.h):
+// [version u8][count u8][sentAtMs u32] + count frame 18 byte, cũ nhất trước
+const SENSOR_BACKLOG_VERSION = 1;
+const SENSOR_BACKLOG_HEADER_SIZE = 6;
+const SENSOR_HISTORY_LIMIT = 2000;
+
+interface SensorSample extends SensorFrame {
+  timestamp: number; // thời điểm đo ước tính theo giờ backend
+}
+
+// Lịch sử mẫu gửi bù theo nhà, giới hạn SENSOR_HISTORY_LIMIT mẫu mới nhất
+const sensorHistory: Record<string, SensorSample[]> = {};
+
+export function decodeSensorBacklog(buf: Buffer, receivedAt: number): SensorSample[] | null {
+  if (buf.length < SENSOR_BACKLOG_HEADER_SIZE || buf.readUInt8(0) !== SENSOR_BACKLOG_VERSION) {
+    return null;
+  }
+  const count = buf.readUInt8(1);
+  const sentAtMs = buf.readUInt32LE(2);
+  if (buf.length !== SENSOR_BACKLOG_HEADER_SIZE + count * SENSOR_FRAME_SIZE) {
+    return null;
+  }
+  const samples: SensorSample[] = [];
+  for (let i = 0; i < count; i++) {
+    const start = SENSOR_BACKLOG_HEADER_SIZE + i * SENSOR_FRAME_SIZE;
+    const frame = decodeSensorFrame(buf.subarray(start, start + SENSOR_FRAME_SIZE));
+    if (!frame) {
+      return null;
+    }
+    // millis() của thiết bị: tuổi của mẫu = sentAtMs - timestampMs (tính cả khi tràn 32 bit)
+    const ageMs = (sentAtMs - frame.timestampMs) >>> 0;
+    samples.push({ ...frame, timestamp: receivedAt - ageMs });
+  }
+  return samples;
+}
+
+// Thống kê một cửa sổ (xem hardware/sensor_rollup.h): [version u8][n u8]
+// [startMs u32][lengthMs u32] + n kênh x (min i16, max i16, mean i16, count u16),
+// kênh theo thứ tự temp, humi, light 4..6; temp/humi đơn vị centi
+const SENSOR_ROLLUP_VERSION = 1;
+const SENSOR_ROLLUP_HEADER_SIZE = 10;
+const SENSOR_ROLLUP_CHANNEL_SIZE = 8;
+const SENSOR_ROLLUP_LIMIT = 500;
+const SENSOR_ROLLUP_SCALES = [100, 100, 1, 1, 1];
+
+interface RollupStats {
+  min: number;
+  max: number;
+  mean: number;
+  count: number; // 0: không có mẫu trong cửa sổ, các giá trị khác vô nghĩa
+}
+
+interface SensorRollup {
+  lengthMs: number;
+  timestamp: number; // lúc cửa sổ bắt đầu, theo giờ backend
+  channels: RollupStats[];
+}
+
+// Bản thống kê theo nhà, giới hạn SENSOR_ROLLUP_LIMIT bản mới nhất
+const sensorRollups: Record<string, SensorRollup[]> = {};
+
+// Thiết bị gửi ngay khi cửa sổ đóng: cửa sổ kết thúc lúc nhận
+export function decodeSensorRollup(buf: Buffer, receivedAt: number): SensorRollup | null {
+  if (buf.length < SENSOR_ROLLUP_HEADER_SIZE || buf.readUInt8(0) !== SENSOR_ROLLUP_VERSION) {
+    return null;
+  }
+  const count = buf.readUInt8(1);
+  if (count > SENSOR_ROLLUP_SCALES.length ||
+      buf.length !== SENSOR_ROLLUP_HEADER_SIZE + count * SENSOR_ROLLUP_CHANNEL_SIZE) {
+    return null;
+  }
+  const lengthMs = buf.readUInt32LE(6);
+  const channels: RollupStats[] = [];
+  for (let i = 0; i < count; i++) {
+    const at = SENSOR_ROLLUP_HEADER_SIZE + i * SENSOR_ROLLUP_CHANNEL_SIZE;
+    const scale = SENSOR_ROLLUP_SCALES[i];
+    channels.push({
+      min: buf.readInt16LE(at) / scale,
+      max: buf.readInt16LE(at + 2) / scale,
+      mean: buf.readInt16LE(at + 4) / scale,
+      count: buf.readUInt16LE(at + 6),
+    });
+  }
+  return { lengthMs, timestamp: receivedAt - lengthMs, channels };
+}
+
 mqttClient.on('message', (topic, message) => {
   const topicParts = topic.split('/');
   const houseId = topicParts[1];
@@ -84,6 +255,97 @@ mqttClient.on('message', (topic, message) => {
       console.error('Error parsing sensor data:', error);
     }
   }
+  // Xử lý frame cảm biến nhị phân: cập nhật giống như các topic riêng lẻ
+  else if (topic === `yolouno/${houseId}/sensors/frame`) {
+    const frame = decodeSensorFrame(message);
+    if (!frame) {
+      console.error(`Invalid sensor frame from ${houseId} (${message.length} bytes)`);
+      return;
+    }
+
+    if (!sensorData[houseId]) {
+      sensorData[houseId] = { temp: 0, humi: 0, light: 0 };
+    }
+    if (!specificSensorData[houseId]) {
+      specificSensorData[houseId] = {};
+    }
+
+    const now = Date.now();
+    if (frame.temp !== undefined && frame.humi !== undefined) {
+      sensorData[houseId].temp = frame.temp;
+      sensorData[houseId].humi = frame.humi;
+    }
+    sensorData[houseId].light = frame.light[0];
+    for (let i = LIGHT_ID_MIN; i <= LIGHT_ID_MAX; i++) {
+      specificSensorData[houseId][i] = {
+        value: frame.light[i - LIGHT_ID_MIN],
+        timestamp: now
+      };
+    }
+
+    console.log(`Received sensor frame #${frame.seq} for ${houseId}: temp=${frame.temp}, humi=${frame.humi}, light=${frame.light.join(',')}`);
+  }
+  // Mẫu gửi bù: chỉ lưu vào lịch sử, không ghi đè giá trị hiện tại
+  else if (topic === `yolouno/${houseId}/sensors/backlog`) {
+    const samples = decodeSensorBacklog(message, Date.now());
+    if (!samples) {
+      console.error(`Invalid sensor backlog from ${houseId} (${message.length} bytes)`);
+      return;
+    }
+    const history = sensorHistory[houseId] || (sensorHistory[houseId] = []);
+    history.push(...samples);
+    if (history.length > SENSOR_HISTORY_LIMIT) {
+      history.splice(0, history.length - SENSOR_HISTORY_LIMIT);
+    }
+    console.log(`Received ${samples.length} backlog samples for ${houseId}, first #${samples[0]?.seq}`);
+  }
+  // Thống kê theo cửa sổ: lưu lịch sử, trung bình 1 phút làm giá trị hiện tại
+  else if (topic === `yolouno/${houseId}/sensors/rollup`) {
+    const rollup = decodeSensorRollup(message, Date.now());
+    if (!rollup) {
+      console.error(`Invalid sensor rollup from ${houseId} (${message.length} bytes)`);
+      return;
+    }
+    const rollups = sensorRollups[houseId] || (sensorRollups[houseId] = []);
+    // Giá trị hiện tại lấy từ cửa sổ ngắn nhất mà nhà này gửi
+    if (rollups.every((r) => r.lengthMs >= rollup.lengthMs)) {
+      if (!sensorData[houseId]) {
+        sensorData[houseId] = { temp: 0, humi: 0, light: 0 };
+      }
+      if (!specificSensorData[houseId]) {
+        specificSensorData[houseId] = {};
+      }
+      const [temp, humi, ...lights] = rollup.channels;
+      if (temp?.count && humi?.count) {
+        sensorData[houseId].temp = temp.mean;
+        sensorData[houseId].humi = humi.mean;
+      }
+      const now = Date.now();
+      lights.forEach((light, i) => {
+        if (!light.count) return;
+        if (i === 0) sensorData[houseId].light = light.mean;
+        specificSensorData[houseId][LIGHT_ID_MIN + i] = { value: light.mean, timestamp: now };
+      });
+    }
+    rollups.push(rollup);
+    if (rollups.length > SENSOR_ROLLUP_LIMIT) {
+      rollups.splice(0, rollups.length - SENSOR_ROLLUP_LIMIT);
+    }
+    console.log(`Received ${rollup.lengthMs / 1000} s rollup for ${houseId}: ${rollup.channels.map((c) => c.mean).join(',')}`);
+  }
+  // Xác nhận lô lệnh: giải quyết lệnh đang chờ và ghi lại độ trễ
+  else if (topic === `yolouno/${houseId}/acks`) {
+    const ack = parseCommandAck(message.toString());
+    const pending = ack && pendingCommands[houseId]?.get(ack.commandId);
+    if (!ack || !pending) {
+      return; // Ack trễ (đã timeout) hoặc của backend khác
+    }
+    clearTimeout(pending.timer);
+    pendingCommands[houseId].delete(ack.commandId);
+    const roundTripMs = Date.now() - pending.sentAt;
+    console.log(`Command ${ack.commandId} for ${houseId}: ${ack.result} ${ack.applied}/${ack.total}, device ${ack.deviceLatencyUs} us, round trip ${roundTripMs} ms`);
+    pending.resolve({ ...ack, roundTripMs });
+  }
   // Xử lý dữ liệu cảm biến cụ thể
   else if (topicParts[2] === 'sensor') {
     const sensorType = topicParts[3];
@@ -229,13 +491,54 @@ export function controlDevice(houseId: string, deviceType: string, deviceId: num
   // Tạo message theo định dạng: "house_id:device_type:device_id:command"
   const message = `${houseId}:${deviceType}:${deviceId}:${command}`;
   
-  // Gửi lệnh đến topic điều khiển
+  // Gửi lệnh đến topic điều khiển. QoS 1: thiết bị dùng phiên MQTT bền, broker
+  // giữ lệnh khi nhà mất kết nối và giao khi kết nối lại (lệnh là trạng thái
+  // tuyệt đối nên nhận hai lần không sao)
   const controlTopic = `yolouno/${houseId}/controls`;
-  mqttClient.publish(controlTopic, message);
+  mqttClient.publish(controlTopic, message, { qos: 1 });
   
   console.log(`Control command sent: ${message} to topic: ${controlTopic}`);
 }
 
+/**
+ * Gửi nhiều lệnh trong một message QoS 1 và chờ thiết bị xác nhận
+ * @param houseId ID của ngôi nhà
+ * @param commands Tối đa COMMAND_BATCH_MAX lệnh, mỗi lệnh là trạng thái tuyệt đối
+ * @returns Kết quả ack, hoặc result 'timeout' nếu không có ack trong COMMAND_ACK_TIMEOUT_MS.
+ * Timeout không có nghĩa là lệnh bị bỏ: broker giữ lệnh cho phiên của thiết bị
+ * và thiết bị vẫn áp dụng khi kết nối lại.
+ */
+export function sendCommands(houseId: string, commands: DeviceCommand[]): Promise<CommandAck> {
+  if (!houseId || commands.length === 0 || commands.length > COMMAND_BATCH_MAX) {
+    return Promise.reject(new Error('Invalid command batch'));
+  }
+
+  // Gửi lại với cùng ID sẽ không bị thực hiện hai lần
+  const commandId = newCommandId();
+  const items = commands.map((c) => `${c.deviceType}:${c.deviceId}:${c.command}`).join(';');
+  const message = `${houseId}:cmd:${commandId}:${items}`;
+  const controlTopic = `yolouno/${houseId}/controls`;
+
+  return new Promise((resolve) => {
+    const pending = pendingCommands[houseId] || (pendingCommands[houseId] = new Map());
+    const sentAt = Date.now();
+    const timer = setTimeout(() => {
+      pending.delete(commandId);
+      resolve({
+        commandId,
+        result: 'timeout',
+        applied: 0,
+        total: commands.length,
+        deviceLatencyUs: 0,
+        roundTripMs: Date.now() - sentAt,
+      });
+    }, COMMAND_ACK_TIMEOUT_MS);
+    pending.set(commandId, { sentAt, resolve, timer });
+    mqttClient.publish(controlTopic, message, { qos: 1 });
+    console.log(`Command batch sent: ${message} to topic: ${controlTopic}`);
+  });
+}
+
 /**
  * Lấy tất cả các thiết bị của một nhà
  * @param houseId ID của ngôi nhà
@@ -249,6 +552,37 @@ export function getAllDevices(houseId: string): Record<number, DeviceStatus> {
   return deviceStatus[houseId];
 }
 
+/**
+ * Lấy các mẫu đo được gửi bù sau khi thiết bị mất kết nối
+ * @param houseId ID của ngôi nhà
+ * @returns Các mẫu theo thứ tự nhận, cũ nhất trước
+ */
+export function getSensorHistory(houseId: string): SensorSample[] {
+  return sensorHistory[houseId] || [];
+}
+
+/**
+ * Lấy các bản thống kê theo cửa sổ (min/max/trung bình/số mẫu mỗi kênh)
+ * @param houseId ID của ngôi nhà
+ * @param lengthMs Chỉ lấy cửa sổ dài này (vd. 60000, 900000); bỏ qua để lấy tất cả
+ * @returns Các bản theo thứ tự nhận, cũ nhất trước
+ */
+export function getSensorRollups(houseId: string, lengthMs?: number): SensorRollup[] {
+  const rollups = sensorRollups[houseId] || [];
+  return lengthMs === undefined ? rollups : rollups.filter((r) => r.lengthMs === lengthMs);
+}
+
+/**
+ * Yêu cầu thiết bị gửi số đo thô trong một khoảng thời gian (khi firmware
+ * tắt SENSOR_RAW_STREAM chỉ còn thống kê theo cửa sổ)
+ * @param houseId ID của ngôi nhà
+ * @param seconds Số giây, tối đa 3600; 0 để dừng
+ */
+export function requestRawSensorStream(houseId: string, seconds: number): void {
+  const value = Math.max(0, Math.min(3600, Math.floor(seconds)));
+  mqttClient.publish(`yolouno/${houseId}/sensors/stream`, String(value));
+}
+
 /**
  * Lấy tất cả dữ liệu cảm biến của một nhà
  * @param houseId ID của ngôi nhà
@@ -266,6 +600,8 @@ export function getAllSensorData(houseId: string): SensorData {
 // Cấu trúc để điều khiển:
 // - Topic: yolouno/HOUSEID/controls |||| Ví dụ: yolouno/house1/controls
 // - message: HOUSEID:DeviceType:DeviceID:command |||| Ví dụ:house1:door:7:open
+// - lô lệnh: HOUSEID:cmd:CommandID:DeviceType:DeviceID:command;... |||| Ví dụ:house1:cmd:a7:door:7:OPEN;fan:11:ON
+//   trả lời trên yolouno/HOUSEID/acks → "a7:ok:2/2:412" (xem sendCommands)
 // Cấu trúc lấy status:
 // - Tất cả các thiết bị: yolouno/HOUSEID/status/#
 // - Tất cả các cửa: yolouno/HOUSEID/status/door/#
@@ -282,6 +618,15 @@ export function getAllSensorData(houseId: string): SensorData {
 // // Dữ liệu cảm biến tổng hợp
 // yolouno/house1/sensors → {"temp":27.50,"humi":65.30,"light":512}
 
+// // Frame nhị phân (khi firmware bật SENSOR_PUBLISH_FRAME), thay cho các topic bên dưới
+// yolouno/house1/sensors/frame → 18 byte, xem decodeSensorFrame()
+
+// // Mẫu đo lưu lại khi mất kết nối, gửi bù theo lô sau khi kết nối lại
+// yolouno/house1/sensors/backlog → xem decodeSensorBacklog()
+
+// // Thống kê mỗi 1 phút / 15 phút (min/max/trung bình/số mẫu mỗi kênh)
+// yolouno/house1/sensors/rollup → 50 byte, xem decodeSensorRollup()
+
 // // Dữ liệu nhiệt độ theo device ID
 // yolouno/house1/status/temp/1 → "27.50"
 // yolouno/house1/status/temp/2 → "27.50"
@@ -0,0 +1,44 @@
+#include "climate_sensor.h"
+
+#include <Arduino.h>
+
+ClimateResult ClimateSensor::fail() {
+  converting_ = false;
+  stats_.failures++;
+  return CLIMATE_FAILED;
+}
+
+ClimateResult ClimateSensor::step(uint32_t* nextMs) {
+  *nextMs = 0;
+  if (!converting_) {
+    triggeredAtMs_ = millis();
+    if (dht_.requestData() != DHT20_OK) return fail();
+    converting_ = true;
+    busyChecks_ = 0;
+    *nextMs = CLIMATE_CONVERSION_MS;
+    return CLIMATE_TRIGGERED;
+  }
+
+  if (dht_.isMeasuring()) {
+    if (busyChecks_ == CLIMATE_BUSY_RETRIES) return fail();
+    busyChecks_++;
+    stats_.busyRetries++;
+    *nextMs = CLIMATE_BUSY_RETRY_MS;
+    return CLIMATE_BUSY;
+  }
+  converting_ = false;
+  if (dht_.readData() < 0) return fail();
+  // convert() overwrites the library's values even when the CRC is wrong:
+  // only a matching result reaches the cache.
+  int status = dht_.convert();
+  if (status == DHT20_ERROR_CHECKSUM) stats_.crcErrors++;
+  float temperature = dht_.getTemperature();
+  float humidity = dht_.getHumidity();
+  if (status != DHT20_OK || isnan(temperature) || isnan(humidity)) return fail();
+
+  reading_.temperature = temperature;
+  reading_.humidity = humidity;
+  reading_.atMs = millis();
+  reading_.readings++;
+  return CLIMATE_UPDATED;
+}
@@ -0,0 +1,70 @@
+// Temperature and humidity from the DHT20, read in two phases so that nothing
+// waits out the ~80 ms conversion.
+//
+// step() is one phase, called from a scheduler task that comes back when it
+// says: trigger a measurement, then CLIMATE_CONVERSION_MS later check the
+// busy bit and read the 7 result bytes. A sensor still busy is asked again
+// every CLIMATE_BUSY_RETRY_MS, CLIMATE_BUSY_RETRIES times at most. Each phase
+// is one short I2C transfer (~1 ms at 100 kHz).
+//
+// A result is kept only if its CRC-8 matches. It then replaces the one cached
+// reading that the LCD, the rules and the publisher all read, so none of them
+// touches the bus and they never disagree. A failed cycle keeps the last good
+// reading; its atMs tells how old it is.
+#pragma once
+
+#include <stdint.h>
+
+#include "DHT20.h"
+
+#define CLIMATE_CONVERSION_MS 85      // trigger -> data ready (datasheet: 80 ms)
+#define CLIMATE_BUSY_RETRY_MS 10
+#define CLIMATE_BUSY_RETRIES 3
+
+struct ClimateReading {
+  float temperature;    // °C
+  float humidity;       // %RH
+  uint32_t atMs;        // millis() when it was read
+  uint32_t readings;    // good readings so far; 0: none yet
+};
+
+enum ClimateResult : uint8_t {
+  CLIMATE_TRIGGERED,    // measurement started
+  CLIMATE_BUSY,         // still converting: step() again later
+  CLIMATE_UPDATED,      // a new reading is cached
+  CLIMATE_FAILED,       // no reading this cycle (bus error, bad CRC, stuck busy)
+};
+
+struct ClimateStats {
+  uint32_t crcErrors;
+  uint32_t busyRetries;
+  uint32_t failures;    // cycles without a reading, CRC errors included
+};
+
+class ClimateSensor {
+ public:
+  explicit ClimateSensor(DHT20& dht) : dht_(dht) {}
+
+  // One phase. *nextMs: when to step() again within this cycle; 0 once the
+  // cycle has ended (UPDATED / FAILED) and the caller's cadence applies.
+  ClimateResult step(uint32_t* nextMs);
+
+  const ClimateReading& reading() const { return reading_; }
+  // A reading exists and is at most maxAgeMs old.
+  bool fresh(uint32_t nowMs, uint32_t maxAgeMs) const {
+    return reading_.readings != 0 && nowMs - reading_.atMs <= maxAgeMs;
+  }
+  // millis() of the current / last trigger, to keep the cadence of cycles.
+  uint32_t triggeredAtMs() const { return triggeredAtMs_; }
+  const ClimateStats& stats() const { return stats_; }
+
+ private:
+  ClimateResult fail();
+
+  DHT20& dht_;
+  bool converting_ = false;
+  uint8_t busyChecks_ = 0;
+  uint32_t triggeredAtMs_ = 0;
+  ClimateReading reading_ = {};
+  ClimateStats stats_ = {};
+};
@@ -0,0 +1,76 @@
+#include "command_parser.h"
+
+#include <ctype.h>
+#include <limits.h>
+
+bool Token::equalsIgnoreCase(const char* s) const {
+  size_t n = strlen(s);
+  if (n != len) return false;
+  for (size_t i = 0; i < n; i++) {
+    if (tolower((unsigned char)ptr[i]) != tolower((unsigned char)s[i])) return false;
+  }
+  return true;
+}
+
+int Token::indexOf(char c) const {
+  const void* p = memchr(ptr, c, len);
+  return p ? (int)((const char*)p - ptr) : -1;
+}
+
+int Token::lastIndexOf(char c) const {
+  for (int i = (int)len - 1; i >= 0; i--) {
+    if (ptr[i] == c) return i;
+  }
+  return -1;
+}
+
+long Token::toInt() const {
+  uint16_t i = 0;
+  while (i < len && isspace((unsigned char)ptr[i])) i++;
+  bool negative = false;
+  if (i < len && (ptr[i] == '-' || ptr[i] == '+')) {
+    negative = ptr[i] == '-';
+    i++;
+  }
+  // Saturates at the long limits like atol(), so an over-long number is far
+  // outside every ID range instead of wrapping into one.
+  long value = 0;
+  for (; i < len && ptr[i] >= '0' && ptr[i] <= '9'; i++) {
+    int digit = ptr[i] - '0';
+    if (value > (LONG_MAX - digit) / 10) return negative ? LONG_MIN : LONG_MAX;
+    value = value * 10 + digit;
+  }
+  return negative ? -value : value;
+}
+
+bool parseCommand(const char* message, size_t length, Command& out) {
+  if (length > 0xFFFF) return false;
+  const char* end = message + length;
+
+  const char* first = (const char*)memchr(message, ':', length);
+  if (first == nullptr || first == message) return false;
+  const char* second = (const char*)memchr(first + 1, ':', end - first - 1);
+  if (second == nullptr) return false;
+  const char* third = (const char*)memchr(second + 1, ':', end - second - 1);
+  if (third == nullptr) return false;
+
+  out.houseId = Token{message, (uint16_t)(first - message)};
+  out.deviceType = Token{first + 1, (uint16_t)(second - first - 1)};
+  out.deviceIdText = Token{second + 1, (uint16_t)(third - second - 1)};
+  out.command = Token{third + 1, (uint16_t)(end - third - 1)};
+  long id = out.deviceIdText.toInt();
+  out.deviceId = id > INT_MAX ? INT_MAX : id < INT_MIN ? INT_MIN : (int)id;
+  return true;
+}
+
+DispatchResult findRoute(const Command& cmd, const CommandRoute* routes, size_t count,
+                         const CommandRoute** route) {
+  for (size_t i = 0; i < count; i++) {
+    const CommandRoute& r = routes[i];
+    if (!cmd.deviceType.equals(r.deviceType)) continue;
+    if (route) *route = &r;
+    if (cmd.deviceId < r.idMin || cmd.deviceId > r.idMax) return DISPATCH_BAD_ID;
+    return DISPATCH_OK;
+  }
+  return DISPATCH_UNKNOWN_TYPE;
+}
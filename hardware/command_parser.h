@@ -0,0 +1,67 @@
+// Zero-allocation parser for control messages
+// "house_id:device_type:device_id:command".
+//
+// Tokens are views into the MQTT payload buffer; nothing is copied and no
+// String is built. Dispatch goes through a table keyed on the device type.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// A slice of the payload buffer. Not NUL-terminated.
+struct Token {
+  const char* ptr;
+  uint16_t len;
+
+  bool equals(const char* s) const {
+    size_t n = strlen(s);
+    return n == len && memcmp(ptr, s, n) == 0;
+  }
+  bool equalsIgnoreCase(const char* s) const;
+  int indexOf(char c) const;
+  int lastIndexOf(char c) const;
+  Token slice(uint16_t begin, uint16_t end) const {
+    if (end > len) end = len;
+    if (begin > end) begin = end;
+    return Token{ptr + begin, (uint16_t)(end - begin)};
+  }
+  // Same rules as String::toInt(): optional leading blanks and sign, then
+  // digits up to the first non-digit; 0 if there are none. Saturates at
+  // LONG_MAX / LONG_MIN.
+  long toInt() const;
+};
+
+struct Command {
+  Token houseId;
+  Token deviceType;
+  Token deviceIdText;
+  Token command;    // everything after the third ':'
+  int deviceId;
+};
+
+// Splits the message in place. Returns false if it does not have the
+// house_id:device_type:device_id:command shape (non-empty house id, three ':').
+bool parseCommand(const char* message, size_t length, Command& out);
+
+// Returns false if the command was not applied (unknown device, bad argument).
+typedef bool (*CommandHandler)(int deviceId, const Token& command);
+
+struct CommandRoute {
+  const char* deviceType;
+  int idMin;
+  int idMax;
+  CommandHandler handler;
+};
+
+enum DispatchResult {
+  DISPATCH_OK,
+  DISPATCH_UNKNOWN_TYPE,
+  DISPATCH_BAD_ID,
+};
+
+// Finds the route for cmd.deviceType and checks the ID range, without calling
+// the handler. *route (if given) is the matched entry for DISPATCH_OK and
+// DISPATCH_BAD_ID.
+DispatchResult findRoute(const Command& cmd, const CommandRoute* routes, size_t count,
+                         const CommandRoute** route);
@@ -0,0 +1,99 @@
+#include "command_pipeline.h"
+
+#include <string.h>
+
+#include "telemetry_format.h"
+
+const char* ackResultName(AckResult result) {
+  switch (result) {
+    case ACK_OK: return "ok";
+    case ACK_PARTIAL: return "partial";
+    case ACK_REJECTED: return "rejected";
+    case ACK_DUPLICATE: return "duplicate";
+  }
+  return "?";
+}
+
+bool parseBatch(const Command& cmd, CommandBatch& out) {
+  out.id = Token{cmd.deviceIdText.ptr, 0};
+  out.count = 0;
+  if (!cmd.deviceType.equals(CMD_BATCH_TYPE)) return false;
+  if (cmd.deviceIdText.len == 0 || cmd.deviceIdText.len > CMD_ID_MAX) return false;
+  out.id = cmd.deviceIdText;
+
+  // Items are "type:id:target", separated by ';'. Each is parsed as a legacy
+  // command body, so its target may not contain ';' (none of ours do).
+  Token rest = cmd.command;
+  while (rest.len > 0) {
+    if (out.count == CMD_BATCH_MAX) return false;
+    int end = rest.indexOf(';');
+    Token item = rest.slice(0, end < 0 ? rest.len : (uint16_t)end);
+    rest = end < 0 ? Token{rest.ptr + rest.len, 0} : rest.slice((uint16_t)end + 1, rest.len);
+
+    // Same split as parseCommand(): type, ID, then the rest is the target.
+    Command& c = out.items[out.count];
+    int first = item.indexOf(':');
+    if (first <= 0) return false;
+    Token afterType = item.slice((uint16_t)first + 1, item.len);
+    int second = afterType.indexOf(':');
+    if (second <= 0 || (uint16_t)second + 1 >= afterType.len) return false;
+    c.houseId = cmd.houseId;
+    c.deviceType = item.slice(0, (uint16_t)first);
+    c.deviceIdText = afterType.slice(0, (uint16_t)second);
+    c.command = afterType.slice((uint16_t)second + 1, afterType.len);
+    c.deviceId = (int)c.deviceIdText.toInt();
+    out.count++;
+  }
+  return out.count > 0;
+}
+
+AckResult batchResult(uint8_t applied, uint8_t total) {
+  if (applied == 0) return ACK_REJECTED;
+  return applied == total ? ACK_OK : ACK_PARTIAL;
+}
+
+static char* put(char* out, const char* text, size_t len) {
+  memcpy(out, text, len);
+  return out + len;
+}
+
+// "<id>:<result>:<applied>/<total>:<latency_us>" from the telemetry_format
+// helpers; the numbers are formatted first so the exact length is known.
+size_t formatAck(char* out, size_t size, const Token& id, AckResult result, uint8_t applied,
+                 uint8_t total, uint32_t latencyUs) {
+  const char* name = ackResultName(result);
+  size_t nameLen = strlen(name);
+  char appliedText[UINT_TEXT_MAX + 1], totalText[UINT_TEXT_MAX + 1], latencyText[UINT_TEXT_MAX + 1];
+  size_t appliedLen = formatUint(appliedText, applied);
+  size_t totalLen = formatUint(totalText, total);
+  size_t latencyLen = formatUint(latencyText, latencyUs);
+  size_t length = id.len + 1 + nameLen + 1 + appliedLen + 1 + totalLen + 1 + latencyLen;
+  if (length >= size) return 0;
+
+  char* p = put(out, id.ptr, id.len);
+  *p++ = ':';
+  p = put(p, name, nameLen);
+  *p++ = ':';
+  p = put(p, appliedText, appliedLen);
+  *p++ = '/';
+  p = put(p, totalText, totalLen);
+  *p++ = ':';
+  p = put(p, latencyText, latencyLen);
+  *p = '\0';
+  return length;
+}
+
+bool CommandDedup::seen(const Token& id, uint32_t nowMs) {
+  for (int i = 0; i < CMD_DEDUP_SIZE; i++) {
+    if (lens_[i] == id.len && lens_[i] != 0 && memcmp(ids_[i], id.ptr, id.len) == 0 &&
+        nowMs - atMs_[i] < CMD_DEDUP_WINDOW_MS) {
+      return true;
+    }
+  }
+  if (id.len == 0 || id.len > CMD_ID_MAX) return false;
+  memcpy(ids_[next_], id.ptr, id.len);
+  lens_[next_] = (uint8_t)id.len;
+  atMs_[next_] = nowMs;
+  next_ = (uint8_t)((next_ + 1) % CMD_DEDUP_SIZE);
+  return false;
+}
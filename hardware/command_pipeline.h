@@ -0,0 +1,72 @@
+// Batched, idempotent actuator commands with acknowledgements.
+//
+// A batch arrives on the control topic (subscribed at QoS 1) as
+//
+//   <house_id>:cmd:<command_id>:<type>:<id>:<target>[;<type>:<id>:<target>...]
+//
+// which parseCommand() already splits into house, "cmd", the command ID and
+// the item list. Targets are absolute states - door OPEN/CLOSED, fan and
+// alarm ON/OFF, rgb ON/OFF or r,g,b - so applying one twice changes nothing.
+// A QoS 1 redelivery is still recognised by its command ID and not applied
+// again if it arrives within CMD_DEDUP_WINDOW_MS.
+//
+// Every batch is answered on yolouno/<house>/acks with
+//
+//   <command_id>:<ok|partial|rejected|duplicate>:<applied>/<total>:<latency_us>
+//
+// where latency is from the message reaching callback() to the last item's
+// actuator being set. The sender measures the end-to-end round trip itself.
+// The legacy single-command form is still accepted and never acknowledged.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "command_parser.h"
+
+#define CMD_BATCH_TYPE "cmd"
+#define CMD_BATCH_MAX 8
+#define CMD_ID_MAX 12
+#define CMD_DEDUP_SIZE 16
+#define CMD_DEDUP_WINDOW_MS 60000UL
+#define CMD_ACK_TEXT_MAX 40          // 12 + ":duplicate:" + "8/8:" + 10 digits
+
+struct CommandBatch {
+  Token id;
+  uint8_t count;
+  Command items[CMD_BATCH_MAX];   // houseId and deviceType/deviceId/command per item
+};
+
+enum AckResult : uint8_t {
+  ACK_OK,          // every item applied
+  ACK_PARTIAL,     // some items rejected (unknown device, bad target)
+  ACK_REJECTED,    // malformed batch, or no room to queue it
+  ACK_DUPLICATE,   // command ID seen within the dedup window; nothing applied
+};
+
+const char* ackResultName(AckResult result);
+
+// Splits a "cmd" command into items. out.id is set whenever the command ID
+// itself is usable (1..CMD_ID_MAX characters), even if the items are not, so
+// a malformed batch can still be rejected by ID.
+bool parseBatch(const Command& cmd, CommandBatch& out);
+
+// ok, partial or rejected (nothing applied) for applied of total items.
+AckResult batchResult(uint8_t applied, uint8_t total);
+
+// Returns the length written, or 0 if it does not fit in size.
+size_t formatAck(char* out, size_t size, const Token& id, AckResult result, uint8_t applied,
+                 uint8_t total, uint32_t latencyUs);
+
+// The last CMD_DEDUP_SIZE command IDs with the time they were first seen.
+class CommandDedup {
+ public:
+  // True if id was seen within the window; otherwise remembers it.
+  bool seen(const Token& id, uint32_t nowMs);
+
+ private:
+  char ids_[CMD_DEDUP_SIZE][CMD_ID_MAX];
+  uint8_t lens_[CMD_DEDUP_SIZE] = {};
+  uint32_t atMs_[CMD_DEDUP_SIZE] = {};
+  uint8_t next_ = 0;
+};
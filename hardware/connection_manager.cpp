@@ -0,0 +1,89 @@
+#include "connection_manager.h"
+
+unsigned long ConnectionManager::backoffMs(uint8_t failures) {
+  unsigned long delayMs = CONN_BACKOFF_MAX_MS;
+  if (failures < 16 && (CONN_BACKOFF_MIN_MS << failures) < CONN_BACKOFF_MAX_MS) {
+    delayMs = CONN_BACKOFF_MIN_MS << failures;
+  }
+  return delayMs / 2 + (unsigned long)random((long)(delayMs / 2) + 1);
+}
+
+void ConnectionManager::enter(ConnState next, unsigned long now) {
+  state_ = next;
+  stateSince_ = now;
+}
+
+void ConnectionManager::scheduleRetry(uint8_t& failures, unsigned long now) {
+  unsigned long wait = backoffMs(failures);
+  if (failures < 255) failures++;
+  nextAttemptAt_ = now + wait;
+  Serial.print(" Thử lại sau ");
+  Serial.print(wait);
+  Serial.println(" ms");
+}
+
+void ConnectionManager::begin() {
+  Serial.println("Connecting to AP ...");
+  WiFi.begin(ssid_, password_);
+  enter(CONN_WIFI_CONNECTING, millis());
+}
+
+void ConnectionManager::service() {
+  unsigned long now = millis();
+
+  switch (state_) {
+    case CONN_WIFI_CONNECTING:
+      if (WiFi.status() == WL_CONNECTED) {
+        Serial.println("Connected to AP");
+        wifiFailures_ = 0;
+        nextAttemptAt_ = now;
+        enter(CONN_MQTT_BACKOFF, now);
+      } else if (now - stateSince_ >= CONN_WIFI_TIMEOUT_MS) {
+        Serial.print("Không kết nối được WiFi.");
+        WiFi.disconnect();
+        scheduleRetry(wifiFailures_, now);
+        enter(CONN_WIFI_BACKOFF, now);
+      }
+      break;
+
+    case CONN_WIFI_BACKOFF:
+      if (due(now)) begin();
+      break;
+
+    case CONN_MQTT_BACKOFF:
+      if (WiFi.status() != WL_CONNECTED) {
+        // The ESP32 stack re-associates on its own; just wait for it.
+        enter(CONN_WIFI_CONNECTING, now);
+        break;
+      }
+      if (!due(now)) break;
+      Serial.print("Đang kết nối MQTT...");
+      if (client_.connect(clientId_, nullptr, nullptr, nullptr, 0, false, nullptr,
+                          cleanSession_)) {
+        Serial.println("Đã kết nối!");
+        mqttFailures_ = 0;
+        reconnects_++;
+        lastConnectMs_ = millis() - now;
+        enter(CONN_MQTT_UP, millis());
+        if (onConnected_) onConnected_();
+      } else {
+        Serial.print("Thất bại, mã lỗi: ");
+        Serial.print(client_.state());
+        Serial.print(".");
+        failedAttempts_++;
+        scheduleRetry(mqttFailures_, millis());
+      }
+      break;
+
+    case CONN_MQTT_UP:
+      if (!client_.connected()) {
+        Serial.print("Mất kết nối MQTT, mã lỗi: ");
+        Serial.print(client_.state());
+        Serial.print(".");
+        // Jittered even on the first retry so a fleet does not reconnect in lockstep.
+        scheduleRetry(mqttFailures_, now);
+        enter(CONN_MQTT_BACKOFF, now);
+      }
+      break;
+  }
+}
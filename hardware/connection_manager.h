@@ -0,0 +1,77 @@
+// Non-blocking WiFi + MQTT connection state machine.
+//
+// service() is called from every loop() iteration and never waits: it checks
+// the link, and when it is down schedules the next WiFi or broker attempt with
+// exponential backoff and jitter. Local sensing and control keep running at
+// full rate while the network is away.
+//
+// Each broker attempt is still one PubSubClient::connect(), which blocks for
+// the TCP/CONNACK exchange (about one round trip, or the socket connect
+// timeout if the host is unreachable; plus the TLS handshake over TlsClient);
+// only the waiting between attempts is gone from the loop.
+//
+// With setCleanSession(false) the client ID names a persistent session: the
+// broker keeps its subscriptions, and QoS 1 messages for them, while the
+// device is away, and hands them over on the next connect.
+#pragma once
+
+#include <PubSubClient.h>
+#include <WiFi.h>
+
+#define CONN_BACKOFF_MIN_MS 1000UL
+#define CONN_BACKOFF_MAX_MS 60000UL
+#define CONN_WIFI_TIMEOUT_MS 15000UL   // give up on one association attempt
+
+enum ConnState : uint8_t {
+  CONN_WIFI_CONNECTING,   // WiFi.begin() issued, waiting for WL_CONNECTED
+  CONN_WIFI_BACKOFF,      // association timed out, waiting to retry
+  CONN_MQTT_BACKOFF,      // WiFi up, waiting for the next broker attempt
+  CONN_MQTT_UP,
+};
+
+class ConnectionManager {
+ public:
+  ConnectionManager(PubSubClient& client, const char* ssid, const char* password,
+                    const char* clientId)
+      : client_(client), ssid_(ssid), password_(password), clientId_(clientId) {}
+
+  // Called once per successful broker connect (subscribe, publish state...).
+  void onConnected(void (*handler)()) { onConnected_ = handler; }
+  // Before begin(). Default true: the broker forgets the client on disconnect.
+  void setCleanSession(bool clean) { cleanSession_ = clean; }
+
+  void begin();
+  void service();
+
+  ConnState state() const { return state_; }
+  bool mqttUp() const { return state_ == CONN_MQTT_UP; }
+  uint32_t reconnects() const { return reconnects_; }
+  uint32_t failedAttempts() const { return failedAttempts_; }
+  // How long the last successful connect() blocked the loop.
+  unsigned long lastConnectMs() const { return lastConnectMs_; }
+
+  // Backoff for the given consecutive failure count, with jitter: a uniform
+  // pick in [d/2, d] where d = min(MAX, MIN * 2^failures).
+  static unsigned long backoffMs(uint8_t failures);
+
+ private:
+  void enter(ConnState next, unsigned long now);
+  void scheduleRetry(uint8_t& failures, unsigned long now);
+  bool due(unsigned long now) const { return (long)(now - nextAttemptAt_) >= 0; }
+
+  PubSubClient& client_;
+  const char* ssid_;
+  const char* password_;
+  const char* clientId_;
+  void (*onConnected_)() = nullptr;
+  bool cleanSession_ = true;
+
+  ConnState state_ = CONN_WIFI_CONNECTING;
+  unsigned long stateSince_ = 0;
+  unsigned long nextAttemptAt_ = 0;
+  uint8_t wifiFailures_ = 0;
+  uint8_t mqttFailures_ = 0;
+  uint32_t reconnects_ = 0;
+  uint32_t failedAttempts_ = 0;
+  unsigned long lastConnectMs_ = 0;
+};
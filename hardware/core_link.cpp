@@ -0,0 +1,35 @@
+#include "core_link.h"
+
+#include <string.h>
+
+bool makeCommandRecord(const CommandRoute* route, int deviceId, const Token& command,
+                       CommandRecord& out) {
+  if (command.len > CORE_COMMAND_TEXT_MAX) return false;
+  out.route = route;
+  out.deviceId = deviceId;
+  out.len = (uint8_t)command.len;
+  memcpy(out.text, command.ptr, command.len);
+  out.batchTotal = 0;
+  return true;
+}
+
+void setBatchItem(const CommandBatch& batch, uint8_t index, uint32_t receivedUs,
+                  CommandRecord& out) {
+  out.batchIndex = index;
+  out.batchTotal = batch.count;
+  out.idLen = (uint8_t)batch.id.len;
+  memcpy(out.commandId, batch.id.ptr, batch.id.len);
+  out.receivedUs = receivedUs;
+}
+
+bool makePublishRecord(const char* topic, const char* payload, bool retained,
+                       TelemetryRecord& out) {
+  size_t len = strlen(payload);
+  if (len > CORE_PAYLOAD_MAX) return false;
+  out.kind = TELEMETRY_PUBLISH;
+  out.publish.topic = topic;
+  out.publish.retained = retained;
+  out.publish.len = (uint8_t)len;
+  memcpy(out.publish.payload, payload, len);
+  return true;
+}
@@ -0,0 +1,89 @@
+// Records passed between the network core and the actuator core in dual-core
+// mode (see DUAL_CORE_MODE in main.cpp).
+//
+// Commands go from the MQTT callback (network core) to the actuator core;
+// status publishes and sensor samples go back. Records are plain values with
+// the command text copied out of the MQTT payload, which is reused as soon as
+// the callback returns. Topics are pointers into the TopicTable, which never
+// changes after setup().
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "command_parser.h"
+#include "command_pipeline.h"
+#include "sensor_frame.h"
+#include "spsc_queue.h"
+
+#define CORE_COMMAND_TEXT_MAX 24     // "255,255,255" and the like
+#define CORE_PAYLOAD_MAX CMD_ACK_TEXT_MAX   // status payloads and command acks
+#define CORE_COMMAND_QUEUE_SIZE 16
+#define CORE_TELEMETRY_QUEUE_SIZE 32
+
+// One device command. Items of a batch are pushed back to back; the actuator
+// core acknowledges the batch after its last item.
+struct CommandRecord {
+  const CommandRoute* route;
+  int deviceId;
+  uint8_t len;
+  char text[CORE_COMMAND_TEXT_MAX];
+  uint8_t batchIndex;
+  uint8_t batchTotal;         // 0: legacy command, not acknowledged
+  uint8_t idLen;
+  char commandId[CMD_ID_MAX];
+  uint32_t receivedUs;        // micros() when the command reached callback()
+
+  Token command() const { return Token{text, len}; }
+  Token id() const { return Token{commandId, idLen}; }
+};
+
+enum TelemetryKind : uint8_t {
+  TELEMETRY_PUBLISH,   // one status message
+  TELEMETRY_SAMPLE,    // one sensor sample, published per sensorPublishMode
+  TELEMETRY_ROLLUP,    // one closed rollup window, already encoded
+};
+
+struct TelemetryPublish {
+  const char* topic;
+  bool retained;
+  uint8_t len;
+  char payload[CORE_PAYLOAD_MAX];
+};
+
+struct TelemetrySample {
+  float temperature;
+  float humidity;
+  int lightValue;
+  int lightValues[SENSOR_FRAME_LIGHTS];
+  uint8_t channels;
+  uint32_t sampledAtMs;
+};
+
+struct TelemetryRollup {
+  uint8_t len;
+  uint8_t bytes[SENSOR_ROLLUP_MAX_SIZE];
+};
+
+struct TelemetryRecord {
+  TelemetryKind kind;
+  union {
+    TelemetryPublish publish;
+    TelemetrySample sample;
+    TelemetryRollup rollup;
+  };
+};
+
+typedef SpscQueue<CommandRecord, CORE_COMMAND_QUEUE_SIZE> CommandQueue;
+typedef SpscQueue<TelemetryRecord, CORE_TELEMETRY_QUEUE_SIZE> TelemetryQueue;
+
+// False if the command text does not fit a record. The record is a legacy
+// command until setBatchItem() is called on it.
+bool makeCommandRecord(const CommandRoute* route, int deviceId, const Token& command,
+                       CommandRecord& out);
+void setBatchItem(const CommandBatch& batch, uint8_t index, uint32_t receivedUs,
+                  CommandRecord& out);
+
+// False if the payload does not fit a record.
+bool makePublishRecord(const char* topic, const char* payload, bool retained,
+                       TelemetryRecord& out);
@@ -0,0 +1,281 @@
+#include "device_config.h"
+
+#include <string.h>
+
+namespace {
+
+// Bounds-checked little-endian cursors; a failed read or write sets ok = false
+// and every later call is a no-op.
+struct Writer {
+  uint8_t* out;
+  size_t size;
+  size_t pos = 0;
+  bool ok = true;
+
+  void bytes(const void* p, size_t n) {
+    if (!ok || pos + n > size) {
+      ok = false;
+      return;
+    }
+    memcpy(out + pos, p, n);
+    pos += n;
+  }
+  void u8(uint8_t v) { bytes(&v, 1); }
+  void u16(uint16_t v) {
+    uint8_t b[2] = {(uint8_t)v, (uint8_t)(v >> 8)};
+    bytes(b, 2);
+  }
+  void u32(uint32_t v) {
+    u16((uint16_t)v);
+    u16((uint16_t)(v >> 16));
+  }
+  void str(const char* s) {
+    size_t n = strlen(s);
+    u8((uint8_t)n);
+    bytes(s, n);
+  }
+};
+
+struct Reader {
+  const uint8_t* data;
+  size_t size;
+  size_t pos = 0;
+  bool ok = true;
+
+  const uint8_t* take(size_t n) {
+    if (!ok || pos + n > size) {
+      ok = false;
+      return nullptr;
+    }
+    pos += n;
+    return data + pos - n;
+  }
+  uint8_t u8() {
+    const uint8_t* p = take(1);
+    return p ? p[0] : 0;
+  }
+  uint16_t u16() {
+    const uint8_t* p = take(2);
+    return p ? (uint16_t)(p[0] | (p[1] << 8)) : 0;
+  }
+  uint32_t u32() {
+    uint32_t lo = u16();
+    return lo | ((uint32_t)u16() << 16);
+  }
+  // False if the string is longer than max; out is always terminated.
+  bool str(char* out, size_t max) {
+    uint8_t n = u8();
+    const uint8_t* p = take(n);
+    if (!p || n > max) {
+      out[0] = '\0';
+      return false;
+    }
+    memcpy(out, p, n);
+    out[n] = '\0';
+    return true;
+  }
+};
+
+bool boundedString(const char* s, size_t max) { return strnlen(s, max + 1) <= max; }
+
+constexpr uint64_t gpioBit(int pin) { return 1ULL << pin; }
+
+// ESP32-S3 GPIOs a door servo or fan may drive: 0-21 and 38-48 exist, minus
+// the strapping pins (0, 3, 45, 46), USB (19, 20), UART0 (43, 44) and what
+// the board already uses (strip data 8, I2C 11/12). 26-37 are the SPI flash
+// and PSRAM. The config's light pins are checked separately.
+constexpr uint64_t kOutputPins =
+    ((gpioBit(22) - 1) & ~(gpioBit(0) | gpioBit(3) | gpioBit(8) | gpioBit(11) | gpioBit(12) |
+                           gpioBit(19) | gpioBit(20))) |
+    gpioBit(38) | gpioBit(39) | gpioBit(40) | gpioBit(41) | gpioBit(42) | gpioBit(47) |
+    gpioBit(48);
+// ADC1 channels (GPIO 1-10); ADC2 cannot be read while WiFi is on.
+constexpr uint64_t kAdc1Pins = (gpioBit(11) - 1) & ~gpioBit(0);
+
+bool inPinSet(uint8_t pin, uint64_t set) { return pin < 64 && (set >> pin & 1); }
+
+}  // namespace
+
+const char* configResultName(ConfigResult result) {
+  switch (result) {
+    case CONFIG_OK: return "ok";
+    case CONFIG_MISSING: return "missing";
+    case CONFIG_TRUNCATED: return "truncated";
+    case CONFIG_BAD_MAGIC: return "bad magic";
+    case CONFIG_BAD_VERSION: return "bad version";
+    case CONFIG_BAD_CRC: return "bad crc";
+    case CONFIG_BAD_FIELD: return "bad field";
+    case CONFIG_IO_ERROR: return "io error";
+  }
+  return "?";
+}
+
+uint32_t crc32(const uint8_t* data, size_t length, uint32_t crc) {
+  // Reflected 0xEDB88320, four bits at a time: a 64-byte table instead of 1 KiB.
+  static const uint32_t nibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+    0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+  };
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ nibble[crc & 0x0F];
+    crc = (crc >> 4) ^ nibble[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+ConfigResult validateDeviceConfig(const DeviceConfig& config) {
+  if (config.houseId[0] == '\0' || !boundedString(config.houseId, CONFIG_HOUSE_ID_MAX) ||
+      !boundedString(config.ssid, CONFIG_SSID_MAX) ||
+      !boundedString(config.password, CONFIG_PASSWORD_MAX) || config.mqttHost[0] == '\0' ||
+      !boundedString(config.mqttHost, CONFIG_HOST_MAX) || config.mqttPort == 0) {
+    return CONFIG_BAD_FIELD;
+  }
+  if (config.sensorIntervalMs < CONFIG_MIN_INTERVAL_MS ||
+      config.lcdIntervalMs < CONFIG_MIN_INTERVAL_MS ||
+      config.alarmIntervalMs < CONFIG_MIN_INTERVAL_MS) {
+    return CONFIG_BAD_FIELD;
+  }
+  for (int kind = 0; kind < STATUS_KIND_COUNT; kind++) {
+    const TopicIdRange& r = config.ranges[kind];
+    if (r.idMin < 0 || r.idMax > 255 || r.idMin > r.idMax) return CONFIG_BAD_FIELD;
+  }
+  // Sensor frame v1 carries exactly this many light channels.
+  const TopicIdRange& lights = config.ranges[STATUS_LIGHT];
+  if (lights.idMax - lights.idMin + 1 != CONFIG_LIGHT_PINS) return CONFIG_BAD_FIELD;
+  if (!TopicTable::fits(config.houseId, config.ranges)) return CONFIG_BAD_FIELD;
+  for (int i = 0; i < CONFIG_LIGHT_PINS; i++) {
+    if (!inPinSet(config.lightPins[i], kAdc1Pins)) return CONFIG_BAD_FIELD;
+  }
+
+  if (config.deviceCount > DEVICE_MAX) return CONFIG_BAD_FIELD;
+  for (uint8_t i = 0; i < config.deviceCount; i++) {
+    const DeviceSpec& d = config.devices[i];
+    if (d.kind != STATUS_DOOR && d.kind != STATUS_ALARM && d.kind != STATUS_FAN &&
+        d.kind != STATUS_RGB) {
+      return CONFIG_BAD_FIELD;
+    }
+    const TopicIdRange& r = config.ranges[d.kind];
+    if (d.id < r.idMin || d.id > r.idMax || d.span == 0) return CONFIG_BAD_FIELD;
+    if (d.kind == STATUS_RGB && d.pin + d.span > CONFIG_STRIP_PIXELS) return CONFIG_BAD_FIELD;
+    if (d.kind == STATUS_DOOR || d.kind == STATUS_FAN) {
+      if (!inPinSet(d.pin, kOutputPins)) return CONFIG_BAD_FIELD;
+      for (int p = 0; p < CONFIG_LIGHT_PINS; p++) {
+        if (d.pin == config.lightPins[p]) return CONFIG_BAD_FIELD;
+      }
+    }
+    for (uint8_t j = 0; j < i; j++) {
+      if (config.devices[j].kind == d.kind && config.devices[j].id == d.id) {
+        return CONFIG_BAD_FIELD;
+      }
+    }
+  }
+  return CONFIG_OK;
+}
+
+size_t encodeDeviceConfig(const DeviceConfig& config, uint8_t* out, size_t size) {
+  if (validateDeviceConfig(config) != CONFIG_OK) return 0;
+  Writer w{out, size};
+  w.u32(CONFIG_MAGIC);
+  w.u8(CONFIG_VERSION);
+  w.u8(0);
+  w.u16(0);   // length, patched below
+  w.str(config.houseId);
+  w.str(config.ssid);
+  w.str(config.password);
+  w.str(config.mqttHost);
+  w.u16(config.mqttPort);
+  w.u32(config.sensorIntervalMs);
+  w.u32(config.lcdIntervalMs);
+  w.u32(config.alarmIntervalMs);
+  w.bytes(config.lightPins, CONFIG_LIGHT_PINS);
+  for (int kind = 0; kind < STATUS_KIND_COUNT; kind++) {
+    w.u8((uint8_t)config.ranges[kind].idMin);
+    w.u8((uint8_t)config.ranges[kind].idMax);
+  }
+  w.u8(config.deviceCount);
+  for (uint8_t i = 0; i < config.deviceCount; i++) {
+    const DeviceSpec& d = config.devices[i];
+    w.u8(d.kind);
+    w.u8(d.id);
+    w.u8(d.pin);
+    w.u8(d.span);
+    w.u32(d.initial);
+  }
+  if (!w.ok || w.pos + 4 > size) return 0;
+  size_t length = w.pos + 4;
+  out[6] = (uint8_t)length;
+  out[7] = (uint8_t)(length >> 8);
+  w.u32(crc32(out, w.pos));
+  return length;
+}
+
+ConfigResult decodeDeviceConfig(const uint8_t* data, size_t length, DeviceConfig& out) {
+  if (length < CONFIG_HEADER_SIZE + 4) return CONFIG_TRUNCATED;
+  Reader header{data, CONFIG_HEADER_SIZE};
+  if (header.u32() != CONFIG_MAGIC) return CONFIG_BAD_MAGIC;
+  if (header.u8() != CONFIG_VERSION) return CONFIG_BAD_VERSION;
+  header.u8();
+  size_t total = header.u16();
+  if (total < CONFIG_HEADER_SIZE + 4 || total > length) return CONFIG_TRUNCATED;
+  if (total < length) return CONFIG_BAD_FIELD;   // trailing bytes
+  Reader crc{data + total - 4, 4};
+  if (crc.u32() != crc32(data, total - 4)) return CONFIG_BAD_CRC;
+
+  // Decoded into a scratch copy so a bad field leaves out untouched.
+  DeviceConfig c = {};
+  Reader r{data, total - 4, CONFIG_HEADER_SIZE};
+  bool fits = r.str(c.houseId, CONFIG_HOUSE_ID_MAX) & r.str(c.ssid, CONFIG_SSID_MAX) &
+              r.str(c.password, CONFIG_PASSWORD_MAX) & r.str(c.mqttHost, CONFIG_HOST_MAX);
+  c.mqttPort = r.u16();
+  c.sensorIntervalMs = r.u32();
+  c.lcdIntervalMs = r.u32();
+  c.alarmIntervalMs = r.u32();
+  for (int i = 0; i < CONFIG_LIGHT_PINS; i++) c.lightPins[i] = r.u8();
+  for (int kind = 0; kind < STATUS_KIND_COUNT; kind++) {
+    c.ranges[kind].idMin = r.u8();
+    c.ranges[kind].idMax = r.u8();
+  }
+  c.deviceCount = r.u8();
+  if (c.deviceCount > DEVICE_MAX) return CONFIG_BAD_FIELD;
+  for (uint8_t i = 0; i < c.deviceCount; i++) {
+    DeviceSpec& d = c.devices[i];
+    d.kind = (StatusTopic)r.u8();
+    d.id = r.u8();
+    d.pin = r.u8();
+    d.span = r.u8();
+    d.initial = r.u32();
+  }
+  if (!r.ok) return CONFIG_TRUNCATED;
+  if (!fits || r.pos != r.size) return CONFIG_BAD_FIELD;
+  ConfigResult result = validateDeviceConfig(c);
+  if (result == CONFIG_OK) out = c;
+  return result;
+}
+
+ConfigResult loadDeviceConfig(fs::FS& fs, DeviceConfig& out) {
+  if (!fs.exists(CONFIG_PATH)) return CONFIG_MISSING;
+  File file = fs.open(CONFIG_PATH, FILE_READ);
+  if (!file) return CONFIG_IO_ERROR;
+  uint8_t blob[CONFIG_BLOB_MAX];
+  size_t length = file.read(blob, sizeof(blob));
+  file.close();
+  return decodeDeviceConfig(blob, length, out);
+}
+
+ConfigResult storeDeviceConfig(fs::FS& fs, const uint8_t* blob, size_t length,
+                               DeviceConfig& decoded) {
+  ConfigResult result = decodeDeviceConfig(blob, length, decoded);
+  if (result != CONFIG_OK) return result;
+  File file = fs.open(CONFIG_TMP_PATH, FILE_WRITE);
+  if (!file) return CONFIG_IO_ERROR;
+  bool written = file.write(blob, length) == length;
+  file.close();
+  if (!written || !fs.rename(CONFIG_TMP_PATH, CONFIG_PATH)) {
+    fs.remove(CONFIG_TMP_PATH);
+    return CONFIG_IO_ERROR;
+  }
+  return CONFIG_OK;
+}
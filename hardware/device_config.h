@@ -0,0 +1,96 @@
+// Per-house configuration: house ID, network credentials, intervals, the
+// device ID ranges and the device table, stored on flash as one small binary
+// blob so that every house runs the same firmware image.
+//
+// Blob layout, little-endian, version 1:
+//   u32 magic "SHC1" | u8 version | u8 reserved | u16 total length
+//   4 x string (u8 length + bytes): house ID, WiFi SSID, WiFi password, MQTT host
+//   u16 MQTT port | u32 sensor, LCD and alarm intervals (ms)
+//   u8 light sensor pins [CONFIG_LIGHT_PINS]
+//   STATUS_KIND_COUNT x (u8 first ID, u8 last ID), in StatusTopic order
+//   u8 device count | per device: u8 kind, u8 id, u8 pin, u8 span, u32 initial state
+//   u32 CRC-32 (IEEE) of everything before it
+//
+// decodeDeviceConfig() checks the framing, the CRC and every field before it
+// touches the output, so a config that decodes is safe to build the topic and
+// device tables from. Updates are written to CONFIG_TMP_PATH and renamed over
+// CONFIG_PATH, which LittleFS does atomically: a power cut leaves either the
+// old or the new config, never half of one.
+#pragma once
+
+#include <FS.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "device_registry.h"
+#include "topic_table.h"
+
+#define CONFIG_MAGIC 0x31434853u       // "SHC1"
+#define CONFIG_VERSION 1
+#define CONFIG_PATH "/config.bin"
+#define CONFIG_TMP_PATH "/config.new"
+
+#define CONFIG_HOUSE_ID_MAX 39         // a UUID is 36
+#define CONFIG_SSID_MAX 32
+#define CONFIG_PASSWORD_MAX 64
+#define CONFIG_HOST_MAX 63
+#define CONFIG_LIGHT_PINS 3
+#define CONFIG_MIN_INTERVAL_MS 100
+
+#define CONFIG_STRIP_PIXELS 4          // NEOPIXEL_COUNT in the sketch
+
+#define CONFIG_HEADER_SIZE 8
+#define CONFIG_DEVICE_SIZE 8
+#define CONFIG_BLOB_MAX                                                                      \
+  (CONFIG_HEADER_SIZE + 4 + CONFIG_HOUSE_ID_MAX + CONFIG_SSID_MAX + CONFIG_PASSWORD_MAX +   \
+   CONFIG_HOST_MAX + 2 + 12 + CONFIG_LIGHT_PINS + 2 * STATUS_KIND_COUNT + 1 +               \
+   DEVICE_MAX * CONFIG_DEVICE_SIZE + 4)
+
+struct DeviceConfig {
+  char houseId[CONFIG_HOUSE_ID_MAX + 1];
+  char ssid[CONFIG_SSID_MAX + 1];
+  char password[CONFIG_PASSWORD_MAX + 1];
+  char mqttHost[CONFIG_HOST_MAX + 1];
+  uint16_t mqttPort;
+  uint32_t sensorIntervalMs;
+  uint32_t lcdIntervalMs;
+  uint32_t alarmIntervalMs;
+  uint8_t lightPins[CONFIG_LIGHT_PINS];
+  TopicIdRange ranges[STATUS_KIND_COUNT];
+  uint8_t deviceCount;
+  DeviceSpec devices[DEVICE_MAX];
+};
+
+enum ConfigResult {
+  CONFIG_OK,
+  CONFIG_MISSING,        // no config on flash
+  CONFIG_TRUNCATED,      // shorter than its header says, or than a field
+  CONFIG_BAD_MAGIC,
+  CONFIG_BAD_VERSION,
+  CONFIG_BAD_CRC,
+  CONFIG_BAD_FIELD,      // framing fine, a value is out of range
+  CONFIG_IO_ERROR,
+};
+
+const char* configResultName(ConfigResult result);
+
+uint32_t crc32(const uint8_t* data, size_t length, uint32_t crc = 0);
+
+// Range and consistency checks shared by encode and decode, including the
+// pins against the board: an RGB device's pixels [pin, pin + span) must be on
+// the strip, door servos and fans must use a GPIO free for output, and light
+// pins must be ADC1 channels.
+ConfigResult validateDeviceConfig(const DeviceConfig& config);
+
+// Returns the blob length, or 0 if config is invalid or size is too small.
+size_t encodeDeviceConfig(const DeviceConfig& config, uint8_t* out, size_t size);
+
+// On anything but CONFIG_OK, out is left unchanged.
+ConfigResult decodeDeviceConfig(const uint8_t* data, size_t length, DeviceConfig& out);
+
+// Reads and decodes CONFIG_PATH.
+ConfigResult loadDeviceConfig(fs::FS& fs, DeviceConfig& out);
+
+// Decodes blob and, if it is valid, atomically replaces CONFIG_PATH with it.
+ConfigResult storeDeviceConfig(fs::FS& fs, const uint8_t* blob, size_t length,
+                               DeviceConfig& decoded);
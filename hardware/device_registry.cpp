@@ -0,0 +1,63 @@
+#include "device_registry.h"
+
+#include <string.h>
+
+#include "telemetry_format.h"
+
+bool DeviceRegistry::build(const DeviceSpec* specs, size_t count) {
+  count_ = 0;
+  if (count > DEVICE_MAX) return false;
+  for (size_t i = 0; i < count; i++) {
+    const DeviceSpec& spec = specs[i];
+    if (find(spec.kind, spec.id) >= 0) {
+      count_ = 0;
+      return false;
+    }
+    kind_[count_] = spec.kind;
+    id_[count_] = spec.id;
+    pin_[count_] = spec.pin;
+    span_[count_] = spec.span;
+    state_[count_] = spec.initial;
+    target_[count_] = spec.initial;
+    version_[count_] = 0;
+    acked_[count_] = (uint16_t)-1;
+    count_++;
+  }
+  return true;
+}
+
+void DeviceRegistry::forgetAcks() {
+  for (int slot = 0; slot < count_; slot++) acked_[slot] = (uint16_t)(version_[slot] - 1);
+}
+
+int DeviceRegistry::find(StatusTopic kind, int id) const {
+  for (int slot = 0; slot < count_; slot++) {
+    if (id_[slot] == id && kind_[slot] == kind) return slot;
+  }
+  return -1;
+}
+
+size_t DeviceRegistry::formatState(int slot, char* out, size_t size) const {
+  if (size == 0) return 0;
+  uint32_t value = state_[slot];
+  char rgb[DEVICE_STATE_TEXT_MAX];
+  const char* text = nullptr;
+  switch (kind_[slot]) {
+    case STATUS_DOOR:
+      text = value ? "OPEN" : "CLOSED";
+      break;
+    case STATUS_RGB:
+      formatRgb(rgb, value);
+      text = rgb;
+      break;
+    default:
+      text = value ? "ON" : "OFF";
+      break;
+  }
+  // A short buffer gets the text cut, still NUL-terminated.
+  size_t len = strlen(text);
+  if (len >= size) len = size - 1;
+  memcpy(out, text, len);
+  out[len] = '\0';
+  return len;
+}
@@ -0,0 +1,81 @@
+// Table of the house's actuators: doors, alarms, fans and RGB lights.
+//
+// One entry per device, stored as parallel arrays (struct of arrays) so that a
+// pass over one column - "which states changed since they were published" -
+// touches only that column. Each entry holds the device's kind (its status
+// topic kind), ID, output pin, current state, the target state last commanded,
+// a version bumped on every state change and the version the broker is known
+// to hold (see state_sync.h).
+//
+// States are one uint32_t per device: 0/1 for doors (closed/open), fans and
+// alarms (off/on), 0xRRGGBB for RGB lights. For an RGB light, pin is its first
+// pixel on the strip and span the number of pixels it owns.
+//
+// Alarm 1 shares its number with climate sensor 1, so entries are looked up by
+// (kind, id), not by ID alone. The table is built once in setup() and never
+// allocates.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "topic_table.h"
+
+#define DEVICE_MAX 16
+#define DEVICE_NO_PIN 0xFF
+#define DEVICE_STATE_TEXT_MAX 12      // "255,255,255" + NUL
+
+struct DeviceSpec {
+  StatusTopic kind;
+  uint8_t id;
+  uint8_t pin;
+  uint8_t span;
+  uint32_t initial;
+};
+
+class DeviceRegistry {
+ public:
+  // False (and an empty table) if there are more than DEVICE_MAX specs or
+  // one (kind, id) appears twice.
+  bool build(const DeviceSpec* specs, size_t count);
+
+  int find(StatusTopic kind, int id) const;   // slot, or -1
+  size_t count() const { return count_; }
+
+  StatusTopic kind(int slot) const { return (StatusTopic)kind_[slot]; }
+  int id(int slot) const { return id_[slot]; }
+  uint8_t pin(int slot) const { return pin_[slot]; }
+  uint8_t span(int slot) const { return span_[slot]; }
+  uint32_t state(int slot) const { return state_[slot]; }
+  uint32_t target(int slot) const { return target_[slot]; }
+  uint16_t version(int slot) const { return version_[slot]; }
+
+  void setTarget(int slot, uint32_t value) { target_[slot] = value; }
+  // The hardware now shows the target; a change bumps the version.
+  void applied(int slot) {
+    if (state_[slot] != target_[slot]) version_[slot]++;
+    state_[slot] = target_[slot];
+  }
+
+  // The broker holds this slot's state as of version.
+  void acknowledge(int slot, uint16_t version) { acked_[slot] = version; }
+  bool unacked(int slot) const { return acked_[slot] != version_[slot]; }
+  // Every slot unacknowledged, e.g. after the broker session was lost.
+  void forgetAcks();
+
+  // The status payload for the current state: OPEN/CLOSED, ON/OFF or r,g,b.
+  // Returns its length; DEVICE_STATE_TEXT_MAX holds any state, a shorter
+  // buffer gets it cut.
+  size_t formatState(int slot, char* out, size_t size) const;
+
+ private:
+  uint8_t count_ = 0;
+  uint8_t kind_[DEVICE_MAX];
+  uint8_t id_[DEVICE_MAX];
+  uint8_t pin_[DEVICE_MAX];
+  uint8_t span_[DEVICE_MAX];
+  uint32_t state_[DEVICE_MAX];
+  uint32_t target_[DEVICE_MAX];
+  uint16_t version_[DEVICE_MAX];
+  uint16_t acked_[DEVICE_MAX];
+};
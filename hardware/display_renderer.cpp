@@ -0,0 +1,98 @@
+#include "display_renderer.h"
+
+#include <string.h>
+
+PixelRenderer::PixelRenderer(Adafruit_NeoPixel& strip, uint16_t count)
+    : strip_(strip), count_(count < RENDER_MAX_PIXELS ? count : RENDER_MAX_PIXELS) {}
+
+void PixelRenderer::set(uint16_t index, uint32_t color) {
+  if (index >= count_) return;
+  frame_[index] = color;
+  uint16_t bit = (uint16_t)(1u << index);
+  if (color != shown_[index]) {
+    dirty_ |= bit;
+  } else {
+    dirty_ &= (uint16_t)~bit;
+  }
+}
+
+void PixelRenderer::fill(uint32_t color) {
+  for (uint16_t i = 0; i < count_; i++) set(i, color);
+}
+
+bool PixelRenderer::flush() {
+  if (!dirty_) return false;
+  for (uint16_t i = 0; i < count_; i++) {
+    if (dirty_ & (1u << i)) {
+      strip_.setPixelColor(i, frame_[i]);
+      shown_[i] = frame_[i];
+    }
+  }
+  dirty_ = 0;
+  strip_.show();
+  shows_++;
+  return true;
+}
+
+LcdRenderer::LcdRenderer(LiquidCrystal_I2C& lcd) : lcd_(lcd) { reset(); }
+
+void LcdRenderer::reset() {
+  memset(frame_, ' ', sizeof(frame_));
+  memset(shown_, ' ', sizeof(shown_));
+  memset(dirty_, 0, sizeof(dirty_));
+  cursorCol_ = cursorRow_ = -1;
+}
+
+void LcdRenderer::put(uint8_t col, uint8_t row, char c) {
+  if (col >= RENDER_LCD_COLS || row >= RENDER_LCD_ROWS) return;
+  frame_[row][col] = c;
+  uint16_t bit = (uint16_t)(1u << col);
+  if (c != shown_[row][col]) {
+    dirty_[row] |= bit;
+  } else {
+    dirty_[row] &= (uint16_t)~bit;
+  }
+}
+
+void LcdRenderer::print(uint8_t col, uint8_t row, const char* text) {
+  for (; *text && col < RENDER_LCD_COLS; text++, col++) put(col, row, *text);
+}
+
+void LcdRenderer::field(uint8_t col, uint8_t row, uint8_t width, const char* text) {
+  for (uint8_t i = 0; i < width; i++) {
+    put(col + i, row, *text ? *text++ : ' ');
+  }
+}
+
+void LcdRenderer::clear() {
+  for (uint8_t row = 0; row < RENDER_LCD_ROWS; row++) field(0, row, RENDER_LCD_COLS, "");
+}
+
+bool LcdRenderer::dirty() const {
+  for (uint8_t row = 0; row < RENDER_LCD_ROWS; row++) {
+    if (dirty_[row]) return true;
+  }
+  return false;
+}
+
+size_t LcdRenderer::flush(size_t budgetBytes) {
+  size_t sent = 0;
+  for (uint8_t row = 0; row < RENDER_LCD_ROWS; row++) {
+    for (uint8_t col = 0; col < RENDER_LCD_COLS && dirty_[row]; col++) {
+      if (!(dirty_[row] & (1u << col))) continue;
+      bool move = cursorRow_ != row || cursorCol_ != col;
+      if (sent + (move ? 2 : 1) > budgetBytes) return sent;
+      if (move) {
+        lcd_.setCursor(col, row);
+        sent++;
+      }
+      lcd_.write((uint8_t)frame_[row][col]);
+      sent++;
+      shown_[row][col] = frame_[row][col];
+      dirty_[row] &= (uint16_t)~(1u << col);
+      cursorRow_ = row;
+      cursorCol_ = col + 1;
+    }
+  }
+  return sent;
+}
@@ -0,0 +1,78 @@
+// Framebuffers for the NeoPixel strip and the 16x2 LCD.
+//
+// Firmware code draws into RAM only: set()/fill() for pixels, print()/field()
+// for LCD cells. Each cell and pixel remembers what the device currently
+// shows, so drawing the same thing again costs nothing and flush() sends only
+// what changed. flush() is called from a low-priority scheduler task, never
+// from a command handler, so a command is not held up by a strip latch or an
+// I2C transfer.
+//
+// The strip is a shift register: one show() clocks out every pixel, so a dirty
+// pixel still costs a full frame, but an unchanged strip costs no show() at
+// all. LCD cells are written in runs, with a cursor move only where the run
+// does not continue from the last write, and at most budgetBytes I2C bytes per
+// flush() (about 0.55 ms per byte through the PCF8574 expander).
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Adafruit_NeoPixel.h>
+#include <LiquidCrystal_I2C.h>
+
+#define RENDER_MAX_PIXELS 16
+#define RENDER_LCD_COLS 16
+#define RENDER_LCD_ROWS 2
+
+class PixelRenderer {
+ public:
+  PixelRenderer(Adafruit_NeoPixel& strip, uint16_t count);
+
+  void set(uint16_t index, uint32_t color);
+  void fill(uint32_t color);
+  uint32_t get(uint16_t index) const { return index < count_ ? frame_[index] : 0; }
+
+  bool dirty() const { return dirty_ != 0; }
+  // Pushes changed pixels and latches the strip. False if nothing changed.
+  bool flush();
+  uint32_t shows() const { return shows_; }
+
+ private:
+  Adafruit_NeoPixel& strip_;
+  uint16_t count_;
+  uint32_t frame_[RENDER_MAX_PIXELS] = {};
+  uint32_t shown_[RENDER_MAX_PIXELS] = {};   // strip is cleared by begin()
+  uint16_t dirty_ = 0;                      // one bit per pixel
+  uint32_t shows_ = 0;
+};
+
+class LcdRenderer {
+ public:
+  explicit LcdRenderer(LiquidCrystal_I2C& lcd);
+
+  // Call after lcd.clear(): the display shows blanks, the frame is blank.
+  void reset();
+
+  // Writes text at (col, row), clipped at the right edge.
+  void print(uint8_t col, uint8_t row, const char* text);
+  // text left-aligned in a width-cell field, the rest blanked.
+  void field(uint8_t col, uint8_t row, uint8_t width, const char* text);
+  void clear();   // blanks the whole frame
+
+  bool dirty() const;
+  // Sends changed cells, at most budgetBytes I2C bytes (cursor moves
+  // included). Returns the bytes sent.
+  size_t flush(size_t budgetBytes);
+
+  char cell(uint8_t col, uint8_t row) const { return frame_[row][col]; }
+
+ private:
+  void put(uint8_t col, uint8_t row, char c);
+
+  LiquidCrystal_I2C& lcd_;
+  char frame_[RENDER_LCD_ROWS][RENDER_LCD_COLS];
+  char shown_[RENDER_LCD_ROWS][RENDER_LCD_COLS];
+  uint16_t dirty_[RENDER_LCD_ROWS] = {};    // one bit per column
+  int8_t cursorCol_ = -1;                   // -1: unknown, move before writing
+  int8_t cursorRow_ = -1;
+};
@@ -0,0 +1,237 @@
+#include "firmware_delta.h"
+
+#include <string.h>
+
+static uint32_t readU32(const uint8_t* p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void writeU32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+const char* deltaResultName(DeltaResult result) {
+  switch (result) {
+    case DELTA_MORE: return "more";
+    case DELTA_DONE: return "done";
+    case DELTA_BAD_HEADER: return "bad header";
+    case DELTA_BAD_BASE: return "bad base";
+    case DELTA_CORRUPT: return "corrupt";
+    case DELTA_IO_ERROR: return "io error";
+    case DELTA_BAD_HASH: return "bad hash";
+  }
+  return "?";
+}
+
+void encodeDeltaHeader(const DeltaHeader& header, uint8_t* out) {
+  writeU32(out, DELTA_MAGIC);
+  out[4] = DELTA_VERSION;
+  out[5] = out[6] = out[7] = 0;
+  writeU32(out + 8, header.baseSize);
+  writeU32(out + 12, header.targetSize);
+  memcpy(out + 16, header.baseSha, SHA256_SIZE);
+  memcpy(out + 16 + SHA256_SIZE, header.targetSha, SHA256_SIZE);
+}
+
+bool decodeDeltaHeader(const uint8_t* data, size_t length, DeltaHeader& out) {
+  if (length < DELTA_HEADER_SIZE || readU32(data) != DELTA_MAGIC || data[4] != DELTA_VERSION) {
+    return false;
+  }
+  out.baseSize = readU32(data + 8);
+  out.targetSize = readU32(data + 12);
+  memcpy(out.baseSha, data + 16, SHA256_SIZE);
+  memcpy(out.targetSha, data + 16 + SHA256_SIZE, SHA256_SIZE);
+  return out.targetSize != 0;
+}
+
+void DeltaPatcher::begin(DeltaReadFn read, DeltaWriteFn write, void* ctx) {
+  read_ = read;
+  write_ = write;
+  ctx_ = ctx;
+  header_ = DeltaHeader();
+  sha_.begin();
+  phase_ = PHASE_HEADER;
+  result_ = DELTA_MORE;
+  varintShift_ = 0;
+  varint_ = 0;
+  remaining_ = baseNext_ = produced_ = patchBytes_ = 0;
+  buffered_ = 0;
+}
+
+DeltaResult DeltaPatcher::end(DeltaResult result) {
+  result_ = result;
+  return result;
+}
+
+bool DeltaPatcher::flush() {
+  if (buffered_ == 0) return true;
+  sha_.update(buffer_, buffered_);
+  bool ok = write_(ctx_, buffer_, buffered_);
+  buffered_ = 0;
+  return ok;
+}
+
+// Accumulates one LEB128 varint; true once its last byte is in.
+bool DeltaPatcher::readVarint(const uint8_t* data, size_t length, size_t* pos) {
+  while (*pos < length) {
+    uint8_t b = data[(*pos)++];
+    varint_ |= (uint64_t)(b & 0x7F) << varintShift_;
+    varintShift_ += 7;
+    if (!(b & 0x80)) return true;
+    if (varintShift_ > 35) {   // longer than any u32 needs
+      varintShift_ = 0xFF;
+      return true;
+    }
+  }
+  return false;
+}
+
+DeltaResult DeltaPatcher::opDone() {
+  if (produced_ < header_.targetSize) {
+    phase_ = PHASE_OP;
+    return DELTA_MORE;
+  }
+  phase_ = PHASE_END;
+  if (!flush()) return end(DELTA_IO_ERROR);
+  uint8_t digest[SHA256_SIZE];
+  sha_.finish(digest);
+  return end(memcmp(digest, header_.targetSha, SHA256_SIZE) == 0 ? DELTA_DONE : DELTA_BAD_HASH);
+}
+
+void DeltaPatcher::advance(uint32_t n, size_t* output) {
+  buffered_ += (uint16_t)n;
+  produced_ += n;
+  remaining_ -= n;
+  *output += n;
+  if (buffered_ == DELTA_BUFFER_SIZE && !flush()) {
+    end(DELTA_IO_ERROR);
+    return;
+  }
+  if (remaining_ == 0) opDone();
+}
+
+DeltaResult DeltaPatcher::feed(const uint8_t* data, size_t length, size_t* used,
+                               size_t maxOutput) {
+  size_t pos = 0;
+  size_t output = 0;
+  *used = 0;
+  if (result_ != DELTA_MORE) return result_;
+
+  while (result_ == DELTA_MORE && output < maxOutput) {
+    uint32_t room = DELTA_BUFFER_SIZE - buffered_;
+    switch (phase_) {
+      case PHASE_HEADER: {
+        size_t n = DELTA_HEADER_SIZE - buffered_;
+        if (n > length - pos) n = length - pos;
+        memcpy(buffer_ + buffered_, data + pos, n);
+        buffered_ += (uint16_t)n;
+        pos += n;
+        if (buffered_ < DELTA_HEADER_SIZE) break;
+        buffered_ = 0;
+        if (!decodeDeltaHeader(buffer_, DELTA_HEADER_SIZE, header_)) {
+          end(DELTA_BAD_HEADER);
+          break;
+        }
+        phase_ = PHASE_BASE;
+        remaining_ = header_.baseSize;
+        break;
+      }
+      case PHASE_BASE: {
+        uint32_t n = remaining_ < DELTA_BUFFER_SIZE ? remaining_ : DELTA_BUFFER_SIZE;
+        if (n > 0 && !read_(ctx_, header_.baseSize - remaining_, buffer_, n)) {
+          end(DELTA_IO_ERROR);
+          break;
+        }
+        sha_.update(buffer_, n);
+        remaining_ -= n;
+        output += n;
+        if (remaining_ > 0) break;
+        uint8_t digest[SHA256_SIZE];
+        sha_.finish(digest);
+        if (memcmp(digest, header_.baseSha, SHA256_SIZE) != 0) {
+          end(DELTA_BAD_BASE);
+          break;
+        }
+        sha_.begin();
+        phase_ = PHASE_OP;
+        break;
+      }
+      case PHASE_OP: {
+        if (!readVarint(data, length, &pos)) break;
+        uint64_t v = varint_;
+        bool overlong = varintShift_ == 0xFF;
+        varint_ = 0;
+        varintShift_ = 0;
+        remaining_ = (uint32_t)(v >> 2);
+        if (overlong || remaining_ == 0 || remaining_ > header_.targetSize - produced_) {
+          end(DELTA_CORRUPT);
+          break;
+        }
+        switch (v & 3) {
+          case DELTA_COPY: phase_ = PHASE_OFFSET; break;
+          case DELTA_ADD: phase_ = PHASE_ADD; break;
+          case DELTA_FILL: phase_ = PHASE_FILL_BYTE; break;
+          default: end(DELTA_CORRUPT); break;
+        }
+        break;
+      }
+      case PHASE_OFFSET: {
+        if (!readVarint(data, length, &pos)) break;
+        bool overlong = varintShift_ == 0xFF;
+        int64_t delta = (int64_t)(varint_ >> 1) ^ -(int64_t)(varint_ & 1);
+        varint_ = 0;
+        varintShift_ = 0;
+        int64_t start = (int64_t)baseNext_ + delta;
+        if (overlong || start < 0 || start + remaining_ > (int64_t)header_.baseSize) {
+          end(DELTA_CORRUPT);
+          break;
+        }
+        baseNext_ = (uint32_t)start;
+        phase_ = PHASE_COPY;
+        break;
+      }
+      case PHASE_COPY: {
+        uint32_t n = remaining_ < room ? remaining_ : room;
+        if (!read_(ctx_, baseNext_, buffer_ + buffered_, n)) {
+          end(DELTA_IO_ERROR);
+          break;
+        }
+        baseNext_ += n;
+        advance(n, &output);
+        break;
+      }
+      case PHASE_ADD: {
+        uint32_t n = remaining_ < room ? remaining_ : room;
+        if (n > length - pos) n = (uint32_t)(length - pos);
+        memcpy(buffer_ + buffered_, data + pos, n);
+        pos += n;
+        advance(n, &output);
+        break;
+      }
+      case PHASE_FILL_BYTE:
+        if (pos < length) {
+          fillByte_ = data[pos++];
+          phase_ = PHASE_FILL;
+        }
+        break;
+      case PHASE_FILL: {
+        uint32_t n = remaining_ < room ? remaining_ : room;
+        memset(buffer_ + buffered_, fillByte_, n);
+        advance(n, &output);
+        break;
+      }
+      case PHASE_END:
+        break;
+    }
+    // Input phases stop when the input runs out; the others need none.
+    bool needsInput = phase_ != PHASE_BASE && phase_ != PHASE_COPY && phase_ != PHASE_FILL;
+    if (needsInput && pos == length) break;
+  }
+  if (result_ == DELTA_DONE && pos < length) end(DELTA_CORRUPT);   // bytes past the end
+  patchBytes_ += (uint32_t)pos;
+  *used = pos;
+  return result_;
+}
@@ -0,0 +1,121 @@
+// Binary delta between two firmware images, applied as a stream.
+//
+// A patch lists how to rebuild the new (target) image from the running
+// (base) one: copy a run of base bytes, add literal bytes, or fill a run with
+// one byte. Code that did not change, or only moved, costs a few bytes per
+// run, and the 0xFF padding of an image costs one op; only new code is sent
+// in full. Patches are made on the host (host/delta_encoder.h).
+//
+// Patch layout, little-endian, version 1:
+//   u32 magic "YOD1" | u8 version | u8 reserved[3]
+//   u32 base size | u32 target size
+//   u8[32] SHA-256 of the base image | u8[32] SHA-256 of the target image
+//   ops, until the target is complete. Each starts with a varint (LEB128) v;
+//   the op is v & 3 and its length v >> 2:
+//     DELTA_COPY  a zigzag varint follows: where the copy starts in the base,
+//                 relative to where the previous copy ended
+//     DELTA_ADD   length literal bytes follow
+//     DELTA_FILL  one byte follows, repeated length times
+//
+// DeltaPatcher takes the patch in pieces of any size (MQTT messages, HTTP
+// chunks), reads the base and writes the target through callbacks, and holds
+// nothing but one DELTA_BUFFER_SIZE buffer and a running SHA-256. Before
+// writing anything it hashes the first base-size bytes of the base: a patch
+// made from another image is refused. The result only counts if its hash is
+// the one the header promised.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sha256.h"
+
+#define DELTA_MAGIC 0x31444F59u       // "YOD1"
+#define DELTA_VERSION 1
+#define DELTA_HEADER_SIZE (16 + 2 * SHA256_SIZE)
+#define DELTA_BUFFER_SIZE 256         // base reads and target writes go through it
+
+enum DeltaOp : uint8_t {
+  DELTA_COPY,
+  DELTA_ADD,
+  DELTA_FILL,
+};
+
+enum DeltaResult : uint8_t {
+  DELTA_MORE,         // everything given was used (or the output budget): feed more
+  DELTA_DONE,         // target complete, hash matches
+  DELTA_BAD_HEADER,   // not a patch, or an unknown version
+  DELTA_BAD_BASE,     // made from another image than the running one
+  DELTA_CORRUPT,      // an op outside the base or the target, or bytes past the end
+  DELTA_IO_ERROR,     // a read or write callback failed
+  DELTA_BAD_HASH,     // target complete but not the promised image
+};
+
+const char* deltaResultName(DeltaResult result);
+
+struct DeltaHeader {
+  uint32_t baseSize;
+  uint32_t targetSize;
+  uint8_t baseSha[SHA256_SIZE];
+  uint8_t targetSha[SHA256_SIZE];
+};
+
+// Both return false on failure; ctx is the pointer given to begin().
+typedef bool (*DeltaReadFn)(void* ctx, uint32_t offset, uint8_t* out, size_t length);
+typedef bool (*DeltaWriteFn)(void* ctx, const uint8_t* data, size_t length);
+
+// Header fields, for the encoder; out must hold DELTA_HEADER_SIZE bytes.
+void encodeDeltaHeader(const DeltaHeader& header, uint8_t* out);
+bool decodeDeltaHeader(const uint8_t* data, size_t length, DeltaHeader& out);
+
+class DeltaPatcher {
+ public:
+  // read() returns the base (running) image, write() takes the target in order.
+  void begin(DeltaReadFn read, DeltaWriteFn write, void* ctx);
+
+  // Applies the next length bytes of the patch. Returns once all of them are
+  // used or, if sooner, once maxOutput bytes were read from the base or
+  // produced in this call; *used says how many were taken. Call again with
+  // the rest (length 0 continues work that needs no input, see busy()).
+  DeltaResult feed(const uint8_t* data, size_t length, size_t* used, size_t maxOutput = SIZE_MAX);
+
+  bool headerRead() const { return phase_ > PHASE_HEADER; }
+  bool baseChecked() const { return phase_ > PHASE_BASE; }
+  // Work is left that needs no more patch bytes: hashing the base, or the
+  // rest of a copy or fill.
+  bool busy() const {
+    return result_ == DELTA_MORE &&
+           (phase_ == PHASE_BASE || phase_ == PHASE_COPY || phase_ == PHASE_FILL);
+  }
+  const DeltaHeader& header() const { return header_; }
+  uint32_t patchBytes() const { return patchBytes_; }    // taken so far
+  uint32_t targetBytes() const { return produced_; }     // produced so far
+  DeltaResult result() const { return result_; }
+
+ private:
+  enum Phase : uint8_t { PHASE_HEADER, PHASE_BASE, PHASE_OP, PHASE_OFFSET, PHASE_COPY,
+                         PHASE_ADD, PHASE_FILL_BYTE, PHASE_FILL, PHASE_END };
+
+  bool readVarint(const uint8_t* data, size_t length, size_t* pos);
+  bool flush();
+  DeltaResult end(DeltaResult result);
+  DeltaResult opDone();
+  void advance(uint32_t n, size_t* output);   // n more target bytes in buffer_
+
+  DeltaReadFn read_ = nullptr;
+  DeltaWriteFn write_ = nullptr;
+  void* ctx_ = nullptr;
+  DeltaHeader header_ = {};
+  Sha256 sha_;
+  Phase phase_ = PHASE_HEADER;
+  DeltaResult result_ = DELTA_MORE;
+  uint8_t varintShift_ = 0;
+  uint8_t fillByte_ = 0;
+  uint64_t varint_ = 0;
+  uint32_t remaining_ = 0;    // of the current op, or of the base to hash
+  uint32_t baseNext_ = 0;     // where the previous copy ended
+  uint32_t produced_ = 0;
+  uint32_t patchBytes_ = 0;
+  uint16_t buffered_ = 0;     // bytes in buffer_; the header while it arrives
+  uint8_t buffer_[DELTA_BUFFER_SIZE];
+};
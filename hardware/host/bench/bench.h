@@ -0,0 +1,69 @@
+// Small measurement helpers shared by the host benchmarks.
+//
+// Every row reports two clocks: host CPU time per call (what the code costs to
+// execute, useful for relative comparisons) and virtual time per call (how
+// long the firmware would sit blocked on modeled device I/O: I2C, NeoPixel,
+// network round trips, delay()).
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <functional>
+
+#include "board_sim.h"
+
+namespace bench {
+
+struct Result {
+  const char* name = "";
+  uint64_t calls = 0;
+  double hostNsPerCall = 0;
+  double virtualUsPerCall = 0;
+  double allocsPerCall = 0;
+  double publishesPerCall = 0;
+  double wireBytesPerCall = 0;
+};
+
+inline Result measure(const char* name, uint64_t calls, const std::function<void(uint64_t)>& fn) {
+  Result r;
+  r.name = name;
+  r.calls = calls;
+  uint64_t allocs0 = sim::heap().allocs;
+  uint64_t virt0 = sim::nowUs();
+  sim::BrokerStats b0 = sim::broker().stats();
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < calls; ++i) fn(i);
+  auto t1 = std::chrono::steady_clock::now();
+  sim::BrokerStats b1 = sim::broker().stats();
+  double n = calls ? (double)calls : 1.0;
+  r.hostNsPerCall = std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+  r.virtualUsPerCall = (double)(sim::nowUs() - virt0) / n;
+  r.allocsPerCall = (double)(sim::heap().allocs - allocs0) / n;
+  r.publishesPerCall = (double)(b1.publishes - b0.publishes) / n;
+  r.wireBytesPerCall = (double)(b1.wireBytes - b0.wireBytes) / n;
+  return r;
+}
+
+inline void printHeader(const char* title) {
+  printf("\n== %s ==\n", title);
+  printf("%-34s %9s %12s %14s %10s %10s %11s\n", "path", "calls", "host ns/call",
+         "virtual us/call", "allocs", "publishes", "wire B");
+}
+
+inline void print(const Result& r) {
+  printf("%-34s %9llu %12.0f %14.1f %10.2f %10.2f %11.1f\n", r.name, (unsigned long long)r.calls,
+         r.hostNsPerCall, r.virtualUsPerCall, r.allocsPerCall, r.publishesPerCall,
+         r.wireBytesPerCall);
+}
+
+inline bool hasFlag(int argc, char** argv, const char* flag) {
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], flag) == 0) return true;
+  }
+  return false;
+}
+
+}  // namespace bench
@@ -0,0 +1,194 @@
+// Firmware deltas on synthetic ~1 MB app images: patch size against the full
+// image, encode and apply throughput on the host, the RAM the patcher needs,
+// and how long the device would spend writing the update to its app slot.
+//
+//   delta_bench [--quick]
+//
+// The images stand in for real builds: code made of a few hundred recurring
+// instruction words, every 16th word an absolute address into the image
+// (literal pools, vtables), 0xFF padding to a 4 KB boundary. Cases:
+//   edit        a constant changed in place
+//   insertion   2 KB of new code in the middle, everything after it moved
+//   relocation  the insertion, plus every address past it shifted, as a
+//               linker does it
+//   unrelated   a different image: the worst case, close to a full image
+// "device" is the OtaUpdater on the simulated app slots (flash writes and
+// sector erases on the virtual clock), without the MQTT transfer itself.
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "board_sim.h"
+#include "delta_encoder.h"
+#include "firmware_delta.h"
+#include "ota_update.h"
+
+namespace {
+
+const uint32_t kImageBase = 0x400D0000;   // where the app is mapped
+
+struct Image {
+  std::vector<uint8_t> bytes;
+  std::vector<size_t> addressAt;   // offsets of the address words
+};
+
+Image makeImage(size_t codeBytes, uint32_t seed) {
+  Image image;
+  image.bytes.push_back(0xE9);
+  while (image.bytes.size() % 4) image.bytes.push_back(0);
+  uint32_t x = seed;
+  size_t words = 0;
+  while (image.bytes.size() < codeBytes) {
+    x = x * 1103515245u + 12345u;
+    uint32_t word = (x >> 8) % 300 * 0x01000193u;
+    if (++words % 16 == 0) {
+      image.addressAt.push_back(image.bytes.size());
+      word = kImageBase + (x >> 4) % (uint32_t)codeBytes / 4 * 4;
+    }
+    for (int i = 0; i < 4; i++) image.bytes.push_back((uint8_t)(word >> (8 * i)));
+  }
+  while (image.bytes.size() % 4096) image.bytes.push_back(0xFF);
+  return image;
+}
+
+void put32(std::vector<uint8_t>& bytes, size_t at, uint32_t v) {
+  for (int i = 0; i < 4; i++) bytes[at + i] = (uint8_t)(v >> (8 * i));
+}
+
+uint32_t get32(const std::vector<uint8_t>& bytes, size_t at) {
+  return (uint32_t)bytes[at] | (uint32_t)bytes[at + 1] << 8 | (uint32_t)bytes[at + 2] << 16 |
+         (uint32_t)bytes[at + 3] << 24;
+}
+
+std::vector<uint8_t> insertCode(const Image& base, size_t at, bool relocate) {
+  const size_t kInserted = 2048;
+  Image added = makeImage(kInserted, 77);
+  std::vector<uint8_t> out = base.bytes;
+  if (relocate) {
+    for (size_t word : base.addressAt) {
+      uint32_t address = get32(out, word);
+      if (address - kImageBase >= at) put32(out, word, address + (uint32_t)kInserted);
+    }
+  }
+  out.insert(out.begin() + at, added.bytes.begin() + 4, added.bytes.begin() + 4 + kInserted);
+  return out;
+}
+
+struct Memory {
+  const std::vector<uint8_t>* base;
+  std::vector<uint8_t> out;
+};
+
+bool readBase(void* ctx, uint32_t offset, uint8_t* out, size_t length) {
+  const std::vector<uint8_t>& base = *((Memory*)ctx)->base;
+  if (offset + length > base.size()) return false;
+  memcpy(out, base.data() + offset, length);
+  return true;
+}
+
+bool writeTarget(void* ctx, const uint8_t* data, size_t length) {
+  std::vector<uint8_t>& out = ((Memory*)ctx)->out;
+  out.insert(out.end(), data, data + length);
+  return true;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Applies the patch the way the device does: OTA_CHUNK_MAX bytes per message,
+// OTA_STEP_BYTES per step(). Returns virtual ms, or -1 if it did not apply.
+double deviceApply(const std::vector<uint8_t>& base, const std::vector<uint8_t>& patch,
+                   uint64_t* allocs, double* longestStepMs) {
+  sim::resetBoard();
+  sim::ota().image[0] = base;
+  OtaUpdater updater;
+  updater.begin(0);
+  uint64_t start = sim::nowUs();
+  uint64_t allocs0 = sim::heap().allocs;
+  uint64_t longest = 0;
+  uint32_t offset = 0;
+  OtaEvent event = OTA_NEXT;
+  std::string message;
+  while (event == OTA_NEXT) {
+    {
+      sim::UncountedHeap guard;
+      message.assign(OTA_CHUNK_HEADER, '\0');
+      for (int i = 0; i < 4; i++) message[i] = (char)(offset >> (8 * i));
+      size_t n = patch.size() - offset < OTA_CHUNK_MAX ? patch.size() - offset : OTA_CHUNK_MAX;
+      message.append((const char*)patch.data() + offset, n);
+    }
+    event = updater.receive((const uint8_t*)message.data(), message.size());
+    while (updater.pending()) {
+      uint64_t stepStart = sim::nowUs();
+      event = updater.step();
+      if (sim::nowUs() - stepStart > longest) longest = sim::nowUs() - stepStart;
+    }
+    offset = updater.nextOffset();
+  }
+  *allocs = sim::heap().allocs - allocs0;
+  *longestStepMs = longest / 1000.0;
+  return event == OTA_APPLIED ? (sim::nowUs() - start) / 1000.0 : -1;
+}
+
+void runCase(const char* name, const std::vector<uint8_t>& base,
+             const std::vector<uint8_t>& target, int rounds) {
+  DeltaEncodeStats stats;
+  std::vector<uint8_t> patch;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++) patch = makeFirmwareDelta(base, target, &stats);
+  double encodeMBs = target.size() * (double)rounds / secondsSince(start) / 1e6;
+
+  Memory memory{&base, {}};
+  memory.out.reserve(target.size());
+  DeltaResult result = DELTA_MORE;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++) {
+    memory.out.clear();
+    DeltaPatcher patcher;
+    patcher.begin(readBase, writeTarget, &memory);
+    size_t used;
+    result = patcher.feed(patch.data(), patch.size(), &used);
+  }
+  double applyMBs = target.size() * (double)rounds / secondsSince(start) / 1e6;
+  bool ok = result == DELTA_DONE && memory.out == target;
+
+  uint64_t allocs;
+  double longestStepMs;
+  double deviceMs = deviceApply(base, patch, &allocs, &longestStepMs);
+  printf("%-11s %8zu %8zu %6.2f%% %7zu %9.1f %9.1f %9.0f %7.1f %7llu %s\n", name, target.size(),
+         patch.size(), 100.0 * patch.size() / target.size(), stats.copies, encodeMBs, applyMBs,
+         deviceMs, longestStepMs, (unsigned long long)allocs,
+         ok && deviceMs >= 0 ? "ok" : "MISMATCH");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool quick = bench::hasFlag(argc, argv, "--quick");
+  size_t codeBytes = quick ? 256 * 1024 : 1000 * 1000;
+  int rounds = quick ? 1 : 5;
+
+  Image base = makeImage(codeBytes, 1);
+  std::vector<uint8_t> edit = base.bytes;
+  put32(edit, codeBytes / 3 / 4 * 4, 0x12345678);
+  size_t middle = codeBytes / 2 / 4 * 4;
+
+  printf("\n== firmware delta, %zu byte images ==\n", base.bytes.size());
+  printf("%-11s %8s %8s %7s %7s %9s %9s %9s %7s %7s\n", "case", "image B", "patch B", "ratio",
+         "copies", "enc MB/s", "app MB/s", "device ms", "step ms", "allocs");
+  runCase("edit", base.bytes, edit, rounds);
+  runCase("insertion", base.bytes, insertCode(base, middle, false), rounds);
+  runCase("relocation", base.bytes, insertCode(base, middle, true), rounds);
+  runCase("unrelated", base.bytes, makeImage(codeBytes, 2).bytes, rounds);
+
+  printf("\npatcher RAM: DeltaPatcher %zu B (buffer %d B + SHA-256 state), OtaUpdater %zu B "
+         "(chunk %d B); no heap\n",
+         sizeof(DeltaPatcher), DELTA_BUFFER_SIZE, sizeof(OtaUpdater), OTA_CHUNK_MAX);
+  printf("encoder RAM (host): index %zu KB + the patch\n", ((size_t)4 << 20) / 1024);
+  return 0;
+}
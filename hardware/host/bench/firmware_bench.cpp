@@ -0,0 +1,215 @@
+// Benchmarks the firmware's hot paths on the simulated board: command
+// dispatch through callback(), the sensor publish cycle, reconnecting, and
+// command-to-actuation latency.
+//
+//   firmware_bench [--quick]
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "board_sim.h"
+#include "sketch.h"
+#include "topic_table.h"
+
+// Earlier implementations, see legacy_firmware.cpp.
+void legacyCallback(char* topic, byte* payload, unsigned int length);
+void legacyReconnect();
+
+namespace {
+
+typedef void (*Callback)(char*, byte*, unsigned int);
+
+std::string controlTopic() { return std::string("yolouno/") + HOUSE_ID + "/controls"; }
+
+bench::Result dispatch(const char* name, const char* deviceCommand, uint64_t calls,
+                       Callback cb = callback) {
+  std::string topic = controlTopic();
+  std::string message = std::string(HOUSE_ID) + ":" + deviceCommand;
+  std::vector<char> topicBuf(topic.begin(), topic.end());
+  topicBuf.push_back(0);
+  std::vector<byte> payload(message.begin(), message.end());
+  return bench::measure(name, calls, [&](uint64_t) {
+    cb(topicBuf.data(), payload.data(), (unsigned int)payload.size());
+  });
+}
+
+// Same command mix through both dispatchers; prints messages/sec.
+void compareDispatch(uint64_t calls) {
+  static const char* mix[] = {"door:7:open", "fan:11:ON", "rgb:15:255,0,128", "alarm:1:OFF",
+                              "fan:12:off", "door:20:open", "heater:1:ON"};
+  const size_t mixCount = sizeof(mix) / sizeof(mix[0]);
+  printf("\n== command dispatch: String-based vs zero-allocation parser ==\n");
+  printf("%-26s %14s %14s %12s\n", "dispatcher", "msgs/sec", "allocs/msg", "virtual us");
+  struct Variant {
+    const char* name;
+    Callback cb;
+  } variants[] = {{"before (String)", legacyCallback}, {"after (Token views)", callback}};
+  for (const Variant& v : variants) {
+    double ns = 0, allocs = 0, virt = 0;
+    for (size_t i = 0; i < mixCount; ++i) {
+      bench::Result r = dispatch(mix[i], mix[i], calls / mixCount, v.cb);
+      ns += r.hostNsPerCall;
+      allocs += r.allocsPerCall;
+      virt += r.virtualUsPerCall;
+    }
+    printf("%-26s %14.0f %14.2f %12.1f\n", v.name, 1e9 / (ns / mixCount), allocs / mixCount,
+           virt / mixCount);
+  }
+}
+
+// Cost of producing one status topic: the old double sprintf vs the table.
+void compareTopicLookup(uint64_t calls) {
+  static TopicTable table;
+  static const TopicIdRange ranges[STATUS_KIND_COUNT] = {
+    {7, 10}, {1, 1}, {11, 13}, {14, 16}, {1, 3}, {1, 3}, {4, 6},
+  };
+  table.build(HOUSE_ID, ranges);
+  volatile size_t sink = 0;
+  bench::printHeader("status topic: sprintf vs precomputed table");
+  bench::print(bench::measure("sprintf x2 into char[60]", calls, [&](uint64_t i) {
+    char topic[60];
+    char deviceIdStr[5];
+    sprintf(deviceIdStr, "%d", (int)(7 + i % 4));
+    snprintf(topic, sizeof(topic), "yolouno/%s/status/door/%s", HOUSE_ID, deviceIdStr);
+    sink = sink + (size_t)topic[sizeof(topic) - 10];
+  }));
+  bench::print(bench::measure("TopicTable::status()", calls, [&](uint64_t i) {
+    sink = sink + (size_t)table.status(STATUS_DOOR, (int)(7 + i % 4))[8];
+  }));
+}
+
+// Worst-case single loop iteration while the broker is down for 60 s:
+// the old MQTT step (blocking reconnect with delay(10000)) vs today's loop().
+void compareOutage(bool quick) {
+  const uint64_t outageUs = 60000000ULL;
+  const uint64_t windowUs = quick ? 90000000ULL : 180000000ULL;
+  printf("\n== loop during a 60 s broker outage ==\n");
+  printf("%-34s %16s %14s %12s\n", "variant", "worst iter (ms)", "iterations", "connects");
+
+  struct Variant {
+    const char* name;
+    void (*step)();
+  } variants[] = {
+    {"old loop MQTT step", [] {
+       static unsigned long lastMQTTTime = 0;
+       unsigned long now = millis();
+       if (now - lastMQTTTime >= 1000) {
+         lastMQTTTime = now;
+         if (!client.connected()) legacyReconnect();
+         client.loop();
+       }
+     }},
+    {"loop() with connection manager", [] { loop(); }},
+  };
+  for (const Variant& v : variants) {
+    runUntilConnected();
+    uint64_t start = sim::nowUs();
+    sim::broker().setOutage(start + 5000000ULL, start + 5000000ULL + outageUs);
+    uint64_t connects0 = sim::broker().stats().connects;
+    uint64_t worst = 0, iterations = 0;
+    while (sim::nowUs() - start < windowUs) {
+      uint64_t t0 = sim::nowUs();
+      v.step();
+      uint64_t dt = sim::nowUs() - t0;
+      if (dt > worst) worst = dt;
+      iterations++;
+      sim::advanceUs(100);
+    }
+    printf("%-34s %16.1f %14llu %12llu\n", v.name, worst / 1000.0, (unsigned long long)iterations,
+           (unsigned long long)(sim::broker().stats().connects - connects0));
+  }
+}
+
+// Fan command -> fan pin, arriving at random points of the task cycle, with
+// MQTT input pumped once a second (the old loop()) vs on every pass.
+void compareCommandLatency(bool quick) {
+  printf("\n== command to actuation latency ==\n");
+  printf("%-30s %10s %10s %10s %10s\n", "mqtt input", "p50 ms", "p99 ms", "max ms", "commands");
+  int mqtt = scheduler.find("mqtt");
+  const uint32_t periods[] = {1000, SCHED_EVERY_PASS};
+  for (uint32_t period : periods) {
+    scheduler.setPeriod(mqtt, period);
+    std::vector<uint64_t> us;
+    bool on = false;
+    for (int i = 0; i < (quick ? 50 : 1000); i++) {
+      on = !on;
+      us.push_back(commandLatencyUs(on ? "fan:11:ON" : "fan:11:OFF",
+                                    [on] { return sim::digitalLevel(6) == (on ? HIGH : LOW); },
+                                    (uint64_t)random(2000000)));
+    }
+    std::sort(us.begin(), us.end());
+    printf("%-30s %10.2f %10.2f %10.2f %10zu\n",
+           period ? "every 1000 ms (before)" : "every loop() pass", us[us.size() / 2] / 1000.0,
+           us[us.size() * 99 / 100] / 1000.0, us.back() / 1000.0, us.size());
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const bool quick = bench::hasFlag(argc, argv, "--quick");
+  const uint64_t n = quick ? 2000 : 200000;
+
+  setup();
+  runUntilConnected();
+  sim::broker().recordLog = false;
+
+  bench::printHeader("command dispatch: callback()");
+  bench::print(dispatch("door open", "door:7:open", n));
+  bench::print(dispatch("fan on", "fan:11:ON", n));
+  bench::print(dispatch("rgb on", "rgb:14:ON", n));
+  bench::print(dispatch("rgb R,G,B", "rgb:15:255,0,128", n));
+  bench::print(dispatch("alarm off", "alarm:1:OFF", n));
+  bench::print(dispatch("unknown device type", "heater:20:ON", n));
+  {
+    std::string topic = controlTopic();
+    std::vector<char> topicBuf(topic.begin(), topic.end());
+    topicBuf.push_back(0);
+    const char* other = "another-house:door:7:open";
+    bench::print(bench::measure("other house id", n, [&](uint64_t) {
+      callback(topicBuf.data(), (byte*)other, (unsigned int)strlen(other));
+    }));
+  }
+
+  compareDispatch(n);
+  compareTopicLookup(n * 10);
+
+  bench::printHeader("sensor publish cycle: publishSensorData()");
+  sim::setAnalog(2, 1234);
+  sim::setAnalog(3, 2345);
+  sim::setAnalog(4, 3456);
+  static const struct {
+    const char* name;
+    uint8_t mode;
+  } modes[] = {{"publishSensorData, text topics", 0},
+               {"publishSensorData, binary frame", 1},
+               {"publishSensorData, frame + topics", 2}};
+  for (const auto& m : modes) {
+    sensorPublishMode = m.mode;
+    bench::print(bench::measure(m.name, n / 10, [](uint64_t i) {
+      publishSensorData(25.0f + (float)(i % 10) * 0.1f, 60.0f, 1234);
+    }));
+  }
+  sensorPublishMode = 0;
+
+  bench::printHeader("reconnect path");
+  bench::print(bench::measure("connect + onMqttConnected, broker up", quick ? 50 : 2000,
+                              [](uint64_t) {
+    client.disconnect();
+    runUntilConnected();
+  }));
+  bench::print(bench::measure("old blocking reconnect(), 30 s outage", quick ? 3 : 20, [](uint64_t) {
+    client.disconnect();
+    sim::broker().setOutage(sim::nowUs(), sim::nowUs() + 30000000ULL);
+    legacyReconnect();
+  }));
+  compareOutage(quick);
+  runUntilConnected();
+  compareCommandLatency(quick);
+  printf("\nvirtual us/call = time the firmware is blocked on modeled I/O and delay()\n");
+  return 0;
+}
@@ -0,0 +1,426 @@
+// Load on one broker from a fleet of houses running the firmware's network
+// paths: the 15 s sensor burst (publishSensorData()), reconnecting with
+// backoff (ConnectionManager) and commands on the controls topic (callback()).
+// Reports the broker's ingress rate, how long a publish waits in the broker
+// before it is routed, and the command round trip as the backend sees it.
+//
+//   fleet_load_bench [--quick] [--houses N] [--frame] [--broker-rate MSGS_PER_S]
+//
+// The sketch itself keeps its state in globals, one house per process, so
+// each house here is composed from the same modules main.cpp uses: its own
+// HOUSE_ID, TopicTable, DeviceRegistry, StateSync, SampleBuffer and
+// PubSubClient. They all run in one event loop on the virtual clock: a house
+// wakes for its next burst, connect attempt, sync pass, backlog drain or
+// command delivery, and nothing in between.
+//
+// The broker is the simulated one, not mosquitto: it routes PUBLISH packets
+// one after the other at --broker-rate per second (Broker::ingressPerS), so
+// publish latency is the queueing delay at that service rate. The network
+// round trip is left out (rttUs = 0) to keep the broker the only bottleneck.
+//
+// Scenarios, each after every house has connected and synced:
+//   staggered bursts  houses publish at random phases of the 15 s period
+//   aligned bursts    every house publishes at the same instant
+//   broker restart    staggered, with the broker down kOutageMs: every house
+//                     loses its connection and comes back through backoff,
+//                     state sync and its offline sample backlog
+// The backend sends each house a fan command every kCommandEveryMs on
+// average; its round trip ends when the house's new fan status is routed.
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "board_sim.h"
+#include "command_parser.h"
+#include "connection_manager.h"
+#include "sample_buffer.h"
+#include "sensor_frame.h"
+#include "state_sync.h"
+#include "telemetry_format.h"
+
+namespace {
+
+const unsigned long kBurstMs = 15000;
+const unsigned long kSettleMs = STATE_SYNC_WINDOW_MS + 3000;
+const unsigned long kOutageMs = 5000;
+const unsigned long kCommandEveryMs = 20000;
+const unsigned long kPollMs = 10;       // the sketch's MQTT task runs every pass
+const unsigned long kDrainMs = 250;     // SAMPLE_DRAIN_INTERVAL_MS
+const size_t kDrainBatch = 8;           // SAMPLE_DRAIN_BATCH
+const unsigned long kBucketMs = 100;
+
+const TopicIdRange kRanges[STATUS_KIND_COUNT] = {
+  {7, 10}, {1, 1}, {11, 13}, {14, 16}, {1, 3}, {1, 3}, {4, 6},
+};
+const DeviceSpec kDevices[] = {
+  {STATUS_DOOR, 7, 5, 1, 0},   {STATUS_DOOR, 8, 16, 1, 0},  {STATUS_DOOR, 9, 17, 1, 0},
+  {STATUS_DOOR, 10, 38, 1, 0}, {STATUS_ALARM, 1, DEVICE_NO_PIN, 1, 0},
+  {STATUS_FAN, 11, 6, 1, 0},   {STATUS_FAN, 12, 10, 1, 0},  {STATUS_RGB, 14, 0, 2, 0x00FF00},
+  {STATUS_RGB, 15, 2, 1, 0},   {STATUS_RGB, 16, 3, 1, 0},
+};
+
+enum Scenario { STAGGERED, ALIGNED, RESTART };
+
+WiFiClient wifiClient;
+bool frameMode = false;
+TextBuffer<SENSOR_SUMMARY_MAX + 1> telemetryText;
+
+// What the run measures; filled by the broker's publish hook and the houses.
+struct Samples {
+  uint64_t fromUs = 0;                 // measurement window start
+  uint64_t lastRoutedUs = 0;           // of the latest accepted publish
+  uint64_t publishes = 0;
+  std::vector<uint32_t> latencyUs;     // sent -> routed, every publish
+  std::vector<uint32_t> perBucket;     // routed publishes per kBucketMs
+  std::vector<uint32_t> roundTripUs;   // command sent -> fan status routed
+  uint32_t commandsSent = 0;
+  uint32_t commandsLost = 0;           // no reply before the next command
+};
+Samples samples;
+
+struct House;
+House* current = nullptr;   // the house whose callback is running
+
+bool handleFanCommand(int deviceId, const Token& command);
+const CommandRoute kRoutes[] = {
+  {"fan", 11, 13, handleFanCommand},
+};
+
+struct House {
+  int index;
+  std::string id;
+  TopicTable topics;
+  DeviceRegistry devices;
+  PubSubClient client{wifiClient};
+  StateSync sync{devices, topics, client};
+  SampleBuffer backlog;
+  uint16_t seq = 0;
+  uint8_t failures = 0;
+  uint64_t nextAttemptUs = 0;
+  uint64_t nextBurstUs = 0;
+  uint64_t nextDrainUs = 0;
+  uint64_t wakeUs = UINT64_MAX;   // the one wake-up in the queue that counts
+  uint64_t commandSentUs = 0;     // 0: no command in flight
+
+  explicit House(int i) : index(i) {
+    char name[sizeof("house-") + 11];   // any int, sign included
+    snprintf(name, sizeof(name), "house-%04d", i);
+    id = name;
+    topics.build(id.c_str(), kRanges);
+    devices.build(kDevices, sizeof(kDevices) / sizeof(kDevices[0]));
+    client.setCallback([this](char* topic, uint8_t* payload, unsigned int length) {
+      callback(topic, payload, length);
+    });
+  }
+
+  // callback() in main.cpp, minus config, rules and batches.
+  void callback(char* topic, uint8_t* payload, unsigned int length) {
+    if (sync.onMessage(topic, payload, length)) return;
+    if (length >= 255 || !topics.isControlTopic(topic)) return;
+    Command cmd;
+    if (!parseCommand((const char*)payload, length, cmd)) return;
+    if (!cmd.houseId.equals(id.c_str())) return;
+    const CommandRoute* route = nullptr;
+    if (findRoute(cmd, kRoutes, sizeof(kRoutes) / sizeof(kRoutes[0]), &route) == DISPATCH_OK) {
+      route->handler(cmd.deviceId, cmd.command);
+    }
+  }
+
+  // setDevice(): new target, applied, retained status.
+  void setDevice(int slot, uint32_t target) {
+    devices.setTarget(slot, target);
+    devices.applied(slot);
+    char text[DEVICE_STATE_TEXT_MAX];
+    devices.formatState(slot, text, sizeof(text));
+    if (!client.publish(topics.status(devices.kind(slot), devices.id(slot)), text, true)) return;
+    if (commandSentUs != 0 && samples.lastRoutedUs >= samples.fromUs) {
+      samples.roundTripUs.push_back((uint32_t)(samples.lastRoutedUs - commandSentUs));
+    }
+    commandSentUs = 0;
+  }
+
+  // publishSensorData() -> sendSensorSample(): topics or one frame, queued
+  // for the backlog while offline.
+  void publishSensorData() {
+    SensorFrame frame = {};
+    frame.seq = seq++;
+    frame.timestampMs = millis();
+    float temperature = 20.0f + (index % 100) / 10.0f;
+    float humidity = 40.0f + (index % 37);
+    setSensorFrameClimate(frame, temperature, humidity);
+    for (int i = 0; i < SENSOR_FRAME_LIGHTS; i++) frame.light[i] = (uint16_t)random(4096);
+
+    if (!client.connected()) {
+      backlog.push(frame);
+      return;
+    }
+    if (frameMode) {
+      uint8_t payload[SENSOR_FRAME_SIZE];
+      size_t length = encodeSensorFrame(frame, payload, sizeof(payload));
+      if (!client.publish(topics.sensorFrame(), payload, length)) backlog.push(frame);
+      return;
+    }
+    int32_t tempCenti = frame.tempCenti;
+    int32_t humiCenti = frame.humiCenti;
+    telemetryText.clear().fixed<2>(tempCenti);
+    for (int i = kRanges[STATUS_TEMP].idMin; i <= kRanges[STATUS_TEMP].idMax; i++) {
+      client.publish(topics.status(STATUS_TEMP, i), telemetryText.c_str());
+    }
+    telemetryText.clear().fixed<2>(humiCenti);
+    for (int i = kRanges[STATUS_HUMI].idMin; i <= kRanges[STATUS_HUMI].idMax; i++) {
+      client.publish(topics.status(STATUS_HUMI, i), telemetryText.c_str());
+    }
+    const TopicIdRange& lightIds = kRanges[STATUS_LIGHT];
+    for (int i = lightIds.idMin; i <= lightIds.idMax; i++) {
+      telemetryText.clear().integer(frame.light[i - lightIds.idMin]);
+      client.publish(topics.status(STATUS_LIGHT, i), telemetryText.c_str(), true);
+    }
+    client.publish(topics.sensors(),
+                   formatSensorSummary(telemetryText, tempCenti, humiCenti, frame.light[0]), true);
+  }
+
+  // drainSampleBacklog(): the oldest batch, removed once published.
+  void drainBacklog() {
+    SensorFrame frames[kDrainBatch];
+    size_t count = backlog.peek(frames, kDrainBatch);
+    if (count == 0) return;
+    uint8_t payload[SENSOR_BACKLOG_HEADER_SIZE + kDrainBatch * SENSOR_FRAME_SIZE];
+    size_t length = encodeSensorBacklog(frames, count, millis(), payload, sizeof(payload));
+    if (client.publish(topics.sensorBacklog(), payload, length)) backlog.pop(count);
+  }
+
+  // One pass of the sketch's network side; returns when to wake next.
+  uint64_t step() {
+    uint64_t now = sim::nowUs();
+    unsigned long nowMs = millis();
+    current = this;
+    if (!client.connected()) {
+      if (now >= nextAttemptUs) {
+        if (client.connect(id.c_str())) {
+          // onMqttConnected()
+          failures = 0;
+          client.subscribe(topics.controls());
+          sync.begin(nowMs);
+          nextDrainUs = now;
+        } else {
+          nextAttemptUs = now + ConnectionManager::backoffMs(failures) * 1000ULL;
+          if (failures < 255) failures++;
+        }
+      }
+    }
+    bool up = client.connected();
+    if (up) {
+      client.loop();
+      if (sync.syncing()) sync.service(nowMs);
+    }
+    if (now >= nextBurstUs) {
+      publishSensorData();
+      nextBurstUs += kBurstMs * 1000ULL;
+    }
+    if (up && !backlog.empty() && now >= nextDrainUs) {
+      drainBacklog();
+      nextDrainUs = now + kDrainMs * 1000ULL;
+    }
+    current = nullptr;
+
+    uint64_t next = nextBurstUs;
+    if (!up) next = std::min(next, nextAttemptUs);
+    if (up && sync.syncing()) {
+      uint64_t startUs = (uint64_t)sync.startAtMs() * 1000ULL;
+      next = std::min(next, std::max<uint64_t>(now + kPollMs * 1000ULL, startUs));
+    }
+    if (up && !backlog.empty()) next = std::min(next, nextDrainUs);
+    return next;
+  }
+};
+
+bool handleFanCommand(int deviceId, const Token& command) {
+  int slot = current->devices.find(STATUS_FAN, deviceId);
+  if (slot < 0) return false;
+  if (command.equals("ON")) current->setDevice(slot, 1);
+  else if (command.equals("OFF")) current->setDevice(slot, 0);
+  else return false;
+  return true;
+}
+
+enum EventKind : uint8_t { EVENT_WAKE, EVENT_COMMAND };
+
+struct Event {
+  uint64_t atUs;
+  int house;
+  EventKind kind;
+  bool operator>(const Event& o) const { return atUs > o.atUs; }
+};
+
+class Fleet {
+ public:
+  explicit Fleet(int count) {
+    for (int i = 0; i < count; i++) houses_.emplace_back(new House(i));
+  }
+
+  House& house(int i) { return *houses_[i]; }
+  int size() const { return (int)houses_.size(); }
+
+  void wake(int i, uint64_t atUs) {
+    House& h = *houses_[i];
+    if (atUs >= h.wakeUs) return;
+    h.wakeUs = atUs;
+    queue_.push(Event{atUs, i, EVENT_WAKE});
+  }
+  void command(int i, uint64_t atUs) { queue_.push(Event{atUs, i, EVENT_COMMAND}); }
+
+  // Runs every event due before untilUs, in time order.
+  void runUntil(uint64_t untilUs, bool commands) {
+    while (!queue_.empty() && queue_.top().atUs < untilUs) {
+      Event e = queue_.top();
+      queue_.pop();
+      if (e.atUs > sim::nowUs()) sim::setNowUs(e.atUs);
+      House& h = *houses_[e.house];
+      if (e.kind == EVENT_COMMAND) {
+        if (commands) sendCommand(e.house);
+        continue;
+      }
+      if (e.atUs != h.wakeUs) continue;   // superseded by an earlier wake
+      h.wakeUs = UINT64_MAX;
+      wake(e.house, h.step());
+    }
+    if (untilUs > sim::nowUs()) sim::setNowUs(untilUs);
+  }
+
+ private:
+  // The backend: toggles fan 11 of the house on its controls topic.
+  void sendCommand(int i) {
+    House& h = *houses_[i];
+    command(i, sim::nowUs() + random(2 * kCommandEveryMs) * 1000ULL);
+    if (!sim::broker().reachable()) return;
+    int slot = h.devices.find(STATUS_FAN, 11);
+    std::string payload = h.id + ":fan:11:" + (h.devices.target(slot) ? "OFF" : "ON");
+    if (h.commandSentUs != 0) samples.commandsLost++;
+    h.commandSentUs = sim::nowUs();
+    samples.commandsSent++;
+    wake(i, sim::broker().inject(h.topics.controls(), payload));
+  }
+
+  std::vector<std::unique_ptr<House>> houses_;
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>> queue_;
+};
+
+struct Outcome {
+  uint64_t publishes = 0;
+  double avgPerS = 0;
+  uint32_t peakPerS = 0;
+  uint32_t latencyUs[3] = {};     // p50, p99, max
+  uint32_t roundTripUs[3] = {};
+  uint32_t commandsSent = 0;
+  uint32_t commandsLost = 0;
+};
+
+void percentiles(std::vector<uint32_t>& v, uint32_t out[3]) {
+  if (v.empty()) return;
+  std::sort(v.begin(), v.end());
+  out[0] = v[(v.size() - 1) / 2];
+  out[1] = v[(v.size() - 1) * 99 / 100];
+  out[2] = v.back();
+}
+
+Outcome run(Scenario scenario, int houseCount, unsigned long runMs, uint32_t brokerRate) {
+  sim::broker().reset();
+  sim::broker().recordLog = false;
+  sim::broker().rttUs = 0;
+  sim::broker().ingressPerS = brokerRate;
+  samples = Samples();
+  samples.fromUs = UINT64_MAX;
+  sim::broker().onPublish = [](const sim::Message& m) {
+    samples.lastRoutedUs = m.atUs;
+    if (sim::nowUs() < samples.fromUs) return;
+    samples.publishes++;
+    samples.latencyUs.push_back((uint32_t)(m.atUs - sim::nowUs()));
+    size_t bucket = (size_t)((m.atUs - samples.fromUs) / (kBucketMs * 1000ULL));
+    if (bucket >= samples.perBucket.size()) samples.perBucket.resize(bucket + 1);
+    samples.perBucket[bucket]++;
+  };
+
+  Fleet fleet(houseCount);
+  uint64_t start = sim::nowUs();
+  uint64_t measureFrom = start + kSettleMs * 1000ULL;
+  for (int i = 0; i < houseCount; i++) {
+    House& h = fleet.house(i);
+    // Boots spread over a second; the first burst is inside the window.
+    h.nextAttemptUs = start + random(1000) * 1000ULL;
+    h.nextBurstUs = measureFrom + (scenario == ALIGNED ? 1000 : random(kBurstMs)) * 1000ULL;
+    fleet.wake(i, h.nextAttemptUs);
+    fleet.command(i, measureFrom + random(2 * kCommandEveryMs) * 1000ULL);
+  }
+  fleet.runUntil(measureFrom, false);
+
+  samples.fromUs = measureFrom;
+  uint64_t endUs = measureFrom + runMs * 1000ULL;
+  if (scenario == RESTART) {
+    // The restart drops every connection; each house sees it on its next pass.
+    uint64_t downUs = measureFrom + 2000000ULL;
+    fleet.runUntil(downUs, true);
+    sim::broker().setOutage(downUs, downUs + kOutageMs * 1000ULL);
+    for (int i = 0; i < houseCount; i++) fleet.wake(i, downUs + random(kPollMs) * 1000ULL);
+  }
+  fleet.runUntil(endUs, true);
+
+  Outcome o;
+  o.publishes = samples.publishes;
+  o.avgPerS = samples.publishes * 1000.0 / runMs;
+  for (uint32_t n : samples.perBucket) o.peakPerS = std::max(o.peakPerS, n);
+  o.peakPerS *= 1000 / kBucketMs;
+  percentiles(samples.latencyUs, o.latencyUs);
+  percentiles(samples.roundTripUs, o.roundTripUs);
+  o.commandsSent = samples.commandsSent;
+  o.commandsLost = samples.commandsLost;
+  sim::broker().onPublish = nullptr;
+  return o;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool quick = bench::hasFlag(argc, argv, "--quick");
+  int houseCount = quick ? 200 : 5000;
+  unsigned long runMs = quick ? 30000 : 60000;
+  uint32_t brokerRate = 20000;
+  frameMode = bench::hasFlag(argc, argv, "--frame");
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--houses") == 0) houseCount = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--broker-rate") == 0) brokerRate = (uint32_t)atoi(argv[i + 1]);
+  }
+  WiFi.begin("fleet", "");
+  sim::advanceMs(sim::wifi().associateMs);
+
+  printf("\n== %d houses, %s every %lu s, broker routes %u msgs/s, %lu s measured ==\n",
+         houseCount, frameMode ? "one sensor frame" : "10 sensor topics", kBurstMs / 1000,
+         (unsigned)brokerRate, runMs / 1000);
+  printf("%-18s %9s %9s %9s %29s %29s %11s\n", "scenario", "messages", "avg/s", "peak/s",
+         "publish ms p50/p99/max", "command ms p50/p99/max", "cmds lost");
+  struct Variant {
+    const char* name;
+    Scenario scenario;
+  } variants[] = {
+    {"staggered bursts", STAGGERED},
+    {"aligned bursts", ALIGNED},
+    {"broker restart", RESTART},
+  };
+  for (const Variant& v : variants) {
+    Outcome o = run(v.scenario, houseCount, runMs, brokerRate);
+    char publish[40], command[40], lost[24];
+    snprintf(publish, sizeof(publish), "%.2f / %.2f / %.2f", o.latencyUs[0] / 1000.0,
+             o.latencyUs[1] / 1000.0, o.latencyUs[2] / 1000.0);
+    snprintf(command, sizeof(command), "%.2f / %.2f / %.2f", o.roundTripUs[0] / 1000.0,
+             o.roundTripUs[1] / 1000.0, o.roundTripUs[2] / 1000.0);
+    snprintf(lost, sizeof(lost), "%u/%u", (unsigned)o.commandsLost, (unsigned)o.commandsSent);
+    printf("%-18s %9llu %9.0f %9u %29s %29s %11s\n", v.name, (unsigned long long)o.publishes,
+           o.avgPerS, (unsigned)o.peakPerS, publish, command, lost);
+  }
+  return 0;
+}
@@ -0,0 +1,178 @@
+// A fleet of houses on one broker, through a broker restart: the old
+// "publish every device on connect" against the retained-state delta sync.
+// Reports the peak publish rate the broker sees while the fleet comes back.
+//
+//   fleet_sync_bench [--quick] [--houses N]
+//
+// Each house is the firmware's own TopicTable, DeviceRegistry and StateSync
+// on its own PubSubClient, reconnecting with ConnectionManager's backoff. The
+// broker is down for kOutageMs; one house in twenty changes a device while it
+// is offline. Runs with the retained store kept (mosquitto with persistence)
+// and lost (without).
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "board_sim.h"
+#include "connection_manager.h"
+#include "state_sync.h"
+
+namespace {
+
+const unsigned long kOutageMs = 2000;
+const unsigned long kRunMs = 20000;   // after the restart
+const unsigned long kStepMs = 10;
+const unsigned long kBucketMs = 100;
+
+const TopicIdRange kRanges[STATUS_KIND_COUNT] = {
+  {7, 10}, {1, 1}, {11, 13}, {14, 16}, {1, 3}, {1, 3}, {4, 6},
+};
+const DeviceSpec kDevices[] = {
+  {STATUS_DOOR, 7, 5, 1, 0},   {STATUS_DOOR, 8, 16, 1, 0},  {STATUS_DOOR, 9, 17, 1, 0},
+  {STATUS_DOOR, 10, 38, 1, 0}, {STATUS_ALARM, 1, DEVICE_NO_PIN, 1, 0},
+  {STATUS_FAN, 11, 6, 1, 0},   {STATUS_FAN, 12, 10, 1, 0},  {STATUS_RGB, 14, 0, 2, 0x00FF00},
+  {STATUS_RGB, 15, 2, 1, 0},   {STATUS_RGB, 16, 3, 1, 0},
+};
+
+enum Mode { FULL_SNAPSHOT, DELTA_SYNC };
+
+WiFiClient wifiClient;
+
+struct House {
+  std::string id;
+  TopicTable topics;
+  DeviceRegistry devices;
+  PubSubClient client{wifiClient};
+  StateSync sync{devices, topics, client};
+  uint8_t failures = 0;
+  unsigned long nextAttemptMs = 0;
+  unsigned long syncedAtMs = 0;
+
+  explicit House(int index) {
+    char name[sizeof("house-") + 11];   // any int, sign included
+    snprintf(name, sizeof(name), "house-%04d", index);
+    id = name;
+    topics.build(id.c_str(), kRanges);
+    devices.build(kDevices, sizeof(kDevices) / sizeof(kDevices[0]));
+    client.setCallback([this](char* topic, uint8_t* payload, unsigned int length) {
+      sync.onMessage(topic, payload, length);
+    });
+  }
+
+  void step(Mode mode, unsigned long now) {
+    if (client.connected()) {
+      client.loop();
+      if (sync.syncing()) {
+        sync.service(now);
+        if (!sync.syncing()) syncedAtMs = now;
+      }
+      return;
+    }
+    if ((long)(now - nextAttemptMs) < 0) return;
+    if (!client.connect(id.c_str())) {
+      nextAttemptMs = now + ConnectionManager::backoffMs(failures);
+      if (failures < 255) failures++;
+      return;
+    }
+    failures = 0;
+    client.subscribe(topics.controls());
+    if (mode == FULL_SNAPSHOT) {
+      // What onMqttConnected() did before: every device, at once.
+      for (size_t slot = 0; slot < devices.count(); slot++) {
+        char text[DEVICE_STATE_TEXT_MAX];
+        devices.formatState(slot, text, sizeof(text));
+        client.publish(topics.status(devices.kind(slot), devices.id(slot)), text);
+      }
+      syncedAtMs = now;
+    } else {
+      sync.begin(now);
+    }
+  }
+};
+
+struct Outcome {
+  uint64_t publishes = 0;
+  uint64_t peakPerBucket = 0;
+  unsigned long lastSyncMs = 0;   // after the broker came back
+};
+
+Outcome run(Mode mode, bool keepRetained, int houseCount) {
+  sim::broker().reset();
+  sim::broker().recordLog = false;
+  // One virtual clock for the whole fleet: a connect must not stall the
+  // other houses by its round trip.
+  sim::broker().rttUs = 0;
+  std::vector<std::unique_ptr<House>> houses;
+  for (int i = 0; i < houseCount; i++) houses.emplace_back(new House(i));
+
+  // Steady state: everyone connected and synced.
+  for (unsigned long t = 0; t < STATE_SYNC_WINDOW_MS + 2000; t += kStepMs) {
+    for (auto& h : houses) h->step(mode, millis());
+    sim::advanceMs(kStepMs);
+  }
+
+  unsigned long restartMs = millis();
+  sim::broker().setOutage(sim::nowUs(), sim::nowUs() + kOutageMs * 1000ULL);
+  if (!keepRetained) sim::broker().dropRetained();
+  for (int i = 0; i < houseCount; i += 20) {
+    int fan = houses[i]->devices.find(STATUS_FAN, 11);
+    houses[i]->devices.setTarget(fan, 1);
+    houses[i]->devices.applied(fan);
+  }
+  for (auto& h : houses) h->syncedAtMs = 0;
+
+  Outcome o;
+  uint64_t bucketStart = sim::broker().stats().publishes;
+  uint64_t first = bucketStart;
+  for (unsigned long t = 0; t < kRunMs; t += kStepMs) {
+    for (auto& h : houses) h->step(mode, millis());
+    sim::advanceMs(kStepMs);
+    if ((t + kStepMs) % kBucketMs == 0) {
+      uint64_t now = sim::broker().stats().publishes;
+      if (now - bucketStart > o.peakPerBucket) o.peakPerBucket = now - bucketStart;
+      bucketStart = now;
+    }
+  }
+  o.publishes = sim::broker().stats().publishes - first;
+  for (auto& h : houses) {
+    unsigned long done = h->syncedAtMs ? h->syncedAtMs - restartMs - kOutageMs : kRunMs;
+    if (done > o.lastSyncMs) o.lastSyncMs = done;
+  }
+  return o;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int houseCount = bench::hasFlag(argc, argv, "--quick") ? 100 : 1000;
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--houses") == 0) houseCount = atoi(argv[i + 1]);
+  }
+  WiFi.begin("fleet", "");
+  sim::advanceMs(sim::wifi().associateMs);
+
+  printf("\n== %d houses, %zu devices each, broker down %lu ms ==\n", houseCount,
+         sizeof(kDevices) / sizeof(kDevices[0]), kOutageMs);
+  printf("%-30s %10s %13s %15s %14s\n", "reconnect", "messages", "msgs/house",
+         "peak msgs/s", "synced by ms");
+  struct Variant {
+    const char* name;
+    Mode mode;
+    bool keepRetained;
+  } variants[] = {
+    {"full snapshot (before)", FULL_SNAPSHOT, true},
+    {"delta sync, retained kept", DELTA_SYNC, true},
+    {"delta sync, retained lost", DELTA_SYNC, false},
+  };
+  for (const Variant& v : variants) {
+    Outcome o = run(v.mode, v.keepRetained, houseCount);
+    printf("%-30s %10llu %13.2f %15llu %14lu\n", v.name, (unsigned long long)o.publishes,
+           (double)o.publishes / houseCount,
+           (unsigned long long)(o.peakPerBucket * (1000 / kBucketMs)), o.lastSyncMs);
+  }
+  return 0;
+}
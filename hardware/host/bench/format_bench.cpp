@@ -0,0 +1,77 @@
+// Text formatting of one sensor cycle's payloads: the dtostrf/sprintf code
+// publishSensorTopics() used to run against the fixed-point formatters in
+// telemetry_format.h writing into one reused buffer.
+//
+//   format_bench [--quick]
+//
+// One cycle is what the topic mode publishes: temperature and humidity for
+// three IDs each, three light levels and the JSON summary, plus one RGB
+// status. Host time only; on the ESP32 the printf path is relatively slower
+// still, since "%f" goes through newlib's soft-float formatter.
+#include <Arduino.h>
+#include <stdio.h>
+
+#include "bench.h"
+#include "telemetry_format.h"
+
+namespace {
+
+volatile size_t sink;   // keeps the formatted bytes observable
+
+const float kTemps[] = {27.5f, 27.81f, -3.25f, 51.07f, 19.99f, 33.3f, 0.0f, 44.44f};
+const float kHumis[] = {65.3f, 40.02f, 99.9f, 12.5f, 55.55f, 70.0f, 1.01f, 38.76f};
+const int kLights[] = {512, 4095, 0, 1733, 2048, 87, 3999, 1000};
+const size_t kSamples = sizeof(kTemps) / sizeof(kTemps[0]);
+
+void printfCycle(uint64_t i) {
+  float temperature = kTemps[i % kSamples];
+  float humidity = kHumis[i % kSamples];
+  size_t bytes = 0;
+  for (int id = 0; id < 3; id++) {
+    char tempStr[10];
+    dtostrf(temperature, 1, 2, tempStr);
+    char humiStr[10];
+    dtostrf(humidity, 1, 2, humiStr);
+    bytes += strlen(tempStr) + strlen(humiStr);
+  }
+  for (int id = 0; id < 3; id++) {
+    char lightStr[10];
+    bytes += sprintf(lightStr, "%d", kLights[(i + id) % kSamples]);
+  }
+  char sensorData[100];
+  bytes += sprintf(sensorData, "{\"temp\":%.2f,\"humi\":%.2f,\"light\":%d}", temperature,
+                   humidity, kLights[i % kSamples]);
+  char rgb[12];
+  bytes += snprintf(rgb, sizeof(rgb), "%u,%u,%u", (unsigned)(i & 0xFF), 0u, 128u);
+  sink = bytes;
+}
+
+TextBuffer<SENSOR_SUMMARY_MAX + 1> text;
+
+void fixedCycle(uint64_t i) {
+  int32_t tempCenti = toFixed<2>(kTemps[i % kSamples]);
+  int32_t humiCenti = toFixed<2>(kHumis[i % kSamples]);
+  size_t bytes = 0;
+  // Formatted once, published for all three IDs.
+  bytes += 3 * text.clear().fixed<2>(tempCenti).length();
+  bytes += 3 * text.clear().fixed<2>(humiCenti).length();
+  for (int id = 0; id < 3; id++) bytes += text.clear().integer(kLights[(i + id) % kSamples]).length();
+  formatSensorSummary(text, tempCenti, humiCenti, kLights[i % kSamples]);
+  bytes += text.length();
+  bytes += text.clear().rgb((uint32_t)(i & 0xFF) << 16 | 128).length();
+  sink = bytes;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const uint64_t n = bench::hasFlag(argc, argv, "--quick") ? 20000 : 2000000;
+
+  bench::printHeader("sensor cycle payload text");
+  bench::Result before = bench::measure("dtostrf / sprintf (before)", n, printfCycle);
+  bench::Result after = bench::measure("fixed-point, one buffer (after)", n, fixedCycle);
+  bench::print(before);
+  bench::print(after);
+  printf("speedup: %.1fx\n", before.hostNsPerCall / after.hostNsPerCall);
+  return 0;
+}
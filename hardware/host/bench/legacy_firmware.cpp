@@ -0,0 +1,184 @@
+// Earlier versions of firmware paths, kept (renamed) so firmware_bench can
+// compare them with the current ones:
+//  - legacyCallback(): the String-based callback() from before the
+//    zero-allocation parser, verbatim.
+//  - legacyReconnect(): the blocking reconnect() from before the connection
+//    state machine; the post-connect publishing is the sketch's own.
+#include <Arduino.h>
+
+#include "sketch.h"
+
+#define DOOR_ID_MIN 7
+#define DOOR_ID_MAX 10
+#define FAN_ID_MIN 11
+#define FAN_ID_MAX 13
+#define RGB_ID_MIN 14
+#define RGB_ID_MAX 16
+
+static const char* TOPIC_ALL_CONTROLS = "yolouno/%s/controls";
+
+// The old door handler flipped the door whatever the command said.
+static void toggleDoor(int deviceId) {
+  int slot = devices.find(STATUS_DOOR, deviceId);
+  if (slot >= 0) setDoor(!devices.state(slot), deviceId);
+}
+
+void legacyCallback(char* topic, byte* payload, unsigned int length) {
+  // Limit message size to prevent buffer overflow
+  if (length >= 255) {
+    Serial.println("Message too large, rejecting");
+    return;
+  }
+  
+  // Safely copy payload with bounds checking
+  char message[256]; // Large enough buffer with room for null terminator
+  size_t copyLength = length < sizeof(message)-1 ? length : sizeof(message)-1;
+  memcpy(message, payload, copyLength);
+  message[copyLength] = '\0';
+  
+  String strMessage = String(message);
+  String strTopic = String(topic);
+  
+  Serial.print("Message arrived on topic: ");
+  Serial.print(strTopic);
+  Serial.print(". Message: ");
+  Serial.println(strMessage);
+
+  char ourControlTopic[100]; 
+  sprintf(ourControlTopic, TOPIC_ALL_CONTROLS, HOUSE_ID);
+
+  if (strTopic == ourControlTopic) {
+    // Message format: "house_id:device_type:device_id:command"
+    
+    int firstColon = strMessage.indexOf(':');
+    int secondColon = strMessage.indexOf(':', firstColon + 1);
+    int thirdColon = strMessage.indexOf(':', secondColon + 1);
+
+    if (firstColon > 0 && secondColon > firstColon && thirdColon > secondColon) {
+      String houseId = strMessage.substring(0, firstColon);
+      String deviceType = strMessage.substring(firstColon + 1, secondColon);
+      String deviceIdStr = strMessage.substring(secondColon + 1, thirdColon);
+      String command = strMessage.substring(thirdColon + 1);
+      
+      int deviceId = deviceIdStr.toInt();
+      String lowerCommand = command;
+      lowerCommand.toLowerCase();
+
+      Serial.print("House ID: ");
+      Serial.print(houseId);
+      Serial.print(", Device Type: ");
+      Serial.print(deviceType);
+      Serial.print(", Device ID: ");
+      Serial.print(deviceId);
+      Serial.print(", Command: ");
+      Serial.println(command);
+      
+      if (houseId == HOUSE_ID) {
+        // Xử lý theo loại thiết bị và device ID
+        if (deviceType == "door") {
+          if (deviceId >= DOOR_ID_MIN && deviceId <= DOOR_ID_MAX) {
+            if (lowerCommand == "open" || lowerCommand == "close" || 
+                lowerCommand == "OPEN" || lowerCommand == "CLOSED" || lowerCommand == "on" || lowerCommand == "off" ) {
+              toggleDoor(deviceId);
+            } else {
+              Serial.println("Lệnh cửa không hợp lệ. Sử dụng: open/OPEN hoặc close/CLOSED");
+            }
+          } else {
+            Serial.print("Device ID cửa không hợp lệ. ID nhận được: ");
+            Serial.print(deviceId);
+            Serial.print(", phạm vi hợp lệ: ");
+            Serial.print(DOOR_ID_MIN);
+            Serial.print("-");
+            Serial.println(DOOR_ID_MAX);
+          }
+        }
+        else if (deviceType == "alarm") {
+          if (command == "ON") {
+            setAlarm(true, config.ranges[STATUS_ALARM].idMin);
+          } else if (command == "OFF") {
+            setAlarm(false, config.ranges[STATUS_ALARM].idMin);
+          } else {
+            Serial.println("Lệnh báo động không hợp lệ. Sử dụng: ON hoặc OFF");
+          }
+        }
+        else if (deviceType == "fan") {
+          if (deviceId >= FAN_ID_MIN && deviceId <= FAN_ID_MAX) {
+            if (command == "ON" || command == "on") {
+              setFan(true, deviceId);
+            } else if (command == "OFF" || command == "off") {
+              setFan(false, deviceId);
+            } else {
+              Serial.println("Lệnh quạt không hợp lệ. Sử dụng: ON hoặc OFF");
+            }
+          } else {
+            Serial.println("Device ID quạt không hợp lệ");
+          }
+        }
+        else if (deviceType == "rgb") {
+          if (deviceId >= RGB_ID_MIN && deviceId <= RGB_ID_MAX) {
+            // Xử lý lệnh ON/OFF cho RGB
+            if (command == "ON" || command == "on") {
+              setRGBColor(254, 254, 254, deviceId);
+              Serial.print("Bật đèn RGB ID ");
+              Serial.println(deviceId);
+            } 
+            else if (command == "OFF" || command == "off") {
+              setRGBColor(0, 0, 0, deviceId);
+              Serial.print("Tắt đèn RGB ID ");
+              Serial.println(deviceId);
+            }
+            // Xử lý lệnh màu sắc cụ thể theo định dạng "R,G,B"
+            else {
+              // Định dạng: "R,G,B" vd: "255,0,128"
+              int firstComma = command.indexOf(',');
+              int secondComma = command.lastIndexOf(',');
+              
+              if (firstComma > 0 && secondComma > firstComma) {
+                int r = command.substring(0, firstComma).toInt();
+                int g = command.substring(firstComma + 1, secondComma).toInt();
+                int b = command.substring(secondComma + 1).toInt();
+                
+                // Giới hạn giá trị trong khoảng 0-255
+                r = constrain(r, 0, 255);
+                g = constrain(g, 0, 255);
+                b = constrain(b, 0, 255);
+                
+                // Thiết lập màu mới
+                setRGBColor(r, g, b, deviceId);
+              } else {
+                Serial.println("Định dạng màu không hợp lệ. Sử dụng: R,G,B hoặc ON/OFF");
+              }
+            }
+          } else {
+            Serial.println("Device ID RGB không hợp lệ");
+          }
+        }
+        else {
+          Serial.print("Loại thiết bị không xác định: ");
+          Serial.println(deviceType);
+        }
+      } else {
+        Serial.print("Lệnh không dành cho nhà này. Nhà hiện tại: ");
+        Serial.println(HOUSE_ID);
+      }
+    } else {
+      Serial.println("Định dạng lệnh không hợp lệ. Sử dụng: 'house_id:device_type:device_id:command'");
+    } 
+  }
+}
+
+
+void legacyReconnect() {
+  while (!client.connected()) {
+      Serial.print("Đang kết nối MQTT...");
+      if (client.connect("ESP32_YOLOUNO29112004")) {
+          Serial.println("Đã kết nối!");
+          onMqttConnected();
+      } else {
+          Serial.print("Thất bại, mã lỗi: ");
+          Serial.print(client.state());
+          Serial.println(" Thử lại sau 10s...");
+          delay(10000);
+      }
+  }
+}
@@ -0,0 +1,180 @@
+// Duty cycle of the sketch per power mode on a workload trace: how much of the
+// time the node is awake, how much of that the CPU is busy, and what each mode
+// costs in command latency.
+//
+//   power_bench [--quick] [--trace commands.csv]
+//
+// The workload is the synthetic sensor day of sensor_trace.h plus backend
+// commands, CSV "seconds,<device command>" (e.g. "12.35,fan:11:ON"); without
+// --trace a command arrives every 10-40 s, anywhere within the second.
+// Latency is from the command reaching the broker to the device's status
+// publish. Always-on spins in 1 ms steps, which is also its latency resolution.
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "board_sim.h"
+#include "sensor_trace.h"
+#include "sketch.h"
+
+namespace {
+
+struct TimedCommand {
+  double seconds;
+  std::string command;   // "fan:11:ON"
+};
+
+bool loadCommands(const char* path, std::vector<TimedCommand>& out) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    double seconds;
+    char command[64];
+    if (sscanf(line, "%lf,%63s", &seconds, command) == 2) out.push_back({seconds, command});
+  }
+  fclose(f);
+  return !out.empty();
+}
+
+std::vector<TimedCommand> syntheticCommands(uint32_t seconds) {
+  static const char* const kCommands[] = {"fan:11:ON",   "rgb:14:255,80,0", "door:7:OPEN",
+                                          "fan:11:OFF",  "rgb:14:0,0,0",    "door:7:CLOSED"};
+  std::vector<TimedCommand> out;
+  size_t next = 0;
+  for (uint32_t t = 30; t < seconds; t += 10 + (uint32_t)random(31)) {
+    out.push_back({t + random(1000) / 1000.0, kCommands[next++ % 6]});
+  }
+  return out;
+}
+
+// yolouno/<house>/status/<type>/<id> for "<type>:<id>:<target>"
+std::string statusTopic(const std::string& command) {
+  size_t second = command.find(':', command.find(':') + 1);
+  std::string typeAndId = command.substr(0, second);
+  typeAndId[typeAndId.find(':')] = '/';
+  return std::string("yolouno/") + HOUSE_ID + "/status/" + typeAndId;
+}
+
+uint64_t arrivalUs(const bench::TracePlayer& player, const TimedCommand& c) {
+  return player.timeOfUs(0) + (uint64_t)(c.seconds * 1e6);
+}
+
+struct Outcome {
+  double awakePct = 0;
+  double busyPct = 0;
+  double sleepsPerS = 0;
+  uint32_t timerWakes = 0;
+  uint32_t wifiWakes = 0;
+  double latencyP50Ms = 0;
+  double latencyMaxMs = 0;
+  int missed = 0;
+};
+
+Outcome run(PowerMode mode, const bench::Trace& trace, const std::vector<TimedCommand>& commands) {
+  power.begin(mode, powerMaxLatencyMs);
+  runUntilConnected();
+  sim::broker().clearLog();
+
+  uint64_t start = (sim::nowUs() / 1000000ULL + 1) * 1000000ULL;
+  sim::setNowUs(start);
+  bench::TracePlayer player(trace, start);
+  {
+    sim::UncountedHeap guard;
+    for (const TimedCommand& c : commands) {
+      sim::broker().inject(std::string("yolouno/") + HOUSE_ID + "/controls",
+                           std::string(HOUSE_ID) + ":" + c.command, false,
+                           arrivalUs(player, c));
+    }
+  }
+  sim::PowerState before = sim::power();
+  PowerStats stats0 = power.stats();
+  while (player.update()) {
+    uint64_t at = sim::nowUs();
+    loop();
+    if (sim::nowUs() == at) sim::advanceUs(mode == POWER_ALWAYS_ON ? 1000 : 10);
+  }
+  double total = (double)(sim::nowUs() - start);
+
+  Outcome out;
+  double slept = (double)(sim::power().lightSleepUs - before.lightSleepUs);
+  double idle = (double)(sim::power().idleUs - before.idleUs);
+  out.awakePct = 100.0 * (1.0 - slept / total);
+  out.busyPct = 100.0 * (1.0 - (slept + idle) / total);
+  out.sleepsPerS = (power.stats().lightSleeps - stats0.lightSleeps) / (total / 1e6);
+  out.timerWakes = power.stats().timerWakes - stats0.timerWakes;
+  out.wifiWakes = power.stats().wifiWakes - stats0.wifiWakes;
+
+  std::vector<double> latencies;
+  for (const TimedCommand& c : commands) {
+    uint64_t at = arrivalUs(player, c);
+    std::string topic = statusTopic(c.command);
+    double ms = -1;
+    for (const sim::Message& m : sim::broker().log()) {
+      if (m.atUs >= at && m.topic == topic) {
+        ms = (m.atUs - at) / 1000.0;
+        break;
+      }
+    }
+    if (ms < 0) {
+      out.missed++;
+    } else {
+      latencies.push_back(ms);
+    }
+  }
+  std::sort(latencies.begin(), latencies.end());
+  if (!latencies.empty()) {
+    out.latencyP50Ms = latencies[latencies.size() / 2];
+    out.latencyMaxMs = latencies.back();
+  }
+  sim::broker().clearLog();
+  return out;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const bool quick = bench::hasFlag(argc, argv, "--quick");
+  const uint32_t seconds = quick ? 300 : 3600;
+  const char* path = nullptr;
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--trace") == 0) path = argv[i + 1];
+  }
+  std::vector<TimedCommand> commands;
+  if (path) {
+    if (!loadCommands(path, commands)) {
+      fprintf(stderr, "cannot read commands %s\n", path);
+      return 1;
+    }
+  } else {
+    commands = syntheticCommands(seconds);
+  }
+  bench::Trace trace = bench::syntheticTrace(seconds);
+
+  setup();
+  printf("workload: %s, %u s, %zu commands, latency bound %u ms\n",
+         path ? path : "synthetic", seconds, commands.size(), (unsigned)powerMaxLatencyMs);
+  printf("\n== duty cycle per power mode ==\n");
+  printf("%-14s %8s %8s %10s %8s %8s %10s %10s %7s\n", "mode", "awake %", "busy %", "sleeps/s",
+         "timer", "wifi", "cmd p50 ms", "cmd max ms", "missed");
+  struct Variant {
+    const char* name;
+    PowerMode mode;
+  } variants[] = {
+    {"always on", POWER_ALWAYS_ON},
+    {"modem sleep", POWER_MODEM_SLEEP},
+    {"light sleep", POWER_LIGHT_SLEEP},
+  };
+  for (const Variant& v : variants) {
+    Outcome o = run(v.mode, trace, commands);
+    printf("%-14s %8.1f %8.2f %10.1f %8u %8u %10.2f %10.2f %7d\n", v.name, o.awakePct, o.busyPct,
+           o.sleepsPerS, (unsigned)o.timerWakes, (unsigned)o.wifiWakes, o.latencyP50Ms,
+           o.latencyMaxMs, o.missed);
+  }
+  printf("\nawake: not in light sleep; busy: awake and not idle waiting for work\n");
+  return 0;
+}
@@ -0,0 +1,174 @@
+// Reconnecting after WiFi blips: plain TCP with a clean session (the old
+// reconnect), then TLS with a full handshake every time, resuming from the
+// RAM session cache, and resuming from flash after a reboot in every blip.
+//
+//   reconnect_bench [--quick] [--rtt MS]
+//
+// One house: ConnectionManager, PubSubClient and, for TLS, TlsClient with
+// TlsSessionCache, against the broker stand-in's TLS listener (session
+// tickets, 2 h lifetime, as mosquitto with OpenSSL defaults; handshake costs
+// in sim::TlsServerState). Per reconnect it reports the time from WiFi being
+// back to the MQTT session up (including ConnectionManager's own WiFi retry
+// after long blips), how long connect() took, the longest the loop was
+// blocked, and the heap peak during connect() above what was in use before;
+// and how many of the QoS 1 commands sent while the house was away reached it.
+#include <LittleFS.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+#include <string>
+
+#include "bench.h"
+#include "board_sim.h"
+#include "connection_manager.h"
+#include "tls_client.h"
+
+namespace {
+
+const char kCa[] = "-----BEGIN CERTIFICATE-----\nMIIBbench\n-----END CERTIFICATE-----\n";
+const char kHost[] = "mqtt.house.local";
+const char kClientId[] = "yolouno-bench";
+const char kControls[] = "yolouno/bench/controls";
+const unsigned long kUpMs = 30000;   // connected between blips
+
+struct Variant {
+  const char* name;
+  bool tls;
+  bool cache;
+  bool reboot;         // the TLS client and its RAM cache start over in every blip
+  bool cleanSession;
+};
+
+struct Outcome {
+  double reconnectMs = 0;      // mean, WiFi back -> MQTT up
+  double connectMs = 0;        // mean, the connect() call itself
+  double blockedMs = 0;        // longest single service() call
+  int64_t heapPeak = 0;        // worst connect(), above the heap in use before it
+  uint64_t full = 0;
+  uint64_t resumed = 0;
+  int sent = 0;
+  int delivered = 0;
+};
+
+PubSubClient* g_client = nullptr;
+int g_delivered = 0;
+
+void onConnected() { g_client->subscribe(kControls, 1); }
+
+Outcome run(const Variant& v, int blips, uint32_t rttUs) {
+  sim::resetBoard();
+  sim::broker().rttUs = rttUs;
+  sim::broker().recordLog = false;
+  LittleFS.begin(true);
+
+  WiFiClient tcp;
+  std::unique_ptr<TlsClient> tls;
+  std::unique_ptr<TlsSessionCache> cache;
+  PubSubClient client(tcp);
+  auto startTls = [&]() {
+    tls.reset(new TlsClient(tcp));
+    tls->setCACert(kCa);
+    if (v.cache) {
+      cache.reset(new TlsSessionCache());
+      cache->begin(&LittleFS);
+      tls->setSessionCache(cache.get());
+    }
+    client.setClient(*tls);
+  };
+  if (v.tls) startTls();
+  client.setServer(kHost, v.tls ? 8883 : 1883);
+  client.setCallback([](char* topic, uint8_t* payload, unsigned int length) {
+    (void)topic;
+    (void)payload;
+    (void)length;
+    g_delivered++;
+  });
+  g_client = &client;
+  g_delivered = 0;
+  ConnectionManager connection(client, "house", "", kClientId);
+  connection.setCleanSession(v.cleanSession);
+  connection.onConnected(onConnected);
+  connection.begin();
+
+  uint64_t worstUs = 0;
+  auto step = [&]() {
+    uint64_t t0 = sim::nowUs();
+    connection.service();
+    if (connection.mqttUp()) client.loop();
+    if (sim::nowUs() - t0 > worstUs) worstUs = sim::nowUs() - t0;
+    sim::advanceMs(1);
+  };
+  while (!connection.mqttUp()) step();
+  worstUs = 0;
+  uint64_t full0 = sim::tls().fullHandshakes;
+  uint64_t resumed0 = sim::tls().resumedHandshakes;
+
+  Outcome o;
+  uint64_t reconnectUs = 0;
+  uint64_t connectMs = 0;
+  uint32_t seed = 11;
+  for (int b = 0; b < blips; b++) {
+    for (unsigned long t = 0; t < kUpMs; t++) step();
+    seed = seed * 1103515245u + 12345u;
+    uint64_t blipUs = (2000 + (seed >> 8) % 18000) * 1000ULL;   // 2-20 s
+    sim::wifi().downUntilUs = sim::nowUs() + blipUs;
+    while (connection.mqttUp()) step();
+    if (v.tls && v.reboot) startTls();
+    {
+      sim::UncountedHeap guard;
+      sim::broker().inject(kControls, "bench:fan:12:ON", false, sim::nowUs());
+    }
+    o.sent++;
+    uint64_t backUs = sim::wifi().downUntilUs + sim::wifi().associateMs * 1000ULL;
+    while (sim::nowUs() < backUs) step();
+    sim::resetHeapPeak();
+    int64_t base = sim::heap().liveBytes;
+    while (!connection.mqttUp()) step();
+    reconnectUs += sim::nowUs() - backUs;
+    connectMs += connection.lastConnectMs();
+    int64_t peak = sim::heap().peakLiveBytes - base;
+    if (peak > o.heapPeak) o.heapPeak = peak;
+  }
+  for (int t = 0; t < 1000; t++) step();
+
+  o.reconnectMs = reconnectUs / 1000.0 / blips;
+  o.connectMs = (double)connectMs / blips;
+  o.blockedMs = worstUs / 1000.0;
+  o.full = sim::tls().fullHandshakes - full0;
+  o.resumed = sim::tls().resumedHandshakes - resumed0;
+  o.delivered = g_delivered;
+  return o;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int blips = bench::hasFlag(argc, argv, "--quick") ? 5 : 50;
+  uint32_t rttMs = 20;
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--rtt") == 0) rttMs = (uint32_t)atoi(argv[i + 1]);
+  }
+
+  printf("\n== %d WiFi blips of 2-20 s, broker round trip %u ms ==\n", blips, rttMs);
+  printf("%-32s %12s %11s %11s %12s %13s %9s\n", "reconnect", "up after ms", "connect ms",
+         "blocked ms", "heap peak B", "full/resumed", "commands");
+  const Variant variants[] = {
+    {"tcp, clean session (before)", false, false, false, true},
+    {"tcp, persistent session", false, false, false, false},
+    {"tls, full handshake each time", true, false, false, false},
+    {"tls, session cache", true, true, false, false},
+    {"tls, cache on flash, reboots", true, true, true, false},
+  };
+  for (const Variant& v : variants) {
+    Outcome o = run(v, blips, rttMs * 1000);
+    char handshakes[32];
+    snprintf(handshakes, sizeof(handshakes), "%llu/%llu", (unsigned long long)o.full,
+             (unsigned long long)o.resumed);
+    char commands[32];
+    snprintf(commands, sizeof(commands), "%d/%d", o.delivered, o.sent);
+    printf("%-32s %12.1f %11.1f %11.1f %12lld %13s %9s\n", v.name, o.reconnectMs, o.connectMs,
+           o.blockedMs, (long long)o.heapPeak, v.tls ? handshakes : "-", commands);
+  }
+  return 0;
+}
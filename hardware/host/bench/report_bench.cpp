@@ -0,0 +1,179 @@
+// Sensor reporting on a trace: the old fixed 15 s publish of every reading vs
+// the change-driven loop() (deadband, maximum silence, immediate alarm), and
+// loop() with raw samples off (1 min / 15 min rollups, alarms and light
+// threshold crossings only). Reports broker traffic and how long meaningful
+// events take to reach it; light steps that cross no threshold only show up
+// in the next rollup, and that variant would count them as missed.
+//
+//   report_bench [--quick] [--trace recording.csv]
+//
+// Events are taken from the trace itself: the temperature crossing
+// TEMP_THRESHOLD (delay to the alarm and temp topics) and light steps of more
+// than 300 counts within a second (delay to that light's topic).
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "board_sim.h"
+#include "sensor_trace.h"
+#include "sketch.h"
+
+namespace {
+
+const float kAlarmC = 50.0f;  // TEMP_THRESHOLD in main.cpp
+const int kLightStep = 300;
+
+struct Event {
+  uint32_t seconds;
+  std::string topic;    // first publish on this topic after the event detects it
+  const char* payload;  // ...with this payload, or any if nullptr
+};
+
+std::vector<Event> findEvents(const bench::Trace& trace) {
+  std::vector<Event> events;
+  std::string base = std::string("yolouno/") + HOUSE_ID + "/status/";
+  for (size_t i = 1; i < trace.size(); i++) {
+    const bench::TracePoint& a = trace[i - 1];
+    const bench::TracePoint& b = trace[i];
+    if (a.temperature <= kAlarmC && b.temperature > kAlarmC) {
+      events.push_back({b.seconds, base + "alarm/1", "ON"});
+    }
+    for (int c = 0; c < 3; c++) {
+      if (abs(b.light[c] - a.light[c]) > kLightStep) {
+        events.push_back({b.seconds, base + "light/" + std::to_string(4 + c), nullptr});
+      }
+    }
+  }
+  return events;
+}
+
+bool isSensorTopic(const std::string& topic) {
+  return topic.find("/status/temp/") != std::string::npos ||
+         topic.find("/status/humi/") != std::string::npos ||
+         topic.find("/status/light/") != std::string::npos ||
+         topic.compare(topic.size() - 8, 8, "/sensors") == 0 ||
+         topic.find("/sensors/rollup") != std::string::npos;
+}
+
+// Sensor block of loop() before change-driven reporting: every 15 s, publish everything.
+void fixedIntervalStep() {
+  static unsigned long lastSensorTime = 0;
+  unsigned long now = millis();
+  if (now - lastSensorTime < 15000) return;
+  lastSensorTime = now;
+  float temperature = sim::dht20().temperature;
+  float humidity = sim::dht20().humidity;
+  if (temperature > kAlarmC && !alarmActive()) {
+    setAlarm(true, config.ranges[STATUS_ALARM].idMin);
+  }
+  publishSensorData(temperature, humidity, analogRead(2));
+}
+
+struct Outcome {
+  uint64_t messages = 0;
+  uint64_t wireBytes = 0;
+  double alarmDelayS = -1;
+  double lightMeanS = 0;
+  double lightMaxS = 0;
+  int missed = 0;
+};
+
+Outcome run(const bench::Trace& trace, void (*step)()) {
+  setAlarm(false, config.ranges[STATUS_ALARM].idMin);
+  runUntilConnected();
+  sim::broker().clearLog();
+  sim::broker().recordLog = true;
+
+  uint64_t start = (sim::nowUs() / 1000000ULL + 1) * 1000000ULL;
+  sim::setNowUs(start);
+  bench::TracePlayer player(trace, start);
+  while (player.update()) {
+    step();
+    sim::advanceUs(10000);
+  }
+
+  Outcome out;
+  for (const sim::Message& m : sim::broker().log()) {
+    if (!isSensorTopic(m.topic)) continue;
+    out.messages++;
+    out.wireBytes += sim::Broker::packetSize(m.topic.size(), m.payload.size());
+  }
+  int lightEvents = 0;
+  for (const Event& e : findEvents(trace)) {
+    uint64_t at = player.timeOfUs(e.seconds);
+    double delay = -1;
+    for (const sim::Message& m : sim::broker().log()) {
+      if (m.atUs >= at && m.topic == e.topic && (!e.payload || m.payload == e.payload)) {
+        delay = (m.atUs - at) / 1e6;
+        break;
+      }
+    }
+    if (delay < 0) {
+      out.missed++;
+    } else if (e.payload) {
+      if (out.alarmDelayS < 0) out.alarmDelayS = delay;
+    } else {
+      lightEvents++;
+      out.lightMeanS += delay;
+      if (delay > out.lightMaxS) out.lightMaxS = delay;
+    }
+  }
+  if (lightEvents) out.lightMeanS /= lightEvents;
+  sim::broker().clearLog();
+  return out;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const bool quick = bench::hasFlag(argc, argv, "--quick");
+  bench::Trace trace;
+  const char* path = nullptr;
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--trace") == 0) path = argv[i + 1];
+  }
+  if (path) {
+    if (!bench::loadTraceCsv(path, trace)) {
+      fprintf(stderr, "cannot read trace %s\n", path);
+      return 1;
+    }
+  } else {
+    // Quick mode keeps the fire event: start 20 minutes before it.
+    trace = bench::syntheticTrace(quick ? 4 * 3600 + 1200 : 6 * 3600);
+    if (quick) trace.erase(trace.begin(), trace.begin() + 4 * 3600 - 1200);
+    for (size_t i = 0; i < trace.size(); i++) trace[i].seconds = (uint32_t)i;
+  }
+  const double hours = (trace.back().seconds + 1) / 3600.0;
+
+  setup();
+  sim::broker().recordLog = false;
+
+  printf("trace: %s, %.1f h, %zu events\n", path ? path : "synthetic", hours,
+         findEvents(trace).size());
+  printf("\n== sensor reporting: fixed 15 s vs change-driven vs rollups ==\n");
+  printf("%-24s %10s %12s %10s %12s %14s %14s %7s\n", "policy", "messages", "msgs/hour",
+         "wire KB", "alarm delay", "light mean s", "light max s", "missed");
+  struct Variant {
+    const char* name;
+    void (*step)();
+  } variants[] = {
+    {"fixed 15 s (before)", fixedIntervalStep},
+    {"change-driven loop()", [] { loop(); }},
+    {"rollups, raw off", [] { sensorRawStream = 0; loop(); }},
+  };
+  uint64_t baseline = 0;
+  for (const Variant& v : variants) {
+    Outcome o = run(trace, v.step);
+    if (!baseline) baseline = o.messages;
+    printf("%-24s %10llu %12.0f %10.1f %12.2f %14.2f %14.2f %7d\n", v.name,
+           (unsigned long long)o.messages, o.messages / hours, o.wireBytes / 1024.0, o.alarmDelayS,
+           o.lightMeanS, o.lightMaxS, o.missed);
+    if (o.messages != baseline) {
+      printf("%-24s %9.1f%% fewer sensor messages\n", "", 100.0 * (1.0 - (double)o.messages / baseline));
+    }
+  }
+  printf("\ndelays are virtual seconds from the change in the trace to the broker\n");
+  return 0;
+}
@@ -0,0 +1,114 @@
+// Sensor traces for the reporting benchmarks: one row per time step with the
+// DHT20 reading and the three light channels, held until the next row.
+//
+// CSV, one header line then: seconds,temp_c,humi_pct,light4,light5,light6
+// syntheticTrace() generates a deterministic day-like trace when no recording
+// is given.
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include "board_sim.h"
+
+namespace bench {
+
+struct TracePoint {
+  uint32_t seconds;
+  float temperature;
+  float humidity;
+  int light[3];
+};
+
+typedef std::vector<TracePoint> Trace;
+
+inline bool loadTraceCsv(const char* path, Trace& out) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+  char line[256];
+  out.clear();
+  while (fgets(line, sizeof(line), f)) {
+    TracePoint p;
+    if (sscanf(line, "%u,%f,%f,%d,%d,%d", &p.seconds, &p.temperature, &p.humidity, &p.light[0],
+               &p.light[1], &p.light[2]) == 6) {
+      out.push_back(p);
+    }
+  }
+  fclose(f);
+  return !out.empty();
+}
+
+// Slow daily drift with sensor-sized noise, a lamp switched on for half an
+// hour, another toggling every 45 minutes, and a fast temperature rise through
+// the alarm threshold at 4 h.
+inline Trace syntheticTrace(uint32_t seconds) {
+  Trace trace;
+  uint32_t state = 0x9E3779B9u;
+  auto noise = [&state](float amplitude) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return amplitude * ((float)(state % 2001) / 1000.0f - 1.0f);
+  };
+  const float day = 2.0f * (float)M_PI / 86400.0f;
+  for (uint32_t t = 0; t < seconds; t++) {
+    TracePoint p;
+    p.seconds = t;
+    p.temperature = 24.0f + 1.5f * sinf(day * t) + noise(0.03f);
+    const uint32_t fire = 4 * 3600;
+    if (t >= fire && t < fire + 1800) {
+      float rise = fminf((float)(t - fire), 34.0f);
+      if (t > fire + 600) rise *= expf(-(float)(t - fire - 600) / 300.0f);
+      p.temperature += rise;
+    }
+    p.humidity = 60.0f + 4.0f * sinf(day * t + 1.0f) + noise(0.15f);
+    p.light[0] = 1800 + (int)(600.0f * sinf(day * t)) + (int)noise(12.0f);
+    p.light[1] = (t >= 3600 && t < 5400 ? 3200 : 900) + (int)noise(12.0f);
+    p.light[2] = ((t / 2700) % 2 ? 2600 : 400) + (int)noise(12.0f);
+    trace.push_back(p);
+  }
+  return trace;
+}
+
+// Points the simulated DHT20 and light ADCs at the trace, offset so the first
+// row plays at startUs. Returns false once the trace has run out.
+class TracePlayer {
+ public:
+  TracePlayer(const Trace& trace, uint64_t startUs) : trace_(trace), startUs_(startUs) {
+    sim::setAnalogSource([this](int pin, uint64_t nowUs) {
+      const TracePoint& p = at(nowUs);
+      return pin >= 2 && pin <= 4 ? p.light[pin - 2] : 0;
+    });
+  }
+  ~TracePlayer() { sim::setAnalogSource(nullptr); }
+
+  bool update() {
+    const TracePoint& p = at(sim::nowUs());
+    sim::dht20().temperature = p.temperature;
+    sim::dht20().humidity = p.humidity;
+    return secondsAt(sim::nowUs()) <= trace_.back().seconds;
+  }
+
+  uint64_t timeOfUs(uint32_t seconds) const { return startUs_ + (uint64_t)seconds * 1000000ULL; }
+
+ private:
+  uint32_t secondsAt(uint64_t nowUs) const {
+    return nowUs < startUs_ ? 0 : (uint32_t)((nowUs - startUs_) / 1000000ULL);
+  }
+
+  const TracePoint& at(uint64_t nowUs) {
+    uint32_t s = secondsAt(nowUs);
+    while (index_ + 1 < trace_.size() && trace_[index_ + 1].seconds <= s) index_++;
+    while (index_ > 0 && trace_[index_].seconds > s) index_--;
+    return trace_[index_];
+  }
+
+  const Trace& trace_;
+  uint64_t startUs_;
+  size_t index_ = 0;
+};
+
+}  // namespace bench
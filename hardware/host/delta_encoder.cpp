@@ -0,0 +1,151 @@
+#include "delta_encoder.h"
+
+#include <string.h>
+
+#include "firmware_delta.h"
+
+namespace {
+
+const size_t kWindow = 16;        // bytes hashed per base position
+const size_t kMinContinue = 8;    // shortest copy worth it where the last one ended
+const size_t kMinFill = 8;
+const int kTableBits = 20;
+
+uint32_t windowHash(const uint8_t* p) {
+  uint64_t a, b;
+  memcpy(&a, p, 8);
+  memcpy(&b, p + 8, 8);
+  uint64_t h = (a * 0x9E3779B97F4A7C15ull) ^ (b * 0xC2B2AE3D27D4EB4Full);
+  return (uint32_t)(h >> (64 - kTableBits));
+}
+
+class Writer {
+ public:
+  Writer(std::vector<uint8_t>& out, DeltaEncodeStats& stats) : out_(out), stats_(stats) {}
+
+  void varint(uint64_t v) {
+    while (v >= 0x80) {
+      out_.push_back((uint8_t)(v | 0x80));
+      v >>= 7;
+    }
+    out_.push_back((uint8_t)v);
+  }
+
+  void copy(size_t start, size_t length) {
+    varint((uint64_t)length << 2 | DELTA_COPY);
+    int64_t delta = (int64_t)start - (int64_t)baseNext_;
+    varint((uint64_t)((delta << 1) ^ (delta >> 63)));   // zigzag
+    baseNext_ = start + length;
+    stats_.copies++;
+    stats_.copiedBytes += length;
+  }
+
+  // Literal bytes, as fills where one byte repeats long enough.
+  void literal(const uint8_t* p, size_t length) {
+    size_t i = 0;
+    size_t pending = 0;
+    while (i < length) {
+      size_t run = 1;
+      while (i + run < length && p[i + run] == p[i]) run++;
+      if (run < kMinFill) {
+        i += run;
+        continue;
+      }
+      add(p + pending, i - pending);
+      varint((uint64_t)run << 2 | DELTA_FILL);
+      out_.push_back(p[i]);
+      stats_.fills++;
+      stats_.literalBytes += run;
+      i += run;
+      pending = i;
+    }
+    add(p + pending, length - pending);
+  }
+
+ private:
+  void add(const uint8_t* p, size_t length) {
+    if (length == 0) return;
+    varint((uint64_t)length << 2 | DELTA_ADD);
+    out_.insert(out_.end(), p, p + length);
+    stats_.adds++;
+    stats_.literalBytes += length;
+  }
+
+  std::vector<uint8_t>& out_;
+  DeltaEncodeStats& stats_;
+  size_t baseNext_ = 0;
+};
+
+size_t matchLength(const std::vector<uint8_t>& base, size_t b, const std::vector<uint8_t>& target,
+                   size_t t) {
+  size_t n = 0;
+  while (b + n < base.size() && t + n < target.size() && base[b + n] == target[t + n]) n++;
+  return n;
+}
+
+}  // namespace
+
+std::vector<uint8_t> makeFirmwareDelta(const std::vector<uint8_t>& base,
+                                       const std::vector<uint8_t>& target,
+                                       DeltaEncodeStats* stats) {
+  DeltaEncodeStats local;
+  DeltaEncodeStats& s = stats ? *stats : local;
+  s = DeltaEncodeStats();
+
+  std::vector<uint8_t> out(DELTA_HEADER_SIZE);
+  DeltaHeader header;
+  header.baseSize = (uint32_t)base.size();
+  header.targetSize = (uint32_t)target.size();
+  Sha256::hash(base.data(), base.size(), header.baseSha);
+  Sha256::hash(target.data(), target.size(), header.targetSha);
+  encodeDeltaHeader(header, out.data());
+
+  // Last base position of each window hash; -1: none.
+  std::vector<int32_t> table((size_t)1 << kTableBits, -1);
+  for (size_t i = 0; i + kWindow <= base.size(); i++) table[windowHash(&base[i])] = (int32_t)i;
+
+  Writer writer(out, s);
+  size_t pending = 0;            // start of the literal not yet written
+  size_t lastBase = SIZE_MAX;    // base position following the last copy
+  size_t t = 0;
+  while (t < target.size()) {
+    size_t bestStart = 0, bestLength = 0;
+    if (lastBase != SIZE_MAX) {
+      size_t follow = lastBase + (t - pending);
+      if (follow < base.size()) {
+        size_t n = matchLength(base, follow, target, t);
+        if (n >= kMinContinue) {
+          bestStart = follow;
+          bestLength = n;
+        }
+      }
+    }
+    if (t + kWindow <= target.size()) {
+      int32_t candidate = table[windowHash(&target[t])];
+      if (candidate >= 0) {
+        size_t n = matchLength(base, (size_t)candidate, target, t);
+        if (n >= kWindow && n > bestLength) {
+          bestStart = (size_t)candidate;
+          bestLength = n;
+        }
+      }
+    }
+    if (bestLength == 0) {
+      t++;
+      continue;
+    }
+    // Grow the match backwards over the literal waiting before it.
+    while (t > pending && bestStart > 0 && base[bestStart - 1] == target[t - 1]) {
+      t--;
+      bestStart--;
+      bestLength++;
+    }
+    writer.literal(&target[pending], t - pending);
+    writer.copy(bestStart, bestLength);
+    t += bestLength;
+    pending = t;
+    lastBase = bestStart + bestLength;
+  }
+  writer.literal(target.data() + pending, target.size() - pending);
+  return out;
+}
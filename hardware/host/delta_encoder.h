@@ -0,0 +1,26 @@
+// Makes the patches DeltaPatcher applies (see firmware_delta.h). Host only:
+// it indexes the whole base image in memory.
+//
+// Every 16-byte window of the base goes into a hash table; the target is then
+// scanned for the longest match at each position, also trying the spot right
+// after the previous copy, where code that only moved continues. Matches are
+// extended backwards into pending literals, and literal runs of one repeated
+// byte become fills.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+struct DeltaEncodeStats {
+  size_t copies = 0;
+  size_t adds = 0;
+  size_t fills = 0;
+  size_t copiedBytes = 0;
+  size_t literalBytes = 0;
+};
+
+std::vector<uint8_t> makeFirmwareDelta(const std::vector<uint8_t>& base,
+                                       const std::vector<uint8_t>& target,
+                                       DeltaEncodeStats* stats = nullptr);
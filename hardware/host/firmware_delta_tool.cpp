@@ -0,0 +1,99 @@
+// Makes and checks firmware delta patches (see firmware_delta.h).
+//
+//   firmware_delta_tool make old.bin new.bin update.patch
+//   firmware_delta_tool apply old.bin update.patch out.bin
+//
+// old.bin must be the image the devices run, byte for byte (the .bin the
+// build produced, as flashed). apply runs the same DeltaPatcher as the
+// firmware, so a patch that applies here applies on the device.
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "delta_encoder.h"
+#include "firmware_delta.h"
+
+static bool readFile(const char* path, std::vector<uint8_t>& out) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  out.clear();
+  uint8_t buffer[65536];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) out.insert(out.end(), buffer, buffer + n);
+  bool ok = !ferror(f);
+  fclose(f);
+  if (!ok) perror(path);
+  return ok;
+}
+
+static bool writeFile(const char* path, const std::vector<uint8_t>& data) {
+  FILE* f = fopen(path, "wb");
+  bool ok = f && fwrite(data.data(), 1, data.size(), f) == data.size();
+  if (f && fclose(f) != 0) ok = false;
+  if (!ok) perror(path);
+  return ok;
+}
+
+struct Images {
+  std::vector<uint8_t> base;
+  std::vector<uint8_t> out;
+};
+
+static bool readBase(void* ctx, uint32_t offset, uint8_t* out, size_t length) {
+  const std::vector<uint8_t>& base = ((Images*)ctx)->base;
+  if (offset + length > base.size()) return false;
+  memcpy(out, base.data() + offset, length);
+  return true;
+}
+
+static bool writeTarget(void* ctx, const uint8_t* data, size_t length) {
+  std::vector<uint8_t>& out = ((Images*)ctx)->out;
+  out.insert(out.end(), data, data + length);
+  return true;
+}
+
+static int make(const char* basePath, const char* targetPath, const char* patchPath) {
+  std::vector<uint8_t> base, target;
+  if (!readFile(basePath, base) || !readFile(targetPath, target)) return 1;
+  if (target.empty()) {
+    fprintf(stderr, "%s: empty image\n", targetPath);
+    return 1;
+  }
+  DeltaEncodeStats stats;
+  std::vector<uint8_t> patch = makeFirmwareDelta(base, target, &stats);
+  if (!writeFile(patchPath, patch)) return 1;
+  printf("%zu -> %zu bytes: patch %zu bytes (%.1f%%), %zu copies, %zu bytes literal\n",
+         base.size(), target.size(), patch.size(), 100.0 * patch.size() / target.size(),
+         stats.copies, stats.literalBytes);
+  return 0;
+}
+
+static int apply(const char* basePath, const char* patchPath, const char* outPath) {
+  Images images;
+  std::vector<uint8_t> patch;
+  if (!readFile(basePath, images.base) || !readFile(patchPath, patch)) return 1;
+  DeltaPatcher patcher;
+  patcher.begin(readBase, writeTarget, &images);
+  size_t used;
+  DeltaResult result = patcher.feed(patch.data(), patch.size(), &used);
+  if (result != DELTA_DONE) {
+    fprintf(stderr, "%s: %s\n", patchPath,
+            result == DELTA_MORE ? "truncated" : deltaResultName(result));
+    return 1;
+  }
+  return writeFile(outPath, images.out) ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+  if (argc == 5 && strcmp(argv[1], "make") == 0) return make(argv[2], argv[3], argv[4]);
+  if (argc == 5 && strcmp(argv[1], "apply") == 0) return apply(argv[2], argv[3], argv[4]);
+  fprintf(stderr,
+          "usage: %s make old.bin new.bin update.patch\n"
+          "       %s apply old.bin update.patch out.bin\n",
+          argv[0], argv[0]);
+  return 2;
+}
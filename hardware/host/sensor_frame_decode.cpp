@@ -0,0 +1,81 @@
+// Decodes sensor frames (hex, one per line or per argument) into the JSON
+// shape the backend already uses for yolouno/<house>/sensors. Rollup
+// records from yolouno/<house>/sensors/rollup are told apart by their
+// length and printed as one object per channel.
+//
+//   mosquitto_sub -t 'yolouno/+/sensors/frame' -F '%x' | sensor_frame_decode
+//   sensor_frame_decode 01010700102700002e09d10f64006400c800
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sensor_frame.h"
+
+static bool fromHex(const char* text, uint8_t* out, size_t capacity, size_t& length) {
+  length = 0;
+  int high = -1;
+  for (const char* p = text; *p; p++) {
+    if (isspace((unsigned char)*p)) continue;
+    int v = isdigit((unsigned char)*p) ? *p - '0'
+          : (tolower((unsigned char)*p) >= 'a' && tolower((unsigned char)*p) <= 'f')
+              ? tolower((unsigned char)*p) - 'a' + 10
+              : -1;
+    if (v < 0) return false;
+    if (high < 0) {
+      high = v;
+    } else {
+      if (length == capacity) return false;
+      out[length++] = (uint8_t)(high << 4 | v);
+      high = -1;
+    }
+  }
+  return high < 0;
+}
+
+static void printRollup(const RollupRecord& record) {
+  static const char* const names[] = {"temp", "humi", "light0", "light1", "light2"};
+  static const double scales[] = {100.0, 100.0, 1.0, 1.0, 1.0};
+  printf("{\"start\":%u,\"length\":%u", record.startMs, record.lengthMs);
+  for (uint8_t c = 0; c < record.channels; c++) {
+    const RollupStats& s = record.stats[c];
+    printf(",\"%s\":{\"min\":%g,\"max\":%g,\"mean\":%g,\"count\":%u}", names[c],
+           s.min / scales[c], s.max / scales[c], s.mean / scales[c], s.count);
+  }
+  printf("}\n");
+}
+
+static int decodeLine(const char* text) {
+  uint8_t bytes[64];
+  size_t length;
+  SensorFrame frame;
+  RollupRecord record;
+  bool parsed = fromHex(text, bytes, sizeof(bytes), length);
+  if (parsed && length != SENSOR_FRAME_SIZE && decodeSensorRollup(bytes, length, record)) {
+    printRollup(record);
+    return 0;
+  }
+  if (!parsed || !decodeSensorFrame(bytes, length, frame)) {
+    fprintf(stderr, "invalid frame: %s\n", text);
+    return 1;
+  }
+  printf("{\"seq\":%u,\"ts\":%u", frame.seq, frame.timestampMs);
+  if (frame.flags & SENSOR_FRAME_FLAG_CLIMATE_VALID) {
+    printf(",\"temp\":%.2f,\"humi\":%.2f", frame.tempCenti / 100.0, frame.humiCenti / 100.0);
+  }
+  printf(",\"light\":[%u,%u,%u]}\n", frame.light[0], frame.light[1], frame.light[2]);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  int errors = 0;
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++) errors += decodeLine(argv[i]);
+    return errors ? 1 : 0;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), stdin)) {
+    line[strcspn(line, "\r\n")] = 0;
+    if (line[0]) errors += decodeLine(line);
+  }
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,37 @@
+// Host stand-in for Adafruit_NeoPixel. show() charges the WS2812 frame time
+// (30 us per pixel plus the latch) to the virtual clock, like the blocking
+// bit-banged/RMT write on the ESP32.
+#pragma once
+
+#include "Arduino.h"
+
+#define NEO_GRB ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_RGB ((0 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_KHZ800 0x0000
+
+typedef uint16_t neoPixelType;
+
+class Adafruit_NeoPixel {
+ public:
+  Adafruit_NeoPixel(uint16_t n, int16_t pin = 6, neoPixelType type = NEO_GRB + NEO_KHZ800);
+
+  void begin() {}
+  void show();
+  void setBrightness(uint8_t b) { brightness_ = b; }
+  uint8_t getBrightness() const { return brightness_; }
+  void clear();
+  void setPixelColor(uint16_t n, uint32_t c);
+  void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) { setPixelColor(n, Color(r, g, b)); }
+  uint32_t getPixelColor(uint16_t n) const { return n < count_ ? pixels_[n] : 0; }
+  uint16_t numPixels() const { return count_; }
+
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+    return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+  }
+
+ private:
+  static constexpr uint16_t kMaxPixels = 64;
+  uint32_t pixels_[kMaxPixels] = {};
+  uint16_t count_;
+  uint8_t brightness_ = 255;
+};
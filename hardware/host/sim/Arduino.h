@@ -0,0 +1,185 @@
+// Host stand-in for the Arduino-ESP32 core: just enough of Arduino.h,
+// Print, HardwareSerial and WString for hardware/main.cpp to compile and run
+// on Linux against the virtual clock in board_sim.h.
+#pragma once
+
+#include <ctype.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+// Code placed in IRAM on the ESP32 so it can run while flash is busy
+#define IRAM_ATTR
+
+#define DEC 10
+#define HEX 16
+
+enum gpio_num_t {
+  GPIO_NUM_NC = -1,
+  GPIO_NUM_0 = 0, GPIO_NUM_1, GPIO_NUM_2, GPIO_NUM_3, GPIO_NUM_4, GPIO_NUM_5,
+  GPIO_NUM_6, GPIO_NUM_7, GPIO_NUM_8, GPIO_NUM_9, GPIO_NUM_10, GPIO_NUM_11,
+  GPIO_NUM_12, GPIO_NUM_13, GPIO_NUM_14, GPIO_NUM_15, GPIO_NUM_16, GPIO_NUM_17,
+  GPIO_NUM_18, GPIO_NUM_19, GPIO_NUM_20, GPIO_NUM_21, GPIO_NUM_38 = 38,
+  GPIO_NUM_47 = 47, GPIO_NUM_48 = 48,
+};
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+// Interrupts run synchronously inside the level change (see sim::setDigital).
+#define digitalPinToInterrupt(p) ((int)(p))
+void attachInterrupt(uint8_t pin, void (*fn)(void), int mode);
+void attachInterruptArg(uint8_t pin, void (*fn)(void*), void* arg, int mode);
+void detachInterrupt(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+char* dtostrf(double number, signed char width, unsigned char prec, char* s);
+
+// ---- WString ------------------------------------------------------------------
+// Mirrors the ESP32 core's String, including its small-string buffer: up to
+// 11 characters live inline, anything longer goes to the heap. That keeps the
+// allocation counts reported by the benchmarks close to the real firmware.
+class String {
+ public:
+  String(const char* cstr = "");
+  String(const String& s);
+  String(String&& s) noexcept;
+  explicit String(char c);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(double value, unsigned int decimalPlaces = 2);
+  ~String();
+
+  String& operator=(const String& rhs);
+  String& operator=(String&& rhs) noexcept;
+  String& operator=(const char* cstr);
+
+  bool concat(const char* cstr, unsigned int length);
+  String& operator+=(const String& rhs) { concat(rhs.c_str(), rhs.length()); return *this; }
+  String& operator+=(const char* cstr) { concat(cstr, (unsigned int)strlen(cstr)); return *this; }
+  String& operator+=(char c) { concat(&c, 1); return *this; }
+
+  unsigned int length() const { return len_; }
+  const char* c_str() const { return buffer(); }
+  char charAt(unsigned int index) const { return index < len_ ? buffer()[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+
+  bool equals(const String& s) const;
+  bool equals(const char* cstr) const;
+  bool equalsIgnoreCase(const String& s) const;
+  bool operator==(const String& rhs) const { return equals(rhs); }
+  bool operator==(const char* cstr) const { return equals(cstr); }
+  bool operator!=(const String& rhs) const { return !equals(rhs); }
+  bool operator!=(const char* cstr) const { return !equals(cstr); }
+  bool startsWith(const String& prefix) const;
+
+  int indexOf(char ch, unsigned int fromIndex = 0) const;
+  int indexOf(const char* str, unsigned int fromIndex = 0) const;
+  int lastIndexOf(char ch) const;
+  String substring(unsigned int beginIndex) const { return substring(beginIndex, len_); }
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+  long toInt() const;
+  float toFloat() const;
+
+ private:
+  static constexpr unsigned int kSsoSize = 11;
+  bool sso() const { return heap_ == nullptr; }
+  const char* buffer() const { return sso() ? inline_ : heap_; }
+  char* wbuffer() { return sso() ? inline_ : heap_; }
+  bool reserve(unsigned int size);
+  void copy(const char* cstr, unsigned int length);
+
+  char inline_[kSsoSize + 1] = {0};
+  char* heap_ = nullptr;
+  unsigned int capacity_ = kSsoSize;
+  unsigned int len_ = 0;
+};
+
+String operator+(const String& lhs, const String& rhs);
+String operator+(const String& lhs, const char* rhs);
+
+// ---- Print / Serial ---------------------------------------------------------------
+class Print {
+ public:
+  virtual ~Print() = default;
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+
+  size_t print(const char* s) { return write(s); }
+  size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t print(int n, int base = DEC) { return print((long)n, base); }
+  size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned long n, int base = DEC);
+  size_t print(double n, int digits = 2);
+
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(const T& v) { size_t n = print(v); return n + println(); }
+  template <typename T>
+  size_t println(const T& v, int fmt) { size_t n = print(v, fmt); return n + println(); }
+
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class HardwareSerial : public Print {
+ public:
+  void begin(unsigned long baud);
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  int available() { return 0; }
+  int read() { return -1; }
+  void flush() {}
+};
+
+extern HardwareSerial Serial;
+
+// ---- ESP ------------------------------------------------------------------------
+class EspClass {
+ public:
+  uint32_t getFreeHeap();
+  uint32_t getMaxAllocHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getHeapSize() { return 320 * 1024; }
+  void restart();
+};
+
+extern EspClass ESP;
@@ -0,0 +1,18 @@
+// Host stand-in for the ArduinoOTA library (no-op).
+#pragma once
+
+#include <functional>
+
+#include "Arduino.h"
+
+class ArduinoOTAClass {
+ public:
+  ArduinoOTAClass& setHostname(const char* name) { (void)name; return *this; }
+  ArduinoOTAClass& setPassword(const char* password) { (void)password; return *this; }
+  ArduinoOTAClass& onStart(std::function<void()> fn) { (void)fn; return *this; }
+  ArduinoOTAClass& onEnd(std::function<void()> fn) { (void)fn; return *this; }
+  void begin() {}
+  void handle() {}
+};
+
+extern ArduinoOTAClass ArduinoOTA;
@@ -0,0 +1,4 @@
+// Host stand-in: included by main.cpp but unused by the firmware.
+#pragma once
+
+#include "Arduino.h"
@@ -0,0 +1,47 @@
+// Host stand-in for RobTillaart/DHT20. Readings come from sim::dht20();
+// the conversion time is charged to the virtual clock the same way the real
+// read() busy-waits for it.
+#pragma once
+
+#include "Arduino.h"
+
+#define DHT20_OK 0
+#define DHT20_ERROR_CHECKSUM -10
+#define DHT20_ERROR_CONNECT -11
+#define DHT20_MISSING_BYTES -12
+#define DHT20_ERROR_BYTES_ALL_ZERO -13
+#define DHT20_ERROR_READ_TIMEOUT -14
+#define DHT20_ERROR_LASTREAD -15
+
+class TwoWire;
+
+class DHT20 {
+ public:
+  explicit DHT20(TwoWire* wire = nullptr) { (void)wire; }
+
+  bool begin();
+  bool isConnected();
+
+  // Blocking: requestData(), wait for conversion, readData(), convert().
+  int read();
+
+  // Split-phase interface of the real library.
+  int requestData();
+  int readData();
+  int convert();
+  bool isMeasuring();
+
+  float getHumidity() const { return humidity_; }
+  float getTemperature() const { return temperature_; }
+  uint32_t lastRead() const { return lastRead_; }
+  uint32_t lastRequest() const { return lastRequest_; }
+
+ private:
+  float humidity_ = 0;
+  float temperature_ = 0;
+  uint8_t bytes_[7] = {};
+  uint32_t lastRead_ = 0;
+  uint32_t lastRequest_ = 0;
+  uint64_t requestUs_ = 0;
+  bool requested_ = false;
+};
@@ -0,0 +1,17 @@
+// Host stand-in for madhephaestus/ESP32Servo.
+#pragma once
+
+#include "Arduino.h"
+
+class Servo {
+ public:
+  int attach(int pin);
+  void detach() { pin_ = -1; }
+  void write(int value);
+  int read() const { return angle_; }
+  bool attached() const { return pin_ >= 0; }
+
+ private:
+  int pin_ = -1;
+  int angle_ = 0;
+};
@@ -0,0 +1,57 @@
+// Host stand-in for the ESP32 core's FS/File API, backed by sim::flash().
+#pragma once
+
+#include <vector>
+
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File {
+ public:
+  File() = default;
+  File(std::vector<uint8_t>* data, bool writable, bool append)
+      : data_(data), writable_(writable), append_(append) {}
+
+  size_t write(const uint8_t* buf, size_t size);
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t read(uint8_t* buf, size_t size);
+  int available() { return data_ ? (int)(data_->size() - pos_) : 0; }
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const { return pos_; }
+  size_t size() const { return data_ ? data_->size() : 0; }
+  void flush() {}
+  void close() { data_ = nullptr; }
+  explicit operator bool() const { return data_ != nullptr; }
+
+ private:
+  std::vector<uint8_t>* data_ = nullptr;  // owned by sim::flash()
+  size_t pos_ = 0;
+  bool writable_ = false;
+  bool append_ = false;
+};
+
+class FS {
+ public:
+  File open(const char* path, const char* mode = FILE_READ, bool create = false);
+  bool exists(const char* path);
+  bool remove(const char* path);
+  // Replaces an existing pathTo in one step, as LittleFS does.
+  bool rename(const char* pathFrom, const char* pathTo);
+  size_t totalBytes();
+  size_t usedBytes();
+
+ protected:
+  bool mounted_ = false;
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
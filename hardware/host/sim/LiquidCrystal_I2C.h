@@ -0,0 +1,33 @@
+// Host stand-in for LiquidCrystal_I2C (PCF8574 backpack, 4-bit mode). Each
+// character costs several expander writes on a 100 kHz bus; the modeled cost
+// is charged to the virtual clock and the text lands in sim::peripherals().lcd.
+#pragma once
+
+#include "Arduino.h"
+
+class LiquidCrystal_I2C : public Print {
+ public:
+  LiquidCrystal_I2C(uint8_t addr, uint8_t cols, uint8_t rows);
+
+  void init();
+  void begin() { init(); }
+  void backlight() { busWrite(1); }
+  void noBacklight() { busWrite(1); }
+  void clear();
+  void home() { setCursor(0, 0); }
+  void setCursor(uint8_t col, uint8_t row);
+
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+  // Modeled cost of one byte sent through the expander in 4-bit mode.
+  static constexpr uint32_t kByteUs = 550;
+
+ private:
+  void busWrite(uint32_t bytes);
+
+  uint8_t cols_;
+  uint8_t rows_;
+  uint8_t col_ = 0;
+  uint8_t row_ = 0;
+};
@@ -0,0 +1,19 @@
+// Host stand-in for the ESP32 LittleFS library. Files live in sim::flash();
+// writes and reads are charged to the virtual clock like flash I/O.
+#pragma once
+
+#include "FS.h"
+
+namespace fs {
+
+class LittleFSFS : public FS {
+ public:
+  bool begin(bool formatOnFail = false, const char* basePath = "/littlefs",
+             uint8_t maxOpenFiles = 10, const char* partitionLabel = "spiffs");
+  bool format();
+  void end() { mounted_ = false; }
+};
+
+}  // namespace fs
+
+extern fs::LittleFSFS LittleFS;
@@ -0,0 +1,83 @@
+// Host stand-in for knolleary/PubSubClient 2.8, backed by the in-process
+// broker in board_sim.h. Same public API and return codes; publishes are
+// QoS 0 like the real library. connect() opens the Client it was built
+// with (TCP, or TLS over it) before CONNECT/CONNACK; with cleanSession false
+// the broker keeps the subscriptions and QoS 1 messages of that client ID.
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "WiFi.h"
+#include "board_sim.h"
+
+#ifndef MQTT_MAX_PACKET_SIZE
+#define MQTT_MAX_PACKET_SIZE 256
+#endif
+
+#define MQTT_KEEPALIVE 15
+#define MQTT_SOCKET_TIMEOUT 15
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+
+#define MQTT_MAX_HEADER_SIZE 5
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+class PubSubClient : private sim::BrokerClient {
+ public:
+  explicit PubSubClient(Client& client);
+  ~PubSubClient() override;
+
+  PubSubClient& setServer(const char* domain, uint16_t port);
+  PubSubClient& setClient(Client& client);
+  PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+  PubSubClient& setKeepAlive(uint16_t keepAlive) { keepAlive_ = keepAlive; return *this; }
+  PubSubClient& setSocketTimeout(uint16_t timeout) { (void)timeout; return *this; }
+  bool setBufferSize(uint16_t size);
+  uint16_t getBufferSize() const { return bufferSize_; }
+
+  bool connect(const char* id);
+  bool connect(const char* id, const char* user, const char* pass);
+  bool connect(const char* id, const char* willTopic, uint8_t willQos, bool willRetain,
+               const char* willMessage);
+  bool connect(const char* id, const char* user, const char* pass, const char* willTopic,
+               uint8_t willQos, bool willRetain, const char* willMessage);
+  bool connect(const char* id, const char* user, const char* pass, const char* willTopic,
+               uint8_t willQos, bool willRetain, const char* willMessage, bool cleanSession);
+  void disconnect();
+
+  bool publish(const char* topic, const char* payload);
+  bool publish(const char* topic, const char* payload, bool retained);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int plength);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int plength, bool retained);
+
+  bool subscribe(const char* topic);
+  bool subscribe(const char* topic, uint8_t qos);
+  bool unsubscribe(const char* topic);
+
+  bool loop();
+  bool connected();
+  int state() const { return state_; }
+
+ private:
+  void deliver(const sim::Message& m) override;
+  uint64_t nextMessageUs() const override;
+
+  Client* transport_;
+  const char* domain_ = nullptr;
+  uint16_t port_ = 0;
+  std::function<void(char*, uint8_t*, unsigned int)> callback_;
+  std::vector<sim::Message> inbox_;
+  std::vector<uint8_t> buffer_;
+  std::string clientId_;
+  uint16_t bufferSize_ = MQTT_MAX_PACKET_SIZE;
+  uint16_t keepAlive_ = MQTT_KEEPALIVE;
+  int state_ = MQTT_DISCONNECTED;
+};
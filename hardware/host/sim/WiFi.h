@@ -0,0 +1,76 @@
+// Host stand-in for the ESP32 WiFi library. Association completes
+// sim::wifi().associateMs after begin() on the virtual clock.
+#pragma once
+
+#include "Arduino.h"
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1 } wifi_mode_t;
+
+class WiFiClass {
+ public:
+  wl_status_t begin(const char* ssid, const char* passphrase = nullptr);
+  wl_status_t status();
+  bool disconnect(bool wifioff = false);
+  bool reconnect();
+  bool mode(wifi_mode_t m) { (void)m; return true; }
+  bool setSleep(bool enabled) { sleep_ = enabled; return true; }
+  bool getSleep() const { return sleep_; }
+  int8_t RSSI() { return -55; }
+
+ private:
+  bool started_ = false;
+  bool sleep_ = true;
+  uint64_t beganUs_ = 0;
+};
+
+extern WiFiClass WiFi;
+
+class IPAddress {
+ public:
+  IPAddress(uint32_t address = 0) : address_(address) {}
+  operator uint32_t() const { return address_; }
+
+ private:
+  uint32_t address_;
+};
+
+// Arduino's Client interface. The broker stand-in carries no bytes, so the
+// data calls are inert; connect() is where a transport charges its cost.
+class Client : public Print {
+ public:
+  virtual int connect(IPAddress ip, uint16_t port) { (void)ip; return connect("", port); }
+  virtual int connect(const char* host, uint16_t port) { (void)host; (void)port; return 1; }
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t* buf, size_t size) override { (void)buf; return size; }
+  using Print::write;
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  virtual int read(uint8_t* buf, size_t size) { (void)buf; (void)size; return 0; }
+  virtual int peek() { return -1; }
+  virtual void flush() {}
+  virtual void stop() {}
+  virtual uint8_t connected() { return 0; }
+  virtual operator bool() { return connected() != 0; }
+};
+
+// TCP to the broker: connect() costs one round trip (sim::broker().rttUs)
+// and fails, after it, when the broker or WiFi is down.
+class WiFiClient : public Client {
+ public:
+  using Client::connect;
+  int connect(const char* host, uint16_t port) override;
+  void stop() override { open_ = false; }
+  uint8_t connected() override;
+
+ private:
+  bool open_ = false;
+};
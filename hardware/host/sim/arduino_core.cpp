@@ -0,0 +1,380 @@
+// Arduino core stand-in: timing, GPIO, Print/Serial and WString.
+#include <stdarg.h>
+
+#include <new>
+
+#include "Arduino.h"
+#include "board_sim.h"
+#include "driver/gpio.h"
+#include "esp_sleep.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+
+unsigned long millis() { return (unsigned long)(sim::nowUs() / 1000ULL); }
+unsigned long micros() { return (unsigned long)sim::nowUs(); }
+void delay(unsigned long ms) { sim::advanceUs((uint64_t)ms * 1000ULL); }
+void delayMicroseconds(unsigned int us) { sim::advanceUs(us); }
+void yield() {}
+
+void pinMode(uint8_t pin, uint8_t mode) { sim::setPinMode(pin, mode); }
+void digitalWrite(uint8_t pin, uint8_t val) { sim::setDigital(pin, val ? HIGH : LOW); }
+int digitalRead(uint8_t pin) { return sim::digitalLevel(pin); }
+
+namespace {
+void callPlain(void* fn) { reinterpret_cast<void (*)(void)>(fn)(); }
+}  // namespace
+
+void attachInterrupt(uint8_t pin, void (*fn)(void), int mode) {
+  sim::setInterrupt(pin, callPlain, reinterpret_cast<void*>(fn), mode);
+}
+void attachInterruptArg(uint8_t pin, void (*fn)(void*), void* arg, int mode) {
+  sim::setInterrupt(pin, fn, arg, mode);
+}
+void detachInterrupt(uint8_t pin) { sim::setInterrupt(pin, nullptr, nullptr, 0); }
+
+uint16_t analogRead(uint8_t pin) {
+  // One-shot conversion on the ESP32-S3 ADC takes on the order of 10 us.
+  sim::advanceUs(10);
+  int v = sim::analogValue(pin);
+  return (uint16_t)constrain(v, 0, 4095);
+}
+
+static uint32_t g_randomState = 0x12345678u;
+
+void randomSeed(unsigned long seed) {
+  if (seed != 0) g_randomState = (uint32_t)seed;
+}
+
+long random(long howbig) {
+  if (howbig <= 0) return 0;
+  // xorshift32: deterministic across runs, which the simulations rely on.
+  g_randomState ^= g_randomState << 13;
+  g_randomState ^= g_randomState >> 17;
+  g_randomState ^= g_randomState << 5;
+  return (long)(g_randomState % (uint32_t)howbig);
+}
+
+long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) return howsmall;
+  return random(howbig - howsmall) + howsmall;
+}
+
+char* dtostrf(double number, signed char width, unsigned char prec, char* s) {
+  sprintf(s, "%*.*f", width, prec, number);
+  return s;
+}
+
+// ---- ESP ---------------------------------------------------------------------------
+
+uint32_t EspClass::getFreeHeap() {
+  int64_t live = sim::heap().liveBytes;
+  return (uint32_t)(getHeapSize() - (live > 0 ? live : 0));
+}
+uint32_t EspClass::getMaxAllocHeap() { return getFreeHeap(); }
+uint32_t EspClass::getMinFreeHeap() { return getFreeHeap(); }
+void EspClass::restart() { sim::peripherals().restarts++; }
+
+// ---- Light sleep -------------------------------------------------------------------
+
+namespace {
+uint64_t g_timerWakeUs = 0;
+bool g_gpioWake = false;
+bool g_wifiWake = false;
+int g_wakeLevel[sim::kPinCount];   // GPIO_INTR_*_LEVEL, 0: not a wake pin
+esp_sleep_wakeup_cause_t g_wakeCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+}  // namespace
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t timeUs) {
+  g_timerWakeUs = timeUs;
+  return ESP_OK;
+}
+esp_err_t esp_sleep_enable_gpio_wakeup() {
+  g_gpioWake = true;
+  return ESP_OK;
+}
+esp_err_t esp_sleep_enable_wifi_wakeup() {
+  g_wifiWake = true;
+  return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_enable(gpio_num_t pin, gpio_int_type_t level) {
+  if (pin < 0 || pin >= sim::kPinCount) return -1;
+  g_wakeLevel[pin] = level;
+  return ESP_OK;
+}
+esp_err_t gpio_wakeup_disable(gpio_num_t pin) {
+  if (pin < 0 || pin >= sim::kPinCount) return -1;
+  g_wakeLevel[pin] = 0;
+  return ESP_OK;
+}
+
+esp_err_t esp_light_sleep_start() {
+  uint64_t now = sim::nowUs();
+  uint64_t wake = g_timerWakeUs ? now + g_timerWakeUs : UINT64_MAX;
+  g_wakeCause = ESP_SLEEP_WAKEUP_TIMER;
+  if (g_wifiWake) {
+    uint64_t rx = sim::broker().nextDeliveryUs();
+    if (rx < wake) {
+      wake = rx < now ? now : rx;
+      g_wakeCause = ESP_SLEEP_WAKEUP_WIFI;
+    }
+  }
+  for (int pin = 0; g_gpioWake && pin < sim::kPinCount; pin++) {
+    if (!g_wakeLevel[pin]) continue;
+    int level = g_wakeLevel[pin] == GPIO_INTR_HIGH_LEVEL ? HIGH : LOW;
+    uint64_t at = sim::digitalLevel(pin) == level ? now : sim::nextDigitalUs(pin, level);
+    if (at < wake) {
+      wake = at;
+      g_wakeCause = ESP_SLEEP_WAKEUP_GPIO;
+    }
+  }
+  if (wake == UINT64_MAX) return -1;   // no wake source: the chip would never wake
+  sim::PowerState& power = sim::power();
+  power.lightSleeps++;
+  power.lightSleepUs += wake - now;
+  sim::advanceUs(wake - now + power.wakeupUs);
+  return ESP_OK;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() { return g_wakeCause; }
+
+// ---- Print -------------------------------------------------------------------------
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+size_t Print::print(long n, int base) {
+  if (base == DEC && n < 0) {
+    size_t t = print('-');
+    return t + print((unsigned long)(-n), base);
+  }
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  char buf[8 * sizeof(long) + 1];
+  char* str = &buf[sizeof(buf) - 1];
+  *str = '\0';
+  if (base < 2) base = 10;
+  do {
+    unsigned long m = n;
+    n /= base;
+    char c = (char)(m - base * n);
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (n);
+  return write(str);
+}
+
+size_t Print::print(double number, int digits) {
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", digits, number);
+  return write(buf);
+}
+
+size_t Print::printf(const char* format, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (n < 0) return 0;
+  return write((const uint8_t*)buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+}
+
+// ---- Serial --------------------------------------------------------------------------
+// Output is dropped unless SIM_SERIAL is set in the environment, so that
+// benchmarks measure the firmware and not the terminal.
+
+static bool serialEcho() {
+  static int echo = -1;
+  if (echo < 0) echo = getenv("SIM_SERIAL") != nullptr;
+  return echo == 1;
+}
+
+void HardwareSerial::begin(unsigned long baud) { (void)baud; }
+
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  sim::peripherals().serialBytes += size;
+  if (serialEcho()) fwrite(buffer, 1, size, stdout);
+  return size;
+}
+
+// ---- String --------------------------------------------------------------------------
+
+String::String(const char* cstr) {
+  if (cstr) copy(cstr, (unsigned int)strlen(cstr));
+}
+
+String::String(const String& s) { copy(s.c_str(), s.len_); }
+
+String::String(String&& s) noexcept {
+  if (s.sso()) {
+    memcpy(inline_, s.inline_, sizeof(inline_));
+  } else {
+    heap_ = s.heap_;
+    capacity_ = s.capacity_;
+    s.heap_ = nullptr;
+    s.capacity_ = kSsoSize;
+  }
+  len_ = s.len_;
+  s.len_ = 0;
+  s.inline_[0] = 0;
+}
+
+String::String(char c) { copy(&c, 1); }
+
+String::String(int value, unsigned char base) : String((long)value, base) {}
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base) {}
+
+String::String(long value, unsigned char base) {
+  char buf[2 + 8 * sizeof(long)];
+  if (base == 10) snprintf(buf, sizeof(buf), "%ld", value);
+  else snprintf(buf, sizeof(buf), "%lx", (unsigned long)value);
+  copy(buf, (unsigned int)strlen(buf));
+}
+
+String::String(unsigned long value, unsigned char base) {
+  char buf[1 + 8 * sizeof(unsigned long)];
+  snprintf(buf, sizeof(buf), base == 10 ? "%lu" : "%lx", value);
+  copy(buf, (unsigned int)strlen(buf));
+}
+
+String::String(double value, unsigned int decimalPlaces) {
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, value);
+  copy(buf, (unsigned int)strlen(buf));
+}
+
+String::~String() { delete[] heap_; }
+
+String& String::operator=(const String& rhs) {
+  if (this != &rhs) copy(rhs.c_str(), rhs.len_);
+  return *this;
+}
+
+String& String::operator=(String&& rhs) noexcept {
+  if (this != &rhs) {
+    delete[] heap_;
+    heap_ = nullptr;
+    capacity_ = kSsoSize;
+    new (this) String(static_cast<String&&>(rhs));
+  }
+  return *this;
+}
+
+String& String::operator=(const char* cstr) {
+  copy(cstr ? cstr : "", cstr ? (unsigned int)strlen(cstr) : 0);
+  return *this;
+}
+
+bool String::reserve(unsigned int size) {
+  if (size <= capacity_) return true;
+  char* fresh = new char[size + 1];
+  memcpy(fresh, buffer(), len_ + 1);
+  delete[] heap_;
+  heap_ = fresh;
+  capacity_ = size;
+  return true;
+}
+
+void String::copy(const char* cstr, unsigned int length) {
+  reserve(length);
+  memmove(wbuffer(), cstr, length);
+  wbuffer()[length] = 0;
+  len_ = length;
+}
+
+bool String::concat(const char* cstr, unsigned int length) {
+  unsigned int newLen = len_ + length;
+  reserve(newLen);
+  memmove(wbuffer() + len_, cstr, length);
+  wbuffer()[newLen] = 0;
+  len_ = newLen;
+  return true;
+}
+
+bool String::equals(const String& s) const {
+  return len_ == s.len_ && memcmp(buffer(), s.buffer(), len_) == 0;
+}
+
+bool String::equals(const char* cstr) const { return strcmp(buffer(), cstr ? cstr : "") == 0; }
+
+bool String::equalsIgnoreCase(const String& s) const {
+  if (len_ != s.len_) return false;
+  for (unsigned int i = 0; i < len_; ++i) {
+    if (tolower((unsigned char)buffer()[i]) != tolower((unsigned char)s.buffer()[i])) return false;
+  }
+  return true;
+}
+
+bool String::startsWith(const String& prefix) const {
+  return prefix.len_ <= len_ && memcmp(buffer(), prefix.buffer(), prefix.len_) == 0;
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+  if (fromIndex >= len_) return -1;
+  const char* p = strchr(buffer() + fromIndex, ch);
+  return p ? (int)(p - buffer()) : -1;
+}
+
+int String::indexOf(const char* str, unsigned int fromIndex) const {
+  if (fromIndex >= len_) return -1;
+  const char* p = strstr(buffer() + fromIndex, str);
+  return p ? (int)(p - buffer()) : -1;
+}
+
+int String::lastIndexOf(char ch) const {
+  const char* p = strrchr(buffer(), ch);
+  return p ? (int)(p - buffer()) : -1;
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if (beginIndex > endIndex) {
+    unsigned int t = endIndex;
+    endIndex = beginIndex;
+    beginIndex = t;
+  }
+  String out;
+  if (beginIndex >= len_) return out;
+  if (endIndex > len_) endIndex = len_;
+  out.copy(buffer() + beginIndex, endIndex - beginIndex);
+  return out;
+}
+
+void String::toLowerCase() {
+  for (unsigned int i = 0; i < len_; ++i) wbuffer()[i] = (char)tolower((unsigned char)wbuffer()[i]);
+}
+
+void String::toUpperCase() {
+  for (unsigned int i = 0; i < len_; ++i) wbuffer()[i] = (char)toupper((unsigned char)wbuffer()[i]);
+}
+
+void String::trim() {
+  unsigned int begin = 0, end = len_;
+  while (begin < end && isspace((unsigned char)buffer()[begin])) ++begin;
+  while (end > begin && isspace((unsigned char)buffer()[end - 1])) --end;
+  memmove(wbuffer(), buffer() + begin, end - begin);
+  len_ = end - begin;
+  wbuffer()[len_] = 0;
+}
+
+long String::toInt() const { return atol(buffer()); }
+float String::toFloat() const { return (float)atof(buffer()); }
+
+String operator+(const String& lhs, const String& rhs) {
+  String out(lhs);
+  out += rhs;
+  return out;
+}
+
+String operator+(const String& lhs, const char* rhs) {
+  String out(lhs);
+  out += rhs;
+  return out;
+}
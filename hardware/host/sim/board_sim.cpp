@@ -0,0 +1,513 @@
+// Simulated board state: virtual clock, counted heap, GPIO/ADC, the DHT20
+// and WiFi models and the in-process MQTT broker.
+#include "board_sim.h"
+
+#include <Arduino.h>
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <atomic>
+#include <new>
+
+namespace sim {
+
+namespace {
+
+std::atomic<uint64_t> g_nowUs{0};
+std::atomic<uint64_t> g_ioUs{0};
+
+std::atomic<uint64_t> g_allocs{0};
+std::atomic<uint64_t> g_frees{0};
+std::atomic<uint64_t> g_allocBytes{0};
+std::atomic<int64_t> g_liveBytes{0};
+std::atomic<int64_t> g_peakLiveBytes{0};
+thread_local int t_uncounted = 0;
+
+int g_analog[kPinCount] = {};
+int g_digital[kPinCount] = {};
+bool g_driven[kPinCount] = {};    // set by digitalWrite() or an external input
+bool g_pullUp[kPinCount] = {};    // pinMode(INPUT_PULLUP): reads HIGH while undriven
+std::atomic<uint64_t> g_analogReads{0};
+std::function<int(int, uint64_t)> g_analogSource;
+
+struct ScheduledLevel {
+  int pin;
+  int level;
+  uint64_t atUs;
+};
+std::vector<ScheduledLevel> g_scheduled;
+std::atomic<bool> g_hasScheduled{false};
+
+struct PinInterrupt {
+  void (*fn)(void*);
+  void* arg;
+  int mode;
+};
+PinInterrupt g_interrupts[kPinCount] = {};
+
+// Moves the clock to untilUs, stopping at each scheduled change on the way so
+// that an interrupt it fires sees the clock at the time of the change.
+void advanceThroughScheduled(uint64_t untilUs) {
+  for (;;) {
+    size_t first = g_scheduled.size();
+    for (size_t i = 0; i < g_scheduled.size(); i++) {
+      if (g_scheduled[i].atUs <= untilUs &&
+          (first == g_scheduled.size() || g_scheduled[i].atUs < g_scheduled[first].atUs)) {
+        first = i;
+      }
+    }
+    if (first == g_scheduled.size()) break;
+    ScheduledLevel s = g_scheduled[first];
+    g_scheduled.erase(g_scheduled.begin() + first);
+    if (s.atUs > nowUs()) g_nowUs.store(s.atUs, std::memory_order_relaxed);
+    setDigital(s.pin, s.level);
+  }
+  g_hasScheduled.store(!g_scheduled.empty(), std::memory_order_relaxed);
+  if (untilUs > nowUs()) g_nowUs.store(untilUs, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+uint64_t nowUs() { return g_nowUs.load(std::memory_order_relaxed); }
+
+void advanceUs(uint64_t us) {
+  if (!g_hasScheduled.load(std::memory_order_relaxed)) {
+    g_nowUs.fetch_add(us, std::memory_order_relaxed);
+    return;
+  }
+  advanceThroughScheduled(nowUs() + us);
+}
+
+void setNowUs(uint64_t us) {
+  if (g_hasScheduled.load(std::memory_order_relaxed) && us > nowUs()) {
+    advanceThroughScheduled(us);
+    return;
+  }
+  g_nowUs.store(us, std::memory_order_relaxed);
+}
+
+void chargeIo(uint64_t us) {
+  g_ioUs.fetch_add(us, std::memory_order_relaxed);
+  advanceUs(us);
+}
+uint64_t ioUs() { return g_ioUs.load(std::memory_order_relaxed); }
+
+const HeapStats& heap() {
+  static thread_local HeapStats snapshot;
+  snapshot.allocs = g_allocs.load(std::memory_order_relaxed);
+  snapshot.frees = g_frees.load(std::memory_order_relaxed);
+  snapshot.bytes = g_allocBytes.load(std::memory_order_relaxed);
+  snapshot.liveBytes = g_liveBytes.load(std::memory_order_relaxed);
+  snapshot.peakLiveBytes = g_peakLiveBytes.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+void resetHeapPeak() {
+  g_peakLiveBytes.store(g_liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+UncountedHeap::UncountedHeap() { ++t_uncounted; }
+UncountedHeap::~UncountedHeap() { --t_uncounted; }
+
+namespace detail {
+void* countedAlloc(size_t size) {
+  // Size header so frees can be attributed; keeps max alignment.
+  constexpr size_t kHeader = alignof(std::max_align_t);
+  unsigned char* p = static_cast<unsigned char*>(malloc(size + kHeader));
+  if (!p) throw std::bad_alloc();
+  *reinterpret_cast<size_t*>(p) = t_uncounted ? ~size_t(0) : size;
+  if (!t_uncounted) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_allocBytes.fetch_add(size, std::memory_order_relaxed);
+    int64_t live = g_liveBytes.fetch_add((int64_t)size, std::memory_order_relaxed) + (int64_t)size;
+    int64_t peak = g_peakLiveBytes.load(std::memory_order_relaxed);
+    while (live > peak &&
+           !g_peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+  }
+  return p + kHeader;
+}
+
+void countedFree(void* ptr) {
+  if (!ptr) return;
+  constexpr size_t kHeader = alignof(std::max_align_t);
+  unsigned char* p = static_cast<unsigned char*>(ptr) - kHeader;
+  size_t size = *reinterpret_cast<size_t*>(p);
+  if (size != ~size_t(0)) {
+    g_frees.fetch_add(1, std::memory_order_relaxed);
+    g_liveBytes.fetch_sub((int64_t)size, std::memory_order_relaxed);
+  }
+  free(p);
+}
+}  // namespace detail
+
+void setAnalog(int pin, int value) {
+  if (pin >= 0 && pin < kPinCount) g_analog[pin] = value;
+}
+
+void setAnalogSource(std::function<int(int, uint64_t)> source) {
+  UncountedHeap guard;
+  g_analogSource = std::move(source);
+}
+
+int analogValue(int pin) {
+  g_analogReads.fetch_add(1, std::memory_order_relaxed);
+  if (g_analogSource) return g_analogSource(pin, nowUs());
+  return (pin >= 0 && pin < kPinCount) ? g_analog[pin] : 0;
+}
+
+void setDigital(int pin, int level) {
+  if (pin < 0 || pin >= kPinCount) return;
+  int was = digitalLevel(pin);
+  g_digital[pin] = level;
+  g_driven[pin] = true;
+  const PinInterrupt& irq = g_interrupts[pin];
+  if (!irq.fn || was == level) return;
+  if (irq.mode == CHANGE || (irq.mode == RISING && level) || (irq.mode == FALLING && !level)) {
+    irq.fn(irq.arg);
+  }
+}
+
+int digitalLevel(int pin) {
+  if (pin < 0 || pin >= kPinCount) return LOW;
+  if (!g_driven[pin]) return g_pullUp[pin] ? HIGH : LOW;
+  return g_digital[pin];
+}
+
+void setPinMode(int pin, int mode) {
+  if (pin >= 0 && pin < kPinCount) g_pullUp[pin] = mode == INPUT_PULLUP;
+}
+
+void scheduleDigital(int pin, int level, uint64_t atUs) {
+  UncountedHeap guard;
+  if (atUs <= nowUs()) {
+    setDigital(pin, level);
+    return;
+  }
+  g_scheduled.push_back(ScheduledLevel{pin, level, atUs});
+  g_hasScheduled.store(true, std::memory_order_relaxed);
+}
+
+uint64_t nextScheduledUs() {
+  uint64_t next = UINT64_MAX;
+  for (const ScheduledLevel& s : g_scheduled) {
+    if (s.atUs < next) next = s.atUs;
+  }
+  return next;
+}
+
+void setInterrupt(int pin, void (*fn)(void*), void* arg, int mode) {
+  if (pin >= 0 && pin < kPinCount) g_interrupts[pin] = PinInterrupt{fn, arg, mode};
+}
+
+uint64_t nextDigitalUs(int pin, int level) {
+  uint64_t next = UINT64_MAX;
+  for (const ScheduledLevel& s : g_scheduled) {
+    if (s.pin == pin && s.level == level && s.atUs < next) next = s.atUs;
+  }
+  return next;
+}
+
+PowerState& power() {
+  static PowerState state;
+  return state;
+}
+uint64_t analogReads() { return g_analogReads.load(std::memory_order_relaxed); }
+
+Dht20State& dht20() {
+  static Dht20State state;
+  return state;
+}
+
+WifiState& wifi() {
+  static WifiState state;
+  return state;
+}
+
+FlashState& flash() {
+  static FlashState state;
+  return state;
+}
+
+OtaState& ota() {
+  static OtaState state;
+  return state;
+}
+
+int rebootOta() {
+  OtaState& o = ota();
+  if (o.state[o.boot] == ESP_OTA_IMG_NEW) {
+    o.state[o.boot] = ESP_OTA_IMG_PENDING_VERIFY;
+  } else if (o.state[o.boot] == ESP_OTA_IMG_PENDING_VERIFY) {
+    o.state[o.boot] = ESP_OTA_IMG_ABORTED;
+    o.boot = 1 - o.boot;
+  }
+  o.running = o.boot;
+  return o.running;
+}
+
+TlsServerState& tls() {
+  static TlsServerState t;
+  return t;
+}
+
+Peripherals& peripherals() {
+  static Peripherals p;
+  return p;
+}
+
+// ---- Broker ------------------------------------------------------------------
+
+Broker& broker() {
+  static Broker b;
+  return b;
+}
+
+void Broker::setOutage(uint64_t fromUs, uint64_t untilUs) {
+  outageFrom_ = fromUs;
+  outageUntil_ = untilUs;
+}
+
+bool Broker::reachable() const {
+  uint64_t now = nowUs();
+  return !(now >= outageFrom_ && now < outageUntil_);
+}
+
+void Broker::attach(BrokerClient* c) {
+  UncountedHeap guard;
+  clients_.push_back(c);
+}
+
+void Broker::detach(BrokerClient* c) {
+  UncountedHeap guard;
+  forget(c);
+  clients_.erase(std::remove(clients_.begin(), clients_.end(), c), clients_.end());
+}
+
+bool Broker::connect(BrokerClient* c, bool cleanSession, const std::string& clientId) {
+  if (!reachable()) {
+    ++stats_.failedConnects;
+    return false;
+  }
+  UncountedHeap guard;
+  ++stats_.connects;
+  c->sessionPresent = !cleanSession && c->persistent && c->sessionId == clientId;
+  if (c->sessionPresent) {
+    ++stats_.resumedSessions;
+  } else {
+    forget(c);
+    c->filters.clear();
+  }
+  c->persistent = !cleanSession;
+  c->sessionId = clientId;
+  c->online = true;
+  return true;
+}
+
+void Broker::dropRetained() {
+  UncountedHeap guard;
+  retained_.clear();
+  for (BrokerClient* c : clients_) {
+    forget(c);
+    c->filters.clear();
+    c->persistent = false;
+  }
+}
+
+void Broker::subscribe(BrokerClient* c, const std::string& filter, uint8_t qos) {
+  UncountedHeap guard;
+  ++stats_.subscribes;
+  std::string prefix = literalPrefix(filter);
+  if (std::find(c->filters.begin(), c->filters.end(), filter) != c->filters.end()) {
+    // Same filter again (a resumed session re-subscribing): replaces the QoS
+    for (Subscription& s : index_[prefix]) {
+      if (s.client == c && s.filter == filter) s.qos = qos;
+    }
+  } else {
+    c->filters.push_back(filter);
+    index_[prefix].push_back(Subscription{c, filter, qos});
+  }
+  // Only retained topics starting with the literal prefix can match.
+  for (auto it = retained_.lower_bound(prefix);
+       it != retained_.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+    if (matches(filter, it->first)) c->deliver(Message{it->first, it->second, true, 0, qos});
+  }
+}
+
+void Broker::unsubscribe(BrokerClient* c, const std::string& filter) {
+  UncountedHeap guard;
+  c->filters.erase(std::remove(c->filters.begin(), c->filters.end(), filter), c->filters.end());
+  auto it = index_.find(literalPrefix(filter));
+  if (it == index_.end()) return;
+  std::vector<Subscription>& subs = it->second;
+  subs.erase(std::remove_if(subs.begin(), subs.end(),
+                            [&](const Subscription& s) { return s.client == c && s.filter == filter; }),
+             subs.end());
+}
+
+void Broker::forget(BrokerClient* c) {
+  for (const std::string& filter : c->filters) {
+    auto it = index_.find(literalPrefix(filter));
+    if (it == index_.end()) continue;
+    std::vector<Subscription>& subs = it->second;
+    subs.erase(std::remove_if(subs.begin(), subs.end(),
+                              [c](const Subscription& s) { return s.client == c; }),
+               subs.end());
+  }
+}
+
+std::string Broker::literalPrefix(const std::string& filter) {
+  size_t end = 0;
+  for (size_t start = 0; start <= filter.size();) {
+    size_t slash = filter.find('/', start);
+    if (slash == std::string::npos) slash = filter.size();
+    if (filter.compare(start, slash - start, "+") == 0 ||
+        filter.compare(start, slash - start, "#") == 0) {
+      break;
+    }
+    end = slash;
+    start = slash + 1;
+  }
+  return filter.substr(0, end);
+}
+
+uint64_t Broker::admit(uint64_t atUs) {
+  if (ingressPerS == 0) return atUs;
+  uint64_t startNs = busyUntilNs_ > atUs * 1000 ? busyUntilNs_ : atUs * 1000;
+  busyUntilNs_ = startNs + 1000000000ULL / ingressPerS;
+  return busyUntilNs_ / 1000;
+}
+
+void Broker::publish(BrokerClient* c, const std::string& topic, const uint8_t* payload,
+                     size_t len, bool retained) {
+  (void)c;
+  UncountedHeap guard;
+  ++stats_.publishes;
+  stats_.payloadBytes += len;
+  stats_.wireBytes += packetSize(topic.size(), len);
+  std::string body(reinterpret_cast<const char*>(payload), len);
+  uint64_t atUs = admit(nowUs());
+  if (recordLog || onPublish) {
+    Message m{topic, body, retained, atUs};
+    if (onPublish) onPublish(m);
+    if (recordLog) log_.push_back(std::move(m));
+  }
+  route(topic, body, retained, atUs);
+}
+
+uint64_t Broker::inject(const std::string& topic, const std::string& payload, bool retained,
+                        uint64_t atUs) {
+  UncountedHeap guard;
+  atUs = admit(atUs > nowUs() ? atUs : nowUs());
+  route(topic, payload, retained, atUs);
+  return atUs;
+}
+
+void Broker::route(const std::string& topic, const std::string& payload, bool retained,
+                   uint64_t atUs) {
+  if (retained) {
+    if (payload.empty()) retained_.erase(topic);
+    else retained_[topic] = payload;
+  }
+  // Filters filed under "" and under each level prefix of the topic; a
+  // client with several matching filters still gets one copy.
+  std::vector<BrokerClient*> sent;
+  auto visit = [&](const std::string& prefix) {
+    auto it = index_.find(prefix);
+    if (it == index_.end()) return;
+    for (const Subscription& s : it->second) {
+      bool queued = !s.client->online && s.client->persistent && s.qos > 0;
+      if ((!s.client->online && !queued) || !matches(s.filter, topic)) continue;
+      if (std::find(sent.begin(), sent.end(), s.client) != sent.end()) continue;
+      sent.push_back(s.client);
+      if (queued) ++stats_.queuedOffline;
+      s.client->deliver(Message{topic, payload, false, atUs, s.qos});
+    }
+  };
+  visit(std::string());
+  for (size_t i = 1; i <= topic.size(); ++i) {
+    if (i == topic.size() || topic[i] == '/') visit(topic.substr(0, i));
+  }
+}
+
+uint64_t Broker::nextDeliveryUs() const {
+  uint64_t next = UINT64_MAX;
+  for (const BrokerClient* c : clients_) {
+    if (c->online && c->nextMessageUs() < next) next = c->nextMessageUs();
+  }
+  return next;
+}
+
+void Broker::reset() {
+  UncountedHeap guard;
+  outageFrom_ = outageUntil_ = 0;
+  busyUntilNs_ = 0;
+  log_.clear();
+  retained_.clear();
+  index_.clear();
+  stats_ = BrokerStats();
+  recordLog = true;
+  rttUs = 20000;
+  ingressPerS = 0;
+  onPublish = nullptr;
+  for (BrokerClient* c : clients_) {
+    c->online = false;
+    c->persistent = false;
+    c->sessionPresent = false;
+    c->filters.clear();
+  }
+}
+
+bool Broker::matches(const std::string& filter, const std::string& topic) {
+  size_t f = 0, t = 0;
+  while (f < filter.size()) {
+    if (filter[f] == '#') return true;
+    if (filter[f] == '+') {
+      while (t < topic.size() && topic[t] != '/') ++t;
+      ++f;
+      continue;
+    }
+    if (t >= topic.size() || filter[f] != topic[t]) return false;
+    ++f;
+    ++t;
+  }
+  return t == topic.size();
+}
+
+size_t Broker::packetSize(size_t topicLen, size_t payloadLen, bool qos1) {
+  size_t remaining = 2 + topicLen + payloadLen + (qos1 ? 2 : 0);
+  size_t lenBytes = remaining < 128 ? 1 : remaining < 16384 ? 2 : 3;
+  return 1 + lenBytes + remaining;
+}
+
+void resetBoard() {
+  UncountedHeap guard;
+  for (int i = 0; i < kPinCount; ++i) {
+    g_analog[i] = g_digital[i] = 0;
+    g_driven[i] = g_pullUp[i] = false;
+  }
+  g_analogSource = nullptr;
+  g_scheduled.clear();
+  g_hasScheduled.store(false, std::memory_order_relaxed);
+  for (PinInterrupt& irq : g_interrupts) irq = PinInterrupt();
+  power() = PowerState();
+  dht20() = Dht20State();
+  wifi() = WifiState();
+  flash() = FlashState();
+  ota() = OtaState();
+  tls() = TlsServerState();
+  peripherals() = Peripherals();
+  broker().reset();
+}
+
+}  // namespace sim
+
+void* operator new(size_t size) { return sim::detail::countedAlloc(size); }
+void* operator new[](size_t size) { return sim::detail::countedAlloc(size); }
+void operator delete(void* p) noexcept { sim::detail::countedFree(p); }
+void operator delete[](void* p) noexcept { sim::detail::countedFree(p); }
+void operator delete(void* p, size_t) noexcept { sim::detail::countedFree(p); }
+void operator delete[](void* p, size_t) noexcept { sim::detail::countedFree(p); }
@@ -0,0 +1,316 @@
+// Host build of hardware/main.cpp: this header is the harness side of the
+// stand-in Arduino libraries in this directory. Tests and benchmarks use it to
+// drive the virtual clock, the in-process MQTT broker and the sensor inputs.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "esp_ota_ops.h"
+#include "freertos/task.h"
+
+namespace sim {
+
+// ---- Virtual clock -------------------------------------------------------
+// millis()/micros() read this clock; delay() and modeled I/O advance it.
+// Nothing in the sim sleeps for real.
+uint64_t nowUs();
+void advanceUs(uint64_t us);
+inline void advanceMs(uint64_t ms) { advanceUs(ms * 1000ULL); }
+void setNowUs(uint64_t us);
+
+// Cost (virtual us) charged to the clock by a blocking driver call, e.g. an
+// I2C transfer or a NeoPixel show(). Summed separately so benchmarks can
+// report how long the firmware was blocked on device I/O.
+void chargeIo(uint64_t us);
+uint64_t ioUs();
+
+// ---- Heap ------------------------------------------------------------------
+// Global operator new/delete are replaced in board_sim.cpp and counted here.
+struct HeapStats {
+  uint64_t allocs = 0;
+  uint64_t frees = 0;
+  uint64_t bytes = 0;      // total bytes requested
+  int64_t liveBytes = 0;
+  int64_t peakLiveBytes = 0;   // highest liveBytes since start or resetHeapPeak()
+};
+const HeapStats& heap();
+void resetHeapPeak();
+
+// Allocations made by the simulation itself (broker bookkeeping, logs) are
+// not the firmware's; stand-in code wraps them in this guard.
+class UncountedHeap {
+ public:
+  UncountedHeap();
+  ~UncountedHeap();
+};
+
+// ---- Analog / GPIO -----------------------------------------------------------
+constexpr int kPinCount = 64;
+void setAnalog(int pin, int value);
+// Optional per-read hook (pin, nowUs) -> raw ADC value; overrides setAnalog.
+void setAnalogSource(std::function<int(int, uint64_t)> source);
+// A pin nothing drives (no digitalWrite(), no external input yet) reads LOW,
+// or HIGH once pinMode() gave it the internal pull-up: an unwired switch input.
+int digitalLevel(int pin);
+// Sets pin to level once the clock reaches atUs, as an external input would.
+// The clock stops at atUs on its way past (advanceUs(), setNowUs()), so an
+// interrupt attached to the pin runs at that time, in the middle of whatever
+// blocking call moved the clock: the host's stand-in for preemption. For
+// single-threaded tests only.
+void scheduleDigital(int pin, int level, uint64_t atUs);
+// Earliest pending scheduleDigital() change of pin to level; UINT64_MAX if none.
+uint64_t nextDigitalUs(int pin, int level);
+// Earliest pending scheduleDigital() change of any pin; UINT64_MAX if none.
+uint64_t nextScheduledUs();
+uint64_t analogReads();
+
+// ---- DHT20 -------------------------------------------------------------------
+struct Dht20State {
+  float temperature = 27.5f;
+  float humidity = 65.3f;
+  bool present = true;
+  uint32_t conversionUs = 80000;  // trigger -> data ready
+  uint64_t reads = 0;             // completed conversions
+  uint32_t corruptReads = 0;      // this many next reads arrive with a bit flipped
+};
+Dht20State& dht20();
+
+// ---- WiFi ------------------------------------------------------------------
+struct WifiState {
+  uint32_t associateMs = 1500;    // begin() -> WL_CONNECTED
+  uint64_t downUntilUs = 0;       // AP unreachable until this time
+};
+WifiState& wifi();
+
+// ---- Sleep --------------------------------------------------------------------
+// esp_light_sleep_start() moves the clock to the first enabled wake source:
+// the timer, the next message due at a connected MQTT client (WiFi wakeup) or
+// a wake GPIO at its level (see scheduleDigital()). Light sleep and the loop
+// task's vTaskDelay() / ulTaskNotifyTake() time (CPU idle, radio in modem
+// sleep) are summed here for duty-cycle reports; everything else is awake time.
+struct PowerState {
+  uint64_t lightSleepUs = 0;
+  uint64_t lightSleeps = 0;
+  uint64_t idleUs = 0;
+  uint32_t wakeupUs = 500;        // leaving light sleep, charged as awake time
+};
+PowerState& power();
+
+// ---- Flash (LittleFS) ---------------------------------------------------------
+// Files of the LittleFS stand-in. Writes and reads are charged to the clock.
+struct FlashState {
+  std::map<std::string, std::vector<uint8_t>> files;
+  size_t capacity = 1536 * 1024;  // default ESP32 "spiffs" partition
+  bool formatted = true;          // false: begin(false) fails to mount
+  uint64_t bytesWritten = 0;
+  uint64_t bytesRead = 0;
+};
+FlashState& flash();
+
+// ---- App slots (OTA) ------------------------------------------------------------
+// The two app partitions behind the esp_ota_ops.h stand-in. image[] holds what
+// was written to each slot; reads past it return erased flash (0xFF). Writes
+// erase 4 KB sectors as they reach them (OTA_WITH_SEQUENTIAL_WRITES) and are
+// charged to the clock like the flash above.
+struct OtaState {
+  std::vector<uint8_t> image[2];
+  esp_ota_img_states_t state[2] = {ESP_OTA_IMG_VALID, ESP_OTA_IMG_UNDEFINED};
+  int running = 0;
+  int boot = 0;                   // esp_ota_set_boot_partition()
+  size_t slotSize = 0x140000;     // default partition table: 1.25 MB per app
+  uint64_t bytesWritten = 0;
+  uint64_t bytesRead = 0;
+  uint32_t sectorErases = 0;
+};
+OtaState& ota();
+// What the bootloader does on a reset (after ESP.restart()): a NEW boot image
+// runs on trial (PENDING_VERIFY); one still on trial, never confirmed, is
+// ABORTED and the other slot runs again. Returns the slot now running.
+int rebootOta();
+
+// ---- TLS ---------------------------------------------------------------------
+// The broker's TLS listener as the mbedtls stand-in sees it. A handshake is
+// charged to the clock: round trips to the broker plus the client's CPU
+// time, and its working memory is allocated on the counted heap for the
+// duration. A session ticket resumes (no certificate chain, no key
+// exchange) while it is within ticketLifetimeS and the server still has the
+// key it was issued under; rotateTicketKey() is a broker restart.
+struct TlsServerState {
+  bool certTrusted = true;             // false: the client's CA does not verify the chain
+  bool tickets = true;                 // server issues and accepts tickets
+  uint32_t ticketLifetimeS = 7200;
+  uint32_t ticketKey = 1;
+  uint32_t fullRoundTrips = 2;         // TLS 1.2: hellos + key exchange/finished
+  uint32_t resumeRoundTrips = 1;
+  uint32_t fullCpuUs = 1100000;        // ECDHE P-256 + RSA-2048 chain verify, 240 MHz
+  uint32_t resumeCpuUs = 30000;
+  uint32_t fullWorkBytes = 22000;      // parsed chain + key exchange, freed after
+  uint32_t resumeWorkBytes = 2000;
+  uint32_t sessionBytes = 1200;        // saved session: secrets, ticket, peer certificate
+  uint64_t fullHandshakes = 0;
+  uint64_t resumedHandshakes = 0;
+  uint64_t failedHandshakes = 0;
+
+  void rotateTicketKey() { ticketKey++; }
+};
+TlsServerState& tls();
+
+// ---- MQTT broker -------------------------------------------------------------
+struct Message {
+  std::string topic;
+  std::string payload;
+  bool retained = false;
+  uint64_t atUs = 0;             // virtual time the broker accepted / delivers it
+  uint8_t qos = 0;               // of the subscription it was delivered on
+};
+
+class BrokerClient;  // one connected PubSubClient
+
+struct BrokerStats {
+  uint64_t publishes = 0;        // PUBLISH packets accepted from clients
+  uint64_t payloadBytes = 0;
+  uint64_t wireBytes = 0;        // full MQTT packet size incl. topic and header
+  uint64_t connects = 0;
+  uint64_t failedConnects = 0;
+  uint64_t subscribes = 0;
+  uint64_t resumedSessions = 0;  // connects that found the client ID's session
+  uint64_t queuedOffline = 0;    // QoS 1 messages kept for an offline session
+};
+
+class Broker {
+ public:
+  // Broker refuses connections, and drops live ones, inside [from, until).
+  void setOutage(uint64_t fromUs, uint64_t untilUs);
+  bool reachable() const;
+  uint32_t rttUs = 20000;        // connect handshake round trip
+  // PUBLISH packets the broker processes per second, one after the other;
+  // a packet is routed once the ones before it are done. 0: instantly.
+  uint32_t ingressPerS = 0;
+  // Called for every PUBLISH accepted from a client, with atUs the time it is
+  // routed; nowUs() is still the time the client sent it.
+  std::function<void(const Message&)> onPublish;
+
+  // Inject a message as if another client had published it. With atUs in
+  // the future, subscribers only see it once the clock reaches atUs.
+  // Returns the time subscribers see it.
+  uint64_t inject(const std::string& topic, const std::string& payload, bool retained = false,
+                  uint64_t atUs = 0);
+
+  const BrokerStats& stats() const { return stats_; }
+  void resetStats() { stats_ = BrokerStats(); }
+
+  // Everything published by clients, in order. Cleared by clearLog().
+  const std::vector<Message>& log() const { return log_; }
+  void clearLog() { log_.clear(); }
+  bool recordLog = true;
+  const std::map<std::string, std::string>& retained() const { return retained_; }
+  // A broker restart without persistence: every retained message is gone,
+  // and so is every persistent session.
+  void dropRetained();
+
+  // Called by the PubSubClient stand-in.
+  void attach(BrokerClient* c);
+  void detach(BrokerClient* c);
+  // cleanSession false keeps (or resumes) the session of clientId: its
+  // subscriptions, and QoS 1 messages routed to it while it is offline.
+  // Sets c->sessionPresent as CONNACK would.
+  bool connect(BrokerClient* c, bool cleanSession = true, const std::string& clientId = "");
+  void subscribe(BrokerClient* c, const std::string& filter, uint8_t qos = 0);
+  void unsubscribe(BrokerClient* c, const std::string& filter);
+  void publish(BrokerClient* c, const std::string& topic, const uint8_t* payload,
+               size_t len, bool retained);
+  void reset();
+  // When the earliest message waiting at a connected client is due; UINT64_MAX
+  // if none is.
+  uint64_t nextDeliveryUs() const;
+
+  static bool matches(const std::string& filter, const std::string& topic);
+  static size_t packetSize(size_t topicLen, size_t payloadLen, bool qos1 = false);
+
+ private:
+  // A subscription, filed under the literal levels of its filter before the
+  // first wildcard ("a/b/+/c" -> "a/b"): a topic only has to be matched
+  // against the filters under each of its own level prefixes.
+  struct Subscription {
+    BrokerClient* client;
+    std::string filter;
+    uint8_t qos;
+  };
+  static std::string literalPrefix(const std::string& filter);
+  void forget(BrokerClient* c);   // drops c's filters from the index
+  uint64_t admit(uint64_t atUs);  // when a packet arriving at atUs is routed
+  void route(const std::string& topic, const std::string& payload, bool retained,
+             uint64_t atUs);
+
+  uint64_t outageFrom_ = 0, outageUntil_ = 0;
+  uint64_t busyUntilNs_ = 0;
+  std::vector<BrokerClient*> clients_;
+  std::unordered_map<std::string, std::vector<Subscription>> index_;
+  std::vector<Message> log_;
+  std::map<std::string, std::string> retained_;
+  BrokerStats stats_;
+};
+Broker& broker();
+
+class BrokerClient {
+ public:
+  virtual ~BrokerClient() = default;
+  virtual void deliver(const Message& m) = 0;
+  virtual uint64_t nextMessageUs() const { return UINT64_MAX; }
+  std::vector<std::string> filters;
+  bool online = false;
+  bool persistent = false;       // session kept while offline (cleanSession false)
+  bool sessionPresent = false;   // the last connect resumed a session
+  std::string sessionId;         // client ID the session belongs to
+};
+
+// ---- Peripherals observed by tests ---------------------------------------------
+struct Peripherals {
+  uint64_t pixelShows = 0;
+  uint64_t lcdBytes = 0;         // bytes pushed over I2C to the LCD
+  uint64_t serialBytes = 0;
+  int servoAngle[kPinCount] = {};
+  uint32_t pixel[64] = {};
+  char lcd[2][17] = {};
+  uint32_t restarts = 0;         // ESP.restart() calls; the sim keeps running
+};
+Peripherals& peripherals();
+
+// ---- FreeRTOS tasks -------------------------------------------------------------
+// xTaskCreatePinnedToCore() only records the task by default: the sketch's
+// state is not thread-safe on the host, so tests step task bodies themselves.
+// With threaded tasks on, each task runs on its own std::thread (for stress
+// tests of the inter-core queues); vTaskDelay() then just yields.
+struct RtosTask {
+  std::string name;
+  int core = 0;
+  unsigned priority = 0;
+};
+void setThreadedTasks(bool threaded);
+const std::vector<RtosTask>& rtosTasks();
+// What uxTaskGetStackHighWaterMark() reports for a task (NULL: the loop task).
+// Defaults to the whole stack depth it was created with.
+void setStackHighWater(TaskHandle_t task, uint32_t bytes);
+// Asks every running task to exit at its next vTaskDelay() and joins them all.
+void stopTasks();
+// Joins every task; they must end on their own with vTaskDelete(NULL).
+void joinTasks();
+
+// ---- Used by the stand-in libraries ------------------------------------------
+int analogValue(int pin);           // one analogRead() sample
+// Also runs the pin's interrupt (attachInterruptArg()) on a matching edge.
+void setDigital(int pin, int level);
+void setPinMode(int pin, int mode);
+void setInterrupt(int pin, void (*fn)(void*), void* arg, int mode);   // fn NULL: detach
+
+// Restore every piece of simulated state (clock excluded) to power-on defaults.
+void resetBoard();
+
+}  // namespace sim
@@ -0,0 +1,13 @@
+// Host stand-in for driver/gpio.h: GPIO wakeup from light sleep only.
+#pragma once
+
+#include "Arduino.h"
+#include "esp_sleep.h"
+
+typedef enum {
+  GPIO_INTR_LOW_LEVEL = 4,
+  GPIO_INTR_HIGH_LEVEL = 5,
+} gpio_int_type_t;
+
+esp_err_t gpio_wakeup_enable(gpio_num_t pin, gpio_int_type_t level);
+esp_err_t gpio_wakeup_disable(gpio_num_t pin);
@@ -0,0 +1,21 @@
+// Host stand-in for the ESP-IDF FreeRTOS headers: the types and constants the
+// sketch uses. Tasks are implemented in freertos_sim.cpp (see board_sim.h).
+#pragma once
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((TickType_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define portYIELD_FROM_ISR() ((void)0)
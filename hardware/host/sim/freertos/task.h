@@ -0,0 +1,26 @@
+// Host stand-in for freertos/task.h: task creation, delay and delete, direct
+// task notifications, and the stack high-water mark (a value set by the test,
+// see board_sim.h).
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+struct SimTask;
+typedef SimTask* TaskHandle_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stackDepth,
+                                   void* param, UBaseType_t priority, TaskHandle_t* created,
+                                   BaseType_t core);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelete(TaskHandle_t task);   // NULL: the calling task
+TaskHandle_t xTaskGetCurrentTaskHandle();
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);   // NULL: the calling task
+BaseType_t xPortGetCoreID();
+
+// Notification count of the task; a waiting ulTaskNotifyTake() returns early.
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken);
+// The loop task waits on the virtual clock until notified - by an interrupt
+// of a scheduleDigital() change - or ticks pass, idle meanwhile like
+// vTaskDelay(). Returns the count before taking it.
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticks);
@@ -0,0 +1,147 @@
+// FreeRTOS task stand-in: recorded only, or one std::thread per task.
+#include "freertos/task.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "board_sim.h"
+
+struct SimTask {
+  TaskFunction_t fn;
+  void* param;
+  int core;
+  uint32_t stackHighWater;   // the host has no stack to measure: set by tests
+  std::atomic<bool> stop{false};
+  std::atomic<uint32_t> notified{0};
+  std::thread thread;
+};
+
+namespace {
+
+// Thrown by vTaskDelete(NULL) / a stopped vTaskDelay() to unwind the task body.
+struct TaskExit {};
+
+bool g_threaded = false;
+std::vector<sim::RtosTask> g_info;
+std::vector<std::unique_ptr<SimTask>> g_tasks;
+thread_local SimTask* t_self = nullptr;
+// The Arduino loop task, which runs setup() and loop(): 8 KB of stack on core 1.
+SimTask g_loopTask{nullptr, nullptr, 1, 8192};
+
+void trampoline(SimTask* task) {
+  t_self = task;
+  try {
+    task->fn(task->param);
+  } catch (const TaskExit&) {
+  }
+}
+
+}  // namespace
+
+namespace sim {
+
+void setThreadedTasks(bool threaded) { g_threaded = threaded; }
+const std::vector<RtosTask>& rtosTasks() { return g_info; }
+
+void setStackHighWater(TaskHandle_t task, uint32_t bytes) {
+  (task ? task : &g_loopTask)->stackHighWater = bytes;
+}
+
+void joinTasks() {
+  for (auto& task : g_tasks) {
+    if (task->thread.joinable()) task->thread.join();
+  }
+  UncountedHeap guard;
+  g_tasks.clear();
+  g_info.clear();
+}
+
+void stopTasks() {
+  for (auto& task : g_tasks) task->stop = true;
+  joinTasks();
+}
+
+}  // namespace sim
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stackDepth,
+                                   void* param, UBaseType_t priority, TaskHandle_t* created,
+                                   BaseType_t core) {
+  sim::UncountedHeap guard;
+  g_tasks.emplace_back(new SimTask{fn, param, core, stackDepth});
+  SimTask* task = g_tasks.back().get();
+  g_info.push_back(sim::RtosTask{name, core, priority});
+  if (g_threaded) task->thread = std::thread(trampoline, task);
+  if (created) *created = task;
+  return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  if (!t_self) {
+    // The loop task, or a recorded task body stepped by the test: behaves
+    // like delay(), with the CPU idle meanwhile.
+    uint64_t us = (uint64_t)ticks * portTICK_PERIOD_MS * 1000ULL;
+    sim::power().idleUs += us;
+    sim::advanceUs(us);
+    return;
+  }
+  if (t_self->stop) throw TaskExit();
+  std::this_thread::yield();
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  task->notified.fetch_add(1);
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken) {
+  task->notified.fetch_add(1);
+  if (higherPriorityTaskWoken) *higherPriorityTaskWoken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticks) {
+  SimTask* self = xTaskGetCurrentTaskHandle();
+  if (!t_self) {
+    // Only a scheduled input change can notify while the loop task waits:
+    // step the clock from one to the next.
+    uint64_t end = sim::nowUs() + (uint64_t)ticks * portTICK_PERIOD_MS * 1000ULL;
+    while (self->notified.load() == 0 && sim::nowUs() < end) {
+      uint64_t next = std::min(end, sim::nextScheduledUs());
+      uint64_t us = next > sim::nowUs() ? next - sim::nowUs() : 0;
+      sim::power().idleUs += us;
+      sim::advanceUs(us);
+      if (us == 0) break;
+    }
+  } else if (self->notified.load() == 0) {
+    if (t_self->stop) throw TaskExit();
+    std::this_thread::yield();
+  }
+  uint32_t count = self->notified.load();
+  if (count == 0) return 0;
+  if (clearCountOnExit) {
+    self->notified.store(0);
+  } else {
+    self->notified.fetch_sub(1);
+  }
+  return count;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (task == nullptr || task == t_self) {
+    if (t_self) throw TaskExit();
+    return;
+  }
+  task->stop = true;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return t_self ? t_self : &g_loopTask; }
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  return (task ? task : xTaskGetCurrentTaskHandle())->stackHighWater;
+}
+
+BaseType_t xPortGetCoreID() {
+  // The Arduino loop task runs on core 1.
+  return t_self ? t_self->core : 1;
+}
@@ -0,0 +1,922 @@
+// Stand-ins for the third-party libraries main.cpp links against.
+#include <string.h>
+
+#include <algorithm>
+
+#include "Adafruit_NeoPixel.h"
+#include "ArduinoOTA.h"
+#include "DHT20.h"
+#include "ESP32Servo.h"
+#include "LiquidCrystal_I2C.h"
+#include "LittleFS.h"
+#include "PubSubClient.h"
+#include "WiFi.h"
+#include "Wire.h"
+#include "board_sim.h"
+#include "mbedtls/ssl.h"
+
+WiFiClass WiFi;
+TwoWire Wire;
+ArduinoOTAClass ArduinoOTA;
+fs::LittleFSFS LittleFS;
+
+// ---- WiFi ------------------------------------------------------------------------
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase) {
+  (void)ssid;
+  (void)passphrase;
+  started_ = true;
+  beganUs_ = sim::nowUs();
+  return WL_DISCONNECTED;
+}
+
+wl_status_t WiFiClass::status() {
+  if (!started_) return WL_IDLE_STATUS;
+  uint64_t now = sim::nowUs();
+  const sim::WifiState& w = sim::wifi();
+  if (now < w.downUntilUs) return WL_DISCONNECTED;
+  uint64_t upAt = std::max<uint64_t>(beganUs_, w.downUntilUs) + (uint64_t)w.associateMs * 1000ULL;
+  return now >= upAt ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+bool WiFiClass::disconnect(bool wifioff) {
+  (void)wifioff;
+  started_ = false;
+  return true;
+}
+
+bool WiFiClass::reconnect() {
+  begin(nullptr);
+  return true;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+  (void)host;
+  (void)port;
+  // SYN / SYN-ACK, refused or not
+  sim::chargeIo(sim::broker().rttUs);
+  open_ = WiFi.status() == WL_CONNECTED && sim::broker().reachable();
+  return open_ ? 1 : 0;
+}
+
+uint8_t WiFiClient::connected() {
+  if (open_ && (WiFi.status() != WL_CONNECTED || !sim::broker().reachable())) open_ = false;
+  return open_ ? 1 : 0;
+}
+
+// ---- PubSubClient ------------------------------------------------------------------
+
+PubSubClient::PubSubClient(Client& client) : transport_(&client) {
+  sim::broker().attach(this);
+}
+
+PubSubClient::~PubSubClient() { sim::broker().detach(this); }
+
+PubSubClient& PubSubClient::setServer(const char* domain, uint16_t port) {
+  domain_ = domain;
+  port_ = port;
+  return *this;
+}
+
+PubSubClient& PubSubClient::setClient(Client& client) {
+  transport_ = &client;
+  return *this;
+}
+
+PubSubClient& PubSubClient::setCallback(std::function<void(char*, uint8_t*, unsigned int)> callback) {
+  sim::UncountedHeap guard;
+  callback_ = std::move(callback);
+  return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size) {
+  if (size == 0) return false;
+  bufferSize_ = size;
+  return true;
+}
+
+bool PubSubClient::connect(const char* id) {
+  return connect(id, nullptr, nullptr, nullptr, 0, false, nullptr, true);
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass) {
+  return connect(id, user, pass, nullptr, 0, false, nullptr, true);
+}
+
+bool PubSubClient::connect(const char* id, const char* willTopic, uint8_t willQos,
+                           bool willRetain, const char* willMessage) {
+  return connect(id, nullptr, nullptr, willTopic, willQos, willRetain, willMessage, true);
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass,
+                           const char* willTopic, uint8_t willQos, bool willRetain,
+                           const char* willMessage) {
+  return connect(id, user, pass, willTopic, willQos, willRetain, willMessage, true);
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass,
+                           const char* willTopic, uint8_t willQos, bool willRetain,
+                           const char* willMessage, bool cleanSession) {
+  (void)user; (void)pass; (void)willTopic; (void)willQos; (void)willRetain;
+  (void)willMessage;
+  if (connected()) return true;
+  {
+    sim::UncountedHeap guard;
+    clientId_ = id ? id : "";
+  }
+  if (WiFi.status() != WL_CONNECTED) {
+    state_ = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  if (!sim::broker().reachable()) {
+    // Refused: the TCP attempt fails after about one round trip.
+    sim::chargeIo(sim::broker().rttUs);
+    sim::broker().connect(this, cleanSession, clientId_);
+    state_ = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  // TCP handshake (and TLS, if the transport does it), then CONNECT/CONNACK.
+  // The transport's own allocations are the firmware's, so no guard here.
+  if (!transport_->connect(domain_, port_)) {
+    state_ = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  sim::chargeIo(sim::broker().rttUs);
+  sim::UncountedHeap guard;
+  sim::broker().connect(this, cleanSession, clientId_);
+  if (sessionPresent) {
+    // QoS 1 messages queued for the session are redelivered; QoS 0 ones
+    // died with the old connection.
+    inbox_.erase(std::remove_if(inbox_.begin(), inbox_.end(),
+                                [](const sim::Message& m) { return m.qos == 0; }),
+                 inbox_.end());
+  } else {
+    inbox_.clear();
+  }
+  state_ = MQTT_CONNECTED;
+  return true;
+}
+
+void PubSubClient::disconnect() {
+  online = false;
+  state_ = MQTT_DISCONNECTED;
+  transport_->stop();
+}
+
+bool PubSubClient::connected() {
+  if (online && (!sim::broker().reachable() || WiFi.status() != WL_CONNECTED)) {
+    online = false;
+    state_ = MQTT_CONNECTION_LOST;
+    transport_->stop();
+  }
+  return online;
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload) {
+  return publish(topic, (const uint8_t*)payload, payload ? strlen(payload) : 0, false);
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload, bool retained) {
+  return publish(topic, (const uint8_t*)payload, payload ? strlen(payload) : 0, retained);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength) {
+  return publish(topic, payload, plength, false);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength,
+                           bool retained) {
+  if (!connected()) return false;
+  // Same size check as the real library: header + topic length + topic + payload.
+  if (MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + plength > bufferSize_) return false;
+  sim::UncountedHeap guard;
+  sim::broker().publish(this, topic, payload, plength, retained);
+  return true;
+}
+
+bool PubSubClient::subscribe(const char* topic) { return subscribe(topic, 0); }
+
+bool PubSubClient::subscribe(const char* topic, uint8_t qos) {
+  if (!connected()) return false;
+  sim::UncountedHeap guard;
+  sim::broker().subscribe(this, topic, qos > 1 ? 1 : qos);
+  return true;
+}
+
+bool PubSubClient::unsubscribe(const char* topic) {
+  if (!connected()) return false;
+  sim::UncountedHeap guard;
+  sim::broker().unsubscribe(this, topic);
+  return true;
+}
+
+void PubSubClient::deliver(const sim::Message& m) {
+  sim::UncountedHeap guard;
+  inbox_.push_back(m);
+}
+
+uint64_t PubSubClient::nextMessageUs() const {
+  uint64_t next = UINT64_MAX;
+  for (const sim::Message& m : inbox_) {
+    if (m.atUs < next) next = m.atUs;
+  }
+  return next;
+}
+
+bool PubSubClient::loop() {
+  if (!connected()) return false;
+  std::vector<sim::Message> pending;
+  {
+    // Messages still in flight (injected with a future time) stay queued.
+    sim::UncountedHeap guard;
+    uint64_t now = sim::nowUs();
+    auto ready = std::stable_partition(inbox_.begin(), inbox_.end(),
+                                       [now](const sim::Message& m) { return m.atUs <= now; });
+    pending.assign(std::make_move_iterator(inbox_.begin()), std::make_move_iterator(ready));
+    inbox_.erase(inbox_.begin(), ready);
+    buffer_.resize(bufferSize_);
+  }
+  for (const sim::Message& m : pending) {
+    size_t tlen = m.topic.size();
+    if (MQTT_MAX_HEADER_SIZE + 2 + tlen + m.payload.size() > bufferSize_) continue;
+    // Like the real library: topic is NUL-terminated in the packet buffer and
+    // the payload follows it, not terminated.
+    char* topic = (char*)buffer_.data();
+    memcpy(topic, m.topic.data(), tlen);
+    topic[tlen] = 0;
+    uint8_t* payload = buffer_.data() + tlen + 1;
+    memcpy(payload, m.payload.data(), m.payload.size());
+    if (callback_) callback_(topic, payload, (unsigned int)m.payload.size());
+  }
+  {
+    sim::UncountedHeap guard;
+    pending.clear();
+    pending.shrink_to_fit();
+  }
+  return true;
+}
+
+// ---- DHT20 ---------------------------------------------------------------------------
+
+// I2C cost of a trigger (3 bytes), a status byte read and a 7-byte result
+// read at 100 kHz.
+static constexpr uint32_t kDhtTriggerUs = 400;
+static constexpr uint32_t kDhtStatusUs = 200;
+static constexpr uint32_t kDhtReadUs = 800;
+
+bool DHT20::begin() { return isConnected(); }
+bool DHT20::isConnected() { return sim::dht20().present; }
+
+int DHT20::requestData() {
+  sim::chargeIo(kDhtTriggerUs);
+  requestUs_ = sim::nowUs();
+  lastRequest_ = millis();
+  requested_ = true;
+  return DHT20_OK;
+}
+
+bool DHT20::isMeasuring() {
+  sim::chargeIo(kDhtStatusUs);
+  return requested_ && sim::nowUs() - requestUs_ < sim::dht20().conversionUs;
+}
+
+int DHT20::readData() {
+  sim::chargeIo(kDhtReadUs);
+  if (!sim::dht20().present) return DHT20_ERROR_CONNECT;
+  if (isMeasuring()) return DHT20_ERROR_READ_TIMEOUT;
+  requested_ = false;
+  // Encode the sim values the way the sensor does (20-bit fields + CRC8) so
+  // convert() exercises the same arithmetic as the real driver.
+  const sim::Dht20State& s = sim::dht20();
+  uint32_t rawH = (uint32_t)(s.humidity / 100.0f * 1048576.0f);
+  uint32_t rawT = (uint32_t)((s.temperature + 50.0f) / 200.0f * 1048576.0f);
+  if (rawH > 0xFFFFF) rawH = 0xFFFFF;
+  if (rawT > 0xFFFFF) rawT = 0xFFFFF;
+  bytes_[0] = 0x1C;
+  bytes_[1] = (uint8_t)(rawH >> 12);
+  bytes_[2] = (uint8_t)(rawH >> 4);
+  bytes_[3] = (uint8_t)(((rawH & 0x0F) << 4) | (rawT >> 16));
+  bytes_[4] = (uint8_t)(rawT >> 8);
+  bytes_[5] = (uint8_t)rawT;
+  uint8_t crc = 0xFF;
+  for (int i = 0; i < 6; ++i) {
+    crc ^= bytes_[i];
+    for (int b = 0; b < 8; ++b) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+  }
+  bytes_[6] = crc;
+  if (sim::dht20().corruptReads) {
+    sim::dht20().corruptReads--;
+    bytes_[4] ^= 0x10;   // a flipped bit on the bus
+  }
+  sim::dht20().reads++;
+  return 7;
+}
+
+int DHT20::convert() {
+  uint32_t rawH = ((uint32_t)bytes_[1] << 12) | ((uint32_t)bytes_[2] << 4) | (bytes_[3] >> 4);
+  uint32_t rawT = ((uint32_t)(bytes_[3] & 0x0F) << 16) | ((uint32_t)bytes_[4] << 8) | bytes_[5];
+  humidity_ = rawH * 9.5367431640625e-5f;
+  temperature_ = rawT * 1.9073486328125e-4f - 50.0f;
+  uint8_t crc = 0xFF;
+  for (int i = 0; i < 6; ++i) {
+    crc ^= bytes_[i];
+    for (int b = 0; b < 8; ++b) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+  }
+  lastRead_ = millis();
+  return crc == bytes_[6] ? DHT20_OK : DHT20_ERROR_CHECKSUM;
+}
+
+int DHT20::read() {
+  if (lastRead_ != 0 && millis() - lastRead_ < 1000) return DHT20_ERROR_LASTREAD;
+  int status = requestData();
+  if (status < 0) return status;
+  // The real driver yields in a loop until the conversion is done.
+  while (requested_ && sim::nowUs() - requestUs_ < sim::dht20().conversionUs) {
+    sim::chargeIo(1000);
+  }
+  status = readData();
+  if (status < 0) return status;
+  return convert();
+}
+
+// ---- Servo -----------------------------------------------------------------------------
+
+int Servo::attach(int pin) {
+  pin_ = pin;
+  return pin;
+}
+
+void Servo::write(int value) {
+  angle_ = constrain(value, 0, 180);
+  if (pin_ >= 0 && pin_ < sim::kPinCount) sim::peripherals().servoAngle[pin_] = angle_;
+}
+
+// ---- NeoPixel -----------------------------------------------------------------------------
+
+Adafruit_NeoPixel::Adafruit_NeoPixel(uint16_t n, int16_t pin, neoPixelType type)
+    : count_(n < kMaxPixels ? n : kMaxPixels) {
+  (void)pin;
+  (void)type;
+}
+
+void Adafruit_NeoPixel::show() {
+  // 24 bits at 800 kHz per pixel, then the >50 us latch.
+  sim::chargeIo(30ULL * count_ + 80);
+  sim::Peripherals& p = sim::peripherals();
+  p.pixelShows++;
+  for (uint16_t i = 0; i < count_; ++i) p.pixel[i] = pixels_[i];
+}
+
+void Adafruit_NeoPixel::clear() {
+  for (uint16_t i = 0; i < count_; ++i) pixels_[i] = 0;
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint32_t c) {
+  if (n < count_) pixels_[n] = c;
+}
+
+// ---- LCD -------------------------------------------------------------------------------------
+
+LiquidCrystal_I2C::LiquidCrystal_I2C(uint8_t addr, uint8_t cols, uint8_t rows)
+    : cols_(cols), rows_(rows) {
+  (void)addr;
+}
+
+void LiquidCrystal_I2C::busWrite(uint32_t bytes) {
+  sim::peripherals().lcdBytes += bytes;
+  sim::chargeIo((uint64_t)bytes * kByteUs);
+}
+
+void LiquidCrystal_I2C::init() {
+  busWrite(8);
+  clear();
+}
+
+void LiquidCrystal_I2C::clear() {
+  busWrite(1);
+  sim::chargeIo(2000);  // HD44780 clear-display execution time
+  for (auto& row : sim::peripherals().lcd) {
+    memset(row, ' ', 16);
+    row[16] = 0;
+  }
+  col_ = row_ = 0;
+}
+
+void LiquidCrystal_I2C::setCursor(uint8_t col, uint8_t row) {
+  busWrite(1);
+  col_ = col;
+  row_ = row < rows_ ? row : (uint8_t)(rows_ - 1);
+}
+
+size_t LiquidCrystal_I2C::write(uint8_t c) {
+  busWrite(1);
+  if (row_ < 2 && col_ < 16 && col_ < cols_) sim::peripherals().lcd[row_][col_] = (char)c;
+  col_++;
+  return 1;
+}
+
+// ---- mbedtls ---------------------------------------------------------------------------
+
+namespace {
+constexpr uint32_t kSessionMagic = 0x534D4953u;   // "SIMS"
+constexpr size_t kSessionHeader = 16;              // magic, ticket key, issued at
+}  // namespace
+
+void mbedtls_x509_crt_init(mbedtls_x509_crt* crt) { crt->parsed = 0; }
+void mbedtls_x509_crt_free(mbedtls_x509_crt* crt) { crt->parsed = 0; }
+
+int mbedtls_x509_crt_parse(mbedtls_x509_crt* chain, const unsigned char* buf, size_t buflen) {
+  static const char kBegin[] = "-----BEGIN CERTIFICATE-----";
+  if (!buf || buflen < sizeof(kBegin) || memcmp(buf, kBegin, sizeof(kBegin) - 1) != 0 ||
+      buf[buflen - 1] != 0) {
+    return MBEDTLS_ERR_X509_INVALID_FORMAT;
+  }
+  chain->parsed++;
+  return 0;
+}
+
+void mbedtls_entropy_init(mbedtls_entropy_context* ctx) { ctx->unused = 0; }
+void mbedtls_entropy_free(mbedtls_entropy_context* ctx) { (void)ctx; }
+
+int mbedtls_entropy_func(void* data, unsigned char* output, size_t len) {
+  (void)data;
+  for (size_t i = 0; i < len; i++) output[i] = (unsigned char)random(256);
+  return 0;
+}
+
+void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context* ctx) { *ctx = mbedtls_ctr_drbg_context(); }
+void mbedtls_ctr_drbg_free(mbedtls_ctr_drbg_context* ctx) { ctx->seeded = 0; }
+
+int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context* ctx,
+                          int (*f_entropy)(void*, unsigned char*, size_t), void* p_entropy,
+                          const unsigned char* custom, size_t len) {
+  (void)custom;
+  (void)len;
+  unsigned char seed[4];
+  int err = f_entropy(p_entropy, seed, sizeof(seed));
+  if (err) return err;
+  ctx->state = (unsigned)seed[0] | (unsigned)seed[1] << 8 | (unsigned)seed[2] << 16 |
+               (unsigned)seed[3] << 24;
+  ctx->seeded = 1;
+  return 0;
+}
+
+int mbedtls_ctr_drbg_random(void* p_rng, unsigned char* output, size_t output_len) {
+  mbedtls_ctr_drbg_context* ctx = (mbedtls_ctr_drbg_context*)p_rng;
+  for (size_t i = 0; i < output_len; i++) {
+    ctx->state = ctx->state * 1103515245u + 12345u;
+    output[i] = (unsigned char)(ctx->state >> 16);
+  }
+  return 0;
+}
+
+void mbedtls_ssl_config_init(mbedtls_ssl_config* conf) { *conf = mbedtls_ssl_config(); }
+void mbedtls_ssl_config_free(mbedtls_ssl_config* conf) { *conf = mbedtls_ssl_config(); }
+
+int mbedtls_ssl_config_defaults(mbedtls_ssl_config* conf, int endpoint, int transport,
+                                int preset) {
+  (void)transport;
+  (void)preset;
+  conf->endpoint = endpoint;
+  conf->authmode = MBEDTLS_SSL_VERIFY_REQUIRED;
+  conf->tickets = MBEDTLS_SSL_SESSION_TICKETS_ENABLED;
+  return 0;
+}
+
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config* conf, int authmode) {
+  conf->authmode = authmode;
+}
+
+void mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config* conf, mbedtls_x509_crt* ca_chain,
+                               void* ca_crl) {
+  (void)ca_crl;
+  conf->ca = ca_chain;
+}
+
+void mbedtls_ssl_conf_rng(mbedtls_ssl_config* conf, int (*f_rng)(void*, unsigned char*, size_t),
+                          void* p_rng) {
+  conf->rng = f_rng;
+  conf->rngCtx = p_rng;
+}
+
+void mbedtls_ssl_conf_session_tickets(mbedtls_ssl_config* conf, int use_tickets) {
+  conf->tickets = use_tickets;
+}
+
+void mbedtls_ssl_init(mbedtls_ssl_context* ssl) { *ssl = mbedtls_ssl_context(); }
+
+void mbedtls_ssl_free(mbedtls_ssl_context* ssl) {
+  delete[] ssl->inBuf;
+  delete[] ssl->outBuf;
+  *ssl = mbedtls_ssl_context();
+}
+
+int mbedtls_ssl_setup(mbedtls_ssl_context* ssl, const mbedtls_ssl_config* conf) {
+  // The record buffers live as long as the context, as in mbedtls.
+  ssl->conf = conf;
+  ssl->inBuf = new unsigned char[MBEDTLS_SSL_IN_CONTENT_LEN + 29];
+  ssl->outBuf = new unsigned char[MBEDTLS_SSL_OUT_CONTENT_LEN + 29];
+  ssl->inBuf[0] = ssl->outBuf[0] = 0;
+  return 0;
+}
+
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context* ssl, const char* hostname) {
+  if (!hostname || strlen(hostname) >= sizeof(ssl->hostname)) {
+    return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+  }
+  strcpy(ssl->hostname, hostname);
+  return 0;
+}
+
+void mbedtls_ssl_set_bio(mbedtls_ssl_context* ssl, void* p_bio, mbedtls_ssl_send_t* f_send,
+                         mbedtls_ssl_recv_t* f_recv, void* f_recv_timeout) {
+  (void)f_recv_timeout;
+  ssl->bio = p_bio;
+  ssl->send = f_send;
+  ssl->recv = f_recv;
+}
+
+int mbedtls_ssl_handshake(mbedtls_ssl_context* ssl) {
+  if (ssl->handshakeDone) return 0;
+  if (!ssl->conf || !ssl->send || !ssl->inBuf) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+  sim::TlsServerState& tls = sim::tls();
+  uint64_t now = sim::nowUs();
+  const mbedtls_ssl_session& offered = ssl->offered;
+  bool resume = offered.valid && tls.tickets && ssl->conf->tickets &&
+                offered.ticketKey == tls.ticketKey &&
+                now - offered.issuedUs < (uint64_t)tls.ticketLifetimeS * 1000000ULL;
+
+  // ClientHello: a transport that is gone fails before anything is spent.
+  const unsigned char hello[1] = {0x16};
+  int sent = ssl->send(ssl->bio, hello, sizeof(hello));
+  if (sent < 0) {
+    tls.failedHandshakes++;
+    return sent;
+  }
+  unsigned char* work = new unsigned char[resume ? tls.resumeWorkBytes : tls.fullWorkBytes];
+  work[0] = 0;
+  sim::chargeIo((uint64_t)(resume ? tls.resumeRoundTrips : tls.fullRoundTrips) *
+                sim::broker().rttUs);
+  sim::chargeIo(resume ? tls.resumeCpuUs : tls.fullCpuUs);
+  delete[] work;
+
+  if (!resume) {
+    bool verified = ssl->conf->authmode == MBEDTLS_SSL_VERIFY_NONE ||
+                    (ssl->conf->ca && ssl->conf->ca->parsed && tls.certTrusted);
+    if (!verified) {
+      tls.failedHandshakes++;
+      return MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+    }
+    // The server's lifetime runs from here; resuming does not renew it.
+    ssl->session.ticketKey = tls.ticketKey;
+    ssl->session.issuedUs = now;
+    ssl->session.valid = tls.tickets && ssl->conf->tickets;
+    tls.fullHandshakes++;
+  } else {
+    ssl->session = offered;
+    tls.resumedHandshakes++;
+  }
+  ssl->handshakeDone = 1;
+  return 0;
+}
+
+int mbedtls_ssl_read(mbedtls_ssl_context* ssl, unsigned char* buf, size_t len) {
+  (void)buf;
+  (void)len;
+  if (!ssl->handshakeDone) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+  return MBEDTLS_ERR_SSL_WANT_READ;
+}
+
+int mbedtls_ssl_write(mbedtls_ssl_context* ssl, const unsigned char* buf, size_t len) {
+  if (!ssl->handshakeDone) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+  return ssl->send(ssl->bio, buf, len);
+}
+
+size_t mbedtls_ssl_get_bytes_avail(const mbedtls_ssl_context* ssl) {
+  (void)ssl;
+  return 0;
+}
+
+int mbedtls_ssl_close_notify(mbedtls_ssl_context* ssl) {
+  if (!ssl->handshakeDone) return 0;
+  const unsigned char alert[1] = {0x15};
+  int sent = ssl->send(ssl->bio, alert, sizeof(alert));
+  return sent < 0 ? sent : 0;
+}
+
+void mbedtls_ssl_session_init(mbedtls_ssl_session* session) { *session = mbedtls_ssl_session(); }
+void mbedtls_ssl_session_free(mbedtls_ssl_session* session) { *session = mbedtls_ssl_session(); }
+
+int mbedtls_ssl_set_session(mbedtls_ssl_context* ssl, const mbedtls_ssl_session* session) {
+  if (!ssl || !session) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+  ssl->offered = *session;
+  return 0;
+}
+
+int mbedtls_ssl_get_session(const mbedtls_ssl_context* ssl, mbedtls_ssl_session* session) {
+  if (!ssl || !session || !ssl->handshakeDone) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+  *session = ssl->session;
+  return 0;
+}
+
+int mbedtls_ssl_session_save(const mbedtls_ssl_session* session, unsigned char* buf,
+                             size_t buf_len, size_t* olen) {
+  size_t need = std::max<size_t>(kSessionHeader, sim::tls().sessionBytes);
+  *olen = need;
+  if (!session->valid) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+  if (!buf || buf_len < need) return MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL;
+  memset(buf, 0xA5, need);
+  memcpy(buf, &kSessionMagic, 4);
+  memcpy(buf + 4, &session->ticketKey, 4);
+  memcpy(buf + 8, &session->issuedUs, 8);
+  return 0;
+}
+
+int mbedtls_ssl_session_load(mbedtls_ssl_session* session, const unsigned char* buf,
+                             size_t len) {
+  uint32_t magic;
+  if (!buf || len < kSessionHeader) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+  memcpy(&magic, buf, 4);
+  if (magic != kSessionMagic) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+  memcpy(&session->ticketKey, buf + 4, 4);
+  memcpy(&session->issuedUs, buf + 8, 8);
+  session->valid = 1;
+  return 0;
+}
+
+// ---- LittleFS ----------------------------------------------------------------------------------
+
+namespace {
+// Program + metadata commit for a small write, and a cached read, on the
+// ESP32's SPI flash through LittleFS.
+constexpr uint64_t kFlashWriteUs = 400;
+constexpr uint64_t kFlashWriteByteUs = 1;
+constexpr uint64_t kFlashReadUs = 40;
+}  // namespace
+
+namespace fs {
+
+size_t File::write(const uint8_t* buf, size_t size) {
+  if (!data_ || !writable_) return 0;
+  sim::FlashState& f = sim::flash();
+  size_t end = (append_ ? data_->size() : pos_) + size;
+  if (end > data_->size()) {
+    size_t used = 0;
+    for (const auto& file : f.files) used += file.second.size();
+    if (used + (end - data_->size()) > f.capacity) return 0;
+    sim::UncountedHeap guard;
+    data_->resize(end);
+  }
+  memcpy(data_->data() + end - size, buf, size);
+  pos_ = end;
+  f.bytesWritten += size;
+  sim::chargeIo(kFlashWriteUs + kFlashWriteByteUs * size);
+  return size;
+}
+
+size_t File::read(uint8_t* buf, size_t size) {
+  if (!data_) return 0;
+  size_t n = std::min(size, data_->size() - std::min(pos_, data_->size()));
+  memcpy(buf, data_->data() + pos_, n);
+  pos_ += n;
+  sim::flash().bytesRead += n;
+  sim::chargeIo(kFlashReadUs + n / 4);
+  return n;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!data_) return false;
+  size_t base = mode == SeekSet ? 0 : mode == SeekCur ? pos_ : data_->size();
+  if (base + pos > data_->size()) return false;
+  pos_ = base + pos;
+  return true;
+}
+
+File FS::open(const char* path, const char* mode, bool create) {
+  (void)create;
+  if (!mounted_ || !path || !mode) return File();
+  sim::FlashState& f = sim::flash();
+  sim::UncountedHeap guard;
+  auto it = f.files.find(path);
+  bool plus = mode[1] == '+';
+  switch (mode[0]) {
+    case 'r':
+      if (it == f.files.end()) return File();
+      return File(&it->second, plus, false);
+    case 'w':
+      f.files[path].clear();
+      return File(&f.files[path], true, false);
+    case 'a':
+      return File(&f.files[path], true, true);
+  }
+  return File();
+}
+
+bool FS::exists(const char* path) {
+  sim::UncountedHeap guard;
+  return mounted_ && sim::flash().files.count(path) > 0;
+}
+
+bool FS::remove(const char* path) {
+  sim::UncountedHeap guard;
+  return mounted_ && sim::flash().files.erase(path) > 0;
+}
+
+bool FS::rename(const char* pathFrom, const char* pathTo) {
+  sim::UncountedHeap guard;
+  sim::FlashState& f = sim::flash();
+  auto it = f.files.find(pathFrom);
+  if (!mounted_ || it == f.files.end()) return false;
+  std::vector<uint8_t> data = std::move(it->second);
+  f.files.erase(it);
+  f.files[pathTo] = std::move(data);
+  sim::chargeIo(kFlashWriteUs);
+  return true;
+}
+
+size_t FS::totalBytes() { return sim::flash().capacity; }
+
+size_t FS::usedBytes() {
+  size_t used = 0;
+  for (const auto& file : sim::flash().files) used += file.second.size();
+  return used;
+}
+
+bool LittleFSFS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles,
+                       const char* partitionLabel) {
+  (void)basePath;
+  (void)maxOpenFiles;
+  (void)partitionLabel;
+  if (!sim::flash().formatted && !(formatOnFail && format())) return false;
+  mounted_ = true;
+  return true;
+}
+
+bool LittleFSFS::format() {
+  sim::UncountedHeap guard;
+  sim::flash().files.clear();
+  sim::flash().formatted = true;
+  sim::chargeIo(500000);
+  return true;
+}
+
+}  // namespace fs
+
+// ---- App slots (esp_ota_ops.h) -------------------------------------------------------
+
+namespace {
+// 4 KB sector erase on the ESP32's SPI flash (typical, datasheet max ~300 ms).
+constexpr uint64_t kSectorEraseUs = 45000;
+constexpr size_t kSectorSize = 4096;
+constexpr uint8_t kImageMagic = 0xE9;   // first byte of every ESP32 app image
+
+esp_partition_t g_appSlots[2] = {
+  {0x10000, 0x140000, "app0"},
+  {0x150000, 0x140000, "app1"},
+};
+int g_otaOpen = -1;   // slot being written, -1: none
+size_t g_otaErased = 0;   // bytes of it erased so far
+
+int slotOf(const esp_partition_t* partition) {
+  if (partition == &g_appSlots[0]) return 0;
+  if (partition == &g_appSlots[1]) return 1;
+  return -1;
+}
+}  // namespace
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst,
+                             size_t size) {
+  int slot = slotOf(partition);
+  sim::OtaState& o = sim::ota();
+  if (slot < 0 || src_offset + size > o.slotSize) return ESP_ERR_INVALID_ARG;
+  const std::vector<uint8_t>& image = o.image[slot];
+  uint8_t* out = (uint8_t*)dst;
+  for (size_t i = 0; i < size; i++) {
+    out[i] = src_offset + i < image.size() ? image[src_offset + i] : 0xFF;
+  }
+  o.bytesRead += size;
+  sim::chargeIo(kFlashReadUs + size / 4);
+  return ESP_OK;
+}
+
+const esp_partition_t* esp_ota_get_running_partition(void) {
+  return &g_appSlots[sim::ota().running];
+}
+
+const esp_partition_t* esp_ota_get_boot_partition(void) { return &g_appSlots[sim::ota().boot]; }
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from) {
+  int from = start_from ? slotOf(start_from) : sim::ota().running;
+  return from < 0 ? nullptr : &g_appSlots[1 - from];
+}
+
+const esp_partition_t* esp_ota_get_last_invalid_partition(void) {
+  const sim::OtaState& o = sim::ota();
+  for (int slot = 0; slot < 2; slot++) {
+    if (o.state[slot] == ESP_OTA_IMG_INVALID || o.state[slot] == ESP_OTA_IMG_ABORTED) {
+      return &g_appSlots[slot];
+    }
+  }
+  return nullptr;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size,
+                        esp_ota_handle_t* out_handle) {
+  int slot = slotOf(partition);
+  sim::OtaState& o = sim::ota();
+  if (slot < 0 || !out_handle) return ESP_ERR_INVALID_ARG;
+  if (slot == o.running) return ESP_ERR_OTA_PARTITION_CONFLICT;
+  if (image_size != OTA_SIZE_UNKNOWN && image_size != OTA_WITH_SEQUENTIAL_WRITES &&
+      image_size > o.slotSize) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  sim::UncountedHeap guard;
+  o.image[slot].clear();
+  o.state[slot] = ESP_OTA_IMG_UNDEFINED;
+  g_otaErased = 0;
+  if (image_size != OTA_WITH_SEQUENTIAL_WRITES) {
+    // Erased up front: the whole slot, or what the image needs.
+    size_t bytes = image_size == OTA_SIZE_UNKNOWN ? o.slotSize : image_size;
+    uint32_t sectors = (uint32_t)((bytes + kSectorSize - 1) / kSectorSize);
+    o.sectorErases += sectors;
+    sim::chargeIo(kSectorEraseUs * sectors);
+    g_otaErased = sectors * kSectorSize;
+  }
+  g_otaOpen = slot;
+  *out_handle = (esp_ota_handle_t)(slot + 1);
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size) {
+  int slot = (int)handle - 1;
+  sim::OtaState& o = sim::ota();
+  if (slot != g_otaOpen || slot < 0) return ESP_ERR_INVALID_ARG;
+  std::vector<uint8_t>& image = o.image[slot];
+  if (image.size() + size > o.slotSize) return ESP_ERR_INVALID_SIZE;
+  // Sequential writes: each sector is erased the first time it is reached.
+  while (g_otaErased < image.size() + size) {
+    o.sectorErases++;
+    sim::chargeIo(kSectorEraseUs);
+    g_otaErased += kSectorSize;
+  }
+  sim::UncountedHeap guard;
+  const uint8_t* bytes = (const uint8_t*)data;
+  image.insert(image.end(), bytes, bytes + size);
+  o.bytesWritten += size;
+  sim::chargeIo(kFlashWriteByteUs * size);
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+  int slot = (int)handle - 1;
+  if (slot != g_otaOpen || slot < 0) return ESP_ERR_INVALID_ARG;
+  g_otaOpen = -1;
+  const std::vector<uint8_t>& image = sim::ota().image[slot];
+  if (image.empty() || image[0] != kImageMagic) return ESP_ERR_OTA_VALIDATE_FAILED;
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+  int slot = (int)handle - 1;
+  if (slot != g_otaOpen || slot < 0) return ESP_ERR_INVALID_ARG;
+  g_otaOpen = -1;
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
+  int slot = slotOf(partition);
+  sim::OtaState& o = sim::ota();
+  if (slot < 0) return ESP_ERR_INVALID_ARG;
+  if (o.image[slot].empty() || o.image[slot][0] != kImageMagic) {
+    return ESP_ERR_OTA_VALIDATE_FAILED;
+  }
+  if (slot != o.running) o.state[slot] = ESP_OTA_IMG_NEW;
+  o.boot = slot;
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition,
+                                      esp_ota_img_states_t* ota_state) {
+  int slot = slotOf(partition);
+  if (slot < 0 || !ota_state) return ESP_ERR_INVALID_ARG;
+  if (sim::ota().state[slot] == ESP_OTA_IMG_UNDEFINED) return ESP_ERR_NOT_FOUND;
+  *ota_state = sim::ota().state[slot];
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void) {
+  sim::OtaState& o = sim::ota();
+  o.state[o.running] = ESP_OTA_IMG_VALID;
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot(void) {
+  sim::OtaState& o = sim::ota();
+  int other = 1 - o.running;
+  if (o.state[other] != ESP_OTA_IMG_VALID) return ESP_ERR_OTA_ROLLBACK_INVALID_STATE;
+  o.state[o.running] = ESP_OTA_IMG_INVALID;
+  o.boot = other;
+  // Does not return on the device; the sim only counts the restart.
+  ESP.restart();
+  return ESP_OK;
+}
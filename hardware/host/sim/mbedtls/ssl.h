@@ -0,0 +1,98 @@
+// Host stand-in for the parts of mbedtls (ESP-IDF's TLS library) that
+// tls_client.cpp uses. Nothing is encrypted and no bytes move: a handshake
+// costs the round trips, CPU time and working memory sim::tls() describes,
+// and records still pass through the BIO callbacks so a dead transport
+// fails the same way. Sessions saved with mbedtls_ssl_session_save() are
+// sim::tls().sessionBytes long and resume as that state allows.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ctr_drbg.h"
+#include "entropy.h"
+#include "x509_crt.h"
+
+#define MBEDTLS_ERR_SSL_WANT_READ -0x6900
+#define MBEDTLS_ERR_SSL_WANT_WRITE -0x6880
+#define MBEDTLS_ERR_SSL_BAD_INPUT_DATA -0x7100
+#define MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL -0x6A00
+#define MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY -0x7880
+#define MBEDTLS_ERR_SSL_ALLOC_FAILED -0x7F00
+#define MBEDTLS_ERR_SSL_TIMEOUT -0x6800
+#define MBEDTLS_ERR_X509_CERT_VERIFY_FAILED -0x2700
+#define MBEDTLS_ERR_NET_CONN_RESET -0x0050
+#define MBEDTLS_ERR_NET_SEND_FAILED -0x004E
+#define MBEDTLS_ERR_NET_RECV_FAILED -0x004C
+
+#define MBEDTLS_SSL_IS_CLIENT 0
+#define MBEDTLS_SSL_TRANSPORT_STREAM 0
+#define MBEDTLS_SSL_PRESET_DEFAULT 0
+#define MBEDTLS_SSL_VERIFY_NONE 0
+#define MBEDTLS_SSL_VERIFY_REQUIRED 2
+#define MBEDTLS_SSL_SESSION_TICKETS_DISABLED 0
+#define MBEDTLS_SSL_SESSION_TICKETS_ENABLED 1
+
+// ESP-IDF defaults (asymmetric buffers): a full record in, a smaller one out.
+#define MBEDTLS_SSL_IN_CONTENT_LEN 16384
+#define MBEDTLS_SSL_OUT_CONTENT_LEN 4096
+
+typedef int mbedtls_ssl_send_t(void* ctx, const unsigned char* buf, size_t len);
+typedef int mbedtls_ssl_recv_t(void* ctx, unsigned char* buf, size_t len);
+
+typedef struct mbedtls_ssl_session {
+  uint32_t ticketKey;     // server key the ticket was issued under
+  uint64_t issuedUs;
+  uint8_t valid;
+} mbedtls_ssl_session;
+
+typedef struct mbedtls_ssl_config {
+  int endpoint;
+  int authmode;
+  int tickets;
+  const mbedtls_x509_crt* ca;
+  int (*rng)(void*, unsigned char*, size_t);
+  void* rngCtx;
+} mbedtls_ssl_config;
+
+typedef struct mbedtls_ssl_context {
+  const mbedtls_ssl_config* conf;
+  char hostname[64];
+  void* bio;
+  mbedtls_ssl_send_t* send;
+  mbedtls_ssl_recv_t* recv;
+  unsigned char* inBuf;
+  unsigned char* outBuf;
+  mbedtls_ssl_session offered;   // mbedtls_ssl_set_session()
+  mbedtls_ssl_session session;   // negotiated
+  int handshakeDone;
+} mbedtls_ssl_context;
+
+void mbedtls_ssl_init(mbedtls_ssl_context* ssl);
+void mbedtls_ssl_free(mbedtls_ssl_context* ssl);
+void mbedtls_ssl_config_init(mbedtls_ssl_config* conf);
+void mbedtls_ssl_config_free(mbedtls_ssl_config* conf);
+int mbedtls_ssl_config_defaults(mbedtls_ssl_config* conf, int endpoint, int transport, int preset);
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config* conf, int authmode);
+void mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config* conf, mbedtls_x509_crt* ca_chain, void* ca_crl);
+void mbedtls_ssl_conf_rng(mbedtls_ssl_config* conf, int (*f_rng)(void*, unsigned char*, size_t),
+                          void* p_rng);
+void mbedtls_ssl_conf_session_tickets(mbedtls_ssl_config* conf, int use_tickets);
+int mbedtls_ssl_setup(mbedtls_ssl_context* ssl, const mbedtls_ssl_config* conf);
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context* ssl, const char* hostname);
+void mbedtls_ssl_set_bio(mbedtls_ssl_context* ssl, void* p_bio, mbedtls_ssl_send_t* f_send,
+                         mbedtls_ssl_recv_t* f_recv, void* f_recv_timeout);
+int mbedtls_ssl_handshake(mbedtls_ssl_context* ssl);
+int mbedtls_ssl_read(mbedtls_ssl_context* ssl, unsigned char* buf, size_t len);
+int mbedtls_ssl_write(mbedtls_ssl_context* ssl, const unsigned char* buf, size_t len);
+size_t mbedtls_ssl_get_bytes_avail(const mbedtls_ssl_context* ssl);
+int mbedtls_ssl_close_notify(mbedtls_ssl_context* ssl);
+
+void mbedtls_ssl_session_init(mbedtls_ssl_session* session);
+void mbedtls_ssl_session_free(mbedtls_ssl_session* session);
+int mbedtls_ssl_set_session(mbedtls_ssl_context* ssl, const mbedtls_ssl_session* session);
+int mbedtls_ssl_get_session(const mbedtls_ssl_context* ssl, mbedtls_ssl_session* session);
+int mbedtls_ssl_session_save(const mbedtls_ssl_session* session, unsigned char* buf,
+                             size_t buf_len, size_t* olen);
+int mbedtls_ssl_session_load(mbedtls_ssl_session* session, const unsigned char* buf,
+                             size_t len);
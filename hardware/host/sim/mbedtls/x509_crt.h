@@ -0,0 +1,15 @@
+// Host stand-in for mbedtls/x509_crt.h: parsing only checks for PEM framing.
+#pragma once
+
+#include <stddef.h>
+
+#define MBEDTLS_ERR_X509_INVALID_FORMAT -0x2180
+
+typedef struct mbedtls_x509_crt {
+  int parsed;
+} mbedtls_x509_crt;
+
+void mbedtls_x509_crt_init(mbedtls_x509_crt* crt);
+void mbedtls_x509_crt_free(mbedtls_x509_crt* crt);
+// buflen includes the terminating NUL, as for real PEM input.
+int mbedtls_x509_crt_parse(mbedtls_x509_crt* chain, const unsigned char* buf, size_t buflen);
@@ -0,0 +1,111 @@
+// Entry points and globals of hardware/main.cpp that the host harness
+// drives directly. Keep in step with the sketch.
+#pragma once
+
+#include <PubSubClient.h>
+
+#include <functional>
+#include <string>
+
+#include "board_sim.h"
+#include "climate_sensor.h"
+#include "connection_manager.h"
+#include "core_link.h"
+#include "device_config.h"
+#include "device_registry.h"
+#include "display_renderer.h"
+#include "input_events.h"
+#include "light_sampler.h"
+#include "metrics.h"
+#include "ota_update.h"
+#include "power_manager.h"
+#include "rule_engine.h"
+#include "sample_buffer.h"
+#include "sensor_rollup.h"
+#include "state_sync.h"
+#include "task_scheduler.h"
+#include "tls_client.h"
+
+void setup();
+void loop();
+void callback(char* topic, byte* payload, unsigned int length);
+void publishSensorData(float temperature, float humidity, int lightValue);
+void reportSensorData(float temperature, float humidity, int lightValue);
+void onMqttConnected();
+void ioStep();   // one pass of the network side in dual-core mode
+void loadDefaultConfig(DeviceConfig& c);
+void loadDefaultRules(RuleSet& set);
+
+bool setDoor(bool open, int deviceId);
+bool setAlarm(bool state, int deviceId);
+bool setFan(bool state, int deviceId);
+bool setRGBColor(uint8_t r, uint8_t g, uint8_t b, int deviceId);
+
+extern PubSubClient client;
+extern ConnectionManager connection;
+extern const char* HOUSE_ID;
+extern DeviceConfig config;
+extern uint8_t sensorPublishMode;   // SENSOR_PUBLISH_TOPICS / _FRAME / _BOTH
+extern uint8_t sensorRawStream;     // 0: rollups and alarms only
+extern WindowedRollup rollup;
+extern SampleBuffer sampleBacklog;
+extern DeviceRegistry devices;
+extern StateSync stateSync;
+extern int alarmSlot;
+extern RuleEngine rules;
+extern LightSampler lights;
+extern ClimateSensor climate;
+extern TaskScheduler scheduler;
+extern PixelRenderer strip;
+extern LcdRenderer screen;
+extern bool dualCoreMode;          // set before setup()
+extern TaskScheduler ioScheduler;
+extern CommandQueue commandQueue;
+extern TelemetryQueue telemetryQueue;
+extern Metrics metrics;
+extern PowerManager power;
+extern uint8_t powerMode;          // set before setup()
+extern uint32_t powerMaxLatencyMs; // set before setup()
+extern int powerWakePin;           // set before setup()
+extern uint8_t doorSense;          // set before setup()
+extern InputCapture inputs;
+extern OtaUpdater ota;
+extern uint8_t mqttTls;            // set before setup()
+extern uint8_t otaMqtt;            // set before setup(); needs mqttTls
+extern TlsClient tlsClient;
+extern TlsSessionCache tlsSessions;
+extern char mqttClientId[];
+
+inline bool alarmActive() { return devices.state(alarmSlot) != 0; }
+
+// Runs loop() until the connection state machine reports the broker session
+// up, or timeoutUs of virtual time passes.
+inline bool runUntilConnected(uint64_t timeoutUs = 30000000ULL) {
+  uint64_t end = sim::nowUs() + timeoutUs;
+  while (!connection.mqttUp() && sim::nowUs() < end) {
+    loop();
+    sim::advanceUs(1000);
+  }
+  return connection.mqttUp();
+}
+
+// Publishes "<HOUSE_ID>:<deviceCommand>" on the control topic as another
+// client would, arriving arriveInUs from now, then runs loop() (stepUs of idle
+// time per pass) until actuated() holds. Returns the virtual time from arrival
+// to actuation, or UINT64_MAX if timeoutUs passes first.
+inline uint64_t commandLatencyUs(const char* deviceCommand, const std::function<bool()>& actuated,
+                                 uint64_t arriveInUs = 0, uint64_t stepUs = 100,
+                                 uint64_t timeoutUs = 5000000ULL) {
+  uint64_t arrival = sim::nowUs() + arriveInUs;
+  {
+    sim::UncountedHeap guard;
+    sim::broker().inject(std::string("yolouno/") + HOUSE_ID + "/controls",
+                         std::string(HOUSE_ID) + ":" + deviceCommand, false, arrival);
+  }
+  while (sim::nowUs() < arrival || !actuated()) {
+    if (sim::nowUs() >= arrival + timeoutUs) return UINT64_MAX;
+    loop();
+    sim::advanceUs(stepUs);
+  }
+  return sim::nowUs() - arrival;
+}
@@ -0,0 +1,32 @@
+// Runs the sketch on the virtual board: setup() once, then loop() until the
+// requested amount of virtual time has passed. Set SIM_SERIAL=1 to see the
+// firmware's Serial output.
+//
+//   firmware_sim [seconds]
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "board_sim.h"
+#include "sketch.h"
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 60.0;
+  uint64_t endUs = (uint64_t)(seconds * 1e6);
+
+  setup();
+  uint64_t iterations = 0;
+  while (sim::nowUs() < endUs) {
+    loop();
+    ++iterations;
+    // An idle loop() takes a few microseconds on the ESP32-S3.
+    sim::advanceUs(5);
+  }
+
+  const sim::BrokerStats& b = sim::broker().stats();
+  printf("virtual time      %.1f s\n", sim::nowUs() / 1e6);
+  printf("loop iterations   %llu\n", (unsigned long long)iterations);
+  printf("mqtt publishes    %llu (%llu bytes on wire)\n", (unsigned long long)b.publishes,
+         (unsigned long long)b.wireBytes);
+  printf("heap allocations  %llu\n", (unsigned long long)sim::heap().allocs);
+  return 0;
+}
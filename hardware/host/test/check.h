@@ -0,0 +1,41 @@
+// Minimal assertion helpers for the host tests (no framework dependency).
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace check {
+inline int& failures() {
+  static int n = 0;
+  return n;
+}
+}  // namespace check
+
+#define CHECK(cond)                                                        \
+  do {                                                                     \
+    if (!(cond)) {                                                         \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+      ++check::failures();                                                 \
+    }                                                                      \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                              \
+  do {                                                                              \
+    auto check_a_ = (a);                                                            \
+    auto check_b_ = (b);                                                            \
+    if (!(check_a_ == check_b_)) {                                                  \
+      fprintf(stderr, "%s:%d: CHECK_EQ failed: %s == %s (%lld vs %lld)\n", __FILE__, \
+              __LINE__, #a, #b, (long long)check_a_, (long long)check_b_);          \
+      ++check::failures();                                                          \
+    }                                                                               \
+  } while (0)
+
+#define CHECK_DONE()                                                   \
+  do {                                                                 \
+    if (check::failures()) {                                           \
+      fprintf(stderr, "%d check(s) failed\n", check::failures());      \
+      return 1;                                                        \
+    }                                                                  \
+    printf("all checks passed\n");                                     \
+    return 0;                                                          \
+  } while (0)
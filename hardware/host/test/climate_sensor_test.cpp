@@ -0,0 +1,111 @@
+// The split-phase DHT20 read against the simulated sensor: how long each call
+// blocks compared with the library's blocking read(), busy retries, CRC
+// errors keeping the cached reading, and the sketch's LCD and telemetry
+// showing the same reading.
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "board_sim.h"
+#include "check.h"
+#include "climate_sensor.h"
+#include "sketch.h"
+
+// Runs one whole cycle of sensor, stepping the clock to each requested time.
+// Returns the result of the last step; *maxBlockUs is the longest step.
+static ClimateResult runCycle(ClimateSensor& sensor, uint64_t* maxBlockUs) {
+  *maxBlockUs = 0;
+  for (;;) {
+    uint32_t nextMs;
+    uint64_t before = sim::nowUs();
+    ClimateResult result = sensor.step(&nextMs);
+    uint64_t blocked = sim::nowUs() - before;
+    if (blocked > *maxBlockUs) *maxBlockUs = blocked;
+    if (result == CLIMATE_UPDATED || result == CLIMATE_FAILED) return result;
+    sim::advanceMs(nextMs);
+  }
+}
+
+int main() {
+  static DHT20 dht;
+  CHECK(dht.begin());
+  sim::dht20().temperature = 24.25f;
+  sim::dht20().humidity = 51.5f;
+
+  // Before: the library's read() holds the caller for the whole conversion.
+  sim::advanceMs(2000);
+  uint64_t before = sim::nowUs();
+  CHECK_EQ(dht.read(), DHT20_OK);
+  uint64_t blockingUs = sim::nowUs() - before;
+
+  // After: no step waits; the reading lands one conversion time later.
+  static ClimateSensor sensor(dht);
+  uint64_t start = sim::nowUs();
+  uint64_t splitUs = 0;
+  CHECK_EQ(runCycle(sensor, &splitUs), CLIMATE_UPDATED);
+  printf("loop blocked per sample: %.1f ms blocking read(), %.1f ms split-phase (reading after "
+         "%.1f ms)\n",
+         blockingUs / 1000.0, splitUs / 1000.0, (sim::nowUs() - start) / 1000.0);
+  CHECK(blockingUs >= 80000);
+  CHECK(splitUs <= 1500);   // status byte + 7-byte read
+  CHECK(fabsf(sensor.reading().temperature - 24.25f) < 0.01f);
+  CHECK(fabsf(sensor.reading().humidity - 51.5f) < 0.01f);
+  CHECK_EQ(sensor.reading().readings, 1u);
+  CHECK(sensor.fresh(millis(), 0));
+
+  // A conversion slower than the datasheet is polled until done...
+  sim::dht20().conversionUs = 100000;
+  CHECK_EQ(runCycle(sensor, &splitUs), CLIMATE_UPDATED);
+  CHECK_EQ(sensor.stats().busyRetries, 2u);
+  // ...and one that never finishes ends the cycle without a reading.
+  sim::dht20().conversionUs = 1000000;
+  CHECK_EQ(runCycle(sensor, &splitUs), CLIMATE_FAILED);
+  CHECK_EQ(sensor.stats().failures, 1u);
+  sim::dht20().conversionUs = 80000;
+
+  // A corrupted result is rejected; the cache keeps the last good reading.
+  uint32_t goodAtMs = sensor.reading().atMs;
+  sim::dht20().temperature = 30.0f;
+  sim::dht20().corruptReads = 1;
+  sim::advanceMs(2000);
+  CHECK_EQ(runCycle(sensor, &splitUs), CLIMATE_FAILED);
+  CHECK_EQ(sensor.stats().crcErrors, 1u);
+  CHECK(fabsf(sensor.reading().temperature - 24.25f) < 0.01f);
+  CHECK_EQ(sensor.reading().atMs, goodAtMs);
+  CHECK(!sensor.fresh(millis(), 1000));
+  CHECK_EQ(runCycle(sensor, &splitUs), CLIMATE_UPDATED);
+  CHECK(fabsf(sensor.reading().temperature - 30.0f) < 0.01f);
+  CHECK_EQ(sensor.reading().readings, 3u);
+
+  // The sketch: the climate task never blocks loop() for a conversion, and a
+  // bad CRC never reaches the LCD or the broker.
+  sim::dht20().temperature = 21.5f;
+  sim::dht20().humidity = 40.0f;
+  setup();
+  CHECK(runUntilConnected());
+  sim::broker().clearLog();
+  sim::dht20().temperature = 23.0f;
+  sim::dht20().corruptReads = 3;
+  for (int i = 0; i < 30000; i++) {
+    loop();
+    sim::advanceUs(1000);
+  }
+  int task = scheduler.find("climate");
+  printf("sketch climate task: %u runs, max %.2f ms per run\n",
+         (unsigned)scheduler.stats(task).runs, scheduler.stats(task).maxRunUs / 1000.0);
+  CHECK(scheduler.stats(task).maxRunUs < 5000);
+  CHECK_EQ(climate.stats().crcErrors, 3u);
+  CHECK(climate.reading().readings >= 10);
+  CHECK(strncmp(sim::peripherals().lcd[0], "T:23.0  H:40.0", 14) == 0);
+  std::string temp = std::string("yolouno/") + HOUSE_ID + "/status/temp/1";
+  int published = 0;
+  for (const sim::Message& m : sim::broker().log()) {
+    if (m.topic != temp) continue;
+    CHECK(m.payload == "23.00");
+    published++;
+  }
+  CHECK(published > 0);
+  CHECK_DONE();
+}
@@ -0,0 +1,34 @@
+// Command-to-actuation latency: a fan command published by the backend until
+// the fan pin changes, at random points in the firmware's task cycle.
+#include <algorithm>
+#include <vector>
+
+#include "board_sim.h"
+#include "check.h"
+#include "sketch.h"
+
+int main() {
+  setup();
+  CHECK(runUntilConnected());
+
+  std::vector<uint64_t> latencies;
+  bool on = false;
+  for (int i = 0; i < 400; i++) {
+    // Arrive anywhere in the 2 s sensor/LCD cycle, including mid-task.
+    on = !on;
+    uint64_t us = commandLatencyUs(on ? "fan:11:ON" : "fan:11:OFF",
+                                   [on] { return sim::digitalLevel(6) == (on ? HIGH : LOW); },
+                                   (uint64_t)random(2000000));
+    CHECK(us != UINT64_MAX);
+    latencies.push_back(us);
+  }
+  std::sort(latencies.begin(), latencies.end());
+  uint64_t p50 = latencies[latencies.size() / 2];
+  uint64_t p99 = latencies[latencies.size() * 99 / 100];
+  uint64_t max = latencies.back();
+  printf("fan command -> pin: p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", p50 / 1000.0, p99 / 1000.0,
+         max / 1000.0);
+  CHECK(max < 50000);
+
+  CHECK_DONE();
+}
@@ -0,0 +1,96 @@
+// Parser edge cases, and callback() end to end on the simulated board.
+#include <limits.h>
+#include <string.h>
+
+#include <string>
+
+#include "board_sim.h"
+#include "check.h"
+#include "command_parser.h"
+#include "sketch.h"
+
+static bool parse(const char* s, Command& cmd) { return parseCommand(s, strlen(s), cmd); }
+
+static void send(const char* deviceCommand) {
+  std::string topic, message;
+  {
+    sim::UncountedHeap harness;  // only the firmware's allocations are checked
+    topic = std::string("yolouno/") + HOUSE_ID + "/controls";
+    message = std::string(HOUSE_ID) + ":" + deviceCommand;
+  }
+  callback(&topic[0], (byte*)&message[0], (unsigned int)message.size());
+}
+
+int main() {
+  Command cmd;
+
+  CHECK(parse("h1:door:7:open", cmd));
+  CHECK(cmd.houseId.equals("h1"));
+  CHECK(cmd.deviceType.equals("door"));
+  CHECK_EQ(cmd.deviceId, 7);
+  CHECK(cmd.command.equals("open"));
+
+  // The command keeps any further ':' (same as substring(thirdColon + 1)).
+  CHECK(parse("h1:rgb:14:1:2", cmd));
+  CHECK(cmd.command.equals("1:2"));
+
+  // toInt() semantics for the device id.
+  CHECK(parse("h1:fan: 12x:ON", cmd));
+  CHECK_EQ(cmd.deviceId, 12);
+  CHECK(parse("h1:fan:abc:ON", cmd));
+  CHECK_EQ(cmd.deviceId, 0);
+  // An ID too long for a long saturates instead of overflowing.
+  CHECK(parse("h1:fan:123456789012345678901234567890:ON", cmd));
+  CHECK_EQ(cmd.deviceId, INT_MAX);
+  CHECK(parse("h1:fan:-123456789012345678901234567890:ON", cmd));
+  CHECK_EQ(cmd.deviceId, INT_MIN);
+  CHECK_EQ(Token({"99999999999999999999", 20}).toInt(), LONG_MAX);
+
+  CHECK(!parse(":door:7:open", cmd));
+  CHECK(!parse("h1:door:7", cmd));
+  CHECK(!parse("", cmd));
+
+  Token rgb{"255,0,128", 9};
+  CHECK_EQ(rgb.indexOf(','), 3);
+  CHECK_EQ(rgb.lastIndexOf(','), 5);
+  CHECK_EQ(rgb.slice(6, 9).toInt(), 128);
+  CHECK(Token({"OPEN", 4}).equalsIgnoreCase("open"));
+
+  // End to end: no heap allocation per command.
+  setup();
+  CHECK(runUntilConnected());
+  uint64_t allocs = sim::heap().allocs;
+  send("door:7:open");
+  send("fan:11:ON");
+  send("rgb:15:10,20,30");
+  send("alarm:1:ON");
+  send("heater:1:ON");
+  CHECK_EQ(sim::heap().allocs - allocs, 0u);
+
+  CHECK_EQ(sim::peripherals().servoAngle[5], 90);
+  CHECK_EQ(sim::digitalLevel(6), HIGH);
+  // alarm ON turns the strip red after the RGB command; the render task
+  // latches it onto the strip.
+  CHECK_EQ(strip.get(0), 0xFF0000u);
+  for (int i = 0; i < 30; i++) {
+    loop();
+    sim::advanceMs(1);
+  }
+  CHECK_EQ(sim::peripherals().pixel[0], 0xFF0000u);
+
+  send("door:7:close");
+  CHECK_EQ(sim::peripherals().servoAngle[5], 0);
+  send("fan:11:off");
+  CHECK_EQ(sim::digitalLevel(6), LOW);
+  // Out-of-range id is rejected.
+  send("fan:20:ON");
+  CHECK_EQ(sim::digitalLevel(6), LOW);
+  // A 30-digit id fails the range check too.
+  send("fan:123456789012345678901234567890:ON");
+  CHECK_EQ(sim::digitalLevel(6), LOW);
+  // So is an alarm the house does not have.
+  send("alarm:2:OFF");
+  CHECK(alarmActive());
+
+  CHECK_DONE();
+}
@@ -0,0 +1,144 @@
+// Batch parsing, dedup and ack text, then batches end to end through
+// callback(): absolute targets, acknowledgements and duplicate suppression.
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "board_sim.h"
+#include "check.h"
+#include "command_pipeline.h"
+#include "sketch.h"
+
+static bool parse(const char* s, CommandBatch& batch) {
+  Command cmd;
+  return parseCommand(s, strlen(s), cmd) && parseBatch(cmd, batch);
+}
+
+static void send(const std::string& body) {
+  std::string topic, message;
+  {
+    sim::UncountedHeap harness;
+    topic = std::string("yolouno/") + HOUSE_ID + "/controls";
+    message = std::string(HOUSE_ID) + ":" + body;
+  }
+  callback(&topic[0], (byte*)&message[0], (unsigned int)message.size());
+}
+
+// Payload of the last ack, or "" if none was published since clearLog().
+static std::string lastAck() {
+  std::string topic = std::string("yolouno/") + HOUSE_ID + "/acks";
+  const auto& log = sim::broker().log();
+  for (size_t i = log.size(); i > 0; i--) {
+    if (log[i - 1].topic == topic) return log[i - 1].payload;
+  }
+  return "";
+}
+
+static bool ackIs(const char* prefix) {
+  std::string ack = lastAck();
+  return ack.compare(0, strlen(prefix), prefix) == 0;
+}
+
+int main() {
+  CommandBatch batch;
+  CHECK(parse("h1:cmd:a7:door:7:OPEN;fan:11:ON;rgb:14:1,2,3", batch));
+  CHECK(batch.id.equals("a7"));
+  CHECK_EQ(batch.count, 3);
+  CHECK(batch.items[0].deviceType.equals("door"));
+  CHECK_EQ(batch.items[0].deviceId, 7);
+  CHECK(batch.items[0].command.equals("OPEN"));
+  CHECK(batch.items[2].command.equals("1,2,3"));
+  CHECK(batch.items[2].houseId.equals("h1"));
+
+  CHECK(!parse("h1:cmd:a7:", batch));               // no items
+  CHECK(batch.id.equals("a7"));                     // ...but rejectable by ID
+  CHECK(!parse("h1:cmd:a7:door:7:", batch));        // empty target
+  CHECK(!parse("h1:cmd:a7:door7OPEN", batch));
+  CHECK(parse("h1:cmd:a7:fan:11:ON;", batch));       // trailing ';' is fine
+  CHECK_EQ(batch.count, 1);
+  CHECK(!parse("h1:cmd:0123456789abc:fan:11:ON", batch));  // ID too long
+  CHECK_EQ(batch.id.len, 0);
+  CHECK(!parse("h1:door:7:open", batch));           // legacy command, not a batch
+  std::string nine = "h1:cmd:n9:";
+  for (int i = 0; i < CMD_BATCH_MAX + 1; i++) nine += "fan:11:ON;";
+  CHECK(!parse(nine.c_str(), batch));
+
+  char text[CMD_ACK_TEXT_MAX];
+  CHECK(formatAck(text, sizeof(text), Token{"a7", 2}, ACK_PARTIAL, 2, 3, 412) > 0);
+  CHECK(strcmp(text, "a7:partial:2/3:412") == 0);
+  CHECK(formatAck(text, sizeof(text), Token{"0123456789ab", 12}, ACK_DUPLICATE, 8, 8,
+                  4294967295u) > 0);
+  CHECK(strcmp(text, "0123456789ab:duplicate:8/8:4294967295") == 0);
+  CHECK_EQ(formatAck(text, 12, Token{"a7", 2}, ACK_OK, 1, 1, 5), (size_t)11);   // exactly fits
+  CHECK(strcmp(text, "a7:ok:1/1:5") == 0);
+  CHECK_EQ(formatAck(text, 10, Token{"a7", 2}, ACK_OK, 1, 1, 5), (size_t)0);
+  CHECK_EQ(batchResult(0, 2), ACK_REJECTED);
+  CHECK_EQ(batchResult(2, 2), ACK_OK);
+
+  CommandDedup dedup;
+  CHECK(!dedup.seen(Token{"x1", 2}, 1000));
+  CHECK(dedup.seen(Token{"x1", 2}, 1000 + CMD_DEDUP_WINDOW_MS - 1));
+  CHECK(!dedup.seen(Token{"x1", 2}, 1000 + CMD_DEDUP_WINDOW_MS));   // window over
+  CHECK(!dedup.seen(Token{"x", 1}, 1000));
+  for (int i = 0; i < CMD_DEDUP_SIZE; i++) {
+    char id[4] = {'y', (char)('a' + i), 0};
+    dedup.seen(Token{id, 2}, 2000);
+  }
+  CHECK(!dedup.seen(Token{"x", 1}, 2000));   // pushed out of the ring
+
+  setup();
+  CHECK(runUntilConnected());
+  sim::Peripherals& p = sim::peripherals();
+
+  // Legacy door commands are absolute now: "open" twice stays open, and the
+  // upper-case forms the backend documents are accepted.
+  send("door:7:open");
+  CHECK_EQ(p.servoAngle[5], 90);
+  send("door:7:open");
+  CHECK_EQ(p.servoAngle[5], 90);
+  send("door:7:CLOSED");
+  CHECK_EQ(p.servoAngle[5], 0);
+  send("door:7:OPEN");
+  CHECK_EQ(p.servoAngle[5], 90);
+  send("door:7:close");
+  CHECK_EQ(p.servoAngle[5], 0);
+
+  // A batch drives several actuators and is acknowledged once.
+  sim::broker().clearLog();
+  send("cmd:b1:door:8:OPEN;fan:11:ON;rgb:15:0,0,9");
+  CHECK_EQ(p.servoAngle[48], 90);
+  CHECK_EQ(sim::digitalLevel(6), HIGH);
+  CHECK_EQ(strip.get(2), 0x000009u);
+  CHECK(ackIs("b1:ok:3/3:"));
+  uint32_t latencyUs = (uint32_t)atol(lastAck().c_str() + strlen("b1:ok:3/3:"));
+  printf("batch of 3: device-side latency %u us\n", (unsigned)latencyUs);
+
+  // Redelivery of the same command ID is acknowledged, not applied again.
+  setFan(false, 11);
+  sim::broker().clearLog();
+  send("cmd:b1:door:8:OPEN;fan:11:ON;rgb:15:0,0,9");
+  CHECK(ackIs("b1:duplicate:0/3:"));
+  CHECK_EQ(sim::digitalLevel(6), LOW);
+
+  // Items that cannot be applied are counted, the rest still run.
+  send("cmd:b2:fan:12:ON;fan:13:ON;heater:1:ON;door:9:ajar");
+  CHECK(ackIs("b2:partial:1/4:"));
+  CHECK_EQ(sim::digitalLevel(10), HIGH);
+  send("cmd:b3:fan:20:ON");
+  CHECK(ackIs("b3:rejected:0/1:"));
+  send("cmd:b4:");
+  CHECK(ackIs("b4:rejected:0/0:"));
+  send("cmd:b4:fan:11:ON");   // a rejected ID is not remembered
+  CHECK(ackIs("b4:ok:1/1:"));
+
+  // Commands for another house are ignored without an ack.
+  sim::broker().clearLog();
+  std::string topic = std::string("yolouno/") + HOUSE_ID + "/controls";
+  std::string other = "someone-else:cmd:c1:fan:11:OFF";
+  callback(&topic[0], (byte*)&other[0], (unsigned int)other.size());
+  CHECK(lastAck().empty());
+  CHECK_EQ(sim::digitalLevel(6), HIGH);
+
+  CHECK_DONE();
+}
@@ -0,0 +1,39 @@
+// Backoff bounds, and the firmware riding out a broker outage without blocking.
+#include "board_sim.h"
+#include "check.h"
+#include "connection_manager.h"
+#include "sketch.h"
+
+int main() {
+  for (int i = 0; i < 200; i++) {
+    unsigned long first = ConnectionManager::backoffMs(0);
+    CHECK(first >= CONN_BACKOFF_MIN_MS / 2 && first <= CONN_BACKOFF_MIN_MS);
+    unsigned long capped = ConnectionManager::backoffMs(40);
+    CHECK(capped >= CONN_BACKOFF_MAX_MS / 2 && capped <= CONN_BACKOFF_MAX_MS);
+  }
+
+  setup();
+  CHECK(runUntilConnected());
+  uint32_t reconnects = connection.reconnects();
+
+  // 60 s outage: no single loop() may block for anything close to a second.
+  uint64_t start = sim::nowUs();
+  sim::broker().setOutage(start, start + 60000000ULL);
+  client.disconnect();
+  uint64_t worst = 0;
+  while (sim::nowUs() - start < 60000000ULL) {
+    uint64_t t0 = sim::nowUs();
+    loop();
+    if (sim::nowUs() - t0 > worst) worst = sim::nowUs() - t0;
+    sim::advanceUs(1000);
+  }
+  CHECK(!connection.mqttUp());
+  CHECK(worst < 500000ULL);
+  CHECK(connection.failedAttempts() > 0);
+
+  // Back once the broker is, within one maximum backoff.
+  CHECK(runUntilConnected(CONN_BACKOFF_MAX_MS * 1000ULL + 1000000ULL));
+  CHECK_EQ(connection.reconnects(), reconnects + 1);
+
+  CHECK_DONE();
+}
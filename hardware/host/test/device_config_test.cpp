@@ -0,0 +1,230 @@
+// Config blob codec, then the sketch booting from a config on flash and taking
+// a new one over MQTT.
+#include <LittleFS.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "board_sim.h"
+#include "check.h"
+#include "device_config.h"
+#include "sketch.h"
+
+static const char* kHouse = "5a1b7c2d-0000-4000-8000-00000000beef";
+
+static std::vector<uint8_t> encode(const DeviceConfig& c) {
+  std::vector<uint8_t> blob(CONFIG_BLOB_MAX);
+  blob.resize(encodeDeviceConfig(c, blob.data(), blob.size()));
+  return blob;
+}
+
+static bool sameConfig(const DeviceConfig& a, const DeviceConfig& b) {
+  if (strcmp(a.houseId, b.houseId) || strcmp(a.ssid, b.ssid) || strcmp(a.password, b.password) ||
+      strcmp(a.mqttHost, b.mqttHost) || a.mqttPort != b.mqttPort ||
+      a.sensorIntervalMs != b.sensorIntervalMs || a.lcdIntervalMs != b.lcdIntervalMs ||
+      a.alarmIntervalMs != b.alarmIntervalMs || a.deviceCount != b.deviceCount ||
+      memcmp(a.lightPins, b.lightPins, sizeof(a.lightPins)) ||
+      memcmp(a.ranges, b.ranges, sizeof(a.ranges))) {
+    return false;
+  }
+  for (uint8_t i = 0; i < a.deviceCount; i++) {
+    const DeviceSpec& x = a.devices[i];
+    const DeviceSpec& y = b.devices[i];
+    if (x.kind != y.kind || x.id != y.id || x.pin != y.pin || x.span != y.span ||
+        x.initial != y.initial) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A second house: other ID, two doors, one fan on another pin, one RGB light,
+// a single temperature/humidity ID.
+static DeviceConfig otherHouse() {
+  DeviceConfig c;
+  loadDefaultConfig(c);
+  strcpy(c.houseId, kHouse);
+  c.sensorIntervalMs = 5000;
+  c.deviceCount = 4;
+  c.devices[0] = {STATUS_DOOR, 7, 5, 1, 0};
+  c.devices[1] = {STATUS_DOOR, 8, 17, 1, 1};
+  c.devices[2] = {STATUS_FAN, 13, 7, 1, 0};
+  c.devices[3] = {STATUS_RGB, 14, 0, 4, 0};
+  c.ranges[STATUS_TEMP] = {2, 2};
+  c.ranges[STATUS_HUMI] = {2, 2};
+  return c;
+}
+
+static void sendConfig(const std::vector<uint8_t>& blob) {
+  sim::UncountedHeap guard;
+  std::string topic = std::string("yolouno/") + HOUSE_ID + "/config";
+  std::vector<uint8_t> copy(blob);
+  callback(&topic[0], copy.data(), copy.size());
+}
+
+static std::string lastPayload() {
+  const auto& log = sim::broker().log();
+  return log.empty() ? std::string() : log.back().payload;
+}
+
+int main() {
+  static const uint8_t check[] = "123456789";
+  CHECK_EQ(crc32(check, 9), 0xCBF43926u);
+
+  // Round trip, and the defaults are themselves a valid config.
+  DeviceConfig defaults;
+  loadDefaultConfig(defaults);
+  CHECK_EQ(validateDeviceConfig(defaults), CONFIG_OK);
+  DeviceConfig other = otherHouse();
+  std::vector<uint8_t> blob = encode(other);
+  CHECK(!blob.empty());
+  CHECK(blob.size() <= (size_t)CONFIG_BLOB_MAX);
+  DeviceConfig decoded;
+  CHECK_EQ(decodeDeviceConfig(blob.data(), blob.size(), decoded), CONFIG_OK);
+  CHECK(sameConfig(decoded, other));
+
+  // Every kind of damage is caught and leaves the output alone.
+  DeviceConfig untouched = defaults;
+  std::vector<uint8_t> bad = blob;
+  bad[20] ^= 0x40;
+  CHECK_EQ(decodeDeviceConfig(bad.data(), bad.size(), untouched), CONFIG_BAD_CRC);
+  CHECK_EQ(decodeDeviceConfig(blob.data(), blob.size() - 1, untouched), CONFIG_TRUNCATED);
+  CHECK_EQ(decodeDeviceConfig(blob.data(), 6, untouched), CONFIG_TRUNCATED);
+  bad = blob;
+  bad[0] = 'X';
+  CHECK_EQ(decodeDeviceConfig(bad.data(), bad.size(), untouched), CONFIG_BAD_MAGIC);
+  bad = blob;
+  bad[4] = CONFIG_VERSION + 1;
+  CHECK_EQ(decodeDeviceConfig(bad.data(), bad.size(), untouched), CONFIG_BAD_VERSION);
+  bad = blob;
+  bad.push_back(0);
+  CHECK_EQ(decodeDeviceConfig(bad.data(), bad.size(), untouched), CONFIG_BAD_FIELD);
+  CHECK(sameConfig(untouched, defaults));
+
+  // Values that frame fine but make no sense are refused by encode and decode.
+  DeviceConfig wrong = other;
+  wrong.devices[2].id = 20;   // fan outside its range
+  CHECK_EQ(validateDeviceConfig(wrong), CONFIG_BAD_FIELD);
+  CHECK_EQ(encodeDeviceConfig(wrong, decoded.lightPins, sizeof(decoded.lightPins)), (size_t)0);
+  wrong = other;
+  wrong.devices[1].id = 7;    // duplicate door
+  CHECK_EQ(validateDeviceConfig(wrong), CONFIG_BAD_FIELD);
+  wrong = other;
+  wrong.sensorIntervalMs = 10;
+  CHECK_EQ(validateDeviceConfig(wrong), CONFIG_BAD_FIELD);
+  wrong = other;
+  wrong.ranges[STATUS_LIGHT].idMax = 7;   // the sensor frame has 3 light channels
+  CHECK_EQ(validateDeviceConfig(wrong), CONFIG_BAD_FIELD);
+  // Pins the board does not have free.
+  wrong = other;
+  wrong.devices[3].span = 5;           // RGB past the end of the 4-pixel strip
+  CHECK_EQ(validateDeviceConfig(wrong), CONFIG_BAD_FIELD);
+  wrong.devices[3] = {STATUS_RGB, 14, 3, 1, 0};
+  CHECK_EQ(validateDeviceConfig(wrong), CONFIG_OK);
+  const uint8_t unusable[] = {0, 8, 11, 19, 26, 33, 43, 46, 49, DEVICE_NO_PIN};
+  for (uint8_t pin : unusable) {
+    wrong = other;
+    wrong.devices[2].pin = pin;        // fan on flash, USB, I2C, the strip...
+    CHECK_EQ(validateDeviceConfig(wrong), CONFIG_BAD_FIELD);
+  }
+  wrong = other;
+  wrong.devices[0].pin = wrong.lightPins[1];   // door servo on a light sensor
+  CHECK_EQ(validateDeviceConfig(wrong), CONFIG_BAD_FIELD);
+  wrong = other;
+  wrong.lightPins[0] = 12;             // not an ADC1 channel
+  CHECK_EQ(validateDeviceConfig(wrong), CONFIG_BAD_FIELD);
+  wrong = other;
+  wrong.ranges[STATUS_FAN].idMax = 256;   // IDs are one byte in the blob and topics
+  CHECK_EQ(validateDeviceConfig(wrong), CONFIG_BAD_FIELD);
+
+  // fits() agrees with build() at the edge of the topic arena.
+  TopicIdRange wide[STATUS_KIND_COUNT];
+  memcpy(wide, defaults.ranges, sizeof(wide));
+  for (int idMax = 16; idMax <= 255; idMax++) {
+    wide[STATUS_RGB].idMax = idMax;
+    TopicTable t;
+    CHECK_EQ(TopicTable::fits(kHouse, wide), t.build(kHouse, wide));
+  }
+
+  double decodeUs = 0;
+  {
+    const int rounds = 10000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) decodeDeviceConfig(blob.data(), blob.size(), decoded);
+    decodeUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+                   .count() / rounds;
+  }
+  printf("config blob: %zu bytes, decode %.2f us on the host\n", blob.size(), decodeUs);
+
+  // Boot: the sketch picks up the second house from flash.
+  sim::flash().files[CONFIG_PATH] = blob;
+  setup();
+  CHECK(strcmp(HOUSE_ID, kHouse) == 0);
+  CHECK_EQ(devices.count(), (size_t)4);
+  CHECK_EQ(alarmSlot, -1);
+  CHECK_EQ(sim::digitalLevel(7), LOW);
+  CHECK_EQ(sim::peripherals().servoAngle[17], 90);
+  CHECK(runUntilConnected());
+
+  sim::broker().clearLog();
+  std::string control = std::string("yolouno/") + kHouse + "/controls";
+  std::string message = std::string(kHouse) + ":fan:13:ON";
+  callback(&control[0], (byte*)&message[0], message.size());
+  CHECK_EQ(sim::digitalLevel(7), HIGH);
+  CHECK(lastPayload() == "ON");
+  CHECK(sim::broker().log().back().topic == std::string("yolouno/") + kHouse + "/status/fan/13");
+  message = std::string(kHouse) + ":fan:11:ON";   // not in this house
+  sim::broker().clearLog();
+  callback(&control[0], (byte*)&message[0], message.size());
+  CHECK(sim::broker().log().empty());
+
+  // Sensor topics follow the configured IDs, not the compiled-in 1-3.
+  publishSensorData(25.0f, 60.0f, 100);
+  std::string status = std::string("yolouno/") + kHouse + "/status/";
+  int tempTopics = 0, humiTopics = 0;
+  for (const auto& m : sim::broker().log()) {
+    if (m.topic.compare(0, status.size() + 5, status + "temp/") == 0) {
+      CHECK(m.topic == status + "temp/2");
+      tempTopics++;
+    }
+    if (m.topic.compare(0, status.size() + 5, status + "humi/") == 0) {
+      CHECK(m.topic == status + "humi/2");
+      humiTopics++;
+    }
+  }
+  CHECK_EQ(tempTopics, 1);
+  CHECK_EQ(humiTopics, 1);
+
+  // A bad update is reported and changes nothing on flash.
+  bad = blob;
+  bad[bad.size() - 1] ^= 1;
+  sendConfig(bad);
+  CHECK(lastPayload() == "config:bad crc");
+  CHECK(sim::flash().files[CONFIG_PATH] == blob);
+  for (int i = 0; i < 2000; i++) {
+    loop();
+    sim::advanceMs(1);
+  }
+  CHECK_EQ(sim::peripherals().restarts, 0u);
+
+  // A good one replaces the file (and leaves no temp file), then restarts once.
+  DeviceConfig next = other;
+  next.devices[3].initial = 0x00FF00;
+  std::vector<uint8_t> nextBlob = encode(next);
+  sendConfig(nextBlob);
+  CHECK(lastPayload() == "config:ok");
+  CHECK(sim::flash().files[CONFIG_PATH] == nextBlob);
+  CHECK(sim::flash().files.count(CONFIG_TMP_PATH) == 0);
+  CHECK_EQ(sim::peripherals().restarts, 0u);
+  for (int i = 0; i < 2000; i++) {
+    loop();
+    sim::advanceMs(1);
+  }
+  CHECK_EQ(sim::peripherals().restarts, 1u);
+  DeviceConfig reloaded;
+  CHECK_EQ(loadDeviceConfig(LittleFS, reloaded), CONFIG_OK);
+  CHECK(sameConfig(reloaded, next));
+  CHECK_DONE();
+}
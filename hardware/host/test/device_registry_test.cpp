@@ -0,0 +1,137 @@
+// Device table lookups and state text, then the sketch driving several
+// instances of each device type from it.
+#include <string.h>
+
+#include <string>
+
+#include "board_sim.h"
+#include "check.h"
+#include "device_registry.h"
+#include "sketch.h"
+
+static void send(const char* deviceCommand) {
+  std::string message = std::string(HOUSE_ID) + ":" + deviceCommand;
+  std::string topic = std::string("yolouno/") + HOUSE_ID + "/controls";
+  callback(&topic[0], (byte*)&message[0], message.size());
+}
+
+static int countStatus(const char* kind) {
+  std::string needle = std::string("/status/") + kind + "/";
+  int n = 0;
+  for (const sim::Message& m : sim::broker().log()) {
+    if (m.topic.find(needle) != std::string::npos) n++;
+  }
+  return n;
+}
+
+static void render() {
+  for (int i = 0; i < 30; i++) {
+    loop();
+    sim::advanceMs(1);
+  }
+}
+
+int main() {
+  static const DeviceSpec specs[] = {
+    {STATUS_DOOR, 7, 5, 1, 0},
+    {STATUS_ALARM, 1, DEVICE_NO_PIN, 1, 0},
+    {STATUS_RGB, 14, 0, 2, 0x0102FF},
+  };
+  DeviceRegistry table;
+  CHECK(table.build(specs, 3));
+  CHECK_EQ(table.count(), (size_t)3);
+  CHECK_EQ(table.find(STATUS_ALARM, 1), 1);
+  CHECK_EQ(table.find(STATUS_DOOR, 1), -1);   // same number, other kind
+  CHECK_EQ(table.find(STATUS_RGB, 14), 2);
+  CHECK_EQ(table.span(2), 2);
+  CHECK(table.unacked(0));                     // the broker has nothing yet
+
+  char text[DEVICE_STATE_TEXT_MAX];
+  CHECK_EQ(table.formatState(0, text, sizeof(text)), (size_t)6);
+  CHECK(strcmp(text, "CLOSED") == 0);
+  table.setTarget(0, 1);
+  CHECK_EQ(table.state(0), 0u);
+  table.applied(0);
+  CHECK_EQ(table.version(0), 1);
+  table.formatState(0, text, sizeof(text));
+  CHECK(strcmp(text, "OPEN") == 0);
+  table.acknowledge(0, table.version(0));
+  CHECK(!table.unacked(0));
+  table.applied(0);                            // no change, no new version
+  CHECK(!table.unacked(0));
+  table.setTarget(0, 0);
+  table.applied(0);
+  CHECK(table.unacked(0));
+  table.acknowledge(0, table.version(0));
+  table.forgetAcks();
+  CHECK(table.unacked(0));
+  table.formatState(2, text, sizeof(text));
+  CHECK(strcmp(text, "1,2,255") == 0);
+  char small[4];
+  CHECK_EQ(table.formatState(2, small, sizeof(small)), (size_t)3);
+  CHECK(strcmp(small, "1,2") == 0);
+  table.formatState(1, text, sizeof(text));
+  CHECK(strcmp(text, "OFF") == 0);
+
+  static const DeviceSpec dup[] = {{STATUS_FAN, 11, 6, 1, 0}, {STATUS_FAN, 11, 10, 1, 0}};
+  CHECK(!table.build(dup, 2));
+  CHECK_EQ(table.count(), (size_t)0);
+
+  // Sketch: each RGB ID owns its own pixels.
+  setup();
+  CHECK(runUntilConnected());
+  // No reed switches on this board (DOOR_SENSE 0): nothing watched, the doors
+  // stay as booted.
+  CHECK_EQ(inputs.pins(), (size_t)0);
+  CHECK_EQ(devices.state(devices.find(STATUS_DOOR, 7)), 0u);
+  render();
+  sim::Peripherals& p = sim::peripherals();
+  send("rgb:15:0,0,9");
+  render();
+  CHECK_EQ(p.pixel[2], 0x000009u);
+  CHECK_EQ(p.pixel[0], 0u);
+  CHECK_EQ(p.pixel[3], 0u);
+  send("rgb:14:7,0,0");
+  render();
+  CHECK_EQ(p.pixel[0], 0x070000u);
+  CHECK_EQ(p.pixel[1], 0x070000u);
+  CHECK_EQ(p.pixel[2], 0x000009u);
+
+  // Both fans, and the fourth door.
+  send("fan:12:ON");
+  CHECK_EQ(sim::digitalLevel(10), HIGH);
+  CHECK_EQ(sim::digitalLevel(6), LOW);
+  send("door:10:open");
+  CHECK_EQ(p.servoAngle[38], 90);
+  sim::broker().clearLog();
+  send("fan:13:ON");   // in the topic range but has no pin
+  CHECK_EQ(countStatus("fan"), 0);
+
+  // Reconnect to a broker that lost its retained store: every device in the
+  // table goes out again within the sync window.
+  sim::broker().setOutage(sim::nowUs(), sim::nowUs() + 1000000);
+  sim::broker().dropRetained();
+  loop();
+  CHECK(!connection.mqttUp());
+  CHECK(runUntilConnected());
+  sim::broker().clearLog();
+  for (unsigned long ms = 0; ms <= STATE_SYNC_WINDOW_MS; ms++) {
+    loop();
+    sim::advanceMs(1);
+  }
+  CHECK_EQ(countStatus("door"), 4);
+  CHECK_EQ(countStatus("fan"), 2);
+  CHECK_EQ(countStatus("rgb"), 3);
+  CHECK_EQ(countStatus("alarm"), 1);
+  bool door10 = false, fan12 = false, rgb15 = false;
+  for (const sim::Message& m : sim::broker().log()) {
+    door10 |= m.topic.find("/status/door/10") != std::string::npos && m.payload == "OPEN";
+    fan12 |= m.topic.find("/status/fan/12") != std::string::npos && m.payload == "ON";
+    rgb15 |= m.topic.find("/status/rgb/15") != std::string::npos && m.payload == "0,0,9";
+  }
+  CHECK(door10);
+  CHECK(fan12);
+  CHECK(rgb15);
+
+  CHECK_DONE();
+}
@@ -0,0 +1,104 @@
+// Framebuffer renderers against the NeoPixel/LCD stand-ins, then the sketch:
+// no blocking splash, no show() for an unchanged colour, and command handlers
+// that never touch the display bus.
+#include <string.h>
+
+#include "board_sim.h"
+#include "check.h"
+#include "display_renderer.h"
+#include "sketch.h"
+
+int main() {
+  sim::Peripherals& p = sim::peripherals();
+
+  // Pixels: one show() per change, none when nothing changed.
+  Adafruit_NeoPixel testStrip(4, 8);
+  PixelRenderer pixelsFb(testStrip, 4);
+  CHECK(!pixelsFb.flush());
+  pixelsFb.fill(0x0000FF);
+  CHECK(pixelsFb.dirty());
+  uint64_t shows = p.pixelShows;
+  CHECK(pixelsFb.flush());
+  CHECK_EQ(p.pixelShows, shows + 1);
+  CHECK_EQ(p.pixel[3], 0x0000FFu);
+  pixelsFb.fill(0x0000FF);
+  CHECK(!pixelsFb.dirty());
+  pixelsFb.set(2, 0xFF0000);
+  pixelsFb.set(2, 0x0000FF);   // changed back before the flush
+  CHECK(!pixelsFb.flush());
+  CHECK_EQ(p.pixelShows, shows + 1);
+
+  // LCD: only changed cells go out, within the byte budget.
+  LiquidCrystal_I2C testLcd(0x21, 16, 2);
+  testLcd.init();
+  LcdRenderer lcdFb(testLcd);
+  lcdFb.print(0, 0, "T:");
+  lcdFb.field(2, 0, 5, "27.5");
+  uint64_t bytes = p.lcdBytes;
+  CHECK_EQ(lcdFb.flush(100), (size_t)7);   // one cursor move + 6 cells
+  CHECK_EQ(p.lcdBytes, bytes + 7);
+  CHECK(strncmp(p.lcd[0], "T:27.5          ", 16) == 0);
+
+  lcdFb.field(2, 0, 5, "27.6");            // one digit changes
+  bytes = p.lcdBytes;
+  CHECK_EQ(lcdFb.flush(100), (size_t)2);
+  CHECK(strncmp(p.lcd[0], "T:27.6", 6) == 0);
+
+  lcdFb.field(2, 0, 5, "27.6");
+  CHECK(!lcdFb.dirty());
+  CHECK_EQ(lcdFb.flush(100), (size_t)0);
+
+  // 15 cells + 1 move, budget 8: the cursor is still in place for pass two.
+  lcdFb.print(0, 1, "Initializing...");
+  size_t total = 0, passes = 0;
+  while (lcdFb.dirty()) {
+    size_t sent = lcdFb.flush(8);
+    CHECK(sent > 0 && sent <= 8);
+    total += sent;
+    passes++;
+  }
+  CHECK_EQ(passes, (size_t)2);
+  CHECK_EQ(total, (size_t)16);
+  CHECK(strncmp(p.lcd[1], "Initializing... ", 16) == 0);
+
+  // Sketch: setup() no longer blocks on the splash screen.
+  sim::resetBoard();
+  uint64_t start = sim::nowUs();
+  setup();
+  // What is left is mostly sizing the flash spill file; it was over 2 s.
+  printf("setup(): %.1f ms\n", (sim::nowUs() - start) / 1000.0);
+  CHECK(sim::nowUs() - start < 250000);
+  CHECK(strncmp(p.lcd[0], "Smarthome System", 16) == 0);
+  CHECK(runUntilConnected());
+  sim::advanceMs(2000);
+  for (int i = 0; i < 500; i++) {
+    loop();
+    sim::advanceUs(1000);
+  }
+  CHECK(strncmp(p.lcd[0], "T:27.5  H:65.3 ", 15) == 0);
+  CHECK(strncmp(p.lcd[1], "L:", 2) == 0);
+
+  // Colour commands only touch the framebuffer; the render task shows them.
+  shows = p.pixelShows;
+  bytes = p.lcdBytes;
+  uint64_t io = sim::ioUs();
+  setRGBColor(1, 2, 3, 14);
+  CHECK_EQ(p.pixelShows, shows);
+  CHECK_EQ(p.lcdBytes, bytes);
+  CHECK_EQ(sim::ioUs(), io);
+  for (int i = 0; i < 30; i++) {
+    loop();
+    sim::advanceUs(1000);
+  }
+  CHECK_EQ(p.pixelShows, shows + 1);
+  CHECK_EQ(p.pixel[0], 0x010203u);
+
+  setRGBColor(1, 2, 3, 14);   // same colour again: status is republished, no show()
+  for (int i = 0; i < 30; i++) {
+    loop();
+    sim::advanceUs(1000);
+  }
+  CHECK_EQ(p.pixelShows, shows + 1);
+
+  CHECK_DONE();
+}
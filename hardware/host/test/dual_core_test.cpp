@@ -0,0 +1,144 @@
+// Dual-core mode, stepped deterministically: the network side (ioStep) owns
+// the MQTT client, the actuator side (loop) only touches hardware, and
+// commands and status messages cross between them in order.
+#include <string>
+#include <vector>
+
+#include "board_sim.h"
+#include "check.h"
+#include "sketch.h"
+
+static uint64_t actuatorPublishes = 0;   // publishes made from inside loop()
+
+static void step(uint64_t us = 1000) {
+  ioStep();
+  uint64_t before = sim::broker().stats().publishes;
+  loop();
+  actuatorPublishes += sim::broker().stats().publishes - before;
+  sim::advanceUs(us);
+}
+
+static void sendCommand(const char* deviceCommand) {
+  sim::UncountedHeap guard;
+  sim::broker().inject(std::string("yolouno/") + HOUSE_ID + "/controls",
+                       std::string(HOUSE_ID) + ":" + deviceCommand);
+}
+
+static bool published(size_t index, const char* suffix, const char* payload) {
+  const auto& log = sim::broker().log();
+  if (index >= log.size()) return false;
+  const std::string& topic = log[index].topic;
+  std::string s(suffix);
+  return topic.size() >= s.size() && topic.compare(topic.size() - s.size(), s.size(), s) == 0 &&
+         log[index].payload == payload;
+}
+
+int main() {
+  dualCoreMode = true;
+  setup();
+
+  // One extra FreeRTOS task for the network side, pinned to core 0.
+  CHECK_EQ(sim::rtosTasks().size(), (size_t)1);
+  CHECK(sim::rtosTasks()[0].name == "io");
+  CHECK_EQ(sim::rtosTasks()[0].core, 0);
+  CHECK(ioScheduler.find("connection") >= 0);
+  CHECK(ioScheduler.find("telemetry") >= 0);
+  CHECK_EQ(scheduler.find("connection"), -1);
+  CHECK(scheduler.find("commands") >= 0);
+
+  for (int i = 0; i < 30000 && !connection.mqttUp(); i++) step();
+  CHECK(connection.mqttUp());
+
+  // A command crosses to the actuator, its status crosses back.
+  sim::broker().clearLog();
+  sendCommand("fan:11:ON");
+  ioStep();
+  CHECK_EQ(commandQueue.size(), (size_t)1);
+  CHECK_EQ(sim::digitalLevel(6), LOW);
+  loop();
+  CHECK_EQ(sim::digitalLevel(6), HIGH);
+  CHECK(sim::broker().log().empty());
+  CHECK_EQ(telemetryQueue.size(), (size_t)1);
+  ioStep();
+  CHECK(telemetryQueue.empty());
+  CHECK_EQ(sim::broker().log().size(), (size_t)1);
+  CHECK(published(0, "/status/fan/11", "ON"));
+
+  // Order is kept across both queues.
+  sim::broker().clearLog();
+  sendCommand("rgb:14:1,2,3");
+  sendCommand("fan:12:ON");
+  sendCommand("rgb:15:4,5,6");
+  step();
+  ioStep();
+  CHECK_EQ(sim::broker().log().size(), (size_t)3);
+  CHECK(published(0, "/status/rgb/14", "1,2,3"));
+  CHECK(published(1, "/status/fan/12", "ON"));
+  CHECK(published(2, "/status/rgb/15", "4,5,6"));
+
+  // A batch is one record per item; the actuator side acks after the last.
+  sim::broker().clearLog();
+  sendCommand("cmd:d1:fan:12:OFF;rgb:16:1,1,1;fan:13:ON");
+  ioStep();
+  CHECK_EQ(commandQueue.size(), (size_t)3);
+  loop();
+  CHECK_EQ(sim::digitalLevel(10), LOW);
+  ioStep();
+  CHECK_EQ(sim::broker().log().size(), (size_t)3);
+  CHECK(published(0, "/status/fan/12", "OFF"));
+  CHECK(published(1, "/status/rgb/16", "1,1,1"));
+  CHECK(sim::broker().log()[2].topic.find("/acks") != std::string::npos);
+  CHECK(sim::broker().log()[2].payload.compare(0, 13, "d1:partial:2/") == 0);
+
+  // New rules are stored by the network side and picked up by the actuator side.
+  RuleSet set;
+  loadDefaultRules(set);
+  set.rules[2] = {0, RULE_ABOVE, 0, STATUS_FAN, 11, 0, 4000, 0, 0};   // fan 11 off above 40 °C
+  set.count = 3;
+  uint8_t blob[RULES_BLOB_MAX];
+  size_t length = encodeRuleSet(set, blob, sizeof(blob));
+  {
+    sim::UncountedHeap guard;
+    sim::broker().inject(std::string("yolouno/") + HOUSE_ID + "/rules",
+                         std::string((const char*)blob, length));
+  }
+  ioStep();
+  CHECK_EQ(rules.count(), (size_t)2);
+  for (int i = 0; i < 1000 && rules.count() != 3; i++) step();
+  CHECK_EQ(rules.count(), (size_t)3);
+
+  // Sensor samples and the alarm go out through the network side too.
+  sim::broker().clearLog();
+  sim::dht20().temperature = 55.0f;
+  for (int i = 0; i < 5000; i++) step();
+  CHECK(alarmActive());
+  CHECK_EQ(sim::digitalLevel(6), LOW);   // the pushed rule
+  bool alarmPublished = false, tempPublished = false;
+  for (size_t i = 0; i < sim::broker().log().size(); i++) {
+    alarmPublished |= published(i, "/status/alarm/1", "ON");
+    tempPublished |= published(i, "/status/temp/1", "55.00");
+  }
+  CHECK(alarmPublished);
+  CHECK(tempPublished);
+
+  CHECK_EQ(actuatorPublishes, 0u);
+  CHECK(commandQueue.empty());
+
+  // A new config is stored by the network side; the restart it asks for is
+  // scheduled on the actuator side, which owns the loop scheduler.
+  DeviceConfig next = config;
+  next.sensorIntervalMs = 3000;
+  std::vector<uint8_t> configBlob(CONFIG_BLOB_MAX);
+  configBlob.resize(encodeDeviceConfig(next, configBlob.data(), configBlob.size()));
+  CHECK(!configBlob.empty());
+  {
+    sim::UncountedHeap guard;
+    sim::broker().inject(std::string("yolouno/") + HOUSE_ID + "/config",
+                         std::string((const char*)configBlob.data(), configBlob.size()));
+  }
+  ioStep();
+  CHECK_EQ(sim::peripherals().restarts, 0u);
+  for (int i = 0; i < 1000 && sim::peripherals().restarts == 0; i++) step();
+  CHECK_EQ(sim::peripherals().restarts, 1u);
+  CHECK_DONE();
+}
@@ -0,0 +1,188 @@
+// SHA-256 against the FIPS 180-4 vectors, then firmware deltas: made on the
+// host, applied by DeltaPatcher in pieces of every size, and refused when the
+// base, the patch or the result is not what it should be.
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "delta_encoder.h"
+#include "firmware_delta.h"
+#include "sha256.h"
+
+static std::string hex(const uint8_t* data, size_t length) {
+  static const char digits[] = "0123456789abcdef";
+  std::string out;
+  for (size_t i = 0; i < length; i++) {
+    out += digits[data[i] >> 4];
+    out += digits[data[i] & 15];
+  }
+  return out;
+}
+
+static std::string sha(const std::string& text) {
+  uint8_t digest[SHA256_SIZE];
+  Sha256::hash((const uint8_t*)text.data(), text.size(), digest);
+  return hex(digest, sizeof(digest));
+}
+
+// Something shaped like an app image: magic byte, code made of a few hundred
+// recurring "instructions", then 0xFF padding up to a 4 KB boundary.
+static std::vector<uint8_t> makeImage(size_t codeBytes, uint32_t seed) {
+  std::vector<uint8_t> image(1, 0xE9);
+  uint32_t x = seed;
+  while (image.size() < codeBytes) {
+    x = x * 1103515245u + 12345u;
+    uint32_t word = (x >> 8) % 300 * 0x01000193u;
+    for (int i = 0; i < 4; i++) image.push_back((uint8_t)(word >> (8 * i)));
+  }
+  while (image.size() % 4096) image.push_back(0xFF);
+  return image;
+}
+
+struct Sink {
+  const std::vector<uint8_t>* base;
+  std::vector<uint8_t> out;
+  size_t failWriteAt = SIZE_MAX;
+};
+
+static bool readBase(void* ctx, uint32_t offset, uint8_t* out, size_t length) {
+  Sink* sink = (Sink*)ctx;
+  if (offset + length > sink->base->size()) return false;
+  memcpy(out, sink->base->data() + offset, length);
+  return true;
+}
+
+static bool writeTarget(void* ctx, const uint8_t* data, size_t length) {
+  Sink* sink = (Sink*)ctx;
+  if (sink->out.size() + length > sink->failWriteAt) return false;
+  sink->out.insert(sink->out.end(), data, data + length);
+  return true;
+}
+
+// Feeds the patch piece by piece; budget caps the output per feed() call.
+static DeltaResult apply(const std::vector<uint8_t>& base, const std::vector<uint8_t>& patch,
+                         size_t piece, size_t budget, Sink& sink) {
+  sink.base = &base;
+  sink.out.clear();
+  DeltaPatcher patcher;
+  patcher.begin(readBase, writeTarget, &sink);
+  DeltaResult result = DELTA_MORE;
+  size_t pos = 0;
+  while (result == DELTA_MORE) {
+    size_t n = patch.size() - pos < piece ? patch.size() - pos : piece;
+    uint32_t produced = patcher.targetBytes();
+    bool checked = patcher.baseChecked();
+    size_t used;
+    result = patcher.feed(patch.data() + pos, n, &used, budget);
+    pos += used;
+    // The patch ran out and nothing is left to do without it.
+    if (n == 0 && patcher.targetBytes() == produced && patcher.baseChecked() == checked) break;
+  }
+  if (result == DELTA_DONE) CHECK_EQ(patcher.patchBytes(), (uint32_t)patch.size());
+  return result;
+}
+
+int main() {
+  CHECK(sha("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  CHECK(sha("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  CHECK(sha("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+  {
+    // One million 'a' in odd-sized updates: crosses every block boundary case.
+    Sha256 s;
+    std::string chunk(997, 'a');
+    size_t left = 1000000;
+    while (left) {
+      size_t n = left < chunk.size() ? left : chunk.size();
+      s.update((const uint8_t*)chunk.data(), n);
+      left -= n;
+    }
+    uint8_t digest[SHA256_SIZE];
+    s.finish(digest);
+    CHECK(hex(digest, sizeof(digest)) ==
+          "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+  }
+
+  std::vector<uint8_t> base = makeImage(60000, 1);
+  std::vector<uint8_t> target = base;
+  // An edit, an insertion that moves everything after it, and a bigger image.
+  for (size_t i = 20000; i < 20040; i++) target[i] ^= 0x5A;
+  std::vector<uint8_t> inserted = makeImage(700, 7);
+  target.insert(target.begin() + 31000, inserted.begin() + 1, inserted.end());
+  target.resize(target.size() + 4096, 0xFF);
+
+  DeltaEncodeStats stats;
+  std::vector<uint8_t> patch = makeFirmwareDelta(base, target, &stats);
+  printf("patch: %zu bytes for a %zu byte image (%zu copies, %zu adds, %zu fills)\n",
+         patch.size(), target.size(), stats.copies, stats.adds, stats.fills);
+  CHECK(patch.size() < target.size() / 10);
+  CHECK_EQ(stats.copiedBytes + stats.literalBytes, target.size());
+  DeltaHeader header;
+  CHECK(decodeDeltaHeader(patch.data(), patch.size(), header));
+  CHECK_EQ(header.baseSize, (uint32_t)base.size());
+  CHECK_EQ(header.targetSize, (uint32_t)target.size());
+
+  // Any split of the patch, any output budget, gives the same image.
+  const size_t pieces[] = {1, 3, 80, 81, 255, 256, 960, SIZE_MAX};
+  const size_t budgets[] = {1, 100, 4096, SIZE_MAX};
+  for (size_t piece : pieces) {
+    for (size_t budget : budgets) {
+      if (piece == 1 && budget == 1) continue;   // slow, covered by the others
+      Sink sink;
+      CHECK_EQ(apply(base, patch, piece, budget, sink), DELTA_DONE);
+      CHECK(sink.out == target);
+    }
+  }
+
+  // Unrelated images and an empty base still round-trip.
+  std::vector<uint8_t> other = makeImage(9000, 99);
+  Sink sink;
+  CHECK_EQ(apply(base, makeFirmwareDelta(base, other), 512, SIZE_MAX, sink), DELTA_DONE);
+  CHECK(sink.out == other);
+  std::vector<uint8_t> empty;
+  CHECK_EQ(apply(empty, makeFirmwareDelta(empty, other), 512, SIZE_MAX, sink), DELTA_DONE);
+  CHECK(sink.out == other);
+
+  // A patch for another base is refused before anything is written.
+  std::vector<uint8_t> wrongBase = base;
+  wrongBase[100] ^= 1;
+  CHECK_EQ(apply(wrongBase, patch, 960, SIZE_MAX, sink), DELTA_BAD_BASE);
+  CHECK(sink.out.empty());
+
+  // Header damage.
+  std::vector<uint8_t> bad = patch;
+  bad[0] = 'X';
+  CHECK_EQ(apply(base, bad, 960, SIZE_MAX, sink), DELTA_BAD_HEADER);
+  bad = patch;
+  bad[4] = DELTA_VERSION + 1;
+  CHECK_EQ(apply(base, bad, 960, SIZE_MAX, sink), DELTA_BAD_HEADER);
+
+  // The image completes but is not the one promised.
+  bad = patch;
+  bad[DELTA_HEADER_SIZE - 1] ^= 0x01;
+  CHECK_EQ(apply(base, bad, 960, SIZE_MAX, sink), DELTA_BAD_HASH);
+
+  // An op past the end of the target, and bytes after the last op.
+  bad = patch;
+  bad.push_back(0x05);   // ADD of length 1
+  bad.push_back(0x00);
+  CHECK_EQ(apply(base, bad, 960, SIZE_MAX, sink), DELTA_CORRUPT);
+  bad.assign(patch.begin(), patch.begin() + DELTA_HEADER_SIZE);
+  uint64_t tooLong = (uint64_t)(target.size() + 1) << 2 | DELTA_FILL;
+  for (; tooLong >= 0x80; tooLong >>= 7) bad.push_back((uint8_t)(tooLong | 0x80));
+  bad.push_back((uint8_t)tooLong);
+  bad.push_back(0x00);
+  CHECK_EQ(apply(base, bad, 960, SIZE_MAX, sink), DELTA_CORRUPT);
+  // A copy from outside the base.
+  bad.assign(patch.begin(), patch.begin() + DELTA_HEADER_SIZE);
+  bad.push_back((uint8_t)(DELTA_COPY | 16 << 2));
+  bad.push_back(0x01);   // zigzag -1: before the start of the base
+  CHECK_EQ(apply(base, bad, 960, SIZE_MAX, sink), DELTA_CORRUPT);
+
+  // A failing flash write stops the patcher.
+  sink.failWriteAt = 1000;
+  CHECK_EQ(apply(base, patch, 960, SIZE_MAX, sink), DELTA_IO_ERROR);
+  CHECK_DONE();
+}
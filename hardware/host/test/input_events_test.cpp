@@ -0,0 +1,283 @@
+// MPSC queue semantics and a multi-threaded stress run; threshold hysteresis;
+// then the sketch with door reed switches fitted, under interrupt storms:
+// every edge captured, the device table and the broker following the doors
+// within 10 ms, overflow recovery, and modem sleep woken by an edge; and a
+// commanded door whose switch is ignored while the servo moves.
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "board_sim.h"
+#include "check.h"
+#include "mpsc_queue.h"
+#include "sketch.h"
+
+static const int kDoorPins[] = {13, 14, 15, 16};   // DOOR_SENSE_PIN_1..4, doors 7..10
+static const uint32_t kPerProducer = 200000;
+static const uint64_t kDoorSettledUs = 1200000;   // past DOOR_MOVE_MS after a command
+
+struct Tagged {
+  uint32_t producer;
+  uint32_t seq;
+};
+
+// Runs loop() for us of virtual time; a pass that does no I/O is charged 10 us.
+static void runFor(uint64_t us) {
+  uint64_t end = sim::nowUs() + us;
+  while (sim::nowUs() < end) {
+    uint64_t before = sim::nowUs();
+    loop();
+    if (sim::nowUs() == before) sim::advanceUs(10);
+  }
+}
+
+static std::string doorTopic(int doorId) {
+  return std::string("yolouno/") + HOUSE_ID + "/status/door/" + std::to_string(doorId);
+}
+
+// First publish of payload on topic at or after fromUs; UINT64_MAX if none.
+static uint64_t firstPublishUs(const std::string& topic, const char* payload, uint64_t fromUs) {
+  for (const sim::Message& m : sim::broker().log()) {
+    if (m.atUs >= fromUs && m.topic == topic && m.payload == payload) return m.atUs;
+  }
+  return UINT64_MAX;
+}
+
+static void command(const char* deviceCommand) {
+  std::string topic, message;
+  {
+    sim::UncountedHeap harness;
+    topic = std::string("yolouno/") + HOUSE_ID + "/controls";
+    message = std::string(HOUSE_ID) + ":" + deviceCommand;
+  }
+  callback(&topic[0], (byte*)&message[0], (unsigned int)message.size());
+}
+
+static bool doorsFollowPins() {
+  for (int i = 0; i < 4; i++) {
+    int slot = devices.find(STATUS_DOOR, 7 + i);
+    if (devices.state(slot) != (uint32_t)sim::digitalLevel(kDoorPins[i])) return false;
+  }
+  return true;
+}
+
+int main() {
+  // Single-threaded semantics: FIFO, capacity, full/empty, wrap-around.
+  MpscQueue<int, 4> q;
+  int v = -1;
+  CHECK(q.empty());
+  CHECK(!q.pop(v));
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < 4; i++) CHECK(q.push(round * 10 + i));
+    CHECK(!q.push(99));
+    CHECK_EQ(q.size(), (size_t)4);
+    for (int i = 0; i < 4; i++) {
+      CHECK(q.pop(v));
+      CHECK_EQ(v, round * 10 + i);
+    }
+    CHECK(!q.pop(v));
+  }
+
+  // Three producers race one consumer: nothing lost, each producer in order.
+  {
+    static MpscQueue<Tagged, 64> shared;
+    std::atomic<uint32_t> fullRetries{0};
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < 3; p++) {
+      producers.emplace_back([p, &fullRetries] {
+        for (uint32_t i = 0; i < kPerProducer; i++) {
+          while (!shared.push(Tagged{p, i})) {
+            fullRetries++;
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    uint32_t next[3] = {};
+    uint32_t outOfOrder = 0;
+    for (uint32_t received = 0; received < 3 * kPerProducer;) {
+      Tagged t;
+      if (!shared.pop(t)) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (t.producer >= 3 || t.seq != next[t.producer]) outOfOrder++;
+      if (t.producer < 3) next[t.producer] = t.seq + 1;
+      received++;
+    }
+    for (std::thread& t : producers) t.join();
+    printf("mpsc: %u records from 3 producers, %u full retries\n", 3 * kPerProducer,
+           (unsigned)fullRetries.load());
+    CHECK_EQ(outOfOrder, 0u);
+    CHECK(shared.empty());
+  }
+
+  // Threshold hysteresis: rises at >= above, falls at <= below, once each.
+  static InputCapture local;
+  local.begin(nullptr);
+  int ch = local.watchThreshold(1800, 2200);
+  CHECK_EQ(ch, 0);
+  CHECK_EQ(local.watchThreshold(2200, 2200), -1);
+  InputEvent e;
+  local.sampleThreshold(ch, 500);    // seeds: below
+  local.sampleThreshold(ch, 2199);
+  CHECK(!local.pop(e));
+  local.sampleThreshold(ch, 2200);
+  CHECK(local.pop(e));
+  CHECK(e.source == INPUT_THRESHOLD && e.channel == 0 && e.level == 1);
+  local.sampleThreshold(ch, 1900);
+  local.sampleThreshold(ch, 2500);
+  CHECK(!local.pop(e));
+  local.sampleThreshold(ch, 1800);
+  CHECK(local.pop(e));
+  CHECK_EQ(e.level, 0);
+
+  // Switches fitted and every door shut. Unwired, a pulled-up input reads open.
+  CHECK_EQ(sim::digitalLevel(kDoorPins[0]), LOW);
+  pinMode(kDoorPins[0], INPUT_PULLUP);
+  CHECK_EQ(sim::digitalLevel(kDoorPins[0]), HIGH);
+  for (int pin : kDoorPins) sim::setDigital(pin, LOW);
+  doorSense = 1;
+  setup();
+  CHECK(runUntilConnected());
+  runFor(10000000);   // past the state sync after connecting
+  CHECK_EQ(inputs.pins(), (size_t)4);
+  CHECK(doorsFollowPins());
+
+  // Storm: bursts of 1-15 bouncing edges on random doors every 20-60 ms,
+  // edges 20-200 us apart, while the sensors, LCD and MQTT keep running.
+  struct Burst {
+    int door;
+    uint64_t firstUs;
+    int final;
+  };
+  std::vector<Burst> bursts;
+  uint32_t edges = 0;
+  int level[4] = {};
+  uint64_t at = sim::nowUs() + 10000;
+  for (int b = 0; b < 300; b++) {
+    int door = (int)random(4);
+    int bounces = 1 + 2 * (int)random(8);
+    bursts.push_back({door, at, !level[door]});
+    uint64_t edgeAt = at;
+    for (int i = 0; i < bounces; i++) {
+      level[door] = !level[door];
+      sim::scheduleDigital(kDoorPins[door], level[door], edgeAt);
+      edgeAt += 20 + random(181);
+      edges++;
+    }
+    at += 20000 + random(40001);
+  }
+  uint32_t captured0 = inputs.captured();
+  sim::broker().clearLog();
+  runFor(at - sim::nowUs() + 20000);
+  printf("storm: %u edges in %zu bursts, %u captured, %u overflows\n", (unsigned)edges,
+         bursts.size(), (unsigned)(inputs.captured() - captured0), (unsigned)inputs.overflows());
+  CHECK_EQ(inputs.captured() - captured0, edges);
+  CHECK_EQ(inputs.overflows(), 0u);
+  CHECK(doorsFollowPins());
+
+  uint64_t worst = 0;
+  int late = 0;
+  for (const Burst& b : bursts) {
+    uint64_t published = firstPublishUs(doorTopic(7 + b.door), b.final ? "OPEN" : "CLOSED",
+                                        b.firstUs);
+    if (published == UINT64_MAX) {
+      late++;
+      continue;
+    }
+    worst = std::max(worst, published - b.firstUs);
+    if (published - b.firstUs > 10000) late++;
+  }
+  printf("door edge -> status publish: max %.2f ms\n", worst / 1000.0);
+  CHECK_EQ(late, 0);
+  CHECK(worst <= 10000);
+
+  // More edges than the queue holds inside one blocking call: the overflow
+  // is counted and the door still ends in the pin's final state.
+  captured0 = inputs.captured();
+  uint64_t start = sim::nowUs() + 100;
+  int finalLevel = sim::digitalLevel(kDoorPins[0]);
+  for (int i = 0; i < 501; i++) {
+    finalLevel = !finalLevel;
+    sim::scheduleDigital(kDoorPins[0], finalLevel, start + i * 2);
+  }
+  sim::advanceUs(2000);
+  runFor(1000);
+  CHECK_EQ(inputs.captured() - captured0 + inputs.overflows(), 501u);
+  CHECK(inputs.overflows() > 0);
+  CHECK(doorsFollowPins());
+
+  // Modem sleep: loop() waits up to its 100 ms latency bound, and an edge
+  // ends the wait at once.
+  power.begin(POWER_MODEM_SLEEP, 100);
+  runFor(1000000);
+  sim::broker().clearLog();
+  worst = 0;
+  for (int i = 0; i < 20; i++) {
+    int slot = devices.find(STATUS_DOOR, 8);
+    uint32_t want = !devices.state(slot);
+    uint64_t edgeAt = sim::nowUs() + 1000 + random(2000000);
+    sim::scheduleDigital(kDoorPins[1], (int)want, edgeAt);
+    while (devices.state(slot) != want && sim::nowUs() < edgeAt + 1000000) runFor(10);
+    uint64_t published = firstPublishUs(doorTopic(8), want ? "OPEN" : "CLOSED", edgeAt);
+    CHECK(published != UINT64_MAX);
+    worst = std::max(worst, published - edgeAt);
+  }
+  printf("door edge -> status publish in modem sleep: max %.2f ms\n", worst / 1000.0);
+  CHECK(worst < 10000);
+  CHECK(power.stats().eventWakes >= 20);
+  power.begin(POWER_ALWAYS_ON, 100);
+
+  // Opened by command: the switch still reads shut, then bounces as the door
+  // swings, and a resync (as after light sleep) reads it mid-way. None of it
+  // counts until the servo is done; then the door is read again.
+  int door7 = devices.find(STATUS_DOOR, 7);
+  sim::setDigital(kDoorPins[0], LOW);
+  runFor(kDoorSettledUs);
+  CHECK_EQ(devices.state(door7), 0u);
+  sim::broker().clearLog();
+  uint64_t commandUs = sim::nowUs();
+  command("door:7:open");
+  CHECK_EQ(devices.state(door7), 1u);
+  sim::scheduleDigital(kDoorPins[0], HIGH, commandUs + 300000);
+  sim::scheduleDigital(kDoorPins[0], LOW, commandUs + 300100);
+  sim::scheduleDigital(kDoorPins[0], HIGH, commandUs + 400000);
+  runFor(200000);
+  inputs.resync();
+  runFor(kDoorSettledUs);
+  CHECK_EQ(devices.state(door7), 1u);
+  CHECK_EQ(firstPublishUs(doorTopic(7), "CLOSED", commandUs), UINT64_MAX);
+  // Closed by command while someone holds it open: once the servo is done
+  // the switch wins, and the door is reported open.
+  commandUs = sim::nowUs();
+  command("door:7:close");
+  CHECK_EQ(devices.state(door7), 0u);
+  runFor(500000);
+  CHECK_EQ(devices.state(door7), 0u);
+  runFor(kDoorSettledUs);
+  CHECK_EQ(devices.state(door7), 1u);
+  CHECK(firstPublishUs(doorTopic(7), "OPEN", commandUs) != UINT64_MAX);
+
+  // A light level crossing its band is published without waiting for the
+  // report cycle.
+  sim::broker().clearLog();
+  uint64_t brightAt = sim::nowUs();
+  sim::setAnalog(2, 3000);   // luxPin1, light 4
+  std::string lightTopic = std::string("yolouno/") + HOUSE_ID + "/status/light/4";
+  uint64_t seen = UINT64_MAX;
+  for (int i = 0; i < 100 && seen == UINT64_MAX; i++) {
+    runFor(10000);
+    for (const sim::Message& m : sim::broker().log()) {
+      if (m.topic == lightTopic && atoi(m.payload.c_str()) >= 2200) seen = m.atUs;
+    }
+  }
+  CHECK(seen != UINT64_MAX);
+  printf("light crossing -> publish: %.1f ms\n", (seen - brightAt) / 1000.0);
+  CHECK(seen - brightAt < 400000);
+  CHECK_DONE();
+}
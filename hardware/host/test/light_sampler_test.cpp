@@ -0,0 +1,107 @@
+// Light sampling pipeline on synthetic ADC noise: variance of the published
+// value vs a single analogRead(), step response, and cost per sample.
+#include <math.h>
+
+#include <chrono>
+
+#include "board_sim.h"
+#include "check.h"
+#include "light_sampler.h"
+
+static uint32_t rng = 12345;
+
+static double uniform() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return (rng + 0.5) / 4294967296.0;
+}
+
+// ESP32-like ADC noise: gaussian (sigma counts) plus rare large spikes.
+static int noisy(int level, double sigma) {
+  double g = sqrt(-2.0 * log(uniform())) * cos(2.0 * M_PI * uniform());
+  int v = level + (int)lround(g * sigma);
+  if (uniform() < 0.01) v += uniform() < 0.5 ? 400 : -400;
+  return v < 0 ? 0 : v > 4095 ? 4095 : v;
+}
+
+struct Stats {
+  double sum = 0, sumSq = 0;
+  int n = 0;
+  void add(double v) {
+    sum += v;
+    sumSq += v * v;
+    n++;
+  }
+  double mean() const { return sum / n; }
+  double variance() const { return sumSq / n - mean() * mean(); }
+};
+
+int main() {
+  // Burst reduction: the middle half survives, outliers do not.
+  uint16_t burst[LIGHT_OVERSAMPLE] = {100, 4095, 102, 98, 0, 101, 99, 100};
+  CHECK_EQ(LightSampler::reduceBurst(burst), 100);
+
+  const int level[LIGHT_SAMPLER_CHANNELS] = {2000, 800, 3300};
+  sim::setAnalogSource([&level](int pin, uint64_t) { return noisy(level[pin - 2], 30.0); });
+
+  const uint8_t pins[LIGHT_SAMPLER_CHANNELS] = {2, 3, 4};
+  static LightSampler sampler(pins);
+  sampler.begin();
+
+  Stats raw, filtered;
+  for (int i = 0; i < 20000; i++) raw.add(sim::analogValue(2));
+
+  const int bursts = 5000;
+  uint64_t reads0 = sim::analogReads();
+  uint64_t burstUs = 0;
+  double hostNs = 0;
+  for (int i = 0; i < bursts; i++) {
+    sim::advanceMs(LIGHT_SAMPLE_INTERVAL_MS);
+    uint64_t before = sim::nowUs();
+    auto t0 = std::chrono::steady_clock::now();
+    CHECK(sampler.service());
+    hostNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    burstUs += sim::nowUs() - before;
+    if (i >= 50) filtered.add(sampler.snapshot().value[0]);
+  }
+  uint64_t reads = sim::analogReads() - reads0;
+  CHECK_EQ(reads, (uint64_t)bursts * LIGHT_SAMPLER_CHANNELS * LIGHT_OVERSAMPLE);
+  CHECK(!sampler.service());  // not due again until the interval passes
+
+  double reduction = raw.variance() / filtered.variance();
+  printf("raw analogRead:   mean %.1f  variance %.1f\n", raw.mean(), raw.variance());
+  printf("filtered value:   mean %.1f  variance %.1f  (%.0fx lower)\n", filtered.mean(),
+         filtered.variance(), reduction);
+  CHECK(reduction > 20.0);
+  CHECK(fabs(filtered.mean() - level[0]) < 3.0);
+  CHECK(abs((int)sampler.snapshot().value[1] - level[1]) < 20);
+  CHECK(abs((int)sampler.snapshot().value[2] - level[2]) < 20);
+
+  // Step response: a light switched on is tracked within a few bursts.
+  static LightSampler step(pins);
+  sim::setAnalogSource([](int, uint64_t) { return noisy(500, 30.0); });
+  step.begin();
+  for (int i = 0; i < 20; i++) {
+    sim::advanceMs(LIGHT_SAMPLE_INTERVAL_MS);
+    step.service();
+  }
+  sim::setAnalogSource([](int, uint64_t) { return noisy(2500, 30.0); });
+  int settled = -1;
+  for (int i = 1; i <= 50 && settled < 0; i++) {
+    sim::advanceMs(LIGHT_SAMPLE_INTERVAL_MS);
+    step.service();
+    if (abs((int)step.snapshot().value[0] - 2500) < 80) settled = i;
+  }
+  printf("step 500 -> 2500: within 80 counts after %d bursts (%d ms)\n", settled,
+         settled * LIGHT_SAMPLE_INTERVAL_MS);
+  CHECK(settled > 0 && settled <= 8);
+
+  double perSample = (double)bursts * LIGHT_SAMPLER_CHANNELS;
+  printf("cost per filtered sample: %.0f host ns (incl. simulated ADC), %.1f virtual us of ADC reads; "
+         "a burst blocks %.0f us every %d ms (%.2f%%)\n",
+         hostNs / perSample, burstUs / perSample, (double)burstUs / bursts,
+         LIGHT_SAMPLE_INTERVAL_MS, 100.0 * burstUs / bursts / (LIGHT_SAMPLE_INTERVAL_MS * 1000.0));
+
+  CHECK_DONE();
+}
@@ -0,0 +1,104 @@
+// Histogram buckets and windows, the report layout and its worst case, and the
+// sketch's periodic report on yolouno/<house>/diagnostics.
+#include <string.h>
+
+#include <string>
+
+#include "board_sim.h"
+#include "check.h"
+#include "metrics.h"
+#include "sketch.h"
+
+static bool contains(const std::string& text, const std::string& part) {
+  return text.find(part) != std::string::npos;
+}
+
+int main() {
+  // Bucket i holds [32 << (i - 1), 32 << i) us; the last one everything above.
+  CHECK_EQ(MetricHistogram::bucketOf(0), 0);
+  CHECK_EQ(MetricHistogram::bucketOf(31), 0);
+  CHECK_EQ(MetricHistogram::bucketOf(32), 1);
+  CHECK_EQ(MetricHistogram::bucketOf(63), 1);
+  CHECK_EQ(MetricHistogram::bucketOf(64), 2);
+  CHECK_EQ(MetricHistogram::bucketOf(32767), 10);
+  CHECK_EQ(MetricHistogram::bucketOf(32768), 11);
+  CHECK_EQ(MetricHistogram::bucketOf(UINT32_MAX), METRIC_BUCKETS - 1);
+
+  static MetricHistogram histogram;
+  histogram.record(5);
+  histogram.record(40);
+  histogram.record(41);
+  histogram.record(1000000);
+  CHECK_EQ(histogram.count(), 4u);
+  CHECK_EQ(histogram.bucket(0), 1u);
+  CHECK_EQ(histogram.bucket(1), 2u);
+  CHECK_EQ(histogram.bucket(11), 1u);
+  CHECK_EQ(histogram.takeMax(), 1000000u);
+  CHECK_EQ(histogram.max(), 0u);   // a new window; counts carry on
+  histogram.record(7);
+  CHECK_EQ(histogram.takeMax(), 7u);
+  CHECK_EQ(histogram.count(), 5u);
+
+  // Counts are cumulative, max is per report, publishes are counted either way.
+  static Metrics local;
+  local.recordLoop(10);
+  local.recordLoop(100);
+  local.recordCommand(2000);
+  CHECK(local.countPublish(true));
+  CHECK(!local.countPublish(false));
+  CHECK(local.watchStack(xTaskGetCurrentTaskHandle()));
+  sim::setStackHighWater(nullptr, 3072);
+  static MetricsText text;
+  MetricsInputs in = {123456, 2, 1, 10, 3};
+  uint32_t freeHeap = ESP.getFreeHeap();
+  std::string report = local.report(text, in);
+  CHECK(text.ok());
+  CHECK(report ==
+        "{\"up\":123456,\"loop\":[100,1,0,1,0,0,0,0,0,0,0,0,0],"
+        "\"cmd\":[2000,0,0,0,0,0,0,1,0,0,0,0,0],\"pub\":[11,4],\"rc\":2,\"drop\":1,"
+        "\"heap\":[" + std::to_string(freeHeap) + "," + std::to_string(freeHeap) + "," +
+            std::to_string(freeHeap) + "],\"stk\":[3072]}");
+  report = local.report(text, in);
+  CHECK(contains(report, "\"loop\":[0,1,0,1,"));
+
+  // Every field at its widest still fits.
+  static Metrics full;
+  for (int i = 0; i < METRIC_TASKS; i++) full.watchStack(xTaskGetCurrentTaskHandle());
+  CHECK(!full.watchStack(xTaskGetCurrentTaskHandle()));
+  sim::setStackHighWater(nullptr, UINT32_MAX);
+  for (uint8_t b = 0; b < METRIC_BUCKETS; b++) {
+    uint32_t us = b == 0 ? 0 : 32u << (b - 1);
+    for (int i = 0; i < 3; i++) full.recordLoop(us);
+  }
+  full.recordLoop(UINT32_MAX);
+  MetricsInputs widest = {UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX};
+  full.report(text, widest);
+  CHECK(text.ok());
+  CHECK(text.length() <= METRICS_REPORT_MAX);
+
+  // The sketch reports once per METRICS_INTERVAL_MS while connected.
+  sim::setStackHighWater(nullptr, 4000);
+  setup();
+  CHECK(runUntilConnected());
+  uint32_t commands = metrics.commandLatency().count();
+  sim::broker().clearLog();
+  CHECK(commandLatencyUs("fan:11:ON", [] { return sim::digitalLevel(6) == HIGH; }) != UINT64_MAX);
+  CHECK_EQ(metrics.commandLatency().count(), commands + 1);
+  std::string topic = std::string("yolouno/") + HOUSE_ID + "/diagnostics";
+  std::string diagnostics;
+  for (int i = 0; i < 70000 && diagnostics.empty(); i++) {
+    loop();
+    sim::advanceUs(1000);
+    for (const auto& m : sim::broker().log()) {
+      if (m.topic == topic) diagnostics = m.payload;
+    }
+  }
+  CHECK(!diagnostics.empty());
+  CHECK(diagnostics.front() == '{' && diagnostics.back() == '}');
+  CHECK(contains(diagnostics, "\"rc\":1,"));
+  CHECK(contains(diagnostics, "\"stk\":[4000]}"));   // no network task in one-core mode
+  CHECK(metrics.loopTime().count() > 1000);
+  CHECK(metrics.publishOk() > 0);
+  CHECK_EQ(metrics.publishFailed(), 0u);
+  CHECK_DONE();
+}
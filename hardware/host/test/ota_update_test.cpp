@@ -0,0 +1,256 @@
+// Delta OTA on the simulated app slots: updates streamed chunk by chunk, the
+// trial of the new image (confirmed, or rolled back by the firmware or by the
+// bootloader), refused patches; then the sketch taking one over MQTT.
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "board_sim.h"
+#include "check.h"
+#include "delta_encoder.h"
+#include "ota_update.h"
+#include "sketch.h"
+
+static const uint64_t kStepBudgetUs = 100000;   // longest a step() may block the loop
+
+static std::vector<uint8_t> makeImage(size_t codeBytes, uint32_t seed) {
+  std::vector<uint8_t> image(1, 0xE9);
+  uint32_t x = seed;
+  while (image.size() < codeBytes) {
+    x = x * 1103515245u + 12345u;
+    uint32_t word = (x >> 8) % 300 * 0x01000193u;
+    for (int i = 0; i < 4; i++) image.push_back((uint8_t)(word >> (8 * i)));
+  }
+  while (image.size() % 4096) image.push_back(0xFF);
+  return image;
+}
+
+// A new build: some code changed, some added in the middle.
+static std::vector<uint8_t> nextBuild(const std::vector<uint8_t>& image, uint32_t seed) {
+  std::vector<uint8_t> next = image;
+  for (size_t i = 5000 + seed * 100; i < 5200 + seed * 100; i++) next[i] ^= 0x21;
+  std::vector<uint8_t> added = makeImage(3000, seed);
+  next.insert(next.begin() + 90000, added.begin() + 1, added.end());
+  return next;
+}
+
+static std::string chunk(const std::vector<uint8_t>& patch, uint32_t offset, size_t size) {
+  std::string message(OTA_CHUNK_HEADER, '\0');
+  for (int i = 0; i < 4; i++) message[i] = (char)(offset >> (8 * i));
+  if (offset < patch.size()) {
+    size_t n = patch.size() - offset < size ? patch.size() - offset : size;
+    message.append((const char*)patch.data() + offset, n);
+  }
+  return message;
+}
+
+struct Transfer {
+  OtaEvent event = OTA_NONE;
+  uint32_t messages = 0;
+  uint32_t steps = 0;
+  uint64_t longestStepUs = 0;
+};
+
+// The sender's side of the protocol, talking to the updater directly.
+static Transfer send(OtaUpdater& updater, const std::vector<uint8_t>& patch,
+                     size_t size = OTA_CHUNK_MAX) {
+  Transfer t;
+  uint32_t offset = 0;
+  for (;;) {
+    OtaEvent event = OTA_NONE;
+    if (offset < patch.size()) {
+      std::string message = chunk(patch, offset, size);
+      t.messages++;
+      event = updater.receive((const uint8_t*)message.data(), message.size());
+    }
+    // Step until the updater answers: the next offset, or the end.
+    while (event == OTA_NONE && updater.pending()) {
+      uint64_t start = sim::nowUs();
+      event = updater.step();
+      t.steps++;
+      if (sim::nowUs() - start > t.longestStepUs) t.longestStepUs = sim::nowUs() - start;
+    }
+    if (event != OTA_NEXT) {
+      t.event = event;
+      return t;
+    }
+    offset = updater.nextOffset();
+  }
+}
+
+static std::string lastStatus() {
+  std::string topic = std::string("yolouno/") + HOUSE_ID + "/status/device";
+  const auto& log = sim::broker().log();
+  for (size_t i = log.size(); i-- > 0;) {
+    if (log[i].topic == topic && log[i].payload.compare(0, 4, "ota:") == 0) return log[i].payload;
+  }
+  return std::string();
+}
+
+int main() {
+  sim::OtaState& slots = sim::ota();
+  std::vector<uint8_t> base = makeImage(400000, 1);
+  slots.image[0] = base;
+
+  // A first update goes to slot 1 and boots next; the running slot is untouched.
+  std::vector<uint8_t> v2 = nextBuild(base, 2);
+  std::vector<uint8_t> patch = makeFirmwareDelta(base, v2);
+  OtaUpdater updater;
+  updater.begin(millis());
+  CHECK(!updater.onTrial());
+  CHECK(!updater.rolledBack());
+  Transfer t = send(updater, patch);
+  CHECK_EQ(t.event, OTA_APPLIED);
+  CHECK_EQ(t.messages, (uint32_t)((patch.size() + OTA_CHUNK_MAX - 1) / OTA_CHUNK_MAX));
+  CHECK(slots.image[1] == v2);
+  CHECK(slots.image[0] == base);
+  CHECK_EQ(slots.boot, 1);
+  CHECK_EQ(slots.state[1], ESP_OTA_IMG_NEW);
+  CHECK(t.longestStepUs <= kStepBudgetUs);
+  printf("update: %zu byte patch for a %zu byte image, %u messages, %u steps, "
+         "longest step %.1f ms, %u sector erases\n",
+         patch.size(), v2.size(), t.messages, t.steps, t.longestStepUs / 1000.0,
+         slots.sectorErases);
+
+  // Booted on trial, confirmed once healthy.
+  CHECK_EQ(sim::rebootOta(), 1);
+  CHECK_EQ(slots.state[1], ESP_OTA_IMG_PENDING_VERIFY);
+  OtaUpdater trial;
+  trial.begin(1000);
+  CHECK(trial.onTrial());
+  CHECK_EQ(trial.checkTrial(false, 1000 + OTA_TRIAL_MS - 1), OTA_NONE);
+  CHECK_EQ(trial.checkTrial(true, 1000 + OTA_TRIAL_MS - 1), OTA_CONFIRMED);
+  CHECK_EQ(slots.state[1], ESP_OTA_IMG_VALID);
+  CHECK(!trial.onTrial());
+  CHECK_EQ(trial.checkTrial(false, 10 * OTA_TRIAL_MS), OTA_NONE);
+
+  // Chunks out of order: a repeat or a gap is answered with the offset needed.
+  std::vector<uint8_t> v3 = nextBuild(v2, 3);
+  patch = makeFirmwareDelta(v2, v3);
+  std::string message = chunk(patch, 0, OTA_CHUNK_MAX);
+  CHECK_EQ(trial.receive((const uint8_t*)message.data(), message.size()), OTA_NONE);
+  OtaEvent event;
+  do event = trial.step(); while (event == OTA_NONE);
+  CHECK_EQ(event, OTA_NEXT);
+  CHECK_EQ(trial.nextOffset(), (uint32_t)OTA_CHUNK_MAX);
+  message = chunk(patch, 3 * OTA_CHUNK_MAX, OTA_CHUNK_MAX);
+  CHECK_EQ(trial.receive((const uint8_t*)message.data(), message.size()), OTA_NEXT);
+  CHECK_EQ(trial.nextOffset(), (uint32_t)OTA_CHUNK_MAX);
+  // Bigger messages than a chunk: the rest is asked for again.
+  message = chunk(patch, OTA_CHUNK_MAX, 2 * OTA_CHUNK_MAX);
+  CHECK_EQ(trial.receive((const uint8_t*)message.data(), message.size()), OTA_NONE);
+  CHECK_EQ(trial.nextOffset(), (uint32_t)(2 * OTA_CHUNK_MAX));
+
+  while (trial.pending()) trial.step();
+
+  // An update that never gets healthy rolls itself back.
+  t = send(trial, patch, 500);
+  CHECK_EQ(t.event, OTA_APPLIED);
+  CHECK(slots.image[0] == v3);
+  CHECK_EQ(sim::rebootOta(), 0);
+  uint32_t restarts = sim::peripherals().restarts;
+  OtaUpdater failing;
+  failing.begin(0);
+  CHECK(failing.onTrial());
+  CHECK_EQ(failing.checkTrial(false, OTA_TRIAL_MS), OTA_ROLLBACK);
+  CHECK_EQ(slots.state[0], ESP_OTA_IMG_INVALID);
+  CHECK_EQ(sim::peripherals().restarts, restarts + 1);
+  CHECK_EQ(sim::rebootOta(), 1);
+  OtaUpdater back;
+  back.begin(0);
+  CHECK(!back.onTrial());
+  CHECK(back.rolledBack());
+
+  // One that crashes before its trial ends is rolled back by the bootloader.
+  CHECK_EQ(send(back, patch).event, OTA_APPLIED);
+  CHECK_EQ(sim::rebootOta(), 0);
+  CHECK_EQ(slots.state[0], ESP_OTA_IMG_PENDING_VERIFY);
+  CHECK_EQ(sim::rebootOta(), 1);
+  CHECK_EQ(slots.state[0], ESP_OTA_IMG_ABORTED);
+  CHECK(slots.image[1] == v2);
+
+  // Refused: a patch for another image, a damaged one, a result that is not
+  // an app image. None of them changes the boot slot.
+  OtaUpdater refuse;
+  refuse.begin(0);
+  CHECK_EQ(send(refuse, makeFirmwareDelta(base, v3)).event, OTA_FAILED);
+  CHECK(strcmp(refuse.error(), "bad base") == 0);
+  std::vector<uint8_t> damaged = patch;
+  damaged[DELTA_HEADER_SIZE - 1] ^= 1;   // target hash
+  CHECK_EQ(send(refuse, damaged).event, OTA_FAILED);
+  CHECK(strcmp(refuse.error(), "bad hash") == 0);
+  std::vector<uint8_t> notAnImage = v3;
+  notAnImage[0] = 0;
+  CHECK_EQ(send(refuse, makeFirmwareDelta(v2, notAnImage)).event, OTA_FAILED);
+  CHECK(strcmp(refuse.error(), "image") == 0);
+  CHECK_EQ(slots.boot, 1);
+  CHECK(!refuse.updating());
+  // Chunks after a failure, until the next offset 0, are ignored.
+  message = chunk(patch, OTA_CHUNK_MAX, OTA_CHUNK_MAX);
+  CHECK_EQ(refuse.receive((const uint8_t*)message.data(), message.size()), OTA_NONE);
+
+  // The sketch: chunks arrive on yolouno/<house>/ota, answers go to
+  // status/device, and the applied image is booted after a restart. Patches
+  // are unsigned, so this takes both opt-ins: OTA over MQTT, and TLS.
+  sim::resetBoard();
+  sim::ota().image[0] = base;
+  static const char kCa[] = "-----BEGIN CERTIFICATE-----\nMIIBota\n-----END CERTIFICATE-----\n";
+  sim::flash().files[TLS_CA_PATH] = std::vector<uint8_t>(kCa, kCa + sizeof(kCa) - 1);
+  mqttTls = 1;
+  otaMqtt = 1;
+  setup();
+  CHECK(runUntilConnected());
+  CHECK(!ota.onTrial());
+  patch = makeFirmwareDelta(base, v2);
+  std::string topic = std::string("yolouno/") + HOUSE_ID + "/ota";
+  // Without either, a chunk on the topic is ignored.
+  std::string first = chunk(patch, 0, OTA_CHUNK_MAX);
+  auto ignored = [&]() {
+    sim::broker().clearLog();
+    callback(&topic[0], (byte*)&first[0], (unsigned int)first.size());
+    for (int i = 0; i < 100; i++) {
+      loop();
+      sim::advanceUs(100);
+    }
+    return lastStatus().empty() && !ota.updating();
+  };
+  otaMqtt = 0;
+  CHECK(ignored());
+  otaMqtt = 1;
+  mqttTls = 0;
+  CHECK(ignored());
+  mqttTls = 1;
+  uint32_t offset = 0;
+  std::string reply;
+  uint64_t longestLoopUs = 0;
+  for (int messages = 0; messages < 1000; messages++) {
+    sim::broker().clearLog();
+    if (offset < patch.size()) {
+      sim::UncountedHeap guard;
+      sim::broker().inject(topic, chunk(patch, offset, OTA_CHUNK_MAX), false, sim::nowUs());
+    }
+    reply.clear();
+    for (int pass = 0; pass < 10000 && reply.empty(); pass++) {
+      uint64_t start = sim::nowUs();
+      loop();
+      if (sim::nowUs() - start > longestLoopUs) longestLoopUs = sim::nowUs() - start;
+      sim::advanceUs(100);
+      reply = lastStatus();
+    }
+    if (reply.compare(0, 9, "ota:next:") != 0) break;
+    offset = (uint32_t)strtoul(reply.c_str() + 9, nullptr, 10);
+  }
+  CHECK(reply == "ota:applied");
+  CHECK(sim::ota().image[1] == v2);
+  CHECK_EQ(sim::ota().boot, 1);
+  CHECK_EQ(sim::peripherals().restarts, 0u);
+  for (int i = 0; i < 1000; i++) {
+    loop();
+    sim::advanceMs(1);
+  }
+  CHECK_EQ(sim::peripherals().restarts, 1u);
+  printf("sketch: longest loop() pass during the update %.1f ms\n", longestLoopUs / 1000.0);
+  CHECK(longestLoopUs <= kStepBudgetUs);
+  CHECK_DONE();
+}
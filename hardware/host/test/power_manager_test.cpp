@@ -0,0 +1,85 @@
+// Sleep planning, and the sketch in light-sleep mode: time awake between
+// scheduled work, command latency with WiFi wakeups, and GPIO wakeups.
+#include <algorithm>
+#include <vector>
+
+#include "board_sim.h"
+#include "check.h"
+#include "sketch.h"
+
+static const int kWakePin = 9;
+
+// Runs loop() for ms of virtual time. loop() sleeps on its own; a pass that
+// neither sleeps nor does I/O is charged as 10 us of spinning.
+static void runFor(uint64_t ms) {
+  uint64_t end = sim::nowUs() + ms * 1000ULL;
+  while (sim::nowUs() < end) {
+    uint64_t before = sim::nowUs();
+    loop();
+    if (sim::nowUs() == before) sim::advanceUs(10);
+  }
+}
+
+int main() {
+  uint32_t ms = 0;
+  CHECK_EQ(PowerManager::plan(POWER_ALWAYS_ON, 500, 100, &ms), SLEEP_NONE);
+  CHECK_EQ(PowerManager::plan(POWER_LIGHT_SLEEP, 0, 100, &ms), SLEEP_NONE);
+  CHECK_EQ(PowerManager::plan(POWER_LIGHT_SLEEP, 3, 100, &ms), SLEEP_IDLE);
+  CHECK_EQ(ms, 3u);
+  CHECK_EQ(PowerManager::plan(POWER_LIGHT_SLEEP, 40, 100, &ms), SLEEP_LIGHT);
+  CHECK_EQ(ms, 40u);
+  CHECK_EQ(PowerManager::plan(POWER_LIGHT_SLEEP, UINT32_MAX, 100, &ms), SLEEP_LIGHT);
+  CHECK_EQ(ms, 100u);   // the latency bound caps every sleep
+  CHECK_EQ(PowerManager::plan(POWER_MODEM_SLEEP, 40, 100, &ms), SLEEP_IDLE);
+  CHECK_EQ(ms, 40u);
+
+  powerMode = POWER_LIGHT_SLEEP;
+  powerWakePin = kWakePin;
+  sim::setDigital(kWakePin, HIGH);
+  setup();
+  CHECK(runUntilConnected());
+  runFor(10000);   // past the state sync after connecting
+
+  // Between sensor cycles the node is mostly asleep, and still samples.
+  uint64_t start = sim::nowUs();
+  uint64_t slept = sim::power().lightSleepUs;
+  uint64_t reads = sim::dht20().reads;
+  runFor(60000);
+  double awake = 1.0 - (double)(sim::power().lightSleepUs - slept) / (sim::nowUs() - start);
+  printf("light sleep: %.1f%% awake over 60 s\n", awake * 100.0);
+  CHECK(awake < 0.10);
+  CHECK(sim::dht20().reads - reads >= 29);
+  CHECK(power.stats().timerWakes > 0);
+
+  // A command wakes the node through WiFi instead of waiting out the sleep.
+  std::vector<uint64_t> latencies;
+  bool on = false;
+  for (int i = 0; i < 100; i++) {
+    on = !on;
+    uint64_t us = commandLatencyUs(on ? "fan:11:ON" : "fan:11:OFF",
+                                   [on] { return sim::digitalLevel(6) == (on ? HIGH : LOW); },
+                                   (uint64_t)random(2000000), 10);
+    CHECK(us != UINT64_MAX);
+    latencies.push_back(us);
+  }
+  uint64_t worst = *std::max_element(latencies.begin(), latencies.end());
+  printf("fan command -> pin in light sleep: max %.2f ms\n", worst / 1000.0);
+  CHECK(worst < 5000);
+  CHECK(power.stats().wifiWakes >= 100);
+
+  // The strip is still redrawn after a command, though render sleeps in between.
+  uint64_t shows = sim::peripherals().pixelShows;
+  CHECK(commandLatencyUs("rgb:14:1,2,3", [] { return true; }) != UINT64_MAX);
+  runFor(50);
+  CHECK(sim::peripherals().pixelShows > shows);
+
+  // The wake pin: once when it goes low, once when it is released.
+  uint64_t pressAt = sim::nowUs() + 700000;
+  sim::scheduleDigital(kWakePin, LOW, pressAt);
+  sim::scheduleDigital(kWakePin, HIGH, pressAt + 1500000);
+  runFor(1000);
+  CHECK_EQ(power.stats().gpioWakes, 1u);
+  runFor(1500);
+  CHECK_EQ(power.stats().gpioWakes, 2u);
+  CHECK_DONE();
+}
@@ -0,0 +1,38 @@
+#include "check.h"
+#include "report_policy.h"
+
+int main() {
+  const ReportPolicy policy = {30, 300000, 5000};  // 0.3 °C, 5 min, alarm at 50 °C
+  ChannelReporter r;
+
+  CHECK_EQ(r.sample(policy, 2500, 0), REPORT_FIRST);
+  CHECK_EQ(r.sample(policy, 2530, 2000), REPORT_NONE);     // inside the deadband
+  CHECK_EQ(r.sample(policy, 2470, 4000), REPORT_NONE);
+  CHECK_EQ(r.sample(policy, 2531, 6000), REPORT_DEADBAND);
+  CHECK_EQ(r.lastValue(), 2531);
+  CHECK_EQ(r.sample(policy, 2531, 305999), REPORT_NONE);
+  CHECK_EQ(r.sample(policy, 2531, 306000), REPORT_SILENCE);
+
+  // The alarm crossing reports even inside the deadband, once per crossing.
+  CHECK_EQ(r.sample(policy, 4990, 308000), REPORT_DEADBAND);
+  CHECK_EQ(r.sample(policy, 5000, 310000), REPORT_ALARM);
+  CHECK(r.aboveAlarm());
+  CHECK_EQ(r.sample(policy, 4990, 312000), REPORT_NONE);   // hysteresis holds
+  CHECK_EQ(r.sample(policy, 5000, 314000), REPORT_NONE);
+  CHECK_EQ(r.sample(policy, 4970, 316000), REPORT_ALARM);  // back below level - deadband
+  CHECK(!r.aboveAlarm());
+
+  // millis() wrap does not stall the silence timer.
+  ChannelReporter w;
+  CHECK_EQ(w.sample(policy, 0, 0xFFFFFF00u), REPORT_FIRST);
+  CHECK_EQ(w.sample(policy, 0, 0xFFFFFF00u + 300000u), REPORT_SILENCE);
+
+  const ReportPolicy noAlarm = {80, 60000, REPORT_NO_ALARM};
+  ChannelReporter light;
+  CHECK_EQ(light.sample(noAlarm, 0x7FFFFFFF, 0), REPORT_FIRST);
+  CHECK_EQ(light.sample(noAlarm, 0, 10), REPORT_DEADBAND);
+  light.reset();
+  CHECK_EQ(light.sample(noAlarm, 0, 20), REPORT_FIRST);
+
+  CHECK_DONE();
+}
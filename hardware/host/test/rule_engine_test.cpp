@@ -0,0 +1,269 @@
+// Rule evaluation (thresholds, hysteresis, hold times), the rule blob codec,
+// evaluation cost against rule count, then rules pushed over MQTT driving the
+// sketch's devices while the broker is down.
+#include <LittleFS.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "board_sim.h"
+#include "check.h"
+#include "rule_engine.h"
+#include "sketch.h"
+
+enum { TEMP, HUMI, LIGHT1 };   // SensorChannel order in main.cpp
+#define ALL_CHANNELS ((1u << RULE_CHANNELS) - 1)
+
+static const DeviceSpec specs[] = {
+  {STATUS_ALARM, 1, DEVICE_NO_PIN, 1, 0},
+  {STATUS_FAN, 11, 6, 1, 0},
+  {STATUS_RGB, 14, 0, 2, 0},
+};
+
+static DeviceRegistry table;
+static int actions = 0;
+
+static void apply(int slot, uint32_t target) {
+  table.setTarget(slot, target);
+  table.applied(slot);
+  actions++;
+}
+
+static std::vector<uint8_t> encode(const RuleSet& set) {
+  std::vector<uint8_t> blob(RULES_BLOB_MAX);
+  blob.resize(encodeRuleSet(set, blob.data(), blob.size()));
+  return blob;
+}
+
+static void sendRules(const std::vector<uint8_t>& blob) {
+  sim::UncountedHeap guard;
+  std::string topic = std::string("yolouno/") + HOUSE_ID + "/rules";
+  std::vector<uint8_t> copy(blob);
+  callback(&topic[0], copy.data(), copy.size());
+}
+
+static std::string lastPayload() {
+  const auto& log = sim::broker().log();
+  return log.empty() ? std::string() : log.back().payload;
+}
+
+static int32_t values[RULE_CHANNELS];
+
+static size_t run(RuleEngine& engine, int32_t temp, uint32_t nowMs, uint8_t valid = ALL_CHANNELS) {
+  values[TEMP] = temp;
+  return engine.evaluate(values, valid, nowMs, apply);
+}
+
+static void runMs(uint32_t ms) {
+  for (uint32_t i = 0; i < ms; i++) {
+    loop();
+    sim::advanceMs(1);
+  }
+}
+
+int main() {
+  CHECK(table.build(specs, sizeof(specs) / sizeof(specs[0])));
+  int fan = table.find(STATUS_FAN, 11);
+  int alarm = table.find(STATUS_ALARM, 1);
+
+  // Fan on above 30.00 °C, off again at 28.00 or below.
+  RuleSet set = {};
+  set.rules[0] = {TEMP, RULE_ABOVE, 0, STATUS_FAN, 11, 200, 3000, 0, 1};
+  set.rules[1] = {TEMP, RULE_BELOW, 0, STATUS_FAN, 11, 200, 2800, 0, 0};
+  set.count = 2;
+  RuleEngine engine(table);
+  CHECK_EQ(engine.load(set), (size_t)2);
+  CHECK_EQ(run(engine, 2900, 0), (size_t)0);   // no rule entered yet
+  CHECK_EQ(run(engine, 3001, 10), (size_t)1);
+  CHECK_EQ(table.state(fan), 1u);
+  CHECK_EQ(run(engine, 2900, 20), (size_t)0);  // inside the band: stays on
+  CHECK_EQ(run(engine, 3100, 30), (size_t)0);  // still active, no second action
+  CHECK_EQ(run(engine, 2799, 40), (size_t)1);
+  CHECK_EQ(table.state(fan), 0u);
+  CHECK(!engine.active(0));
+  CHECK(engine.active(1));
+
+  // Edge-triggered: a device set by hand keeps its state until the next entry.
+  apply(fan, 1);
+  CHECK_EQ(run(engine, 2700, 50), (size_t)0);
+  CHECK_EQ(table.state(fan), 1u);
+
+  // A threshold at the int32 limits: the band past it does not wrap around.
+  set.rules[0] = {TEMP, RULE_ABOVE, 0, STATUS_FAN, 11, 200, INT32_MIN + 100, 0, 1};
+  set.rules[1] = {TEMP, RULE_BELOW, 0, STATUS_FAN, 11, 200, INT32_MAX - 100, 0, 0};
+  set.count = 2;
+  engine.load(set);
+  run(engine, 0, 60);
+  CHECK(engine.active(0));
+  CHECK(engine.active(1));
+  run(engine, INT32_MIN, 70);
+  run(engine, INT32_MAX, 80);
+  CHECK(engine.active(0));
+  CHECK(engine.active(1));
+
+  // Hold time, and a failed reading neither fires nor resets the rule.
+  set.rules[0] = {TEMP, RULE_BELOW, 0, STATUS_ALARM, 1, 0, 5000, 60000, 0};
+  set.rules[1] = {TEMP, RULE_ABOVE, RULE_REASSERT, STATUS_ALARM, 1, 0, 5000, 0, 1};
+  engine.load(set);
+  run(engine, 5500, 1000);
+  CHECK_EQ(table.state(alarm), 1u);
+  apply(alarm, 0);                               // silenced by hand while hot
+  run(engine, 5500, 1500);
+  CHECK_EQ(table.state(alarm), 1u);              // RULE_REASSERT: back on
+  run(engine, 4000, 2000);
+  run(engine, 4000, 31000);
+  run(engine, 9000, 40000, 0);                   // channel invalid: ignored
+  CHECK_EQ(table.state(alarm), 1u);
+  run(engine, 4000, 61999);
+  CHECK_EQ(table.state(alarm), 1u);
+  run(engine, 4000, 62000);
+  CHECK_EQ(table.state(alarm), 0u);
+  run(engine, 4000, 63000);
+  run(engine, 5100, 63500);                      // back above: the hold starts over
+  run(engine, 4000, 64000);
+  apply(alarm, 1);
+  run(engine, 4000, 64000 + 59999);
+  CHECK_EQ(table.state(alarm), 1u);
+  run(engine, 4000, 64000 + 60000);
+  CHECK_EQ(table.state(alarm), 0u);
+
+  // Codec: round trip, and every kind of damage leaves the output untouched.
+  std::vector<uint8_t> blob = encode(set);
+  CHECK_EQ(blob.size(), (size_t)(RULES_HEADER_SIZE + 2 * RULE_RECORD_SIZE + 4));
+  RuleSet decoded = {};
+  CHECK_EQ(decodeRuleSet(blob.data(), blob.size(), table, decoded), CONFIG_OK);
+  CHECK_EQ(decoded.count, 2);
+  CHECK_EQ(decoded.rules[0].holdMs, 60000u);
+  CHECK_EQ(decoded.rules[1].flags, RULE_REASSERT);
+  CHECK_EQ(decoded.rules[1].threshold, 5000);
+  std::vector<uint8_t> bad = blob;
+  bad[10] ^= 1;
+  CHECK_EQ(decodeRuleSet(bad.data(), bad.size(), table, decoded), CONFIG_BAD_CRC);
+  CHECK_EQ(decodeRuleSet(blob.data(), blob.size() - 1, table, decoded), CONFIG_TRUNCATED);
+  bad = blob;
+  bad[0] = 'X';
+  CHECK_EQ(decodeRuleSet(bad.data(), bad.size(), table, decoded), CONFIG_BAD_MAGIC);
+  RuleSet negative = set;
+  negative.rules[0].threshold = -1500;             // -15.00 °C survives the trip
+  blob = encode(negative);
+  CHECK_EQ(decodeRuleSet(blob.data(), blob.size(), table, decoded), CONFIG_OK);
+  CHECK_EQ(decoded.rules[0].threshold, -1500);
+
+  RuleSet wrong = set;
+  wrong.rules[0].channel = RULE_CHANNELS;
+  CHECK_EQ(validateRuleSet(wrong), CONFIG_BAD_FIELD);
+  wrong = set;
+  wrong.rules[0].kind = STATUS_TEMP;               // sensors are not actuators
+  CHECK_EQ(validateRuleSet(wrong), CONFIG_BAD_FIELD);
+  wrong = set;
+  wrong.rules[0].target = 2;                       // alarm is on or off
+  CHECK_EQ(validateRuleSet(wrong), CONFIG_BAD_FIELD);
+  wrong = set;
+  wrong.rules[0] = {TEMP, RULE_ABOVE, 0, STATUS_FAN, 12, 0, 3000, 0, 1};
+  CHECK_EQ(validateRuleSet(wrong), CONFIG_OK);
+  CHECK_EQ(validateRuleSet(wrong, &table), CONFIG_BAD_FIELD);   // no fan 12 here
+  blob = encode(wrong);
+  CHECK_EQ(decodeRuleSet(blob.data(), blob.size(), table, decoded), CONFIG_BAD_FIELD);
+  CHECK_EQ(engine.load(wrong), (size_t)1);         // load() drops it instead
+
+  // Evaluation cost grows linearly with the table and stays bounded by RULE_MAX.
+  printf("%6s %14s\n", "rules", "host ns/pass");
+  for (int n = 1; n <= RULE_MAX; n *= 2) {
+    RuleSet many = {};
+    for (int i = 0; i < n; i++) {
+      many.rules[i] = {(uint8_t)(i % RULE_CHANNELS), i % 2 ? RULE_BELOW : RULE_ABOVE, 0,
+                       STATUS_FAN, 11, 50, 1000 + i, 1000, (uint32_t)(i % 2)};
+    }
+    many.count = (uint8_t)n;
+    CHECK_EQ(engine.load(many), (size_t)n);
+    const int passes = 100000;
+    for (int c = 0; c < RULE_CHANNELS; c++) values[c] = 1000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < passes; i++) {
+      values[i % RULE_CHANNELS] = 990 + i % 23;   // crosses thresholds now and then
+      engine.evaluate(values, ALL_CHANNELS, (uint32_t)i * 100, apply);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start)
+                    .count() / passes;
+    printf("%6d %14.1f\n", n, ns);
+  }
+
+  // The sketch: default rules from firmware, new ones over MQTT.
+  sim::setAnalog(2, 2000);   // light 4: daylight
+  setup();
+  CHECK_EQ(rules.count(), (size_t)2);
+  CHECK(runUntilConnected());
+
+  RuleSet pushed;
+  loadDefaultRules(pushed);
+  pushed.rules[2] = {TEMP, RULE_ABOVE, 0, STATUS_FAN, 11, 200, 3000, 0, 1};
+  pushed.rules[3] = {TEMP, RULE_BELOW, 0, STATUS_FAN, 11, 200, 2800, 0, 0};
+  // Light 4 dark for a second: RGB 16 on; bright again: off.
+  pushed.rules[4] = {LIGHT1, RULE_BELOW, 0, STATUS_RGB, 16, 0, 500, 1000, 0x202020};
+  pushed.rules[5] = {LIGHT1, RULE_ABOVE, 0, STATUS_RGB, 16, 0, 800, 0, 0};
+  pushed.count = 6;
+  std::vector<uint8_t> pushedBlob = encode(pushed);
+
+  bad = pushedBlob;
+  bad[bad.size() - 1] ^= 1;
+  sendRules(bad);
+  CHECK(lastPayload() == "rules:bad crc");
+  CHECK_EQ(rules.count(), (size_t)2);
+  wrong = pushed;
+  wrong.rules[2].deviceId = 13;   // fan 13 has no pin in this house
+  sendRules(encode(wrong));
+  CHECK(lastPayload() == "rules:bad field");
+  sendRules(pushedBlob);
+  CHECK(lastPayload() == "rules:ok");
+  CHECK_EQ(rules.count(), (size_t)6);
+  CHECK(sim::flash().files[RULES_PATH] == pushedBlob);
+  CHECK(sim::flash().files.count(RULES_TMP_PATH) == 0);
+  RuleSet reloaded;
+  CHECK_EQ(loadRuleSet(LittleFS, devices, reloaded), CONFIG_OK);
+  CHECK_EQ(reloaded.count, 6);
+
+  // Broker down: the fan follows the temperature within a loop pass of the read.
+  sim::broker().setOutage(sim::nowUs(), sim::nowUs() + 600000000ULL);
+  sim::dht20().temperature = 31.0f;
+  uint64_t readAtUs = 0, fanOnAtUs = 0;
+  uint64_t reads = sim::dht20().reads;
+  for (int i = 0; i < 50000 && !fanOnAtUs; i++) {
+    loop();
+    if (!readAtUs && sim::dht20().reads != reads) readAtUs = sim::nowUs();
+    if (sim::digitalLevel(6) == HIGH) fanOnAtUs = sim::nowUs();
+    sim::advanceUs(100);
+  }
+  CHECK(readAtUs != 0 && fanOnAtUs != 0);
+  CHECK(!connection.mqttUp());
+  printf("fan on %llu us after the climate read, broker down\n",
+         (unsigned long long)(fanOnAtUs - readAtUs));
+  CHECK(fanOnAtUs - readAtUs < 5000);
+
+  // Alarm above 50 °C, cleared after a minute below it.
+  sim::dht20().temperature = 55.0f;
+  runMs(3000);
+  CHECK(alarmActive());
+  sim::dht20().temperature = 45.0f;
+  runMs(30000);
+  CHECK(alarmActive());
+  runMs(35000);
+  CHECK(!alarmActive());
+  CHECK_EQ(sim::digitalLevel(6), HIGH);   // 45 °C: the fan stays on
+  sim::dht20().temperature = 26.0f;
+  runMs(3000);
+  CHECK_EQ(sim::digitalLevel(6), LOW);
+
+  // Lights by lux: dark for over a second turns RGB 16 on.
+  int rgb16 = devices.find(STATUS_RGB, 16);
+  sim::setAnalog(2, 300);
+  runMs(500);
+  CHECK_EQ(devices.state(rgb16), 0u);
+  runMs(1500);
+  CHECK_EQ(devices.state(rgb16), 0x202020u);
+  sim::setAnalog(2, 2000);
+  runMs(1500);
+  CHECK_EQ(devices.state(rgb16), 0u);
+  CHECK_DONE();
+}
@@ -0,0 +1,127 @@
+// Offline sample buffer: ordering, fixed capacity, flash spill, and a one hour
+// broker outage replayed through the firmware with nothing lost or repeated.
+#include <LittleFS.h>
+
+#include <string>
+#include <vector>
+
+#include "board_sim.h"
+#include "check.h"
+#include "sample_buffer.h"
+#include "sketch.h"
+
+static SensorFrame sample(uint16_t seq) {
+  SensorFrame f = {};
+  f.seq = seq;
+  f.timestampMs = seq * 15000u;
+  f.light[0] = seq;
+  return f;
+}
+
+// Drains the buffer in odd-sized batches and checks it yields first..last in order.
+static void checkDrains(SampleBuffer& buffer, uint16_t first, uint16_t last) {
+  SensorFrame out[7];
+  uint32_t expect = first;
+  while (!buffer.empty()) {
+    size_t n = buffer.peek(out, 7);
+    CHECK(n > 0);
+    if (n == 0) return;
+    for (size_t i = 0; i < n; i++, expect++) CHECK_EQ(out[i].seq, (uint16_t)expect);
+    buffer.pop(n);
+  }
+  CHECK_EQ(expect, (uint32_t)last + 1);
+}
+
+int main() {
+  // RAM only: fixed capacity, oldest samples go first.
+  static SampleBuffer ram;
+  for (uint16_t i = 0; i < 100; i++) ram.push(sample(i));
+  CHECK_EQ(ram.size(), (size_t)SAMPLE_RAM_CAPACITY);
+  CHECK_EQ(ram.dropped(), 100u - SAMPLE_RAM_CAPACITY);
+  checkDrains(ram, 100 - SAMPLE_RAM_CAPACITY, 99);
+
+  // With spill: the file is sized up front and keeps its size.
+  CHECK(LittleFS.begin(true));
+  static SampleBuffer spill;
+  CHECK(spill.beginSpill(LittleFS));
+  const size_t fileSize = SAMPLE_SPILL_CAPACITY * SENSOR_FRAME_SIZE;
+  CHECK_EQ(sim::flash().files[SAMPLE_SPILL_PATH].size(), fileSize);
+  uint64_t heapBefore = sim::heap().allocs;
+  for (uint16_t i = 0; i < 500; i++) spill.push(sample(i));
+  CHECK_EQ(sim::heap().allocs, heapBefore);
+  CHECK_EQ(spill.size(), (size_t)500);
+  CHECK(spill.spilled() > 0);
+  CHECK_EQ(spill.dropped(), 0u);
+  checkDrains(spill, 0, 499);
+
+  // Past both capacities the ring wraps on flash and drops the oldest.
+  const uint16_t total = SAMPLE_SPILL_CAPACITY + SAMPLE_RAM_CAPACITY + 100;
+  for (uint16_t i = 0; i < total; i++) spill.push(sample(i));
+  CHECK(spill.size() <= (size_t)(SAMPLE_SPILL_CAPACITY + SAMPLE_RAM_CAPACITY));
+  CHECK_EQ(spill.size() + spill.dropped(), (size_t)total);
+  checkDrains(spill, (uint16_t)(total - spill.size()), total - 1);
+  CHECK_EQ(sim::flash().files[SAMPLE_SPILL_PATH].size(), fileSize);
+
+  // Firmware: a one hour outage, then everything reaches the broker once.
+  sim::resetBoard();
+  setup();
+  sensorPublishMode = 1;  // SENSOR_PUBLISH_FRAME, so live samples carry seq too
+  // A light level that moves past the deadband on every sample, so every
+  // sample is reported and the outage fills RAM and spills to flash.
+  sim::setAnalogSource([](int pin, uint64_t nowUs) {
+    (void)pin;
+    return (int)((nowUs / 1000000ULL) * 50 % 4000);
+  });
+  sim::broker().clearLog();
+  CHECK(runUntilConnected());
+
+  uint64_t start = sim::nowUs();
+  const uint64_t outageStart = start + 120000000ULL;
+  const uint64_t outageEnd = outageStart + 3600000000ULL;
+  sim::broker().setOutage(outageStart, outageEnd);
+  size_t peak = 0;
+  while (sim::nowUs() < outageEnd + 600000000ULL) {
+    loop();
+    if (sampleBacklog.size() > peak) peak = sampleBacklog.size();
+    sim::advanceUs(10000);
+  }
+  CHECK(sampleBacklog.empty());
+  CHECK_EQ(sampleBacklog.dropped(), 0u);
+  CHECK(peak >= 3600 / 2 - 1);
+  CHECK(peak > SAMPLE_RAM_CAPACITY);  // exercised the flash spill
+
+  std::vector<int> seen;
+  size_t batches = 0;
+  std::string frameTopic = std::string("yolouno/") + HOUSE_ID + "/sensors/frame";
+  std::string backlogTopic = std::string("yolouno/") + HOUSE_ID + "/sensors/backlog";
+  auto record = [&](const uint8_t* bytes, size_t len) {
+    SensorFrame f;
+    CHECK(decodeSensorFrame(bytes, len, f));
+    if (f.seq >= seen.size()) seen.resize(f.seq + 1, 0);
+    seen[f.seq]++;
+  };
+  for (const sim::Message& m : sim::broker().log()) {
+    const uint8_t* p = (const uint8_t*)m.payload.data();
+    if (m.topic == frameTopic) {
+      record(p, m.payload.size());
+    } else if (m.topic == backlogTopic) {
+      batches++;
+      CHECK_EQ(p[0], SENSOR_BACKLOG_VERSION);
+      CHECK(p[1] >= 1 && p[1] <= 8);
+      CHECK_EQ(m.payload.size(), (size_t)(SENSOR_BACKLOG_HEADER_SIZE + p[1] * SENSOR_FRAME_SIZE));
+      for (int i = 0; i < p[1]; i++) {
+        record(p + SENSOR_BACKLOG_HEADER_SIZE + i * SENSOR_FRAME_SIZE, SENSOR_FRAME_SIZE);
+      }
+    }
+  }
+  CHECK(seen.size() > 3600 / 2);
+  for (size_t seq = 0; seq < seen.size(); seq++) {
+    if (seen[seq] != 1) fprintf(stderr, "seq %zu seen %d times\n", seq, seen[seq]);
+    CHECK_EQ(seen[seq], 1);
+  }
+  CHECK(batches >= peak / 8);
+  printf("outage 3600 s: %zu samples buffered at peak, %zu backlog batches, %zu total\n", peak,
+         batches, seen.size());
+
+  CHECK_DONE();
+}
@@ -0,0 +1,86 @@
+// Frame round trip, and the firmware's publish modes on the simulated board.
+#include <math.h>
+#include <string.h>
+
+#include <string>
+
+#include "board_sim.h"
+#include "check.h"
+#include "sensor_frame.h"
+#include "sketch.h"
+
+static int countPublishes(const char* suffix) {
+  int n = 0;
+  size_t len = strlen(suffix);
+  for (const sim::Message& m : sim::broker().log()) {
+    if (m.topic.size() >= len && m.topic.compare(m.topic.size() - len, len, suffix) == 0) n++;
+  }
+  return n;
+}
+
+int main() {
+  SensorFrame in = {};
+  in.seq = 65535;
+  in.timestampMs = 0xDEADBEEF;
+  setSensorFrameClimate(in, -12.345f, 101.0f);
+  in.light[0] = 0;
+  in.light[1] = 2048;
+  in.light[2] = 4095;
+
+  uint8_t bytes[SENSOR_FRAME_SIZE];
+  CHECK_EQ(encodeSensorFrame(in, bytes, sizeof(bytes)), (size_t)SENSOR_FRAME_SIZE);
+  CHECK_EQ(encodeSensorFrame(in, bytes, SENSOR_FRAME_SIZE - 1), (size_t)0);
+
+  SensorFrame out;
+  CHECK(decodeSensorFrame(bytes, sizeof(bytes), out));
+  CHECK_EQ(out.seq, 65535);
+  CHECK_EQ(out.timestampMs, 0xDEADBEEFu);
+  CHECK_EQ(out.tempCenti, -1235);
+  CHECK_EQ(out.humiCenti, 10000);  // clamped
+  CHECK_EQ(out.light[2], 4095);
+  CHECK(out.flags & SENSOR_FRAME_FLAG_CLIMATE_VALID);
+
+  setSensorFrameClimate(in, NAN, 50.0f);
+  CHECK(!(in.flags & SENSOR_FRAME_FLAG_CLIMATE_VALID));
+
+  bytes[0] = SENSOR_FRAME_VERSION + 1;
+  CHECK(!decodeSensorFrame(bytes, sizeof(bytes), out));
+  CHECK(!decodeSensorFrame(bytes, sizeof(bytes) - 1, out));
+
+  // Firmware: frame mode is one publish; both mode keeps the legacy topics.
+  setup();
+  CHECK(runUntilConnected());
+  sim::setAnalog(2, 100);
+  sim::setAnalog(3, 200);
+  sim::setAnalog(4, 300);
+  for (int i = 0; i < 40; i++) {  // let the light filter settle
+    sim::advanceMs(LIGHT_SAMPLE_INTERVAL_MS);
+    lights.service();
+  }
+
+  sensorPublishMode = 1;  // SENSOR_PUBLISH_FRAME
+  sim::broker().clearLog();
+  publishSensorData(23.5f, 40.25f, 100);
+  CHECK_EQ(sim::broker().log().size(), (size_t)1);
+  CHECK_EQ(countPublishes("/sensors/frame"), 1);
+  const std::string& payload = sim::broker().log().back().payload;
+  CHECK(decodeSensorFrame((const uint8_t*)payload.data(), payload.size(), out));
+  CHECK_EQ(out.tempCenti, 2350);
+  CHECK_EQ(out.humiCenti, 4025);
+  CHECK_EQ(out.light[0], 100);
+  CHECK_EQ(out.light[1], 200);
+  CHECK_EQ(out.light[2], 300);
+  uint16_t firstSeq = out.seq;
+
+  sensorPublishMode = 2;  // SENSOR_PUBLISH_BOTH
+  sim::broker().clearLog();
+  publishSensorData(23.5f, 40.25f, 100);
+  CHECK_EQ(countPublishes("/sensors/frame"), 1);
+  CHECK_EQ(countPublishes("/status/light/5"), 1);
+  CHECK_EQ(sim::broker().log().size(), (size_t)11);
+  const std::string& again = sim::broker().log().front().payload;
+  CHECK(decodeSensorFrame((const uint8_t*)again.data(), again.size(), out));
+  CHECK_EQ(out.seq, firstSeq + 1);
+
+  CHECK_DONE();
+}
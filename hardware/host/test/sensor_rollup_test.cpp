@@ -0,0 +1,263 @@
+// Windowed rollups against a floating-point reference, window boundaries and
+// the wire record; then the sketch with raw samples off, publishing one
+// record per window and raw samples again on request.
+#include <math.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "board_sim.h"
+#include "check.h"
+#include "sensor_frame.h"
+#include "sensor_rollup.h"
+#include "sketch.h"
+
+namespace {
+
+struct Reference {
+  std::vector<double> values;
+
+  void add(int32_t v) { values.push_back(v); }
+  double mean() const {
+    double sum = 0;
+    for (double v : values) sum += v;
+    return sum / values.size();
+  }
+  int32_t min() const {
+    double m = values[0];
+    for (double v : values) m = v < m ? v : m;
+    return (int32_t)m;
+  }
+  int32_t max() const {
+    double m = values[0];
+    for (double v : values) m = v > m ? v : m;
+    return (int32_t)m;
+  }
+};
+
+uint32_t lcg(uint32_t& x) {
+  x = x * 1103515245u + 12345u;
+  return x >> 8;
+}
+
+int countPublishes(const char* suffix) {
+  int n = 0;
+  size_t len = strlen(suffix);
+  for (const sim::Message& m : sim::broker().log()) {
+    if (m.topic.size() >= len && m.topic.compare(m.topic.size() - len, len, suffix) == 0) n++;
+  }
+  return n;
+}
+
+void run(uint64_t ms) {
+  for (uint64_t end = sim::nowUs() + ms * 1000; sim::nowUs() < end;) {
+    loop();
+    sim::advanceMs(5);
+  }
+}
+
+}  // namespace
+
+int main() {
+  // Three channels sampled at different rates, with noise and a drift, over
+  // several 1 min windows: min/max/count exact, mean within rounding.
+  const uint32_t oneWindow[] = {60000};
+  WindowedRollup rollup1;
+  CHECK(rollup1.begin(oneWindow, 1, 3, 1000));
+  CHECK_EQ(rollup1.windows(), 1);
+  uint32_t x = 7;
+  Reference ref[3];
+  RollupRecord record;
+  int records = 0;
+  double worstMeanError = 0;
+  for (uint32_t t = 1000; t <= 1000 + 5 * 60000; t += 100) {
+    if (rollup1.close(t, record)) {
+      records++;
+      CHECK_EQ(record.startMs, t - 60000);
+      CHECK_EQ(record.lengthMs, 60000u);
+      CHECK_EQ(record.channels, 3);
+      for (int c = 0; c < 3; c++) {
+        const RollupStats& s = record.stats[c];
+        CHECK_EQ(s.count, (uint32_t)ref[c].values.size());
+        CHECK_EQ(s.min, ref[c].min());
+        CHECK_EQ(s.max, ref[c].max());
+        double error = fabs(s.mean - ref[c].mean());
+        CHECK(error <= 0.5);
+        if (error > worstMeanError) worstMeanError = error;
+        ref[c] = Reference();
+      }
+      CHECK(!rollup1.close(t, record));
+    }
+    int32_t temp = 2500 + (int32_t)(t / 1000) - (int32_t)(lcg(x) % 61) + 30;   // centi-degrees
+    int32_t light = (int32_t)(lcg(x) % 4096);
+    rollup1.add(1, light);
+    ref[1].add(light);
+    if (t % 2000 == 0) {
+      rollup1.add(0, temp);
+      ref[0].add(temp);
+    }
+    if (t % 700 == 0) {
+      rollup1.add(2, -temp);   // negative means round away from zero too
+      ref[2].add(-temp);
+    }
+  }
+  CHECK_EQ(records, 5);
+  printf("5 windows, worst |mean - reference| %.3f\n", worstMeanError);
+
+  // Rounding half away from zero, on both sides.
+  const int32_t halves[][3] = {{1, 2, 2}, {-1, -2, -2}, {1, 0, 1}, {-1, 0, -1}};
+  for (const auto& h : halves) {
+    CHECK(rollup1.begin(oneWindow, 1, 1, 0));
+    rollup1.add(0, h[0]);
+    rollup1.add(0, h[1]);
+    CHECK(rollup1.close(60000, record));
+    CHECK_EQ(record.stats[0].mean, h[2]);
+  }
+
+  // A long window of extreme values does not overflow the sum.
+  CHECK(rollup1.begin(oneWindow, 1, 2, 0));
+  for (int i = 0; i < 1000000; i++) {
+    rollup1.add(0, INT32_MAX);
+    rollup1.add(1, i % 2 ? INT32_MIN : INT32_MAX);
+  }
+  CHECK(rollup1.close(60000, record));
+  CHECK_EQ(record.stats[0].mean, INT32_MAX);
+  CHECK_EQ(record.stats[0].count, 1000000u);
+  CHECK_EQ(record.stats[1].mean, -1);   // (MAX + MIN) / 2 = -0.5
+  CHECK_EQ(record.stats[1].min, INT32_MIN);
+  CHECK_EQ(record.stats[1].max, INT32_MAX);
+
+  // 1 min and 15 min, given longest first: both close at 15 min, the short
+  // one first; each start stays on the grid from begin().
+  const uint32_t windows[] = {900000, 60000};
+  WindowedRollup rollup2;
+  CHECK(rollup2.begin(windows, 2, 1, 500));
+  int shortWindows = 0, longWindows = 0;
+  for (uint32_t t = 500; t <= 500 + 900000; t += 250) {
+    while (rollup2.close(t, record)) {
+      if (record.lengthMs == 60000) {
+        CHECK_EQ(record.stats[0].count, 240u);
+        CHECK_EQ(record.startMs, 500 + 60000u * shortWindows);
+        shortWindows++;
+      } else {
+        CHECK_EQ(shortWindows, 15);   // the last short window went first
+        CHECK_EQ(record.startMs, 500u);
+        CHECK_EQ(record.stats[0].count, 3600u);
+        CHECK_EQ(record.stats[0].min, 0);
+        CHECK_EQ(record.stats[0].max, 3599);
+        CHECK_EQ(record.stats[0].mean, 1800);   // 1799.5
+        longWindows++;
+      }
+    }
+    if (t < 500 + 900000) rollup2.add(0, (int32_t)((t - 500) / 250));
+  }
+  CHECK_EQ(shortWindows, 15);
+  CHECK_EQ(longWindows, 1);
+
+  // Windows without a sample are not sent; the next one keeps the grid.
+  CHECK(rollup2.begin(windows, 1, 2, 0));   // 15 min only
+  CHECK(!rollup2.close(3 * 900000 + 10, record));
+  rollup2.add(1, 42);
+  CHECK(!rollup2.close(4 * 900000 - 1, record));
+  CHECK(rollup2.close(4 * 900000, record));
+  CHECK_EQ(record.startMs, 3u * 900000);
+  CHECK_EQ(record.stats[0].count, 0u);
+  CHECK_EQ(record.stats[1].count, 1u);
+  CHECK_EQ(record.stats[1].mean, 42);
+
+  // Across the millis() wrap.
+  CHECK(rollup2.begin(oneWindow, 1, 1, 0xFFFFFFFFu - 1000));
+  rollup2.add(0, 5);
+  CHECK(!rollup2.close(58000, record));
+  CHECK(rollup2.close(59000, record));
+  CHECK_EQ(record.startMs, 0xFFFFFFFFu - 1000);
+
+  // Refused configurations.
+  const uint32_t tooMany[] = {1000, 2000, 3000};
+  const uint32_t zero[] = {0};
+  CHECK(!rollup2.begin(tooMany, 3, 1, 0));
+  CHECK(!rollup2.begin(zero, 1, 1, 0));
+  CHECK(!rollup2.begin(oneWindow, 1, ROLLUP_MAX_CHANNELS + 1, 0));
+  CHECK_EQ(rollup2.windows(), 0);
+
+  // Wire record: round trip, clamped to the i16/u16 fields.
+  RollupRecord in = {};
+  in.startMs = 0xDEADBEEF;
+  in.lengthMs = 60000;
+  in.channels = ROLLUP_MAX_CHANNELS;
+  in.stats[0] = {-1234, 3456, 2001, 30};
+  in.stats[1] = {4000, 6000, 5000, 30};
+  in.stats[2] = {-40000, 40000, 0, 70000};
+  in.stats[3] = {0, 0, 0, 0};
+  in.stats[4] = {0, 4095, 2048, 600};
+  uint8_t bytes[SENSOR_ROLLUP_MAX_SIZE];
+  size_t length = encodeSensorRollup(in, bytes, sizeof(bytes));
+  CHECK_EQ(length, (size_t)50);
+  CHECK_EQ(encodeSensorRollup(in, bytes, sizeof(bytes) - 1), (size_t)0);
+  RollupRecord out;
+  CHECK(decodeSensorRollup(bytes, length, out));
+  CHECK_EQ(out.startMs, 0xDEADBEEFu);
+  CHECK_EQ(out.lengthMs, 60000u);
+  CHECK_EQ(out.channels, ROLLUP_MAX_CHANNELS);
+  CHECK_EQ(out.stats[0].min, -1234);
+  CHECK_EQ(out.stats[0].mean, 2001);
+  CHECK_EQ(out.stats[2].min, -32768);
+  CHECK_EQ(out.stats[2].max, 32767);
+  CHECK_EQ(out.stats[2].count, 65535u);
+  CHECK_EQ(out.stats[4].max, 4095);
+  CHECK(!decodeSensorRollup(bytes, length - 1, out));
+  bytes[0] = SENSOR_ROLLUP_VERSION + 1;
+  CHECK(!decodeSensorRollup(bytes, length, out));
+
+  // The sketch with raw samples off: one record per minute, nothing else on
+  // the sensor topics.
+  sensorRawStream = 0;
+  setup();
+  CHECK(runUntilConnected());
+  sim::setAnalog(2, 1000);
+  sim::setAnalog(3, 2000);
+  sim::setAnalog(4, 3000);
+  run(60000);   // settle, and the first window (partly before the light filter) closes
+  sim::broker().clearLog();
+  run(60000);
+  CHECK_EQ(countPublishes("/sensors/rollup"), 1);
+  CHECK_EQ(countPublishes("/status/temp/1"), 0);
+  CHECK_EQ(countPublishes("/status/light/4"), 0);
+  for (const sim::Message& m : sim::broker().log()) {
+    if (m.topic.find("/sensors/rollup") == std::string::npos) continue;
+    CHECK(decodeSensorRollup((const uint8_t*)m.payload.data(), m.payload.size(), out));
+    CHECK_EQ(out.lengthMs, 60000u);
+    CHECK_EQ(out.channels, 5);
+    CHECK_EQ(out.stats[0].mean, 2750);
+    CHECK_EQ(out.stats[1].mean, 6530);
+    CHECK(out.stats[0].count >= 29 && out.stats[0].count <= 31);   // DHT20 every 2 s
+    CHECK(out.stats[2].count >= 590 && out.stats[2].count <= 610);  // lights every 100 ms
+    CHECK(abs(out.stats[3].mean - 2000) <= 2);
+    CHECK(out.stats[4].min <= out.stats[4].mean && out.stats[4].mean <= out.stats[4].max);
+    printf("sketch: %zu byte record, %u light samples per minute\n", m.payload.size(),
+           out.stats[2].count);
+  }
+
+  // Raw samples for 10 s on request, then off again.
+  std::string stream = std::string("yolouno/") + HOUSE_ID + "/sensors/stream";
+  {
+    sim::UncountedHeap guard;
+    sim::broker().inject(stream, "10", false, sim::nowUs());
+  }
+  sim::broker().clearLog();
+  run(5000);
+  CHECK(countPublishes("/status/temp/1") >= 1);
+  CHECK(countPublishes("/status/light/6") >= 1);
+  run(6000);
+  sim::broker().clearLog();
+  sim::dht20().temperature = 29.0f;
+  run(10000);
+  CHECK_EQ(countPublishes("/status/temp/1"), 0);
+
+  // Alarms still go out at once.
+  sim::dht20().temperature = 55.0f;
+  run(5000);
+  CHECK(countPublishes("/status/temp/1") >= 1);
+  CHECK_DONE();
+}
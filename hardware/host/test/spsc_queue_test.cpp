@@ -0,0 +1,142 @@
+// SPSC queue semantics, then a two-thread stress run of the dual-core records:
+// an "io" task sends commands and receives telemetry while an "actuator" task
+// does the reverse, both through the FreeRTOS stand-in on real threads.
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "board_sim.h"
+#include "check.h"
+#include "core_link.h"
+
+static const uint32_t kRecords = 500000;
+
+static const CommandRoute route = {"fan", 0, 0, nullptr};
+static CommandQueue commands;
+static TelemetryQueue telemetry;
+static std::atomic<uint32_t> outOfOrder{0};
+static std::atomic<uint32_t> badPayload{0};
+static std::atomic<uint32_t> fullRetries{0};
+static std::atomic<int> wrongCore{0};
+
+// Network side: produces commands, consumes telemetry.
+static void ioTask(void*) {
+  if (xPortGetCoreID() != 0) wrongCore++;
+  uint32_t sent = 0, received = 0;
+  while (sent < kRecords || received < kRecords) {
+    bool progress = false;
+    if (sent < kRecords) {
+      char text[12];
+      int len = snprintf(text, sizeof(text), "%u", (unsigned)sent);
+      CommandRecord record;
+      makeCommandRecord(&route, (int)sent, Token{text, (uint16_t)len}, record);
+      if (commands.push(record)) {
+        sent++;
+        progress = true;
+      } else {
+        fullRetries++;
+      }
+    }
+    TelemetryRecord in;
+    if (telemetry.pop(in)) {
+      if (in.kind != TELEMETRY_SAMPLE || in.sample.sampledAtMs != received) outOfOrder++;
+      if (in.sample.lightValues[2] != (int)(received * 3)) badPayload++;
+      received++;
+      progress = true;
+    }
+    if (!progress) vTaskDelay(0);
+  }
+  vTaskDelete(NULL);
+}
+
+// Actuator side: consumes commands, answers each with one sample.
+static void actuatorTask(void*) {
+  if (xPortGetCoreID() != 1) wrongCore++;
+  uint32_t received = 0;
+  while (received < kRecords) {
+    CommandRecord record;
+    if (!commands.pop(record)) {
+      vTaskDelay(0);
+      continue;
+    }
+    if (record.deviceId != (int)received || record.route != &route) outOfOrder++;
+    char text[12];
+    int len = snprintf(text, sizeof(text), "%u", (unsigned)received);
+    if (!record.command().equals(text) || record.len != len) badPayload++;
+
+    TelemetryRecord out;
+    out.kind = TELEMETRY_SAMPLE;
+    out.sample.sampledAtMs = received;
+    out.sample.lightValues[2] = (int)(received * 3);
+    while (!telemetry.push(out)) {
+      fullRetries++;
+      vTaskDelay(0);
+    }
+    received++;
+  }
+  vTaskDelete(NULL);
+}
+
+int main() {
+  // Single-threaded semantics: FIFO, capacity, full/empty, wrap-around.
+  uint64_t allocs = sim::heap().allocs;
+  SpscQueue<int, 4> q;
+  int v = -1;
+  CHECK(q.empty());
+  CHECK(!q.pop(v));
+  for (int round = 0; round < 3; round++) {   // indexes wrap the ring
+    for (int i = 0; i < 4; i++) CHECK(q.push(round * 10 + i));
+    CHECK(!q.push(99));
+    CHECK_EQ(q.size(), (size_t)4);
+    for (int i = 0; i < 4; i++) {
+      CHECK(q.pop(v));
+      CHECK_EQ(v, round * 10 + i);
+    }
+    CHECK(q.empty());
+  }
+  CHECK_EQ(sim::heap().allocs, allocs);
+
+  // Records: text is copied; oversize text / payloads are refused.
+  CommandRecord cr;
+  char payload[] = "255,0,128";
+  CHECK(makeCommandRecord(&route, 14, Token{payload, 9}, cr));
+  payload[0] = 'x';   // the MQTT buffer is reused after the callback
+  CHECK(cr.command().equals("255,0,128"));
+  char longText[CORE_COMMAND_TEXT_MAX + 1];
+  memset(longText, 'a', sizeof(longText));
+  CHECK(!makeCommandRecord(&route, 14, Token{longText, (uint16_t)sizeof(longText)}, cr));
+  TelemetryRecord tr;
+  CHECK(makePublishRecord("t", "CLOSED", true, tr));
+  CHECK_EQ(tr.publish.len, 6);
+  CHECK(tr.publish.retained);
+  std::string longPayload(CORE_PAYLOAD_MAX + 1, 'p');
+  CHECK(!makePublishRecord("t", longPayload.c_str(), false, tr));
+
+  // Stress: both directions at once, on two threads.
+  sim::setThreadedTasks(true);
+  auto start = std::chrono::steady_clock::now();
+  TaskHandle_t io = nullptr, actuator = nullptr;
+  CHECK_EQ(xTaskCreatePinnedToCore(ioTask, "io", 8192, nullptr, 1, &io, 0), pdPASS);
+  CHECK_EQ(xTaskCreatePinnedToCore(actuatorTask, "actuator", 8192, nullptr, 1, &actuator, 1),
+           pdPASS);
+  CHECK_EQ(sim::rtosTasks().size(), (size_t)2);
+  sim::joinTasks();
+  double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  CHECK_EQ(outOfOrder.load(), 0u);
+  CHECK_EQ(badPayload.load(), 0u);
+  CHECK_EQ(wrongCore.load(), 0);
+  CHECK(commands.empty());
+  CHECK(telemetry.empty());
+  printf("%u commands + %u samples in %.3f s (%.2f M records/s), %u full-queue retries\n",
+         kRecords, kRecords, seconds, 2.0 * kRecords / seconds / 1e6, fullRetries.load());
+
+  CHECK_DONE();
+}
@@ -0,0 +1,112 @@
+// Reconnect delta sync: only states the broker does not hold go out, paced
+// and at a random point in the window.
+#include <string>
+
+#include "board_sim.h"
+#include "check.h"
+#include "state_sync.h"
+
+static const TopicIdRange ranges[STATUS_KIND_COUNT] = {
+  {7, 10}, {1, 1}, {11, 13}, {14, 16}, {1, 3}, {1, 3}, {4, 6},
+};
+static const DeviceSpec specs[] = {
+  {STATUS_DOOR, 7, 5, 1, 0},
+  {STATUS_DOOR, 8, 16, 1, 1},
+  {STATUS_ALARM, 1, DEVICE_NO_PIN, 1, 0},
+  {STATUS_FAN, 11, 6, 1, 0},
+  {STATUS_RGB, 14, 0, 2, 0x00FF00},
+};
+static const size_t kDevices = sizeof(specs) / sizeof(specs[0]);
+
+static TopicTable topics;
+static DeviceRegistry devices;
+static WiFiClient wifiClient;
+static PubSubClient client(wifiClient);
+static StateSync sync(devices, topics, client);
+
+// Connects, starts a sync and runs it to completion; returns its publishes.
+static uint32_t reconnect(unsigned long windowMs = STATE_SYNC_WINDOW_MS) {
+  client.disconnect();
+  CHECK(client.connect("sync-test"));
+  uint32_t before = sync.published();
+  sync.begin(millis(), windowMs);
+  CHECK(sync.startAtMs() >= millis() && sync.startAtMs() < millis() + (windowMs ? windowMs : 1));
+  while (sync.syncing()) {
+    client.loop();
+    size_t sent = sync.service(millis());
+    CHECK(sent <= STATE_SYNC_BURST);
+    sim::advanceMs(10);
+  }
+  client.loop();   // echoes of what was just published
+  return sync.published() - before;
+}
+
+static int unackedCount() {
+  int n = 0;
+  for (size_t slot = 0; slot < devices.count(); slot++) n += devices.unacked(slot);
+  return n;
+}
+
+int main() {
+  CHECK(topics.build("h1", ranges));
+  CHECK(devices.build(specs, kDevices));
+  client.setCallback([](char* topic, uint8_t* payload, unsigned int length) {
+    CHECK(sync.onMessage(topic, payload, length));
+  });
+  WiFi.begin("ssid", "pass");
+  sim::advanceMs(sim::wifi().associateMs);
+
+  // Empty broker: everything goes out, retained, and comes back as acks.
+  CHECK_EQ(reconnect(), (uint32_t)kDevices);
+  CHECK_EQ(sim::broker().retained().size(), kDevices);
+  CHECK(sim::broker().retained().at("yolouno/h1/status/door/8") == "OPEN");
+  CHECK(sim::broker().retained().at("yolouno/h1/status/rgb/14") == "0,255,0");
+  CHECK_EQ(unackedCount(), 0);
+
+  // Broker kept its retained store: nothing to send.
+  uint32_t skippedBefore = sync.skipped();
+  CHECK_EQ(reconnect(), 0u);
+  CHECK_EQ(sync.skipped() - skippedBefore, (uint32_t)kDevices);
+  CHECK_EQ(unackedCount(), 0);
+
+  // A change made while offline: only that device.
+  client.disconnect();
+  int fan = devices.find(STATUS_FAN, 11);
+  devices.setTarget(fan, 1);
+  devices.applied(fan);
+  CHECK(devices.unacked(fan));
+  sim::broker().clearLog();
+  CHECK_EQ(reconnect(), 1u);
+  CHECK_EQ(sim::broker().log().size(), (size_t)1);
+  CHECK(sim::broker().log()[0].topic == "yolouno/h1/status/fan/11");
+  CHECK(sim::broker().log()[0].payload == "ON");
+  CHECK(sim::broker().log()[0].retained);
+
+  // The broker holds a different value (e.g. another client wrote it): corrected.
+  sim::broker().inject("yolouno/h1/status/door/7", "OPEN", true);
+  sim::broker().clearLog();
+  CHECK_EQ(reconnect(), 1u);
+  CHECK(sim::broker().retained().at("yolouno/h1/status/door/7") == "CLOSED");
+
+  // Broker restarted without persistence: a full resync, still paced.
+  sim::broker().dropRetained();
+  CHECK_EQ(reconnect(0), (uint32_t)kDevices);
+  CHECK_EQ(unackedCount(), 0);
+
+  // Topics of other kinds, IDs and houses are not ours to ack.
+  uint8_t on[] = {'O', 'N'};
+  CHECK(!sync.onMessage("yolouno/h2/status/fan/11", on, 2));
+  CHECK(!sync.onMessage("yolouno/h1/controls", on, 2));
+  CHECK(sync.onMessage("yolouno/h1/status/fan/12", on, 2));   // ours, no such device
+
+  // Start times spread over the whole window.
+  unsigned long lo = ~0UL, hi = 0;
+  for (int i = 0; i < 200; i++) {
+    sync.begin(1000, STATE_SYNC_WINDOW_MS);
+    lo = sync.startAtMs() < lo ? sync.startAtMs() : lo;
+    hi = sync.startAtMs() > hi ? sync.startAtMs() : hi;
+  }
+  CHECK(lo < 1000 + STATE_SYNC_WINDOW_MS / 10);
+  CHECK(hi > 1000 + STATE_SYNC_WINDOW_MS * 9 / 10);
+  CHECK_DONE();
+}
@@ -0,0 +1,76 @@
+#include <string.h>
+
+#include <string>
+
+#include "board_sim.h"
+#include "check.h"
+#include "task_scheduler.h"
+
+static std::string trace;
+static TaskScheduler* current;
+static int phasedId = -1;
+
+static void every() {}
+static void fast() { trace += "f"; }
+static void slow() { trace += "s"; }
+static void urgent() { trace += "u"; }
+static void phased() {
+  trace += "p";
+  current->runAfter(phasedId, 5);   // overrides the 1000 ms period
+}
+
+int main() {
+  static TaskScheduler sched;
+  current = &sched;
+  uint64_t allocs = sim::heap().allocs;
+
+  int e = sched.add("every", every, SCHED_EVERY_PASS, 9);
+  int s = sched.add("slow", slow, 100, 1);
+  int f = sched.add("fast", fast, 10, 1);
+  int u = sched.add("urgent", urgent, 100, 5);
+  CHECK(e >= 0 && s >= 0 && f >= 0 && u >= 0);
+  CHECK_EQ(sched.find("fast"), f);
+  CHECK_EQ(sched.find("none"), -1);
+
+  // All due on the first pass: priority first, then registration order.
+  sched.run();
+  CHECK(trace == "usf");
+  CHECK_EQ(sched.idleMs(), 0u);   // an every-pass task is registered
+  CHECK(sched.idleMs(false) > 0 && sched.idleMs(false) <= 10);
+
+  trace.clear();
+  for (int ms = 1; ms <= 100; ms++) {
+    sim::advanceMs(1);
+    sched.run();
+  }
+  CHECK(trace == "fffffffffusf");
+  CHECK_EQ(sched.stats(e).runs, 101u);
+  CHECK_EQ(sched.stats(f).runs, 11u);
+
+  // A task that falls behind runs once, not once per missed period.
+  trace.clear();
+  sim::advanceMs(55);
+  sched.run();
+  CHECK(trace == "f");
+  CHECK(sched.stats(f).maxLateMs >= 45);
+
+  sched.setEnabled(e, false);
+  sched.setPeriod(f, 1000);
+  CHECK(sched.idleMs() > 0 && sched.idleMs() <= 45);
+
+  // runAfter() from inside a task wins over its period.
+  phasedId = sched.add("phased", phased, 1000, 0);
+  trace.clear();
+  sched.run();
+  for (int ms = 0; ms < 12; ms++) {
+    sim::advanceMs(1);
+    sched.run();
+  }
+  CHECK(trace == "ppp");
+
+  while (sched.add("filler", every, 1, 0) >= 0) {}
+  CHECK_EQ(sched.count(), (size_t)SCHED_MAX_TASKS);
+  CHECK_EQ(sim::heap().allocs, allocs);
+
+  CHECK_DONE();
+}
@@ -0,0 +1,106 @@
+// Integer/fixed-point formatting against printf, buffer bounds, and the
+// sketch's sensor payloads after the switch away from dtostrf/sprintf.
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "board_sim.h"
+#include "check.h"
+#include "sketch.h"
+#include "telemetry_format.h"
+
+static bool sameAsPrintf(const char* ours, const char* format, ...) __attribute__((format(printf, 2, 3)));
+static bool sameAsPrintf(const char* ours, const char* format, ...) {
+  char expected[64];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(expected, sizeof(expected), format, args);
+  va_end(args);
+  return strcmp(ours, expected) == 0;
+}
+
+int main() {
+  char text[FIXED_TEXT_MAX + 1];
+  int mismatches = 0;
+  for (int32_t v = -100000; v <= 100000; v += 7) {
+    formatInt(text, v);
+    mismatches += !sameAsPrintf(text, "%ld", (long)v);
+    formatFixed<2>(text, v);
+    mismatches += !sameAsPrintf(text, "%s%ld.%02ld", v < 0 ? "-" : "", labs(v) / 100, labs(v) % 100);
+    formatFixed<1>(text, v);
+    mismatches += !sameAsPrintf(text, "%s%ld.%ld", v < 0 ? "-" : "", labs(v) / 10, labs(v) % 10);
+  }
+  CHECK_EQ(mismatches, 0);
+
+  // The extremes fit the advertised worst cases.
+  CHECK_EQ(formatInt(text, INT32_MIN), INT_TEXT_MAX);
+  CHECK(strcmp(text, "-2147483648") == 0);
+  CHECK_EQ(formatUint(text, UINT32_MAX), UINT_TEXT_MAX);
+  CHECK(strcmp(text, "4294967295") == 0);
+  CHECK(formatFixed<2>(text, INT32_MIN) <= FIXED_TEXT_MAX);
+  CHECK(strcmp(text, "-21474836.48") == 0);
+  CHECK(formatFixed<4>(text, INT32_MAX) <= FIXED_TEXT_MAX);
+  formatFixed<2>(text, -5);
+  CHECK(strcmp(text, "-0.05") == 0);
+  formatFixed<2>(text, 0);
+  CHECK(strcmp(text, "0.00") == 0);
+  CHECK_EQ(formatRgb(text, 0xFF0080), (size_t)9);
+  CHECK(strcmp(text, "255,0,128") == 0);
+  CHECK_EQ(formatRgb(text, 0xFFFFFF), RGB_TEXT_MAX);
+
+  // Rounding matches dtostrf(value, 1, 2) for readings on the sensor grid.
+  for (int i = -4000; i <= 8500; i++) {
+    float reading = i / 100.0f;
+    char expected[16];
+    dtostrf(reading, 1, 2, expected);
+    formatFixed<2>(text, toFixed<2>(reading));
+    mismatches += strcmp(text, expected) != 0;
+  }
+  CHECK_EQ(mismatches, 0);
+
+  TextBuffer<SENSOR_SUMMARY_MAX + 1> summary;
+  CHECK(strcmp(formatSensorSummary(summary, 2750, 6530, 512),
+               "{\"temp\":27.50,\"humi\":65.30,\"light\":512}") == 0);
+  CHECK(summary.ok());
+  CHECK(strcmp(formatSensorSummary(summary, INT32_MIN, INT32_MIN, INT32_MIN),
+               "{\"temp\":-21474836.48,\"humi\":-21474836.48,\"light\":-2147483648}") == 0);
+  CHECK(summary.ok());
+
+  // A field that might not fit is refused whole, and the buffer stays as it was.
+  TextBuffer<16> small;
+  small.literal("abcd").integer(7);
+  CHECK(small.ok());
+  CHECK(strcmp(small.c_str(), "abcd7") == 0);
+  small.integer(1);   // 5 + INT_TEXT_MAX leaves no room for the NUL
+  CHECK(!small.ok());
+  CHECK(strcmp(small.c_str(), "abcd7") == 0);
+  small.clear().rgb(0x010203);
+  CHECK(small.ok());
+  CHECK(strcmp(small.c_str(), "1,2,3") == 0);
+
+  // The sketch publishes the same text it did with dtostrf/sprintf.
+  setup();
+  CHECK(runUntilConnected());
+  sim::broker().clearLog();
+  sim::setAnalog(2, 777);
+  for (int i = 0; i < 20; i++) lights.sample();
+  publishSensorData(27.5f, 65.3f, 512);
+  std::string base = std::string("yolouno/") + HOUSE_ID + "/";
+  int temps = 0, humis = 0;
+  bool light = false, json = false;
+  for (const auto& m : sim::broker().log()) {
+    if (m.topic.compare(0, base.size() + 12, base + "status/temp/") == 0) temps += m.payload == "27.50";
+    if (m.topic.compare(0, base.size() + 12, base + "status/humi/") == 0) humis += m.payload == "65.30";
+    light |= m.topic == base + "status/light/4" && m.payload == "777";
+    json |= m.topic == base + "sensors" && m.payload == "{\"temp\":27.50,\"humi\":65.30,\"light\":512}";
+  }
+  CHECK_EQ(temps, 3);
+  CHECK_EQ(humis, 3);
+  CHECK(light);
+  CHECK(json);
+  CHECK_DONE();
+}
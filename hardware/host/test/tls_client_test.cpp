@@ -0,0 +1,244 @@
+// TLS session resumption against the broker stand-in: a full handshake, then
+// resumed ones from RAM and from flash after a reboot, the cases where the
+// server turns a ticket down, a certificate that does not verify, and a
+// socket that stops taking bytes. Then
+// the sketch over TLS with a persistent MQTT session, riding out a WiFi blip
+// without a full handshake or a lost command.
+#include <LittleFS.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "board_sim.h"
+#include "check.h"
+#include "sketch.h"
+#include "tls_client.h"
+
+namespace {
+
+const char kCa[] =
+    "-----BEGIN CERTIFICATE-----\n"
+    "MIIBszCCAVmgAwIBAgIUb3RoZXJ3aXNlIGVtcHR5IHRlc3QgQ0EwCgYIKoZIzj0E\n"
+    "-----END CERTIFICATE-----\n";
+const char kHost[] = "mqtt.house.local";
+const uint16_t kPort = 8883;
+
+// TCP whose send buffer can be made to stay full.
+class StallingClient : public WiFiClient {
+ public:
+  bool stalled = false;
+  using WiFiClient::write;
+  size_t write(const uint8_t* buf, size_t size) override {
+    return stalled ? 0 : WiFiClient::write(buf, size);
+  }
+};
+
+struct Attempt {
+  bool ok;
+  uint64_t us;
+  int64_t peakBytes;   // above the heap in use before connect()
+};
+
+Attempt attempt(TlsClient& tls, const char* host = kHost, uint16_t port = kPort) {
+  sim::resetHeapPeak();
+  int64_t base = sim::heap().liveBytes;
+  uint64_t start = sim::nowUs();
+  bool ok = tls.connect(host, port) == 1;
+  return {ok, sim::nowUs() - start, sim::heap().peakLiveBytes - base};
+}
+
+}  // namespace
+
+int main() {
+  WiFi.begin("house", "secret");
+  sim::advanceMs(sim::wifi().associateMs);
+  CHECK(LittleFS.begin(true));
+  WiFiClient tcp;
+  const sim::TlsServerState& server = sim::tls();
+
+  // No CA, no connection: there is no unverified mode.
+  TlsClient bare(tcp);
+  CHECK_EQ(bare.connect(kHost, kPort), 0);
+  CHECK_EQ(server.fullHandshakes, 0u);
+
+  // First contact: a full handshake, and its session saved.
+  TlsSessionCache cache;
+  cache.begin(&LittleFS);
+  CHECK_EQ(cache.size(), (size_t)0);
+  TlsClient tls(tcp);
+  tls.setCACert(kCa);
+  tls.setSessionCache(&cache);
+  Attempt full = attempt(tls);
+  CHECK(full.ok);
+  CHECK(tls.connected());
+  CHECK(!tls.offeredSession());
+  CHECK_EQ(server.fullHandshakes, 1u);
+  CHECK(cache.size() > 0);
+  CHECK_EQ(cache.flashWrites(), 1u);
+  CHECK(sim::flash().files.count(TLS_SESSION_PATH) == 1);
+  CHECK(sim::flash().files.count(TLS_SESSION_TMP_PATH) == 0);
+
+  // Reconnect: the ticket resumes, in a fraction of the time and heap, and
+  // the unchanged session is not written again. Nothing leaks across stop().
+  int64_t idle = sim::heap().liveBytes;
+  tls.stop();
+  CHECK(!tls.connected());
+  int64_t closed = sim::heap().liveBytes;
+  CHECK(closed < idle);
+  Attempt resumed = attempt(tls);
+  CHECK(resumed.ok);
+  CHECK(tls.offeredSession());
+  CHECK_EQ(server.resumedHandshakes, 1u);
+  CHECK_EQ(server.fullHandshakes, 1u);
+  CHECK(resumed.us * 10 < full.us);
+  CHECK(resumed.peakBytes + 15000 < full.peakBytes);
+  CHECK_EQ(cache.flashWrites(), 1u);
+  tls.stop();
+  CHECK_EQ(sim::heap().liveBytes, closed);
+  printf("full %.0f ms / %lld B peak, resumed %.0f ms / %lld B peak\n", full.us / 1000.0,
+         (long long)full.peakBytes, resumed.us / 1000.0, (long long)resumed.peakBytes);
+
+  // The session belongs to its host and port.
+  Attempt other = attempt(tls, kHost, 8884);
+  CHECK(other.ok);
+  CHECK(!tls.offeredSession());
+  tls.stop();
+  CHECK(attempt(tls).ok);
+  CHECK(!tls.offeredSession());
+  CHECK_EQ(server.fullHandshakes, 3u);
+  tls.stop();
+
+  // After a reboot: a new cache finds the session on flash and resumes.
+  {
+    TlsSessionCache rebooted;
+    rebooted.begin(&LittleFS);
+    CHECK_EQ(rebooted.size(), cache.size());
+    TlsClient fresh(tcp);
+    fresh.setCACert(kCa);
+    fresh.setSessionCache(&rebooted);
+    CHECK(attempt(fresh).ok);
+    CHECK(fresh.offeredSession());
+    CHECK_EQ(server.resumedHandshakes, 2u);
+  }
+
+  // A damaged file is ignored.
+  {
+    std::vector<uint8_t> good = sim::flash().files[TLS_SESSION_PATH];
+    sim::flash().files[TLS_SESSION_PATH][TLS_SESSION_HEADER_SIZE + 20] ^= 0x40;
+    TlsSessionCache damaged;
+    damaged.begin(&LittleFS);
+    CHECK_EQ(damaged.size(), (size_t)0);
+    sim::flash().files[TLS_SESSION_PATH].resize(good.size() - 1);
+    damaged.begin(&LittleFS);
+    CHECK_EQ(damaged.size(), (size_t)0);
+    sim::flash().files[TLS_SESSION_PATH] = good;
+  }
+
+  // Tickets the server turns down fall back to a full handshake, whose new
+  // session replaces the old one: past its lifetime...
+  sim::advanceUs((uint64_t)server.ticketLifetimeS * 1000000ULL);
+  CHECK(attempt(tls).ok);
+  CHECK(tls.offeredSession());
+  CHECK_EQ(server.fullHandshakes, 4u);
+  CHECK_EQ(cache.flashWrites(), 4u);
+  tls.stop();
+  CHECK(attempt(tls).ok);
+  CHECK_EQ(server.resumedHandshakes, 3u);
+  tls.stop();
+  // ...after a broker restart with a new ticket key...
+  sim::tls().rotateTicketKey();
+  CHECK(attempt(tls).ok);
+  CHECK_EQ(server.fullHandshakes, 5u);
+  tls.stop();
+  CHECK(attempt(tls).ok);
+  CHECK_EQ(server.resumedHandshakes, 4u);
+  tls.stop();
+  // ...and from a server without tickets, which leaves nothing to offer.
+  sim::tls().tickets = false;
+  CHECK(attempt(tls).ok);
+  CHECK_EQ(server.fullHandshakes, 6u);
+  CHECK_EQ(cache.size(), (size_t)0);
+  CHECK(sim::flash().files.count(TLS_SESSION_PATH) == 0);
+  tls.stop();
+  CHECK(attempt(tls).ok);
+  CHECK(!tls.offeredSession());
+  tls.stop();
+  sim::tls().tickets = true;
+
+  // A chain that does not verify against the CA: refused, nothing kept.
+  sim::tls().certTrusted = false;
+  Attempt untrusted = attempt(tls);
+  CHECK(!untrusted.ok);
+  CHECK_EQ(tls.lastError(), MBEDTLS_ERR_X509_CERT_VERIFY_FAILED);
+  CHECK(!tls.connected());
+  CHECK_EQ(sim::heap().liveBytes, closed);
+  CHECK_EQ(server.failedHandshakes, 1u);
+  sim::tls().certTrusted = true;
+
+  // The broker unreachable: the TCP connect fails, no handshake is tried.
+  sim::broker().setOutage(sim::nowUs(), sim::nowUs() + 1000000);
+  CHECK(!attempt(tls).ok);
+  CHECK_EQ(tls.lastError(), MBEDTLS_ERR_NET_CONN_RESET);
+  CHECK_EQ(server.failedHandshakes, 1u);
+  sim::advanceMs(1000);
+
+  // A socket that stops taking bytes: write() gives up after the timeout,
+  // with the loop let run in between, and the connection counts as closed.
+  {
+    StallingClient stalling;
+    TlsClient stuck(stalling);
+    stuck.setCACert(kCa);
+    CHECK(stuck.connect(kHost, kPort) == 1);
+    const uint8_t packet[] = {0x30, 0x02, 0x00, 0x00};
+    CHECK_EQ(stuck.write(packet, sizeof(packet)), sizeof(packet));
+    stalling.stalled = true;
+    uint64_t start = sim::nowUs();
+    CHECK_EQ(stuck.write(packet, sizeof(packet)), (size_t)0);
+    CHECK(sim::nowUs() - start >= TLS_WRITE_TIMEOUT_MS * 1000ULL);
+    CHECK(sim::nowUs() - start < (TLS_WRITE_TIMEOUT_MS + 100) * 1000ULL);
+    CHECK_EQ(stuck.lastError(), MBEDTLS_ERR_SSL_TIMEOUT);
+    CHECK(!stuck.connected());
+    CHECK_EQ(stuck.write(packet, sizeof(packet)), (size_t)0);
+  }
+
+  // The sketch over TLS: port 8883, its own client ID, one full handshake.
+  sim::resetBoard();
+  sim::flash().files[TLS_CA_PATH] = std::vector<uint8_t>(kCa, kCa + sizeof(kCa) - 1);
+  mqttTls = 1;
+  setup();
+  CHECK(runUntilConnected());
+  CHECK_EQ(config.mqttPort, 8883);
+  CHECK(std::string(mqttClientId) == std::string("yolouno-") + HOUSE_ID);
+  CHECK_EQ(server.fullHandshakes, 1u);
+  CHECK_EQ(server.resumedHandshakes, 0u);
+  unsigned long fullConnectMs = connection.lastConnectMs();
+
+  // A 5 s WiFi blip, and a fan command sent while the house is away: the
+  // broker keeps it for the session, the ticket resumes, the fan turns on.
+  sim::wifi().downUntilUs = sim::nowUs() + 5000000ULL;
+  for (int i = 0; i < 100 && connection.mqttUp(); i++) {
+    loop();
+    sim::advanceMs(1);
+  }
+  CHECK(!connection.mqttUp());
+  {
+    sim::UncountedHeap guard;
+    sim::broker().inject(std::string("yolouno/") + HOUSE_ID + "/controls",
+                         std::string(HOUSE_ID) + ":fan:12:ON", false, sim::nowUs());
+  }
+  CHECK_EQ(sim::broker().stats().queuedOffline, 1u);
+  CHECK(runUntilConnected());
+  CHECK_EQ(server.fullHandshakes, 1u);
+  CHECK_EQ(server.resumedHandshakes, 1u);
+  CHECK_EQ(sim::broker().stats().resumedSessions, 1u);
+  CHECK(connection.lastConnectMs() * 10 < fullConnectMs);
+  for (int i = 0; i < 100 && sim::digitalLevel(10) != HIGH; i++) {
+    loop();
+    sim::advanceMs(1);
+  }
+  CHECK_EQ(sim::digitalLevel(10), HIGH);
+  printf("sketch: connect %lu ms full, %lu ms resumed\n", fullConnectMs,
+         connection.lastConnectMs());
+  CHECK_DONE();
+}
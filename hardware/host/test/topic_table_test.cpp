@@ -0,0 +1,87 @@
+#include <string.h>
+
+#include <string>
+
+#include "check.h"
+#include "topic_table.h"
+
+static const TopicIdRange ranges[STATUS_KIND_COUNT] = {
+  {7, 10}, {1, 1}, {11, 13}, {14, 16}, {1, 3}, {1, 3}, {4, 6},
+};
+
+int main() {
+  static TopicTable table;
+  const char* house = "e0f1ba9c-aa1d-452e-b928-d2cc3c5eedf6";
+  CHECK(table.build(house, ranges));
+
+  std::string prefix = std::string("yolouno/") + house + "/";
+  CHECK(prefix + "controls" == table.controls());
+  CHECK(prefix + "sensors" == table.sensors());
+  CHECK(prefix + "status/device" == table.deviceStatus());
+  CHECK(prefix + "sensors/frame" == table.sensorFrame());
+  CHECK(prefix + "sensors/backlog" == table.sensorBacklog());
+  CHECK(prefix + "sensors/rollup" == table.sensorRollup());
+  CHECK(prefix + "sensors/stream" == table.sensorStream());
+  CHECK(table.isSensorStreamTopic((prefix + "sensors/stream").c_str()));
+  CHECK(!table.isSensorStreamTopic((prefix + "sensors/rollup").c_str()));
+  CHECK(prefix + "acks" == table.acks());
+  CHECK(prefix + "rules" == table.rules());
+  CHECK(prefix + "diagnostics" == table.diagnostics());
+  CHECK(table.isRulesTopic((prefix + "rules").c_str()));
+  CHECK(!table.isRulesTopic((prefix + "config").c_str()));
+  CHECK(prefix + "ota" == table.ota());
+  CHECK(table.isOtaTopic((prefix + "ota").c_str()));
+  CHECK(!table.isOtaTopic((prefix + "rules").c_str()));
+  CHECK(prefix + "status/door/7" == table.status(STATUS_DOOR, 7));
+  CHECK(prefix + "status/door/10" == table.status(STATUS_DOOR, 10));
+  CHECK(prefix + "status/alarm/1" == table.status(STATUS_ALARM, 1));
+  CHECK(prefix + "status/rgb/16" == table.status(STATUS_RGB, 16));
+  CHECK(prefix + "status/light/4" == table.status(STATUS_LIGHT, 4));
+  CHECK(prefix + "status/humi/3" == table.status(STATUS_HUMI, 3));
+
+  CHECK(table.status(STATUS_DOOR, 6) == nullptr);
+  CHECK(table.status(STATUS_DOOR, 11) == nullptr);
+  CHECK(table.status(STATUS_ALARM, 2) == nullptr);
+
+  CHECK(table.isControlTopic((prefix + "controls").c_str()));
+  CHECK(!table.isControlTopic((prefix + "controls/x").c_str()));
+  CHECK(!table.isControlTopic((prefix + "control").c_str()));
+
+  StatusTopic kind;
+  int id = 0;
+  CHECK(table.findStatus((prefix + "status/door/10").c_str(), &kind, &id));
+  CHECK_EQ(kind, STATUS_DOOR);
+  CHECK_EQ(id, 10);
+  CHECK(table.findStatus((prefix + "status/alarm/1").c_str(), &kind, &id));
+  CHECK_EQ(kind, STATUS_ALARM);
+  CHECK(!table.findStatus((prefix + "status/door/11").c_str(), &kind, &id));
+  CHECK(!table.findStatus((prefix + "status/door/7/x").c_str(), &kind, &id));
+  CHECK(!table.findStatus((prefix + "status/door/").c_str(), &kind, &id));
+  CHECK(!table.findStatus((prefix + "status/device").c_str(), &kind, &id));
+  CHECK(!table.findStatus("yolouno/other/status/door/7", &kind, &id));
+
+  char filter[96];
+  CHECK(table.statusFilter(STATUS_RGB, filter, sizeof(filter)));
+  CHECK(prefix + "status/rgb/+" == filter);
+  CHECK(!table.statusFilter(STATUS_RGB, filter, 20));
+
+  // A house id that cannot fit is refused, never truncated.
+  std::string huge(TOPIC_ARENA_SIZE, 'h');
+  CHECK(!table.build(huge.c_str(), ranges));
+  CHECK(strcmp(table.controls(), "") == 0);
+  CHECK(table.status(STATUS_DOOR, 7) == nullptr);
+  CHECK(!table.isControlTopic(""));
+  CHECK(!table.findStatus("yolouno//status/door/7", &kind, &id));
+
+  // fits() counts every digit of an ID the way build() writes it, so the two
+  // agree at the arena limit even for IDs past 999.
+  const TopicIdRange wide[STATUS_KIND_COUNT] = {
+    {1000000000, 1000000003}, {1, 1}, {100000, 100002}, {10000, 10002}, {1, 3}, {1, 3}, {4, 6},
+  };
+  for (size_t len = 1; len < 64; len++) {
+    std::string h(len, 'h');
+    CHECK_EQ(TopicTable::fits(h.c_str(), wide), table.build(h.c_str(), wide));
+  }
+
+  CHECK_DONE();
+}
@@ -0,0 +1,84 @@
+#include "input_events.h"
+
+#include <Arduino.h>
+
+#define THRESHOLD_UNKNOWN 0xFF
+
+void InputCapture::begin(TaskHandle_t notify) {
+  notify_ = notify;
+}
+
+int InputCapture::watchPin(uint8_t pin, uint8_t mode) {
+  if (pinCount_ >= INPUT_MAX_PINS) return -1;
+  WatchedPin& w = pins_[pinCount_];
+  w.owner = this;
+  w.pin = pin;
+  w.channel = pinCount_;
+  pinMode(pin, mode);
+  attachInterruptArg(digitalPinToInterrupt(pin), onEdge, &w, CHANGE);
+  return pinCount_++;
+}
+
+int InputCapture::watchThreshold(uint16_t below, uint16_t above) {
+  if (thresholdCount_ >= INPUT_MAX_THRESHOLDS || below >= above) return -1;
+  below_[thresholdCount_] = below;
+  above_[thresholdCount_] = above;
+  side_[thresholdCount_] = THRESHOLD_UNKNOWN;
+  return thresholdCount_++;
+}
+
+void IRAM_ATTR InputCapture::push(const InputEvent& event) {
+  if (queue_.push(event)) {
+    captured_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    overflows_.fetch_add(1, std::memory_order_relaxed);
+    resync_.store(true, std::memory_order_release);
+  }
+}
+
+void IRAM_ATTR InputCapture::onEdge(void* arg) {
+  const WatchedPin* w = (const WatchedPin*)arg;
+  InputCapture* self = w->owner;
+  // The level now, not the edge's direction: after a burst of bounces the
+  // last event is always the level the pin settled at.
+  InputEvent event = {(uint32_t)micros(), INPUT_PIN, w->channel, (uint8_t)digitalRead(w->pin)};
+  self->push(event);
+  if (self->notify_) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(self->notify_, &woken);
+    if (woken) portYIELD_FROM_ISR();
+  }
+}
+
+void InputCapture::sampleThreshold(int channel, uint16_t value) {
+  if (channel < 0 || channel >= thresholdCount_) return;
+  uint8_t side = side_[channel];
+  if (side == THRESHOLD_UNKNOWN) {
+    side_[channel] = value >= above_[channel] ? 1 : 0;
+    return;
+  }
+  if (side == 0 && value >= above_[channel]) {
+    side = 1;
+  } else if (side == 1 && value <= below_[channel]) {
+    side = 0;
+  } else {
+    return;
+  }
+  side_[channel] = side;
+  push(InputEvent{(uint32_t)micros(), INPUT_THRESHOLD, (uint8_t)channel, side});
+}
+
+bool InputCapture::pop(InputEvent& out) {
+  if (queue_.pop(out)) return true;
+  if (!resync_.exchange(false, std::memory_order_acq_rel)) return false;
+  // Edges after this point queue behind the levels read here. Not counted
+  // as captured: they are readings, not edges.
+  uint32_t now = (uint32_t)micros();
+  for (uint8_t c = 0; c < pinCount_; c++) {
+    if (!queue_.push(InputEvent{now, INPUT_PIN, c, (uint8_t)digitalRead(pins_[c].pin)})) {
+      resync_.store(true, std::memory_order_release);
+      break;
+    }
+  }
+  return queue_.pop(out);
+}
@@ -0,0 +1,94 @@
+// Input changes captured as they happen: GPIO edges (door reed switches,
+// buttons) by interrupt, light-level threshold crossings from the sampler.
+//
+// Each change becomes a timestamped InputEvent on one lock-free queue
+// (mpsc_queue.h) that the loop task drains. A pin's interrupt handler reads
+// the new level, pushes it with micros() and notifies the loop task, so a
+// loop() waiting in modem sleep (power_manager.h) wakes at once instead of at
+// its latency bound. Draining an empty queue costs one atomic load per pass,
+// so nothing is polled faster than before.
+//
+// ADC channels have no interrupt here (the sampler reads them in one-shot
+// bursts): sampleThreshold() is called with each filtered reading and pushes
+// an event when it leaves its hysteresis band.
+//
+// When the queue is full an edge is counted in overflows() and a resync is
+// requested: once the queue is drained, pop() reports every pin's current
+// level. A storm longer than the queue loses intermediate edges, never the
+// final state. resync() asks for the same by hand, e.g. after light sleep,
+// when interrupts do not run.
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "mpsc_queue.h"
+
+#define INPUT_MAX_PINS 8
+#define INPUT_MAX_THRESHOLDS 4
+#define INPUT_QUEUE_SIZE 64
+
+enum InputSource : uint8_t {
+  INPUT_PIN,         // a GPIO level change
+  INPUT_THRESHOLD,   // an analog reading crossed its band
+};
+
+struct InputEvent {
+  uint32_t atUs;        // micros() of the edge / the reading
+  InputSource source;
+  uint8_t channel;      // as returned by watchPin() / watchThreshold()
+  uint8_t level;        // pin: its level; threshold: 1 above the band, 0 below
+};
+
+class InputCapture {
+ public:
+  // notify: the task woken by every edge (the loop task); NULL for none.
+  void begin(TaskHandle_t notify);
+
+  // Attaches a CHANGE interrupt to pin. Returns its channel, or -1 if
+  // INPUT_MAX_PINS pins are watched already.
+  int watchPin(uint8_t pin, uint8_t mode);
+  // A reading rises at >= above and falls at <= below. Returns the channel,
+  // or -1 if the table is full or the band is empty.
+  int watchThreshold(uint16_t below, uint16_t above);
+
+  // Task side: the latest reading of a threshold channel. The first reading
+  // only sets the side of the band the channel is on.
+  void sampleThreshold(int channel, uint16_t value);
+
+  // Consumer: the oldest event; false when there is none.
+  bool pop(InputEvent& out);
+  // Report every pin's current level once the queue is drained.
+  void resync() { resync_.store(true, std::memory_order_release); }
+
+  uint8_t pin(int channel) const { return pins_[channel].pin; }
+  size_t pins() const { return pinCount_; }
+  uint32_t captured() const { return captured_.load(std::memory_order_relaxed); }
+  uint32_t overflows() const { return overflows_.load(std::memory_order_relaxed); }
+
+ private:
+  struct WatchedPin {
+    InputCapture* owner;
+    uint8_t pin;
+    uint8_t channel;
+  };
+
+  static void onEdge(void* arg);   // the interrupt handler, in IRAM
+  void push(const InputEvent& event);   // in IRAM, inlines MpscQueue::push
+
+  MpscQueue<InputEvent, INPUT_QUEUE_SIZE> queue_;
+  TaskHandle_t notify_ = nullptr;
+  WatchedPin pins_[INPUT_MAX_PINS];
+  uint8_t pinCount_ = 0;
+  uint16_t below_[INPUT_MAX_THRESHOLDS];
+  uint16_t above_[INPUT_MAX_THRESHOLDS];
+  uint8_t side_[INPUT_MAX_THRESHOLDS];     // 0/1, or 0xFF before the first reading
+  uint8_t thresholdCount_ = 0;
+  std::atomic<bool> resync_{false};
+  std::atomic<uint32_t> captured_{0};
+  std::atomic<uint32_t> overflows_{0};
+};
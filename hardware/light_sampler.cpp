@@ -0,0 +1,58 @@
+#include "light_sampler.h"
+
+#include <Arduino.h>
+
+static_assert(LIGHT_OVERSAMPLE >= 4 && LIGHT_OVERSAMPLE % 4 == 0,
+              "the middle half of a burst must be a whole number of samples");
+
+LightSampler::LightSampler(const uint8_t pins[LIGHT_SAMPLER_CHANNELS]) {
+  for (int c = 0; c < LIGHT_SAMPLER_CHANNELS; c++) pins_[c] = pins[c];
+}
+
+uint16_t LightSampler::reduceBurst(uint16_t* samples) {
+  for (int i = 1; i < LIGHT_OVERSAMPLE; i++) {
+    uint16_t v = samples[i];
+    int j = i - 1;
+    while (j >= 0 && samples[j] > v) {
+      samples[j + 1] = samples[j];
+      j--;
+    }
+    samples[j + 1] = v;
+  }
+  uint32_t sum = 0;
+  for (int i = LIGHT_OVERSAMPLE / 4; i < LIGHT_OVERSAMPLE * 3 / 4; i++) sum += samples[i];
+  return (uint16_t)((sum + LIGHT_OVERSAMPLE / 4) / (LIGHT_OVERSAMPLE / 2));
+}
+
+void LightSampler::sample() {
+  uint16_t raw[LIGHT_SAMPLER_CHANNELS][LIGHT_OVERSAMPLE];
+  // Interleaved so every channel sees the same stretch of supply noise.
+  for (int i = 0; i < LIGHT_OVERSAMPLE; i++) {
+    for (int c = 0; c < LIGHT_SAMPLER_CHANNELS; c++) raw[c][i] = (uint16_t)analogRead(pins_[c]);
+  }
+
+  for (int c = 0; c < LIGHT_SAMPLER_CHANNELS; c++) {
+    uint32_t reading = (uint32_t)reduceBurst(raw[c]) << 8;
+    if (snapshot_.bursts == 0) {
+      ema_[c] = reading;
+    } else if (reading >= ema_[c]) {
+      ema_[c] += (reading - ema_[c]) >> LIGHT_EMA_SHIFT;
+    } else {
+      ema_[c] -= (ema_[c] - reading) >> LIGHT_EMA_SHIFT;
+    }
+    snapshot_.value[c] = (uint16_t)((ema_[c] + 128) >> 8);
+  }
+  snapshot_.atMs = millis();
+  snapshot_.bursts++;
+}
+
+void LightSampler::begin() {
+  snapshot_.bursts = 0;
+  sample();
+}
+
+bool LightSampler::service() {
+  if (snapshot_.bursts != 0 && millis() - snapshot_.atMs < LIGHT_SAMPLE_INTERVAL_MS) return false;
+  sample();
+  return true;
+}
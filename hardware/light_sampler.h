@@ -0,0 +1,44 @@
+// Filtered light-sensor readings, sampled on a fixed cadence.
+//
+// Every LIGHT_SAMPLE_INTERVAL_MS, service() reads all channels in one tight
+// burst of LIGHT_OVERSAMPLE interleaved analogRead()s. Each channel's burst is
+// reduced to the mean of its middle half (a median that still averages), then
+// smoothed by an EMA with alpha = 1/2^LIGHT_EMA_SHIFT, all in integer
+// fixed-point. The result is one snapshot that the LCD and the publisher both
+// read, so they never disagree and no caller touches the ADC itself.
+#pragma once
+
+#include <stdint.h>
+
+#define LIGHT_SAMPLER_CHANNELS 3
+#define LIGHT_OVERSAMPLE 8            // raw reads per channel per burst
+#define LIGHT_EMA_SHIFT 1             // alpha = 1/2
+#define LIGHT_SAMPLE_INTERVAL_MS 100
+
+struct LightSnapshot {
+  uint16_t value[LIGHT_SAMPLER_CHANNELS];  // filtered raw ADC counts
+  uint32_t atMs;                           // millis() of the burst
+  uint32_t bursts;                         // 0 until the first burst
+};
+
+class LightSampler {
+ public:
+  explicit LightSampler(const uint8_t pins[LIGHT_SAMPLER_CHANNELS]);
+
+  // Takes a burst now and seeds the filter with it.
+  void begin();
+  // Takes a burst when one is due; returns true if it did.
+  bool service();
+  // Takes a burst now, for callers that keep the cadence themselves.
+  void sample();
+
+  const LightSnapshot& snapshot() const { return snapshot_; }
+
+  // One burst's reduction of LIGHT_OVERSAMPLE raw samples (sorted in place).
+  static uint16_t reduceBurst(uint16_t* samples);
+
+ private:
+  uint8_t pins_[LIGHT_SAMPLER_CHANNELS];
+  uint32_t ema_[LIGHT_SAMPLER_CHANNELS] = {};  // Q8 fixed-point counts
+  LightSnapshot snapshot_ = {};
+};
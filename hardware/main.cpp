@@ -2,6 +2,9 @@
 #define SDA_PIN GPIO_NUM_11
 #define SCL_PIN GPIO_NUM_12
 #define MQTT_MAX_PACKET_SIZE 1024
+// ID, chân, khoảng thời gian và thông tin mạng dưới đây chỉ là cấu hình mặc
+// định: mỗi nhà nạp cấu hình riêng từ flash (xem device_config.h), cùng một
+// firmware cho mọi nhà.
 #define TEMP_HUMI_ID_MIN 1
 #define TEMP_HUMI_ID_MAX 3
 #define LIGHT_ID_MIN 4
@@ -12,6 +15,7 @@
 #define FAN_ID_MAX 13
 #define RGB_ID_MIN 14
 #define RGB_ID_MAX 16
+#define ALARM_ID 1
 //Pindefine
 #define luxPin1 2   // Pin cho cảm biến ánh sáng 1 (ID 4)
 #define luxPin2 3   // Pin cho cảm biến ánh sáng 2 (ID 5)
@@ -26,6 +30,117 @@
 #define FAN_PIN_2 10       // Pin điều khiển quạt 2
 
 #define TEMP_THRESHOLD 50.0 
+#define ALARM_CLEAR_HOLD_MS 60000UL      // Tắt báo động khi nhiệt độ dưới ngưỡng đủ 60s
+
+// Định dạng gửi dữ liệu cảm biến. Mặc định giữ 10 topic text như cũ;
+// SENSOR_PUBLISH_FRAME gửi một frame nhị phân duy nhất mỗi chu kỳ,
+// SENSOR_PUBLISH_BOTH gửi cả hai trong lúc chuyển đổi consumer.
+#define SENSOR_PUBLISH_TOPICS 0
+#define SENSOR_PUBLISH_FRAME 1
+#define SENSOR_PUBLISH_BOTH 2
+#ifndef SENSOR_PUBLISH_MODE
+#define SENSOR_PUBLISH_MODE SENSOR_PUBLISH_TOPICS
+#endif
+
+// Mẫu đo khi mất MQTT được giữ lại (xem sample_buffer.h) và gửi bù theo lô
+// trên yolouno/<house>/sensors/backlog, tối đa SAMPLE_DRAIN_BATCH frame mỗi
+// SAMPLE_DRAIN_INTERVAL_MS để không dồn broker/backend sau khi kết nối lại.
+#ifndef SAMPLE_SPILL_FLASH
+#define SAMPLE_SPILL_FLASH 1      // 0: chỉ giữ trong RAM
+#endif
+#define SAMPLE_DRAIN_BATCH 8
+#define SAMPLE_DRAIN_INTERVAL_MS 250
+
+// Báo cáo theo thay đổi (xem report_policy.h): lấy mẫu mỗi
+// SENSOR_SAMPLE_INTERVAL_MS, chỉ gửi kênh nào lệch quá deadband, im lặng quá
+// REPORT_MAX_SILENCE_MS, hoặc vừa vượt ngưỡng báo động (gửi ngay).
+#define SENSOR_SAMPLE_INTERVAL_MS 2000
+#define REPORT_MAX_SILENCE_MS 300000UL   // 5 phút
+#define TEMP_DEADBAND_CENTI 30           // 0.3 °C
+#define HUMI_DEADBAND_CENTI 100          // 1 %
+#define LIGHT_DEADBAND_RAW 80            // ~2% thang ADC 12 bit
+
+// Thống kê theo cửa sổ (xem sensor_rollup.h): mỗi kênh được cộng dồn ở nhịp
+// lấy mẫu (ánh sáng mỗi LIGHT_SAMPLE_INTERVAL_MS, nhiệt độ/độ ẩm mỗi lần đọc
+// DHT20); hết mỗi cửa sổ gửi một bản min/max/trung bình/số mẫu lên
+// yolouno/<house>/sensors/rollup. SENSOR_RAW_STREAM 0 tắt gửi số đo thô (chỉ
+// còn vượt ngưỡng báo động); backend bật lại tạm thời bằng cách gửi số giây
+// tới yolouno/<house>/sensors/stream ("0" để tắt sớm).
+#define ROLLUP_WINDOW_1_MS 60000UL       // 1 phút
+#define ROLLUP_WINDOW_2_MS 900000UL      // 15 phút
+#ifndef SENSOR_RAW_STREAM
+#define SENSOR_RAW_STREAM 1              // Mặc định vẫn gửi số đo thô như cũ
+#endif
+#define RAW_STREAM_MAX_S 3600            // Yêu cầu gửi thô dài nhất
+
+// DHT20 đọc hai pha (xem climate_sensor.h); LCD báo "--" nếu số đo cũ hơn
+// CLIMATE_STALE_CYCLES chu kỳ đo
+#define CLIMATE_STALE_CYCLES 3
+
+// Đèn và LCD chỉ vẽ vào framebuffer (xem display_renderer.h); task "render"
+// gửi phần thay đổi mỗi RENDER_INTERVAL_MS, tối đa LCD_FLUSH_BUDGET_BYTES byte
+// I2C mỗi lượt (~4.4 ms) để lệnh điều khiển không phải chờ màn hình.
+#define RENDER_INTERVAL_MS 20
+#define LCD_FLUSH_BUDGET_BYTES 8
+#define LCD_SPLASH_MS 2000               // Màn hình chào, không chặn setup()
+
+#define STATE_SYNC_INTERVAL_MS 50        // Nhịp gửi trạng thái sau khi kết nối lại
+
+// Chạy trên cả hai nhân ESP32-S3 (tùy chọn): WiFi/MQTT ở một task riêng trên
+// IO_TASK_CORE, cảm biến/cơ cấu chấp hành ở loop() (nhân 1). Hai bên chỉ trao
+// đổi qua hàng đợi SPSC không khóa (xem core_link.h). Mặc định 0: một loop().
+#ifndef DUAL_CORE_MODE
+#define DUAL_CORE_MODE 0
+#endif
+#define IO_TASK_CORE 0
+#define IO_TASK_STACK 8192
+#define IO_TASK_PRIORITY 1
+
+// Số đo chẩn đoán (xem metrics.h): thời gian loop(), độ trễ lệnh, publish
+// thành công/thất bại, heap, stack; gửi lên yolouno/<house>/diagnostics
+#define METRICS_INTERVAL_MS 60000UL
+
+// Tiết kiệm điện (xem power_manager.h): giữa các việc đã lên lịch, loop() ngủ
+// (light sleep hoặc modem sleep) tới hạn kế tiếp thay vì quay vòng. Lệnh MQTT
+// đánh thức qua WiFi; POWER_MAX_LATENCY_MS là thời gian ngủ tối đa mỗi lần,
+// tức độ trễ lệnh tối đa nếu không có nguồn đánh thức nào khác.
+#ifndef POWER_MODE
+#define POWER_MODE POWER_ALWAYS_ON
+#endif
+#define POWER_MAX_LATENCY_MS 100
+#define POWER_WAKE_PIN POWER_NO_WAKE_PIN   // Chân GPIO đánh thức (mức thấp), vd. nút bấm
+
+// Sự kiện đầu vào (xem input_events.h): công tắc từ của cửa báo bằng ngắt
+// GPIO, không quét chân. Công tắc nối GND, kéo lên trong chip: LOW = cửa
+// đóng (nam châm áp sát), HIGH = mở. Cửa mở/đóng bằng tay được cập nhật vào
+// bảng thiết bị và gửi lên MQTT trong vài ms. Mạch gốc không có công tắc
+// (chân bỏ trống đọc HIGH, tức "mở"), nên mặc định tắt: đặt DOOR_SENSE 1 khi
+// đã lắp. Sau một lệnh, công tắc của cửa đó bị bỏ qua DOOR_MOVE_MS trong lúc
+// servo quay, rồi đọc lại: cửa bị kẹt/giữ lại được báo đúng trạng thái thật.
+#ifndef DOOR_SENSE
+#define DOOR_SENSE 0
+#endif
+#define DOOR_MOVE_MS 1000
+#define DOOR_SENSE_PIN_1 13
+#define DOOR_SENSE_PIN_2 14
+#define DOOR_SENSE_PIN_3 15
+#define DOOR_SENSE_PIN_4 16
+// Ánh sáng vượt ngưỡng (có trễ) được gửi ngay và chạy luật ngay, không chờ
+// chu kỳ báo cáo
+#define LIGHT_BRIGHT_RAW 2200
+#define LIGHT_DARK_RAW 1800
+
+// Cập nhật firmware (xem ota_update.h): bản vá delta so với firmware đang chạy,
+// gửi từng đoạn qua yolouno/<house>/ota, ghi vào slot app còn lại rồi khởi
+// động lại. Firmware mới phải kết nối MQTT ổn định trong OTA_TRIAL_MS, không
+// thì tự quay về bản cũ. Bản vá không có chữ ký (hash chỉ chống hỏng dữ
+// liệu), nên mặc định tắt: chỉ nhận qua MQTT khi bật OTA_MQTT và MQTT_TLS
+// (broker đã xác thực, chỉ bên có quyền ghi topic mới gửi được). Định nghĩa
+// OTA_PASSWORD để bật thêm ArduinoOTA (nạp nguyên image qua mạng LAN, cũng
+// phải qua thử nghiệm như trên).
+#ifndef OTA_MQTT
+#define OTA_MQTT 0
+#endif
 
 #include <WiFi.h>
 #include <Arduino_MQTT_Client.h>
@@ -37,102 +152,356 @@
 #include <PubSubClient.h>
 #include <ESP32Servo.h>  
 #include <LiquidCrystal_I2C.h>
+#include <LittleFS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+#include "command_parser.h"
+#include "topic_table.h"
+#include "sensor_frame.h"
+#include "connection_manager.h"
+#include "sample_buffer.h"
+#include "report_policy.h"
+#include "light_sampler.h"
+#include "task_scheduler.h"
+#include "core_link.h"
+#include "display_renderer.h"
+#include "device_registry.h"
+#include "device_config.h"
+#include "state_sync.h"
+#include "command_pipeline.h"
+#include "rule_engine.h"
+#include "telemetry_format.h"
+#include "metrics.h"
+#include "power_manager.h"
+#include "input_events.h"
+#include "climate_sensor.h"
+#include "ota_update.h"
+#include "sensor_rollup.h"
+#include "tls_client.h"
 
 WiFiClient wifiClient;
-PubSubClient client(wifiClient);
+TlsClient tlsClient(wifiClient);     // MQTT qua TLS, chạy trên wifiClient
+TlsSessionCache tlsSessions;
+PubSubClient client(wifiClient);     // Chuyển sang tlsClient trong setup() nếu mqttTls
 LiquidCrystal_I2C lcd(0x21, 16, 2);
 Adafruit_NeoPixel pixels(NEOPIXEL_COUNT, NEOPIXEL_PIN, NEO_GRB + NEO_KHZ800);
+PixelRenderer strip(pixels, NEOPIXEL_COUNT);
+static_assert(NEOPIXEL_COUNT == CONFIG_STRIP_PIXELS, "cấu hình kiểm RGB theo độ dài dải LED");
+LcdRenderer screen(lcd);
+
+// Cấu hình đang chạy: mặc định ở trên, thay bằng /config.bin nếu hợp lệ.
+// Cập nhật qua MQTT (yolouno/<house>/config) được ghi flash rồi khởi động lại.
+DeviceConfig config;
+const char* HOUSE_ID = config.houseId;
+#define CONFIG_RESTART_DELAY_MS 500    // Chờ gửi xong thông báo trước khi khởi động lại
+
+// Tất cả topic của nhà này, tạo một lần trong setup():
+// yolouno/<house>/controls, yolouno/<house>/sensors, yolouno/<house>/config,
+// yolouno/<house>/status/<door|alarm|fan|rgb|temp|humi|light>/<device_id>
+TopicTable topics;
+const TopicIdRange defaultIdRanges[STATUS_KIND_COUNT] = {
+  {DOOR_ID_MIN, DOOR_ID_MAX},           // STATUS_DOOR
+  {ALARM_ID, ALARM_ID},                 // STATUS_ALARM
+  {FAN_ID_MIN, FAN_ID_MAX},             // STATUS_FAN
+  {RGB_ID_MIN, RGB_ID_MAX},             // STATUS_RGB
+  {TEMP_HUMI_ID_MIN, TEMP_HUMI_ID_MAX}, // STATUS_TEMP
+  {TEMP_HUMI_ID_MIN, TEMP_HUMI_ID_MAX}, // STATUS_HUMI
+  {LIGHT_ID_MIN, LIGHT_ID_MAX},         // STATUS_LIGHT
+};
+
+#define LCD_INTERVAL_MS 1000           // Vẽ lại LCD mỗi 1s
+#define ALARM_INTERVAL_MS 500          // Chạy luật tự động (báo động...) mỗi 0.5s
+
+// Các việc định kỳ của loop() (xem task_scheduler.h), đăng ký trong setup()
+TaskScheduler scheduler;
+int climateTask = -1;
+int rulesTask = -1;
+int restartTask = -1;
+std::atomic<bool> restartRequested{false};   // Hai nhân: phía mạng xin khởi động lại
+int renderTask = -1;
+int syncTask = -1;
+
+// Chế độ hai nhân: scheduler chạy phần cảm biến/cơ cấu trong loop(),
+// ioScheduler chạy phần mạng trong ioTask. Lệnh đi qua commandQueue
+// (mạng -> cơ cấu), trạng thái và mẫu đo đi qua telemetryQueue (ngược lại).
+bool dualCoreMode = DUAL_CORE_MODE;
+TaskScheduler ioScheduler;
+TaskHandle_t ioTask = nullptr;
+TaskScheduler* networkScheduler = &scheduler;   // Chạy phần mạng: scheduler hoặc ioScheduler
+CommandQueue commandQueue;
+TelemetryQueue telemetryQueue;
+uint32_t commandQueueDrops = 0;     // Lệnh bỏ vì hàng đợi đầy / quá dài
+uint32_t telemetryQueueDrops = 0;   // Tin trạng thái/mẫu bỏ vì hàng đợi đầy
+
+Metrics metrics;
+
+PowerManager power;
+
+OtaUpdater ota;
+int otaTask = -1;
+bool otaRollbackReported = false;
+
+// Firmware mới khởi động ở trạng thái chờ xác nhận: core Arduino không tự
+// đánh dấu hợp lệ, việc đó do OtaUpdater::checkTrial() quyết định
+extern "C" bool verifyRollbackLater() {
+  return true;
+}
+uint8_t powerMode = POWER_MODE;            // Đặt trước setup()
+uint32_t powerMaxLatencyMs = POWER_MAX_LATENCY_MS;
+int powerWakePin = POWER_WAKE_PIN;
+MetricsText metricsText;   // Phía mạng, chỉ task metrics dùng
+
+#define DEFAULT_HOUSE_ID "e0f1ba9c-aa1d-452e-b928-d2cc3c5eedf6"
+#define DEFAULT_SSID "ACLAB"
+#define DEFAULT_PASSWORD "ACLAB2023"
+#define DEFAULT_MQTT_HOST "test.mosquitto.org"
+#define DEFAULT_MQTT_PORT 1883
+#define DEFAULT_MQTTS_PORT 8883
 
-const char* HOUSE_ID = "e0f1ba9c-aa1d-452e-b928-d2cc3c5eedf6"; 
+// MQTT qua TLS (xem tls_client.h): chứng chỉ CA của broker đặt ở TLS_CA_PATH
+// trên LittleFS, thiếu thì không kết nối (không có chế độ bỏ qua xác thực).
+// Phiên TLS được giữ trong RAM và flash: kết nối lại, kể cả sau khởi động
+// lại, chỉ tốn một round trip thay vì handshake đầy đủ (hơn 1 s CPU và
+// ~20 KB heap). Mặc định 0: cổng 1883 không mã hóa như trước.
+#ifndef MQTT_TLS
+#define MQTT_TLS 0
+#endif
+uint8_t mqttTls = MQTT_TLS;                // Đặt trước setup()
+char mqttCaPem[TLS_CA_MAX + 1];
 
-const char* TOPIC_ALL_CONTROLS = "yolouno/%s/controls";      // %s: house_id
-const char* TOPIC_ALL_SENSORS = "yolouno/%s/sensors";        // %s: house_id
-const char* TOPIC_RGB_STATUS = "yolouno/%s/status/rgb/%s";   // %s: house_id, %s: device_id
-const char* TOPIC_DOOR_STATUS = "yolouno/%s/status/door/%s"; // %s: house_id, %s: device_id
-const char* TOPIC_ALARM_STATUS = "yolouno/%s/status/alarm/%s"; // %s: house_id, %s: device_id
-const char* TOPIC_FAN_STATUS = "yolouno/%s/status/fan/%s";   // %s: house_id, %s: device_id
-const char* TOPIC_TEMP_STATUS = "yolouno/%s/status/temp/%s"; // %s: house_id, %s: device_id
-const char* TOPIC_HUMI_STATUS = "yolouno/%s/status/humi/%s"; // %s: house_id, %s: device_id
-const char* TOPIC_LIGHT_STATUS = "yolouno/%s/status/light/%s"; // %s: house_id, %s: device_id
+// Bản vá qua MQTT chỉ khi được bật và kết nối có TLS (xem OTA_MQTT)
+uint8_t otaMqtt = OTA_MQTT;                // Đặt trước setup()
+bool otaOverMqtt() { return otaMqtt && mqttTls; }
 
-unsigned long lastimageTime =0;
-unsigned long lastSensorTime = 0;            // Lần cập nhật cảm biến gần nhất
-unsigned long lastMQTTTime = 0;              // Lần cập nhật MQTT gần nhất
-const unsigned long sensorInterval = 15000;   // Cập nhật cảm biến mỗi 5000ms (5s)
-const unsigned long mqttInterval = 1000;     // Cập nhật MQTT mỗi 1000ms (1s)
-const unsigned long imageInterval = 10000;
+// Phiên MQTT bền: client ID cố định theo nhà và cleanSession = false, broker
+// giữ subscription và lệnh QoS 1 đến trong lúc mất kết nối rồi giao khi kết
+// nối lại. Mỗi nhà một ID, không thì hai nhà đá nhau khỏi broker.
+#define MQTT_CLIENT_ID_PREFIX "yolouno-"
+char mqttClientId[sizeof(MQTT_CLIENT_ID_PREFIX) + CONFIG_HOUSE_ID_MAX];
 
-const char* ssid = "ACLAB";
-const char* password = "ACLAB2023";
-const char* mqtt_server = "test.mosquitto.org";
+// WiFi + MQTT không chặn loop(): thử lại với backoff, xem connection_manager.h
+ConnectionManager connection(client, config.ssid, config.password, mqttClientId);
+bool announcedOnline = false;
 
-int previousLuxValue = -1;
+// Cảm biến ánh sáng: lấy mẫu theo chùm + lọc (xem light_sampler.h); LCD và
+// MQTT cùng đọc một snapshot, không ai gọi analogRead() trực tiếp
+const uint8_t defaultLightPins[LIGHT_SAMPLER_CHANNELS] = {luxPin1, luxPin2, luxPin3};
+LightSampler lights(defaultLightPins);   // Chân thật lấy từ config trong setup()
+
+uint8_t sensorPublishMode = SENSOR_PUBLISH_MODE;
+uint16_t sensorFrameSeq = 0;   // Số thứ tự frame cảm biến
+SampleBuffer sampleBacklog;    // Mẫu chưa gửi được khi mất kết nối
+static_assert(LIGHT_ID_MAX - LIGHT_ID_MIN + 1 == SENSOR_FRAME_LIGHTS,
+              "sensor frame v1 carries exactly three light channels");
+static_assert(LIGHT_SAMPLER_CHANNELS == SENSOR_FRAME_LIGHTS,
+              "one sampler channel per light sensor ID");
+static_assert(CONFIG_LIGHT_PINS == LIGHT_SAMPLER_CHANNELS,
+              "the config carries one pin per light sampler channel");
+
+// Kênh cảm biến và chính sách báo cáo của từng kênh (đơn vị: centi / raw ADC)
+enum SensorChannel : uint8_t {
+  CH_TEMP,
+  CH_HUMI,
+  CH_LIGHT_FIRST,
+  SENSOR_CHANNEL_COUNT = CH_LIGHT_FIRST + SENSOR_FRAME_LIGHTS
+};
+#define SENSOR_CHANNELS_ALL ((1u << SENSOR_CHANNEL_COUNT) - 1)
+const ReportPolicy sensorPolicies[SENSOR_CHANNEL_COUNT] = {
+  {TEMP_DEADBAND_CENTI, REPORT_MAX_SILENCE_MS, (int32_t)(TEMP_THRESHOLD * 100)},  // CH_TEMP
+  {HUMI_DEADBAND_CENTI, REPORT_MAX_SILENCE_MS, REPORT_NO_ALARM},                  // CH_HUMI
+  {LIGHT_DEADBAND_RAW,  REPORT_MAX_SILENCE_MS, REPORT_NO_ALARM},                  // light 4
+  {LIGHT_DEADBAND_RAW,  REPORT_MAX_SILENCE_MS, REPORT_NO_ALARM},                  // light 5
+  {LIGHT_DEADBAND_RAW,  REPORT_MAX_SILENCE_MS, REPORT_NO_ALARM},                  // light 6
+};
+ChannelReporter sensorReporters[SENSOR_CHANNEL_COUNT];
+
+// Cửa sổ thống kê của mọi kênh; chỉ phía cảm biến (loop()) đọc/ghi
+const uint32_t rollupWindowsMs[] = {ROLLUP_WINDOW_1_MS, ROLLUP_WINDOW_2_MS};
+WindowedRollup rollup;
+uint8_t sensorRawStream = SENSOR_RAW_STREAM;   // 0: chỉ gửi thống kê và báo động
+// Yêu cầu gửi thô từ callback (phía mạng): 0 không có, n là n - 1 giây
+std::atomic<uint32_t> rawStreamRequest{0};
+bool rawStreaming = false;        // Đang gửi thô theo yêu cầu, tới rawStreamUntilMs
+uint32_t rawStreamUntilMs = 0;
+static_assert(SENSOR_CHANNEL_COUNT == RULE_CHANNELS, "rules address channels in SensorChannel order");
 
 DHT20 dht20;
+// Số đo DHT20 đã kiểm CRC; LCD, luật và MQTT cùng đọc, không ai đọc I2C lại
+ClimateSensor climate(dht20);
 
-// Các biến toàn cục mới
-Servo doorServo;         // Đối tượng điều khiển servo
-bool doorOpen = false;   // Trạng thái cửa
-bool alarmActive = false; // Trạng thái báo động
-bool fanActive = false;   // Trạng thái quạt
 String doorPassword = "connect";
-Servo doorServos[DOOR_ID_MAX - DOOR_ID_MIN + 1];  
-bool doorStates[DOOR_ID_MAX - DOOR_ID_MIN + 1] = {false, false, false}; 
 
-void InitWiFi() {
-  Serial.println("Connecting to AP ...");
-  WiFi.begin(ssid, password);
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    Serial.print(".");
-  }
-  Serial.println("Connected to AP");
+// Thiết bị chấp hành mặc định (xem device_registry.h). Thêm thiết bị chỉ cần
+// thêm một dòng (hoặc một mục trong cấu hình flash): lệnh, gửi trạng thái và
+// snapshot khi kết nối lại đều duyệt bảng. Với RGB, pin là LED đầu tiên trên
+// dải và span là số LED.
+const DeviceSpec defaultDevices[] = {
+  // kind        id        pin            span  trạng thái đầu
+  {STATUS_DOOR,  7,        SERVO_PIN_1,   1,    0},
+  {STATUS_DOOR,  8,        SERVO_PIN_2,   1,    0},
+  {STATUS_DOOR,  9,        SERVO_PIN_3,   1,    0},
+  {STATUS_DOOR,  10,       SERVO_PIN_4,   1,    0},
+  {STATUS_ALARM, ALARM_ID, DEVICE_NO_PIN, 1,    0},
+  {STATUS_FAN,   11,       FAN_PIN_1,     1,    0},
+  {STATUS_FAN,   12,       FAN_PIN_2,     1,    0},   // quạt 13 chưa gắn chân
+  {STATUS_RGB,   14,       0,             2,    0},   // LED 0-1, cũng báo động
+  {STATUS_RGB,   15,       2,             1,    0},
+  {STATUS_RGB,   16,       3,             1,    0},
+};
+DeviceRegistry devices;
+StateSync stateSync(devices, topics, client);
+
+// Công tắc từ của từng cửa, theo ID cửa; cửa không có trong bảng thiết bị bị bỏ qua
+struct DoorSensor {
+  uint8_t doorId;
+  uint8_t pin;
+};
+const DoorSensor doorSensors[] = {
+  {7,  DOOR_SENSE_PIN_1},
+  {8,  DOOR_SENSE_PIN_2},
+  {9,  DOOR_SENSE_PIN_3},
+  {10, DOOR_SENSE_PIN_4},
+};
+uint8_t doorSense = DOOR_SENSE;   // Đặt trước setup()
+InputCapture inputs;
+int8_t inputDoorSlot[INPUT_MAX_PINS];   // Kênh chân -> slot cửa trong devices
+uint32_t doorsMoving = 0;               // Bit theo slot: servo đang chạy theo lệnh
+uint32_t doorSettleAtMs[DEVICE_MAX];    // Hết DOOR_MOVE_MS của lệnh gần nhất
+static_assert(DEVICE_MAX <= 32, "doorsMoving: một bit mỗi slot");
+Servo servos[DEVICE_MAX];   // Servo của từng cửa, theo slot trong devices
+int alarmSlot = -1;
+
+// Luật tự động chạy ngay trên thiết bị (xem rule_engine.h), không cần broker.
+// Mặc định: báo động khi vượt TEMP_THRESHOLD, tắt khi dưới ngưỡng đủ
+// ALARM_CLEAR_HOLD_MS. Luật mới qua MQTT (yolouno/<house>/rules) được ghi flash
+// và áp dụng ngay, không khởi động lại.
+RuleEngine rules(devices);
+std::atomic<bool> rulesUpdated{false};   // Hai nhân: nhân cơ cấu nạp lại từ flash
+
+// Cấu hình dựng sẵn trong firmware, dùng khi flash chưa có cấu hình hợp lệ
+void loadDefaultConfig(DeviceConfig& c) {
+  memset(&c, 0, sizeof(c));
+  strcpy(c.houseId, DEFAULT_HOUSE_ID);
+  strcpy(c.ssid, DEFAULT_SSID);
+  strcpy(c.password, DEFAULT_PASSWORD);
+  strcpy(c.mqttHost, DEFAULT_MQTT_HOST);
+  c.mqttPort = mqttTls ? DEFAULT_MQTTS_PORT : DEFAULT_MQTT_PORT;
+  c.sensorIntervalMs = SENSOR_SAMPLE_INTERVAL_MS;
+  c.lcdIntervalMs = LCD_INTERVAL_MS;
+  c.alarmIntervalMs = ALARM_INTERVAL_MS;
+  memcpy(c.lightPins, defaultLightPins, sizeof(c.lightPins));
+  memcpy(c.ranges, defaultIdRanges, sizeof(c.ranges));
+  c.deviceCount = sizeof(defaultDevices) / sizeof(defaultDevices[0]);
+  memcpy(c.devices, defaultDevices, sizeof(defaultDevices));
+}
+
+// Luật dựng sẵn trong firmware, dùng khi flash chưa có bộ luật hợp lệ
+void loadDefaultRules(RuleSet& set) {
+  memset(&set, 0, sizeof(set));
+  uint8_t alarmId = (uint8_t)config.ranges[STATUS_ALARM].idMin;
+  int32_t threshold = (int32_t)(TEMP_THRESHOLD * 100);
+  set.rules[0] = {CH_TEMP, RULE_ABOVE, RULE_REASSERT, STATUS_ALARM, alarmId, 0, threshold, 0, 1};
+  set.rules[1] = {CH_TEMP, RULE_BELOW, 0, STATUS_ALARM, alarmId, 0, threshold,
+                  ALARM_CLEAR_HOLD_MS, 0};
+  set.count = 2;
 }
 
 void temperature1() {
-  float temp = dht20.getTemperature();
-  float hum = dht20.getHumidity();
-  
-  lcd.setCursor(2, 0);
-  lcd.print("     ");  // Xóa giá trị cũ
-  lcd.setCursor(2, 0);
-  lcd.print(temp, 1);
-  
-  lcd.setCursor(10, 0);
-  lcd.print("     ");  // Xóa giá trị cũ
-  lcd.setCursor(10, 0);
-  lcd.print(hum, 1);
+  const ClimateReading& reading = climate.reading();
+  bool fresh = climate.fresh(millis(), CLIMATE_STALE_CYCLES * config.sensorIntervalMs);
+  TextBuffer<16> text;
+
+  // Ô 5 ký tự; chỉ ký tự thay đổi mới được gửi qua I2C
+  screen.field(2, 0, 5, fresh ? text.clear().fixed<1>(toFixed<1>(reading.temperature)).c_str()
+                              : "--");
+  screen.field(10, 0, 5, fresh ? text.clear().fixed<1>(toFixed<1>(reading.humidity)).c_str()
+                               : "--");
+}
+
+// Mọi publish MQTT của sketch đi qua đây để đếm thành công / thất bại
+bool publishMqtt(const char* topic, const char* payload, bool retained = false) {
+  return metrics.countPublish(client.publish(topic, payload, retained));
+}
+
+bool publishMqtt(const char* topic, const uint8_t* payload, unsigned int length,
+                 bool retained = false) {
+  return metrics.countPublish(client.publish(topic, payload, length, retained));
+}
+
+// Có nội dung mới cho đèn/LCD: task render chạy lại ở lượt kế tiếp
+void requestRender() {
+  scheduler.setEnabled(renderTask, true);
+}
+
+// Gửi trạng thái thiết bị; ở chế độ hai nhân chuyển sang nhân mạng qua hàng đợi
+bool publishStatus(const char* topic, const char* payload, bool retained = false) {
+  if (!dualCoreMode) {
+    return publishMqtt(topic, payload, retained);
+  }
+  TelemetryRecord record;
+  if (!makePublishRecord(topic, payload, retained, record) || !telemetryQueue.push(record)) {
+    telemetryQueueDrops++;
+    return false;
+  }
+  return true;
+}
+
+// Điều khiển phần cứng của thiết bị ở slot theo trạng thái đích
+void applyDevice(int slot) {
+  uint32_t target = devices.target(slot);
+  switch (devices.kind(slot)) {
+    case STATUS_DOOR:
+      servos[slot].write(target ? 90 : 0);
+      break;
+    case STATUS_FAN:
+      digitalWrite(devices.pin(slot), target ? HIGH : LOW);
+      break;
+    case STATUS_RGB:
+      // Task render gửi ra dải đèn nếu có thay đổi
+      for (uint8_t i = 0; i < devices.span(slot); i++) {
+        strip.set(devices.pin(slot) + i, target);
+      }
+      requestRender();
+      break;
+    default:
+      // Báo động không có chân riêng: setAlarm() đổi màu RGB đầu tiên
+      break;
+  }
+  devices.applied(slot);
+}
+
+// Trạng thái thiết bị gửi retained: broker giữ bản mới nhất, bản phản hồi về
+// xác nhận đã nhận (xem state_sync.h)
+void publishDevice(int slot) {
+  char text[DEVICE_STATE_TEXT_MAX];
+  devices.formatState(slot, text, sizeof(text));
+  publishStatus(topics.status(devices.kind(slot), devices.id(slot)), text, true);
+}
+
+// Đặt trạng thái đích, điều khiển phần cứng rồi gửi trạng thái mới
+void setDevice(int slot, uint32_t target) {
+  // Cửa được lệnh chạy: taskInputs bỏ qua công tắc của nó tới khi servo tới nơi
+  if (devices.kind(slot) == STATUS_DOOR && devices.state(slot) != target) {
+    doorsMoving |= 1u << slot;
+    doorSettleAtMs[slot] = millis() + DOOR_MOVE_MS;
+  }
+  devices.setTarget(slot, target);
+  applyDevice(slot);
+  publishDevice(slot);
 }
 
-uint32_t currentColor = pixels.Color(0, 0, 255  ); 
 // Hàm điều khiển màu đèn RGB với device ID
-void setRGBColor(uint8_t r, uint8_t g, uint8_t b, int deviceId) {
+bool setRGBColor(uint8_t r, uint8_t g, uint8_t b, int deviceId) {
   Serial.print("Setting new color for RGB ID ");
   Serial.println(deviceId);
 
-  // Reset tất cả các LED trước
-  pixels.clear();
-  
-  // Tạo màu mới
-  currentColor = pixels.Color(r, g, b);
-  
-  // Hiển thị màu trên tất cả các LED
-  for(int i = 0; i < NEOPIXEL_COUNT; i++) {
-    pixels.setPixelColor(i, currentColor);
+  int slot = devices.find(STATUS_RGB, deviceId);
+  if (slot < 0) {
+    Serial.println("RGB ID không có trong bảng thiết bị");
+    return false;
   }
-  
-  // Hiển thị màu
-  pixels.show();
-  
-  // Gửi trạng thái màu lên MQTT với device ID
-  char rgbStatusTopic[60];
-  char deviceIdStr[5];
-  sprintf(deviceIdStr, "%d", deviceId);
-  sprintf(rgbStatusTopic, TOPIC_RGB_STATUS, HOUSE_ID, deviceIdStr);
-  
-  char colorStr[20];
-  sprintf(colorStr, "%d,%d,%d", r, g, b);
-  client.publish(rgbStatusTopic, colorStr);
+  setDevice(slot, pixels.Color(r, g, b));
 
   Serial.print("Đã đổi màu RGB ID ");
   Serial.print(deviceId);
@@ -140,389 +509,936 @@ void setRGBColor(uint8_t r, uint8_t g, uint8_t b, int deviceId) {
   Serial.print(r); Serial.print(",");
   Serial.print(g); Serial.print(",");
   Serial.println(b);
+  return true;
 }
 
-void reconnect() {
-  while (!client.connected()) {
-      Serial.print("Đang kết nối MQTT...");
-      if (client.connect("ESP32_YOLOUNO29112004")) {
-          Serial.println("Đã kết nối!");
-          
-          // Create topic with house ID
-          char controlTopic[50];
-          sprintf(controlTopic, TOPIC_ALL_CONTROLS, HOUSE_ID);
-          
-          // Subscribe to the single control topic for this house
-          client.subscribe(controlTopic);
-          
-          // Publish status for all default devices
-          char deviceIdStr[5];
-          char statusTopic[60];
-          
-          // Gửi trạng thái cho tất cả các cửa
-          for (int i = DOOR_ID_MIN; i <= DOOR_ID_MAX; i++) {
-            int servoIndex = i - DOOR_ID_MIN;
-            sprintf(deviceIdStr, "%d", i);
-            sprintf(statusTopic, TOPIC_DOOR_STATUS, HOUSE_ID, deviceIdStr);
-            client.publish(statusTopic, doorStates[servoIndex] ? "OPEN" : "CLOSED");
-          }
-          
-          // Alarm status
-          sprintf(statusTopic, TOPIC_ALARM_STATUS, HOUSE_ID, "1");
-          client.publish(statusTopic, alarmActive ? "ON" : "OFF");
-          
-          // Fan status
-          sprintf(deviceIdStr, "%d", FAN_ID_MIN);
-          sprintf(statusTopic, TOPIC_FAN_STATUS, HOUSE_ID, deviceIdStr);
-          client.publish(statusTopic, fanActive ? "ON" : "OFF");
-          
-          // RGB status
-          uint8_t r = (currentColor >> 16) & 0xFF;
-          uint8_t g = (currentColor >> 8) & 0xFF;
-          uint8_t b = currentColor & 0xFF;
-          char colorStr[20];
-          sprintf(colorStr, "%d,%d,%d", r, g, b);
-          
-          sprintf(deviceIdStr, "%d", RGB_ID_MIN);
-          sprintf(statusTopic, TOPIC_RGB_STATUS, HOUSE_ID, deviceIdStr);
-          client.publish(statusTopic, colorStr);
-      } else {
-          Serial.print("Thất bại, mã lỗi: ");
-          Serial.print(client.state());
-          Serial.println(" Thử lại sau 10s...");
-          delay(10000);
-      }
+// Gọi mỗi lần kết nối MQTT thành công (xem connection_manager.h)
+// Ở chế độ hai nhân hàm này chạy phía mạng và chỉ đọc trạng thái cơ cấu
+// (bool / uint32_t, đọc nguyên tử trên ESP32), không ghi.
+void onMqttConnected() {
+  if (mqttTls) {
+    Serial.print("TLS: ");
+    Serial.print(tlsClient.handshakeMs());
+    Serial.println(tlsClient.offeredSession() ? " ms (gửi kèm phiên cũ)" : " ms (đầy đủ)");
+  }
+  // Subscribe to the single control topic for this house
+  // QoS 1: broker gửi lại lệnh chưa được xác nhận; ID lệnh chống áp dụng hai lần.
+  // Phiên bền vẫn subscribe lại mỗi lần: PubSubClient không cho biết broker
+  // còn giữ phiên hay không, và subscribe lại không mất gì.
+  client.subscribe(topics.controls(), 1);
+  client.subscribe(topics.config());
+  client.subscribe(topics.rules());
+  if (otaOverMqtt()) client.subscribe(topics.ota());
+  client.subscribe(topics.sensorStream());
+  
+  // Không gửi lại cả snapshot: chỉ thiết bị broker chưa có đúng trạng thái,
+  // rải ngẫu nhiên trong STATE_SYNC_WINDOW_MS (task sync)
+  stateSync.begin(millis());
+  networkScheduler->setEnabled(syncTask, true);
+
+  if (!announcedOnline) {
+    publishMqtt(topics.deviceStatus(), "Device is online");
+    Serial.println("Sent online status message");
+    announcedOnline = true;
+  }
+  if (ota.rolledBack() && !otaRollbackReported) {
+    publishMqtt(topics.deviceStatus(), "ota:rolled back");
+    otaRollbackReported = true;
   }
 }
 
-// Hàm đọc giá trị từ cảm biến ánh sáng theo ID
+// Hàm đọc giá trị (đã lọc) của cảm biến ánh sáng theo ID
 int getLightValueById(int deviceId) {
-  int lightValue = 0;
-  
-  switch(deviceId) {
-    case 4: // LIGHT_ID_MIN - cảm biến ánh sáng 1
-      lightValue = analogRead(luxPin1);
-      break;
-    case 5: // Cảm biến ánh sáng 2
-      lightValue = analogRead(luxPin2);
-      break;
-    case 6: // LIGHT_ID_MAX - cảm biến ánh sáng 3
-      lightValue = analogRead(luxPin3);
-      break;
-    default:
-      Serial.print("ID cảm biến ánh sáng không hợp lệ: ");
-      Serial.println(deviceId);
-      lightValue = 0;
-      break;
+  int index = deviceId - config.ranges[STATUS_LIGHT].idMin;
+  if (index < 0 || index >= LIGHT_SAMPLER_CHANNELS) {
+    Serial.print("ID cảm biến ánh sáng không hợp lệ: ");
+    Serial.println(deviceId);
+    return 0;
   }
-  
-  return lightValue;
+  return lights.snapshot().value[index];
 }
 
 int luxSensor() {
   // Chỉ trả về giá trị từ cảm biến ánh sáng 1 để tương thích với code cũ
-  int luxValue = analogRead(luxPin1);
-  if (luxValue != previousLuxValue) {
-    lcd.setCursor(2, 1);
-    lcd.print("       ");  // Xóa giá trị cũ
-    lcd.setCursor(2, 1);
-    lcd.print(luxValue);
-    previousLuxValue = luxValue;
-  }  
+  int luxValue = lights.snapshot().value[0];
+  char text[INT_TEXT_MAX + 1];
+  formatInt(text, luxValue);
+  screen.field(2, 1, 7, text);
   return luxValue;
 }
 
-// Điều khiển cửa
-
-void toggleDoor(int deviceId) {
-  // Tính chỉ số trong mảng từ device ID
-  int servoIndex = deviceId - DOOR_ID_MIN;
-  
-  // Kiểm tra chỉ số hợp lệ
-  if (servoIndex < 0 || servoIndex >= (DOOR_ID_MAX - DOOR_ID_MIN + 1)) {
+// Điều khiển cửa: trạng thái đích tuyệt đối, lệnh lặp lại không đảo cửa
+bool setDoor(bool open, int deviceId) {
+  int slot = devices.find(STATUS_DOOR, deviceId);
+  if (slot < 0) {
     Serial.println("Chỉ số servo không hợp lệ");
-    return;
-  }
-  
-  // Đảo trạng thái cửa
-  doorStates[servoIndex] = !doorStates[servoIndex];
-  
-  // Cập nhật biến doorOpen để tương thích với code cũ
-  if (deviceId == DOOR_ID_MIN) {
-    doorOpen = doorStates[servoIndex];
+    return false;
   }
   
-  // Điều khiển servo tương ứng
-  if (doorStates[servoIndex]) {
-    doorServos[servoIndex].write(90);  // Mở cửa
-    Serial.print("Cửa ID ");
-    Serial.print(deviceId);
-    Serial.println(" đã mở");
-  } else {
-    doorServos[servoIndex].write(0);   // Đóng cửa
-    Serial.print("Cửa ID ");
-    Serial.print(deviceId);
-    Serial.println(" đã đóng");
+  // Điều khiển servo và gửi trạng thái lên MQTT
+  setDevice(slot, open);
+
+  Serial.print("Cửa ID ");
+  Serial.print(deviceId);
+  Serial.println(devices.state(slot) ? " đã mở" : " đã đóng");
+  return true;
+}
+
+// Báo động theo device ID như cửa/quạt; màu báo hiệu ở RGB đầu tiên
+bool setAlarm(bool state, int deviceId) {
+  int slot = devices.find(STATUS_ALARM, deviceId);
+  if (slot < 0) {
+    Serial.println("Nhà này không có báo động với ID này");
+    return false;
   }
-  
-  // Gửi trạng thái lên MQTT
-  char doorStatusTopic[60];
-  char deviceIdStr[5];
-  sprintf(deviceIdStr, "%d", deviceId);
-  sprintf(doorStatusTopic, TOPIC_DOOR_STATUS, HOUSE_ID, deviceIdStr);
-  client.publish(doorStatusTopic, doorStates[servoIndex] ? "OPEN" : "CLOSED");
-}
-
-// Điều chỉnh hàm setAlarm để hỗ trợ device ID
-void setAlarm(bool state) {
-  alarmActive = state;
-  if (alarmActive) {
+  if (state) {
     // Đèn đỏ khi báo động
-    setRGBColor(255, 0, 0, RGB_ID_MIN);  // Sử dụng RGB đầu tiên cho báo động
+    setRGBColor(255, 0, 0, config.ranges[STATUS_RGB].idMin);  // Sử dụng RGB đầu tiên cho báo động
     Serial.println("Báo động BẬT");
   } else {
     // Đèn xanh lá khi bình thường
-    setRGBColor(0, 255, 0, RGB_ID_MIN);
+    setRGBColor(0, 255, 0, config.ranges[STATUS_RGB].idMin);
     Serial.println("Báo động TẮT");
   }
   
   // Gửi trạng thái báo động lên MQTT với house ID
-  char alarmStatusTopic[60];
-  sprintf(alarmStatusTopic, TOPIC_ALARM_STATUS, HOUSE_ID, "1");  // Alarm ID mặc định là 1
-  client.publish(alarmStatusTopic, alarmActive ? "ON" : "OFF");
+  setDevice(slot, state);
+  return true;
 }
 
 // Điều khiển quạt với device ID
-void setFan(bool state, int deviceId) {
-  // Map device ID to the correct pin
-  int fanPin;
-  if (deviceId == 11) {
-    fanPin = FAN_PIN_1;
-  } 
-  else if (deviceId == 12) {
-    fanPin = FAN_PIN_2;
-  }
-  else {
+bool setFan(bool state, int deviceId) {
+  int slot = devices.find(STATUS_FAN, deviceId);
+  if (slot < 0) {
     Serial.println("Fan ID not mapped to a pin");
-    return;
+    return false;
   }
   
-  // Keep track of each fan state in an array or separate variables
-  if (deviceId == FAN_ID_MIN) {
-    fanActive = state;  // For backwards compatibility with your existing code
-  }
-  
-  // Control the appropriate pin
-  digitalWrite(fanPin, state ? HIGH : LOW);
+  // Bật/tắt chân của quạt và gửi trạng thái lên MQTT
+  setDevice(slot, state);
   
   Serial.print("Quạt ID ");
   Serial.print(deviceId);
   Serial.println(state ? " BẬT" : " TẮT");
-  
-  // Publish status to MQTT
-  char fanStatusTopic[60];
-  char deviceIdStr[5];
-  sprintf(deviceIdStr, "%d", deviceId);
-  sprintf(fanStatusTopic, TOPIC_FAN_STATUS, HOUSE_ID, deviceIdStr);
-  client.publish(fanStatusTopic, state ? "ON" : "OFF");
+  return true;
+}
+
+// Ghi token (view vào payload) ra Serial mà không tạo String
+void printToken(const Token& token) {
+  Serial.write((const uint8_t*)token.ptr, token.len);
+}
+
+// Lệnh là trạng thái đích tuyệt đối: cửa open/on -> mở, close/closed/off ->
+// đóng (không phân biệt hoa thường), nên nhận lại cùng lệnh không đổi gì
+bool handleDoorCommand(int deviceId, const Token& command) {
+  if (command.equalsIgnoreCase("open") || command.equalsIgnoreCase("on")) {
+    return setDoor(true, deviceId);
+  }
+  if (command.equalsIgnoreCase("close") || command.equalsIgnoreCase("closed") ||
+      command.equalsIgnoreCase("off")) {
+    return setDoor(false, deviceId);
+  }
+  Serial.println("Lệnh cửa không hợp lệ. Sử dụng: open/OPEN hoặc close/CLOSED");
+  return false;
+}
+
+bool handleAlarmCommand(int deviceId, const Token& command) {
+  if (command.equals("ON")) {
+    return setAlarm(true, deviceId);
+  }
+  if (command.equals("OFF")) {
+    return setAlarm(false, deviceId);
+  }
+  Serial.println("Lệnh báo động không hợp lệ. Sử dụng: ON hoặc OFF");
+  return false;
+}
+
+bool handleFanCommand(int deviceId, const Token& command) {
+  if (command.equals("ON") || command.equals("on")) {
+    return setFan(true, deviceId);
+  }
+  if (command.equals("OFF") || command.equals("off")) {
+    return setFan(false, deviceId);
+  }
+  Serial.println("Lệnh quạt không hợp lệ. Sử dụng: ON hoặc OFF");
+  return false;
+}
+
+bool handleRgbCommand(int deviceId, const Token& command) {
+  // Xử lý lệnh ON/OFF cho RGB
+  if (command.equals("ON") || command.equals("on")) {
+    if (!setRGBColor(254, 254, 254, deviceId)) return false;
+    Serial.print("Bật đèn RGB ID ");
+    Serial.println(deviceId);
+    return true;
+  }
+  if (command.equals("OFF") || command.equals("off")) {
+    if (!setRGBColor(0, 0, 0, deviceId)) return false;
+    Serial.print("Tắt đèn RGB ID ");
+    Serial.println(deviceId);
+    return true;
+  }
+
+  // Định dạng: "R,G,B" vd: "255,0,128"
+  int firstComma = command.indexOf(',');
+  int secondComma = command.lastIndexOf(',');
+  if (firstComma > 0 && secondComma > firstComma) {
+    long r = command.slice(0, firstComma).toInt();
+    long g = command.slice(firstComma + 1, secondComma).toInt();
+    long b = command.slice(secondComma + 1, command.len).toInt();
+
+    // Giới hạn giá trị trong khoảng 0-255
+    r = constrain(r, 0, 255);
+    g = constrain(g, 0, 255);
+    b = constrain(b, 0, 255);
+
+    return setRGBColor(r, g, b, deviceId);
+  }
+  Serial.println("Định dạng màu không hợp lệ. Sử dụng: R,G,B hoặc ON/OFF");
+  return false;
+}
+
+// Bảng điều phối lệnh theo loại thiết bị; phạm vi ID lấy lại từ config trong setup()
+CommandRoute commandRoutes[] = {
+  {"door",  DOOR_ID_MIN, DOOR_ID_MAX, handleDoorCommand},
+  {"alarm", ALARM_ID,    ALARM_ID,    handleAlarmCommand},
+  {"fan",   FAN_ID_MIN,  FAN_ID_MAX,  handleFanCommand},
+  {"rgb",   RGB_ID_MIN,  RGB_ID_MAX,  handleRgbCommand},
+};
+const size_t commandRouteCount = sizeof(commandRoutes) / sizeof(commandRoutes[0]);
+const StatusTopic commandRouteKinds[commandRouteCount] = {
+  STATUS_DOOR, STATUS_ALARM, STATUS_FAN, STATUS_RGB,
+};
+
+// Lệnh theo lô (xem command_pipeline.h): ack trên yolouno/<house>/acks
+CommandDedup commandDedup;
+uint8_t batchApplied = 0;   // Phía cơ cấu: số mục đã áp dụng của lô đang chạy
+
+void publishAck(const Token& id, AckResult result, uint8_t applied, uint8_t total,
+                uint32_t receivedUs, bool fromActuator) {
+  char text[CMD_ACK_TEXT_MAX];
+  if (!formatAck(text, sizeof(text), id, result, applied, total, micros() - receivedUs)) return;
+  // Phía mạng gửi thẳng; phía cơ cấu đi qua hàng đợi như trạng thái thiết bị
+  if (fromActuator) {
+    publishStatus(topics.acks(), text);
+  } else {
+    publishMqtt(topics.acks(), text);
+  }
+}
+
+void handleBatch(const Command& cmd, uint32_t receivedUs) {
+  CommandBatch batch;
+  bool parsed = parseBatch(cmd, batch);
+  if (batch.id.len == 0) {
+    Serial.println("Lô lệnh không có command ID hợp lệ, bỏ qua");
+    return;
+  }
+  if (!parsed || (dualCoreMode && commandQueue.capacity() - commandQueue.size() < batch.count)) {
+    // Không ghi nhớ ID: bên gửi có thể gửi lại
+    publishAck(batch.id, ACK_REJECTED, 0, batch.count, receivedUs, false);
+    return;
+  }
+  if (commandDedup.seen(batch.id, millis())) {
+    publishAck(batch.id, ACK_DUPLICATE, 0, batch.count, receivedUs, false);
+    return;
+  }
+
+  uint8_t applied = 0;
+  for (uint8_t i = 0; i < batch.count; i++) {
+    const Command& item = batch.items[i];
+    const CommandRoute* route = nullptr;
+    if (findRoute(item, commandRoutes, commandRouteCount, &route) != DISPATCH_OK) {
+      route = nullptr;
+    }
+    if (!dualCoreMode) {
+      if (route) {
+        applied += route->handler(item.deviceId, item.command);
+        metrics.recordCommand(micros() - receivedUs);
+      }
+      continue;
+    }
+    // Mục không hợp lệ vẫn được xếp hàng (route rỗng) để nhân cơ cấu đếm đủ
+    // số mục và gửi ack sau mục cuối cùng
+    CommandRecord record;
+    if (!route || !makeCommandRecord(route, item.deviceId, item.command, record)) {
+      makeCommandRecord(nullptr, item.deviceId, Token{"", 0}, record);
+    }
+    setBatchItem(batch, i, receivedUs, record);
+    commandQueue.push(record);
+  }
+  if (!dualCoreMode) {
+    publishAck(batch.id, batchResult(applied, batch.count), applied, batch.count, receivedUs,
+               false);
+  }
+}
+
+void taskRestart() {
+  scheduler.setEnabled(restartTask, false);
+  ESP.restart();
+}
+
+// Hẹn khởi động lại sau CONFIG_RESTART_DELAY_MS; chỉ gọi phía loop(), nơi
+// scheduler chạy
+void scheduleRestart() {
+  scheduler.setEnabled(restartTask, true);
+  scheduler.runAfter(restartTask, CONFIG_RESTART_DELAY_MS);
+}
+
+// Gọi được từ cả hai phía: ở chế độ hai nhân phía mạng không đụng scheduler
+// của loop(), chỉ bật cờ để taskCommands hẹn giúp
+void requestRestart() {
+  if (dualCoreMode) {
+    restartRequested.store(true, std::memory_order_release);
+    return;
+  }
+  scheduleRestart();
+}
+
+// Cấu hình mới qua MQTT: kiểm tra toàn bộ, ghi flash (thay thế nguyên tử) rồi
+// khởi động lại để mọi bảng được dựng lại từ cấu hình mới. Blob lỗi bị bỏ qua,
+// cấu hình đang chạy giữ nguyên.
+void handleConfigUpdate(const uint8_t* blob, unsigned int length) {
+  DeviceConfig next;
+  ConfigResult result = storeDeviceConfig(LittleFS, blob, length, next);
+  char reply[40];
+  snprintf(reply, sizeof(reply), "config:%s", configResultName(result));
+  publishMqtt(topics.deviceStatus(), reply);
+  Serial.print("Cập nhật cấu hình: ");
+  Serial.println(configResultName(result));
+  if (result == CONFIG_OK) requestRestart();
+}
+
+// Bộ luật mới qua MQTT: kiểm tra, ghi flash rồi áp dụng ngay. Ở chế độ hai
+// nhân hàm này chạy phía mạng; nhân cơ cấu tự nạp lại từ flash (task rules).
+void handleRulesUpdate(const uint8_t* blob, unsigned int length) {
+  RuleSet next;
+  ConfigResult result = storeRuleSet(LittleFS, blob, length, devices, next);
+  char reply[40];
+  snprintf(reply, sizeof(reply), "rules:%s", configResultName(result));
+  publishMqtt(topics.deviceStatus(), reply);
+  Serial.print("Cập nhật luật: ");
+  Serial.println(configResultName(result));
+  if (result != CONFIG_OK) return;
+  if (dualCoreMode) {
+    rulesUpdated.store(true, std::memory_order_release);
+    return;
+  }
+  rules.load(next);
+  scheduler.runAfter(rulesTask, 0);
+}
+
+// Trả lời bên gửi bản vá: "ota:next:<offset>", "ota:failed:<lý do>", ...
+void publishOtaEvent(OtaEvent event) {
+  char reply[40];
+  switch (event) {
+    case OTA_NEXT:
+      snprintf(reply, sizeof(reply), "ota:next:%lu", (unsigned long)ota.nextOffset());
+      break;
+    case OTA_APPLIED: snprintf(reply, sizeof(reply), "ota:applied"); break;
+    case OTA_FAILED: snprintf(reply, sizeof(reply), "ota:failed:%s", ota.error()); break;
+    case OTA_CONFIRMED: snprintf(reply, sizeof(reply), "ota:confirmed"); break;
+    case OTA_ROLLBACK: snprintf(reply, sizeof(reply), "ota:rollback"); break;
+    default: return;
+  }
+  publishMqtt(topics.deviceStatus(), reply);
+  Serial.print("Cập nhật firmware: ");
+  Serial.println(reply);
+}
+
+// Một đoạn bản vá: chép lại, task ota áp dụng dần qua nhiều lượt
+void handleOtaMessage(const uint8_t* payload, unsigned int length) {
+  publishOtaEvent(ota.receive(payload, length));
+  if (ota.pending()) networkScheduler->setEnabled(otaTask, true);
+}
+
+// Gửi số đo thô trong n giây (văn bản "n"), kể cả khi SENSOR_RAW_STREAM 0
+void handleRawStreamRequest(const uint8_t* payload, unsigned int length) {
+  uint32_t seconds = 0;
+  unsigned int i = 0;
+  for (; i < length && i < 6 && payload[i] >= '0' && payload[i] <= '9'; i++) {
+    seconds = seconds * 10 + (payload[i] - '0');
+  }
+  if (i == 0 || i != length) return;
+  if (seconds > RAW_STREAM_MAX_S) seconds = RAW_STREAM_MAX_S;
+  rawStreamRequest.store(seconds + 1, std::memory_order_release);
 }
 
 // Only process if it's our control topic
 void callback(char* topic, byte* payload, unsigned int length) {
+  uint32_t receivedUs = micros();
+
+  // Cấu hình là blob nhị phân, không phải lệnh văn bản
+  if (topics.isConfigTopic(topic)) {
+    handleConfigUpdate(payload, length);
+    return;
+  }
+  if (topics.isRulesTopic(topic)) {
+    handleRulesUpdate(payload, length);
+    return;
+  }
+  if (topics.isOtaTopic(topic)) {
+    if (otaOverMqtt()) handleOtaMessage(payload, length);
+    return;
+  }
+  if (topics.isSensorStreamTopic(topic)) {
+    handleRawStreamRequest(payload, length);
+    return;
+  }
+  // Bản retained / phản hồi trạng thái của chính nhà này
+  if (stateSync.onMessage(topic, payload, length)) {
+    return;
+  }
+
   // Limit message size to prevent buffer overflow
   if (length >= 255) {
     Serial.println("Message too large, rejecting");
     return;
   }
-  
-  // Safely copy payload with bounds checking
-  char message[256]; // Large enough buffer with room for null terminator
-  size_t copyLength = length < sizeof(message)-1 ? length : sizeof(message)-1;
-  memcpy(message, payload, copyLength);
-  message[copyLength] = '\0';
-  
-  String strMessage = String(message);
-  String strTopic = String(topic);
-  
+
+  // The payload is parsed in place: tokens point into it, no copy, no String.
+  const char* message = (const char*)payload;
+
   Serial.print("Message arrived on topic: ");
-  Serial.print(strTopic);
+  Serial.print(topic);
   Serial.print(". Message: ");
-  Serial.println(strMessage);
+  Serial.write((const uint8_t*)message, length);
+  Serial.println();
+
+  if (!topics.isControlTopic(topic)) {
+    return;
+  }
 
-  char ourControlTopic[100]; 
-  sprintf(ourControlTopic, TOPIC_ALL_CONTROLS, HOUSE_ID);
+  // Message format: "house_id:device_type:device_id:command"
+  Command cmd;
+  if (!parseCommand(message, length, cmd)) {
+    Serial.println("Định dạng lệnh không hợp lệ. Sử dụng: 'house_id:device_type:device_id:command'");
+    return;
+  }
 
-  if (strTopic == ourControlTopic) {
-    // Message format: "house_id:device_type:device_id:command"
-    
-    int firstColon = strMessage.indexOf(':');
-    int secondColon = strMessage.indexOf(':', firstColon + 1);
-    int thirdColon = strMessage.indexOf(':', secondColon + 1);
-
-    if (firstColon > 0 && secondColon > firstColon && thirdColon > secondColon) {
-      String houseId = strMessage.substring(0, firstColon);
-      String deviceType = strMessage.substring(firstColon + 1, secondColon);
-      String deviceIdStr = strMessage.substring(secondColon + 1, thirdColon);
-      String command = strMessage.substring(thirdColon + 1);
-      
-      int deviceId = deviceIdStr.toInt();
-      String lowerCommand = command;
-      lowerCommand.toLowerCase();
-
-      Serial.print("House ID: ");
-      Serial.print(houseId);
-      Serial.print(", Device Type: ");
-      Serial.print(deviceType);
-      Serial.print(", Device ID: ");
-      Serial.print(deviceId);
-      Serial.print(", Command: ");
-      Serial.println(command);
-      
-      if (houseId == HOUSE_ID) {
-        // Xử lý theo loại thiết bị và device ID
-        if (deviceType == "door") {
-          if (deviceId >= DOOR_ID_MIN && deviceId <= DOOR_ID_MAX) {
-            if (lowerCommand == "open" || lowerCommand == "close" || 
-                lowerCommand == "OPEN" || lowerCommand == "CLOSED" || lowerCommand == "on" || lowerCommand == "off" ) {
-              toggleDoor(deviceId);
-            } else {
-              Serial.println("Lệnh cửa không hợp lệ. Sử dụng: open/OPEN hoặc close/CLOSED");
-            }
-          } else {
-            Serial.print("Device ID cửa không hợp lệ. ID nhận được: ");
-            Serial.print(deviceId);
-            Serial.print(", phạm vi hợp lệ: ");
-            Serial.print(DOOR_ID_MIN);
-            Serial.print("-");
-            Serial.println(DOOR_ID_MAX);
-          }
-        }
-        else if (deviceType == "alarm") {
-          if (command == "ON") {
-            setAlarm(true);
-          } else if (command == "OFF") {
-            setAlarm(false);
-          } else {
-            Serial.println("Lệnh báo động không hợp lệ. Sử dụng: ON hoặc OFF");
-          }
-        }
-        else if (deviceType == "fan") {
-          if (deviceId >= FAN_ID_MIN && deviceId <= FAN_ID_MAX) {
-            if (command == "ON" || command == "on") {
-              setFan(true, deviceId);
-            } else if (command == "OFF" || command == "off") {
-              setFan(false, deviceId);
-            } else {
-              Serial.println("Lệnh quạt không hợp lệ. Sử dụng: ON hoặc OFF");
-            }
-          } else {
-            Serial.println("Device ID quạt không hợp lệ");
-          }
-        }
-        else if (deviceType == "rgb") {
-          if (deviceId >= RGB_ID_MIN && deviceId <= RGB_ID_MAX) {
-            // Xử lý lệnh ON/OFF cho RGB
-            if (command == "ON" || command == "on") {
-              setRGBColor(254, 254, 254, deviceId);
-              Serial.print("Bật đèn RGB ID ");
-              Serial.println(deviceId);
-            } 
-            else if (command == "OFF" || command == "off") {
-              setRGBColor(0, 0, 0, deviceId);
-              Serial.print("Tắt đèn RGB ID ");
-              Serial.println(deviceId);
-            }
-            // Xử lý lệnh màu sắc cụ thể theo định dạng "R,G,B"
-            else {
-              // Định dạng: "R,G,B" vd: "255,0,128"
-              int firstComma = command.indexOf(',');
-              int secondComma = command.lastIndexOf(',');
-              
-              if (firstComma > 0 && secondComma > firstComma) {
-                int r = command.substring(0, firstComma).toInt();
-                int g = command.substring(firstComma + 1, secondComma).toInt();
-                int b = command.substring(secondComma + 1).toInt();
-                
-                // Giới hạn giá trị trong khoảng 0-255
-                r = constrain(r, 0, 255);
-                g = constrain(g, 0, 255);
-                b = constrain(b, 0, 255);
-                
-                // Thiết lập màu mới
-                setRGBColor(r, g, b, deviceId);
-              } else {
-                Serial.println("Định dạng màu không hợp lệ. Sử dụng: R,G,B hoặc ON/OFF");
-              }
-            }
-          } else {
-            Serial.println("Device ID RGB không hợp lệ");
-          }
-        }
-        else {
-          Serial.print("Loại thiết bị không xác định: ");
-          Serial.println(deviceType);
+  Serial.print("House ID: ");
+  printToken(cmd.houseId);
+  Serial.print(", Device Type: ");
+  printToken(cmd.deviceType);
+  Serial.print(", Device ID: ");
+  Serial.print(cmd.deviceId);
+  Serial.print(", Command: ");
+  printToken(cmd.command);
+  Serial.println();
+
+  if (!cmd.houseId.equals(HOUSE_ID)) {
+    Serial.print("Lệnh không dành cho nhà này. Nhà hiện tại: ");
+    Serial.println(HOUSE_ID);
+    return;
+  }
+
+  if (cmd.deviceType.equals(CMD_BATCH_TYPE)) {
+    handleBatch(cmd, receivedUs);
+    return;
+  }
+
+  // Xử lý theo loại thiết bị và device ID
+  const CommandRoute* route = nullptr;
+  switch (findRoute(cmd, commandRoutes, commandRouteCount, &route)) {
+    case DISPATCH_OK:
+      if (!dualCoreMode) {
+        route->handler(cmd.deviceId, cmd.command);
+        metrics.recordCommand(micros() - receivedUs);
+        break;
+      }
+      // Payload bị ghi đè sau callback: chép lệnh vào record cho nhân cơ cấu
+      {
+        CommandRecord record;
+        bool made = makeCommandRecord(route, cmd.deviceId, cmd.command, record);
+        record.receivedUs = receivedUs;
+        if (!made || !commandQueue.push(record)) {
+          commandQueueDrops++;
+          Serial.println("Hàng đợi lệnh đầy hoặc lệnh quá dài, bỏ qua");
         }
-      } else {
-        Serial.print("Lệnh không dành cho nhà này. Nhà hiện tại: ");
-        Serial.println(HOUSE_ID);
       }
-    } else {
-      Serial.println("Định dạng lệnh không hợp lệ. Sử dụng: 'house_id:device_type:device_id:command'");
-    } 
+      break;
+    case DISPATCH_BAD_ID:
+      Serial.print("Device ID ");
+      Serial.print(route->deviceType);
+      Serial.print(" không hợp lệ. ID nhận được: ");
+      Serial.print(cmd.deviceId);
+      Serial.print(", phạm vi hợp lệ: ");
+      Serial.print(route->idMin);
+      Serial.print("-");
+      Serial.println(route->idMax);
+      break;
+    case DISPATCH_UNKNOWN_TYPE:
+      Serial.print("Loại thiết bị không xác định: ");
+      printToken(cmd.deviceType);
+      Serial.println();
+      break;
   }
 }
 
-void publishSensorData(float temperature, float humidity, int lightValue) {
-  if (client.connected()) {
-    char sensorTopic[60];
-    char deviceIdStr[5];
-    
-    // Publish temperature data for each temperature sensor ID (1-3)
-    for (int i = TEMP_HUMI_ID_MIN; i <= TEMP_HUMI_ID_MAX; i++) {
-      sprintf(deviceIdStr, "%d", i);
-      
-      // Temperature
-      sprintf(sensorTopic, TOPIC_TEMP_STATUS, HOUSE_ID, deviceIdStr);
-      char tempStr[10];
-      dtostrf(temperature, 1, 2, tempStr);
-      client.publish(sensorTopic, tempStr);
-      
-      // Humidity
-      sprintf(sensorTopic, TOPIC_HUMI_STATUS, HOUSE_ID, deviceIdStr);
-      char humiStr[10];
-      dtostrf(humidity, 1, 2, humiStr);
-      client.publish(sensorTopic, humiStr);
+// Bộ đệm văn bản dùng lại cho mọi payload cảm biến (phía mạng, xem
+// telemetry_format.h): số nguyên / fixed-point, không printf số thực
+TextBuffer<SENSOR_SUMMARY_MAX + 1> telemetryText;
+
+// Gửi dữ liệu cảm biến theo topic riêng cho từng device ID (định dạng cũ)
+void publishSensorTopics(float temperature, float humidity, int lightValue,
+                         const int lightValues[SENSOR_FRAME_LIGHTS], uint8_t channels) {
+  int32_t tempCenti = toFixed<2>(temperature);
+  int32_t humiCenti = toFixed<2>(humidity);
+
+  // Cùng một giá trị cho mọi ID nhiệt độ/độ ẩm trong config: định dạng một lần
+  if (channels & (1u << CH_TEMP)) {
+    telemetryText.clear().fixed<2>(tempCenti);
+    const TopicIdRange& tempIds = config.ranges[STATUS_TEMP];
+    for (int i = tempIds.idMin; i <= tempIds.idMax; i++) {
+      publishMqtt(topics.status(STATUS_TEMP, i), telemetryText.c_str());
     }
-    
-    // Publish light data for each light sensor ID (4-6) with unique values
-    for (int i = LIGHT_ID_MIN; i <= LIGHT_ID_MAX; i++) {
-      // Lấy giá trị ánh sáng cụ thể cho từng ID cảm biến
-      int specificLightValue = getLightValueById(i);
-      
-      sprintf(deviceIdStr, "%d", i);
-      sprintf(sensorTopic, TOPIC_LIGHT_STATUS, HOUSE_ID, deviceIdStr);
-      char lightStr[10];
-      sprintf(lightStr, "%d", specificLightValue);
-      
-      boolean published = client.publish(sensorTopic, lightStr, true);
-      
-      Serial.print("Đã gửi giá trị ánh sáng cho ID ");
-      Serial.print(i);
-      Serial.print(": ");
-      Serial.print(specificLightValue);
-      Serial.print(" - Topic: ");
-      Serial.print(sensorTopic);
-      Serial.print(" - Thành công: ");
-      Serial.println(published ? "YES" : "NO");
+  }
+  if (channels & (1u << CH_HUMI)) {
+    telemetryText.clear().fixed<2>(humiCenti);
+    const TopicIdRange& humiIds = config.ranges[STATUS_HUMI];
+    for (int i = humiIds.idMin; i <= humiIds.idMax; i++) {
+      publishMqtt(topics.status(STATUS_HUMI, i), telemetryText.c_str());
     }
+  }
+  
+  // Publish light data for each light sensor ID with unique values
+  const TopicIdRange& lightIds = config.ranges[STATUS_LIGHT];
+  for (int i = lightIds.idMin; i <= lightIds.idMax; i++) {
+    if (!(channels & (1u << (CH_LIGHT_FIRST + i - lightIds.idMin)))) continue;
+    int specificLightValue = lightValues[i - lightIds.idMin];
+    const char* sensorTopic = topics.status(STATUS_LIGHT, i);
+    telemetryText.clear().integer(specificLightValue);
     
-    sprintf(sensorTopic, TOPIC_ALL_SENSORS, HOUSE_ID);
-    char sensorData[100];
-    sprintf(sensorData, "{\"temp\":%.2f,\"humi\":%.2f,\"light\":%d}",
-            temperature, humidity, lightValue);
-    client.publish(sensorTopic, sensorData, true);
+    boolean published = publishMqtt(sensorTopic, telemetryText.c_str(), true);
     
-    Serial.println("Sensor data sent to MQTT broker with device IDs");
+    Serial.print("Đã gửi giá trị ánh sáng cho ID ");
+    Serial.print(i);
+    Serial.print(": ");
+    Serial.print(specificLightValue);
+    Serial.print(" - Topic: ");
+    Serial.print(sensorTopic);
+    Serial.print(" - Thành công: ");
+    Serial.println(published ? "YES" : "NO");
+  }
+  
+  publishMqtt(topics.sensors(),
+                 formatSensorSummary(telemetryText, tempCenti, humiCenti, lightValue), true);
+}
+
+// Một mẫu đo đầy đủ, dùng cho cả frame nhị phân và hàng đợi offline
+SensorFrame makeSensorFrame(float temperature, float humidity,
+                            const int lightValues[SENSOR_FRAME_LIGHTS], uint32_t sampledAtMs) {
+  SensorFrame frame = {};
+  frame.seq = sensorFrameSeq++;
+  frame.timestampMs = sampledAtMs;
+  setSensorFrameClimate(frame, temperature, humidity);
+  for (int i = 0; i < SENSOR_FRAME_LIGHTS; i++) {
+    frame.light[i] = (uint16_t)lightValues[i];
+  }
+  return frame;
+}
+
+// Gửi toàn bộ số đo trong một frame nhị phân (xem sensor_frame.h)
+bool publishSensorFrame(const SensorFrame& frame) {
+  uint8_t payload[SENSOR_FRAME_SIZE];
+  size_t length = encodeSensorFrame(frame, payload, sizeof(payload));
+  boolean published = publishMqtt(topics.sensorFrame(), payload, length);
+
+  Serial.print("Đã gửi sensor frame #");
+  Serial.print(frame.seq);
+  Serial.print(" - Thành công: ");
+  Serial.println(published ? "YES" : "NO");
+  return published;
+}
+
+// Lấy giá trị ánh sáng cụ thể cho từng ID cảm biến, một lần cho mọi định dạng
+void readLightValues(int lightValues[SENSOR_FRAME_LIGHTS]) {
+  const TopicIdRange& lightIds = config.ranges[STATUS_LIGHT];
+  for (int i = lightIds.idMin; i <= lightIds.idMax; i++) {
+    lightValues[i - lightIds.idMin] = getLightValueById(i);
+  }
+}
+
+// Gửi một mẫu lấy lúc sampledAtMs; ở chế độ topic chỉ gửi các kênh trong channels
+void sendSensorSample(float temperature, float humidity, int lightValue,
+                      const int lightValues[SENSOR_FRAME_LIGHTS], uint8_t channels,
+                      uint32_t sampledAtMs) {
+  SensorFrame frame = makeSensorFrame(temperature, humidity, lightValues, sampledAtMs);
+
+  if (!client.connected()) {
+    sampleBacklog.push(frame);
+    Serial.print("MQTT offline, đã lưu mẫu #");
+    Serial.print(frame.seq);
+    Serial.print(", đang chờ: ");
+    Serial.println((unsigned long)sampleBacklog.size());
+    return;
+  }
+
+  if (sensorPublishMode != SENSOR_PUBLISH_TOPICS && !publishSensorFrame(frame)) {
+    sampleBacklog.push(frame);
+  }
+  if (sensorPublishMode != SENSOR_PUBLISH_FRAME) {
+    publishSensorTopics(temperature, humidity, lightValue, lightValues, channels);
+  }
+
+  Serial.println("Sensor data sent to MQTT broker with device IDs");
+}
+
+// Gửi một mẫu vừa đo; ở chế độ hai nhân nhân mạng sẽ gửi (xem taskTelemetry)
+void publishSensorSample(float temperature, float humidity, int lightValue,
+                         const int lightValues[SENSOR_FRAME_LIGHTS], uint8_t channels) {
+  if (!dualCoreMode) {
+    sendSensorSample(temperature, humidity, lightValue, lightValues, channels, millis());
+    return;
+  }
+  TelemetryRecord record;
+  record.kind = TELEMETRY_SAMPLE;
+  record.sample.temperature = temperature;
+  record.sample.humidity = humidity;
+  record.sample.lightValue = lightValue;
+  for (int i = 0; i < SENSOR_FRAME_LIGHTS; i++) record.sample.lightValues[i] = lightValues[i];
+  record.sample.channels = channels;
+  record.sample.sampledAtMs = millis();
+  if (!telemetryQueue.push(record)) {
+    telemetryQueueDrops++;
+  }
+}
+
+// Gửi toàn bộ số đo ngay, không xét chính sách báo cáo
+void publishSensorData(float temperature, float humidity, int lightValue) {
+  int lightValues[SENSOR_FRAME_LIGHTS];
+  readLightValues(lightValues);
+  publishSensorSample(temperature, humidity, lightValue, lightValues, SENSOR_CHANNELS_ALL);
+}
+
+// Số đo thô có được gửi không: theo SENSOR_RAW_STREAM, hoặc theo yêu cầu
+// trên yolouno/<house>/sensors/stream còn hạn
+bool rawStreamOn(uint32_t now) {
+  uint32_t request = rawStreamRequest.exchange(0, std::memory_order_acquire);
+  if (request) {
+    rawStreaming = request > 1;
+    rawStreamUntilMs = now + (request - 1) * 1000;
+    // Bắt đầu lại từ đầu: mẫu kế tiếp gửi đủ mọi kênh
+    for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) sensorReporters[c].reset();
+  }
+  if (rawStreaming && (int32_t)(now - rawStreamUntilMs) >= 0) rawStreaming = false;
+  return sensorRawStream || rawStreaming;
+}
+
+// Chỉ gửi khi có kênh cần báo cáo theo sensorPolicies; khi tắt gửi thô chỉ
+// còn kênh vừa vượt ngưỡng báo động
+void reportSensorData(float temperature, float humidity, int lightValue) {
+  int lightValues[SENSOR_FRAME_LIGHTS];
+  readLightValues(lightValues);
+
+  int32_t values[SENSOR_CHANNEL_COUNT];
+  values[CH_TEMP] = lroundf(temperature * 100.0f);
+  values[CH_HUMI] = lroundf(humidity * 100.0f);
+  for (int i = 0; i < SENSOR_FRAME_LIGHTS; i++) values[CH_LIGHT_FIRST + i] = lightValues[i];
+
+  uint8_t channels = 0;
+  unsigned long now = millis();
+  bool raw = rawStreamOn(now);
+  for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+    ReportReason reason = sensorReporters[c].sample(sensorPolicies[c], values[c], now);
+    if (reason == REPORT_ALARM || (raw && reason != REPORT_NONE)) {
+      channels |= 1u << c;
+    }
+  }
+  if (channels) {
+    publishSensorSample(temperature, humidity, lightValue, lightValues, channels);
+  }
+}
+
+// Gửi một cửa sổ thống kê vừa đóng; ở chế độ hai nhân nhân mạng sẽ gửi.
+// Mất MQTT thì bản đó mất (không vào hàng đợi offline như mẫu thô).
+void publishRollup(const RollupRecord& record) {
+  TelemetryRecord out;
+  out.kind = TELEMETRY_ROLLUP;
+  out.rollup.len = (uint8_t)encodeSensorRollup(record, out.rollup.bytes, sizeof(out.rollup.bytes));
+  if (!dualCoreMode) {
+    publishMqtt(topics.sensorRollup(), out.rollup.bytes, out.rollup.len);
+  } else if (!telemetryQueue.push(out)) {
+    telemetryQueueDrops++;
+  }
+}
+
+// Đóng các cửa sổ đã hết hạn trước khi cộng mẫu mới vào
+void closeRollups() {
+  RollupRecord record;
+  while (rollup.close(millis(), record)) publishRollup(record);
+}
+
+// Gửi bù một lô mẫu cũ nhất; chỉ xoá khỏi hàng đợi khi publish thành công
+void drainSampleBacklog() {
+  SensorFrame frames[SAMPLE_DRAIN_BATCH];
+  size_t count = sampleBacklog.peek(frames, SAMPLE_DRAIN_BATCH);
+  if (count == 0) return;
+
+  uint8_t payload[SENSOR_BACKLOG_HEADER_SIZE + SAMPLE_DRAIN_BATCH * SENSOR_FRAME_SIZE];
+  size_t length = encodeSensorBacklog(frames, count, millis(), payload, sizeof(payload));
+  if (publishMqtt(topics.sensorBacklog(), payload, length)) {
+    sampleBacklog.pop(count);
+  }
+}
+
+//--- Các task của scheduler ---
+
+void taskConnection() {
+  // WiFi/MQTT state machine: never blocks waiting for the network
+  connection.service();
+}
+
+void taskStateSync() {
+  if (connection.mqttUp()) {
+    stateSync.service(millis());
+  }
+  // Chỉ chạy khi đang đồng bộ; onMqttConnected() bật lại
+  if (!stateSync.syncing()) {
+    networkScheduler->setEnabled(syncTask, false);
+  }
+}
+
+void taskMqttInput() {
+  // Lệnh điều khiển được xử lý ngay ở lần loop() kế tiếp
+  if (connection.mqttUp()) {
+    client.loop();
+  }
+}
+
+void taskLightSampling() {
+  lights.sample();
+  const LightSnapshot& light = lights.snapshot();
+  for (int i = 0; i < LIGHT_SAMPLER_CHANNELS; i++) inputs.sampleThreshold(i, light.value[i]);
+  closeRollups();
+  if (light.bursts) {
+    for (int i = 0; i < SENSOR_FRAME_LIGHTS; i++) rollup.add(CH_LIGHT_FIRST + i, light.value[i]);
+  }
+}
+
+void taskSampleDrain() {
+  // Gửi bù mẫu đo đã lưu khi offline, giới hạn tốc độ
+  if (connection.mqttUp() && !sampleBacklog.empty()) {
+    drainSampleBacklog();
+  }
+}
+
+// Hai pha để không chặn loop() trong lúc DHT20 đo (~80 ms): gửi lệnh đo,
+// quay lại khi đo xong để đọc và kiểm CRC (xem climate_sensor.h)
+void taskClimate() {
+  uint32_t nextMs;
+  ClimateResult result = climate.step(&nextMs);
+  if (result == CLIMATE_TRIGGERED || result == CLIMATE_BUSY) {
+    scheduler.runAfter(climateTask, nextMs);
+    return;
+  }
+  // Chu kỳ kế tiếp tính từ lúc gửi lệnh đo, dù phải chờ thêm
+  uint32_t elapsed = millis() - climate.triggeredAtMs();
+  scheduler.runAfter(climateTask,
+                     elapsed < config.sensorIntervalMs ? config.sensorIntervalMs - elapsed : 0);
+
+  if (result == CLIMATE_FAILED) {
+    Serial.println("Failed to read from DHT20 sensor!");
+    return;
+  }
+  float temperature = climate.reading().temperature;
+  float humidity = climate.reading().humidity;
+  int lightValue = getLightValueById(config.ranges[STATUS_LIGHT].idMin);
+  closeRollups();
+  rollup.add(CH_TEMP, lroundf(temperature * 100.0f));
+  rollup.add(CH_HUMI, lroundf(humidity * 100.0f));
+
+  // Print sensor values to serial
+  Serial.print("Temperature: ");
+  Serial.print(temperature);
+  Serial.print(" °C, Humidity: ");
+  Serial.print(humidity);
+  Serial.print("%, Light: ");
+  Serial.println(lightValue);
+
+  // Chạy luật ngay với số đo mới
+  scheduler.runAfter(rulesTask, 0);
+
+  // Chỉ gửi kênh đã thay đổi, quá hạn im lặng hoặc vượt ngưỡng báo động
+  reportSensorData(temperature, humidity, lightValue);
+}
+
+// Hành động của một luật; báo động đi qua setAlarm() để đổi cả màu đèn
+void applyRuleAction(int slot, uint32_t target) {
+  if (slot == alarmSlot) {
+    setAlarm(target != 0, devices.id(slot));
+  } else {
+    setDevice(slot, target);
+  }
+  Serial.print("Luật tự động: ");
+  Serial.print(topics.status(devices.kind(slot), devices.id(slot)));
+  Serial.print(" -> ");
+  Serial.println(target);
+}
+
+void taskRules() {
+  if (rulesUpdated.exchange(false, std::memory_order_acquire)) {
+    RuleSet set;
+    if (loadRuleSet(LittleFS, devices, set) == CONFIG_OK) rules.load(set);
+  }
+
+  // Kênh nhiệt độ/độ ẩm chỉ hợp lệ sau lần đọc DHT20 thành công đầu tiên
+  int32_t values[SENSOR_CHANNEL_COUNT];
+  uint8_t valid = 0;
+  const ClimateReading& reading = climate.reading();
+  values[CH_TEMP] = lroundf(reading.temperature * 100.0f);
+  values[CH_HUMI] = lroundf(reading.humidity * 100.0f);
+  if (reading.readings) valid |= (1u << CH_TEMP) | (1u << CH_HUMI);
+  const LightSnapshot& light = lights.snapshot();
+  for (int i = 0; i < SENSOR_FRAME_LIGHTS; i++) values[CH_LIGHT_FIRST + i] = light.value[i];
+  if (light.bursts) valid |= ((1u << SENSOR_FRAME_LIGHTS) - 1) << CH_LIGHT_FIRST;
+
+  rules.evaluate(values, valid, millis(), applyRuleAction);
+}
+
+// Sự kiện đầu vào, mỗi lượt loop(); hàng đợi rỗng chỉ tốn một lần đọc.
+// Các cạnh dội (bounce) trong cùng một lượt gộp lại: chỉ mức cuối của mỗi chân.
+void taskInputs() {
+  InputEvent event;
+  uint8_t level[INPUT_MAX_PINS];
+  uint32_t changed = 0;
+  bool lightCrossed = false;
+  while (inputs.pop(event)) {
+    if (event.source == INPUT_PIN) {
+      level[event.channel] = event.level;
+      changed |= 1u << event.channel;
+      continue;
+    }
+    // Ánh sáng qua ngưỡng: gửi giá trị hiện tại của kênh đó ngay
+    const TopicIdRange& lightIds = config.ranges[STATUS_LIGHT];
+    char text[INT_TEXT_MAX + 1];
+    formatInt(text, lights.snapshot().value[event.channel]);
+    publishStatus(topics.status(STATUS_LIGHT, lightIds.idMin + event.channel), text, true);
+    lightCrossed = true;
+  }
+  for (size_t c = 0; c < inputs.pins(); c++) {
+    if (!(changed & (1u << c))) continue;
+    int slot = inputDoorSlot[c];
+    // Servo đang chạy theo lệnh: công tắc chưa phản ánh vị trí cuối
+    if (doorsMoving & (1u << slot)) continue;
+    // Servo theo cửa để không cản người mở; không qua setDevice(), không phải lệnh
+    uint32_t open = level[c] == HIGH;
+    if (devices.state(slot) == open) continue;
+    devices.setTarget(slot, open);
+    applyDevice(slot);
+    publishDevice(slot);
+  }
+  // Servo chạy xong: đọc lại công tắc ở lượt sau
+  if (doorsMoving) {
+    uint32_t now = millis();
+    for (size_t slot = 0; slot < devices.count(); slot++) {
+      uint32_t bit = 1u << slot;
+      if (!(doorsMoving & bit) || (int32_t)(now - doorSettleAtMs[slot]) < 0) continue;
+      doorsMoving &= ~bit;
+      inputs.resync();
+    }
+  }
+  if (lightCrossed) scheduler.runAfter(rulesTask, 0);
+}
+
+bool lcdLayoutDrawn = false;
+
+void taskLcd() {
+  // Lần đầu (sau LCD_SPLASH_MS): thay màn hình chào bằng nhãn các ô
+  if (!lcdLayoutDrawn) {
+    screen.clear();
+    screen.print(0, 0, "T:");
+    screen.print(8, 0, "H:");
+    screen.print(0, 1, "L:");
+    lcdLayoutDrawn = true;
+  }
+  temperature1();
+  luxSensor();
+  requestRender();
+}
+
+void taskRender() {
+  strip.flush();
+  screen.flush(LCD_FLUSH_BUDGET_BYTES);
+  // Đã gửi hết: nghỉ tới lần requestRender() kế tiếp, loop() được ngủ lâu hơn
+  if (!strip.dirty() && !screen.dirty()) {
+    scheduler.setEnabled(renderTask, false);
+  }
+}
+
+// Chế độ hai nhân, phía cơ cấu: thực thi các lệnh nhân mạng đã nhận
+void taskCommands() {
+  if (restartRequested.exchange(false, std::memory_order_acquire)) scheduleRestart();
+  CommandRecord record;
+  while (commandQueue.pop(record)) {
+    bool applied = record.route && record.route->handler(record.deviceId, record.command());
+    if (record.route) metrics.recordCommand(micros() - record.receivedUs);
+    if (record.batchTotal == 0) continue;
+    batchApplied += applied;
+    if (record.batchIndex + 1 == record.batchTotal) {
+      publishAck(record.id(), batchResult(batchApplied, record.batchTotal), batchApplied,
+                 record.batchTotal, record.receivedUs, true);
+      batchApplied = 0;
+    }
+  }
+}
+
+// Chế độ hai nhân, phía mạng: gửi trạng thái và mẫu đo theo đúng thứ tự
+void taskTelemetry() {
+  TelemetryRecord record;
+  while (telemetryQueue.pop(record)) {
+    if (record.kind == TELEMETRY_PUBLISH) {
+      const TelemetryPublish& p = record.publish;
+      publishMqtt(p.topic, (const uint8_t*)p.payload, p.len, p.retained);
+    } else if (record.kind == TELEMETRY_ROLLUP) {
+      publishMqtt(topics.sensorRollup(), record.rollup.bytes, record.rollup.len);
+    } else {
+      const TelemetrySample& s = record.sample;
+      sendSensorSample(s.temperature, s.humidity, s.lightValue, s.lightValues, s.channels,
+                       s.sampledAtMs);
+    }
+  }
+}
+
+// Số đo chẩn đoán định kỳ, phía mạng. Bộ đếm tính từ lúc khởi động (bên
+// nhận lấy hiệu hai báo cáo), max và heap/stack là của lúc báo cáo.
+void taskMetrics() {
+  if (!connection.mqttUp()) return;
+  MetricsInputs in;
+  in.uptimeMs = millis();
+  in.reconnects = connection.reconnects();
+  in.queueDrops = commandQueueDrops + telemetryQueueDrops;
+  in.publishOk = stateSync.published();
+  in.publishFailed = stateSync.failed();
+  publishMqtt(topics.diagnostics(), metrics.report(metricsText, in));
+}
+
+// Áp dụng đoạn bản vá đang chờ, mỗi lượt OTA_STEP_BYTES; lúc firmware đang
+// thử nghiệm thì xác nhận khi MQTT đã kết nối và đồng bộ trạng thái xong.
+void taskOta() {
+#ifdef OTA_PASSWORD
+  ArduinoOTA.handle();
+#endif
+  OtaEvent event = ota.step();
+  publishOtaEvent(event);
+  if (event == OTA_APPLIED) requestRestart();
+  publishOtaEvent(ota.checkTrial(connection.mqttUp() && !stateSync.syncing(), millis()));
+#ifndef OTA_PASSWORD
+  // Không còn việc: nghỉ tới đoạn bản vá kế tiếp
+  if (!ota.pending() && !ota.onTrial()) {
+    networkScheduler->setEnabled(otaTask, false);
+  }
+#endif
+}
+
+// Một lượt phía mạng; ioTask lặp lại nó trên IO_TASK_CORE
+void ioStep() {
+  ioScheduler.run();
+}
+
+void ioTaskMain(void*) {
+  for (;;) {
+    ioStep();
+    vTaskDelay(1);   // Nhường CPU cho task idle (watchdog) trên nhân này
   }
 }
 
@@ -530,112 +1446,166 @@ void setup() {
   Serial.begin(115200);
   Serial.println("Starting setup...");
 
+  // Cấu hình của nhà: /config.bin nếu hợp lệ, không thì mặc định trong firmware
+  bool flashReady = LittleFS.begin(true);
+  loadDefaultConfig(config);
+  ConfigResult configResult = flashReady ? loadDeviceConfig(LittleFS, config) : CONFIG_IO_ERROR;
+  Serial.print("Cấu hình: ");
+  Serial.println(configResult == CONFIG_OK ? "flash" : configResultName(configResult));
+  for (size_t i = 0; i < commandRouteCount; i++) {
+    commandRoutes[i].idMin = config.ranges[commandRouteKinds[i]].idMin;
+    commandRoutes[i].idMax = config.ranges[commandRouteKinds[i]].idMax;
+  }
 
+  lights = LightSampler(config.lightPins);
+  lights.begin();
 
-  pinMode(FAN_PIN_1, OUTPUT);
-  pinMode(FAN_PIN_2, OUTPUT);
-  digitalWrite(FAN_PIN_1, LOW);
-  digitalWrite(FAN_PIN_2, LOW);
-  
-  // Khởi tạo servo
-  doorServos[0].attach(SERVO_PIN_1); 
-  doorServos[0].write(0);            
-  
-  doorServos[1].attach(SERVO_PIN_2); 
-  doorServos[1].write(0);
-  
-  doorServos[2].attach(SERVO_PIN_3);  
-  doorServos[2].write(0);
-  
-  doorServos[3].attach(SERVO_PIN_4);  
-  doorServos[3].write(0);
   // Khởi tạo NeoPixel
   pixels.begin();
   pixels.setBrightness(50);
   pixels.clear(); 
-  
+
+  // Khởi tạo thiết bị theo bảng: chân quạt, servo cửa, trạng thái đầu
+  if (!devices.build(config.devices, config.deviceCount)) {
+    Serial.println("Bảng thiết bị không hợp lệ (quá nhiều hoặc trùng ID)");
+  }
+  alarmSlot = devices.find(STATUS_ALARM, config.ranges[STATUS_ALARM].idMin);
+  RuleSet ruleSet;
+  loadDefaultRules(ruleSet);
+  ConfigResult rulesResult = flashReady ? loadRuleSet(LittleFS, devices, ruleSet) : CONFIG_IO_ERROR;
+  Serial.print("Luật tự động: ");
+  Serial.print(rules.load(ruleSet));
+  Serial.println(rulesResult == CONFIG_OK ? " (flash)" : " (mặc định)");
+  for (size_t slot = 0; slot < devices.count(); slot++) {
+    if (devices.kind(slot) == STATUS_DOOR) {
+      servos[slot].attach(devices.pin(slot));
+    } else if (devices.kind(slot) == STATUS_FAN) {
+      pinMode(devices.pin(slot), OUTPUT);
+    }
+    applyDevice(slot);
+  }
+
+  // Ngắt của công tắc cửa đánh thức task loop() (setup() chạy trong task đó)
+  inputs.begin(xTaskGetCurrentTaskHandle());
+  for (size_t i = 0; doorSense && i < sizeof(doorSensors) / sizeof(doorSensors[0]); i++) {
+    int slot = devices.find(STATUS_DOOR, doorSensors[i].doorId);
+    if (slot < 0) continue;
+    int channel = inputs.watchPin(doorSensors[i].pin, INPUT_PULLUP);
+    if (channel >= 0) inputDoorSlot[channel] = slot;
+  }
+  for (int i = 0; i < LIGHT_SAMPLER_CHANNELS; i++) {
+    inputs.watchThreshold(LIGHT_DARK_RAW, LIGHT_BRIGHT_RAW);
+  }
+  inputs.resync();   // Cửa đang mở lúc khởi động: lượt đầu tiên đọc mức hiện tại
+
+  snprintf(mqttClientId, sizeof(mqttClientId), "%s%s", MQTT_CLIENT_ID_PREFIX, HOUSE_ID);
+  connection.setCleanSession(false);
+  if (mqttTls) {
+    // Chứng chỉ CA và phiên TLS của lần chạy trước (nếu có) từ flash
+    File caFile = flashReady ? LittleFS.open(TLS_CA_PATH, FILE_READ) : File();
+    size_t caLength = caFile ? caFile.read((uint8_t*)mqttCaPem, TLS_CA_MAX) : 0;
+    if (caFile) caFile.close();
+    mqttCaPem[caLength] = '\0';
+    if (caLength == 0) Serial.println("Thiếu chứng chỉ CA " TLS_CA_PATH ", MQTT sẽ không kết nối");
+    tlsClient.setCACert(caLength > 0 ? mqttCaPem : nullptr);
+    tlsSessions.begin(flashReady ? &LittleFS : nullptr);
+    tlsClient.setSessionCache(&tlsSessions);
+    client.setClient(tlsClient);
+  }
+
   Serial.println("Initializing WiFi...");
-  InitWiFi();
-  Serial.println("WiFi initialized!");
+  connection.begin();
   Wire.begin(SDA_PIN, SCL_PIN);
   
   lcd.init();
   lcd.backlight();
   lcd.clear();
+  screen.reset();
   
-  lcd.setCursor(0, 0);
-  lcd.print("Smarthome System");
-  lcd.setCursor(0, 1);
-  lcd.print("Initializing...");
-  delay(2000);
-  
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("T:");
-  lcd.setCursor(8, 0);
-  lcd.print("H:");
-  lcd.setCursor(0, 1);
-  lcd.print("L:");
+  // Màn hình chào ở lại LCD_SPLASH_MS, đến lần chạy đầu của task lcd
+  screen.print(0, 0, "Smarthome System");
+  screen.print(0, 1, "Initializing...");
+  screen.flush(SIZE_MAX);
 
   if (dht20.begin()) {
     Serial.println("DHT20 sensor initialized!");
   } else {
     Serial.println("Failed to initialize DHT20 sensor!");
   }
+#if SAMPLE_SPILL_FLASH
+  if (!flashReady || !sampleBacklog.beginSpill(LittleFS)) {
+    Serial.println("Không dùng được LittleFS, mẫu offline chỉ lưu trong RAM");
+  }
+#endif
   Serial.println("Setting up MQTT...");
-  client.setServer(mqtt_server, 1883);
+  if (!topics.build(HOUSE_ID, config.ranges)) {
+    Serial.println("HOUSE_ID quá dài, không tạo được bảng topic MQTT");
+  }
+  client.setServer(config.mqttHost, config.mqttPort);
+  client.setBufferSize(MQTT_MAX_PACKET_SIZE);
   client.setCallback(callback);
-  if (!client.connected()) {
-    reconnect();
-  } 
-  char statusTopic[60];
-  sprintf(statusTopic, "yolouno/%s/status/device", HOUSE_ID);
-  client.publish(statusTopic, "Device is online");
-  Serial.println("Sent online status message");
+  connection.onConnected(onMqttConnected);
+  ota.begin(millis());
+  if (ota.onTrial()) Serial.println("Firmware mới, chờ kết nối MQTT để xác nhận");
+#ifdef OTA_PASSWORD
+  ArduinoOTA.setHostname(HOUSE_ID);
+  ArduinoOTA.setPassword(OTA_PASSWORD);
+  ArduinoOTA.begin();
+#endif
+
+  // Ưu tiên cao chạy trước khi nhiều task đến hạn cùng lúc.
+  // Chế độ hai nhân: việc mạng sang ioScheduler, loop() chỉ còn cảm biến/cơ cấu
+  networkScheduler = dualCoreMode ? &ioScheduler : &scheduler;
+  TaskScheduler& network = *networkScheduler;
+  network.add("connection", taskConnection, SCHED_EVERY_PASS, 5);
+  network.add("mqtt", taskMqttInput, SCHED_EVERY_PASS, 4);
+  syncTask = network.add("sync", taskStateSync, STATE_SYNC_INTERVAL_MS, 3);
+  network.setEnabled(syncTask, false);
+  if (dualCoreMode) {
+    ioScheduler.add("telemetry", taskTelemetry, SCHED_EVERY_PASS, 3);
+    scheduler.add("commands", taskCommands, SCHED_EVERY_PASS, 4);
+  }
+  scheduler.add("inputs", taskInputs, SCHED_EVERY_PASS, 5);
+  rulesTask = scheduler.add("rules", taskRules, config.alarmIntervalMs, 3);
+  rollup.begin(rollupWindowsMs, sizeof(rollupWindowsMs) / sizeof(rollupWindowsMs[0]),
+               SENSOR_CHANNEL_COUNT, millis());
+  climateTask = scheduler.add("climate", taskClimate, config.sensorIntervalMs, 2);
+  scheduler.add("lights", taskLightSampling, LIGHT_SAMPLE_INTERVAL_MS, 2);
+  network.add("backlog", taskSampleDrain, SAMPLE_DRAIN_INTERVAL_MS, 1);
+  network.add("metrics", taskMetrics, METRICS_INTERVAL_MS, 0, METRICS_INTERVAL_MS);
+  otaTask = network.add("ota", taskOta, SCHED_EVERY_PASS, 1);
+  scheduler.add("lcd", taskLcd, config.lcdIntervalMs, 0, LCD_SPLASH_MS);
+  renderTask = scheduler.add("render", taskRender, RENDER_INTERVAL_MS, 0);
+  // Chạy một lần, CONFIG_RESTART_DELAY_MS sau runAfter() (task có chu kỳ mới chờ hạn)
+  restartTask = scheduler.add("restart", taskRestart, CONFIG_RESTART_DELAY_MS, 0);
+  scheduler.setEnabled(restartTask, false);
+
+  if (dualCoreMode &&
+      xTaskCreatePinnedToCore(ioTaskMain, "io", IO_TASK_STACK, nullptr, IO_TASK_PRIORITY,
+                              &ioTask, IO_TASK_CORE) != pdPASS) {
+    // Không tạo được task: chạy phần mạng ngay trong loop()
+    Serial.println("Không tạo được task mạng, chạy một nhân");
+    scheduler.add("io", ioStep, SCHED_EVERY_PASS, 5);
+  }
+  // setup() chạy trong task của loop(): stack của nó, rồi của task mạng
+  metrics.watchStack(xTaskGetCurrentTaskHandle());
+  metrics.watchStack(ioTask);
+
+  // Light sleep dừng cả hai nhân: ở chế độ hai nhân chỉ dùng modem sleep
+  PowerMode mode = (PowerMode)powerMode;
+  if (dualCoreMode && mode == POWER_LIGHT_SLEEP) mode = POWER_MODEM_SLEEP;
+  power.begin(mode, powerMaxLatencyMs, powerWakePin, LOW);
   
   Serial.println("Setup completed!");
 }
 
 void loop() {
-  unsigned long currentMillis = millis();
-    
-  //--- Update MQTT connection every 1s ---
-  if (currentMillis - lastMQTTTime >= mqttInterval) {
-    lastMQTTTime = currentMillis;
-    if (!client.connected()) {
-      reconnect();
-    }
-    client.loop();  // Always listen for MQTT messages
-  }
-
-  if (currentMillis - lastSensorTime >= sensorInterval) {
-    lastSensorTime = currentMillis;
-    
-    dht20.read();
-    float temperature = dht20.getTemperature();
-    float humidity = dht20.getHumidity();
-    int lightValue = luxSensor();
-    temperature1();
-
-    if (isnan(temperature) || isnan(humidity)) {
-      Serial.println("Failed to read from DHT20 sensor!");
-    } else {
-      // Print sensor values to serial
-      Serial.print("Temperature: ");
-      Serial.print(temperature);
-      Serial.print(" °C, Humidity: ");
-      Serial.print(humidity);
-      Serial.print("%, Light: ");
-      Serial.println(lightValue);
-      
-      // Kiểm tra nhiệt độ và kích hoạt báo động nếu cần
-      if (temperature > TEMP_THRESHOLD && !alarmActive) {
-        setAlarm(true);
-        Serial.println("Báo động nhiệt độ cao!");
-      }
-      
-      // Publish sensor data with device IDs
-      publishSensorData(temperature, humidity, lightValue);
-    }
+  uint32_t start = micros();
+  scheduler.run();
+  metrics.recordLoop(micros() - start);
+  // Ngủ tới việc kế tiếp; task chạy mọi lượt (kết nối, MQTT) không tính.
+  // Ngắt không chạy trong light sleep: đọc lại chân đầu vào sau khi thức.
+  if (power.sleep(scheduler.idleMs(false)) == SLEEP_LIGHT) {
+    inputs.resync();
   }
 }
@@ -0,0 +1,52 @@
+#include "metrics.h"
+
+#include <Arduino.h>
+
+namespace {
+
+void appendHistogram(MetricsText& out, MetricHistogram& histogram) {
+  out.literal("[").uinteger(histogram.takeMax());
+  for (uint8_t i = 0; i < METRIC_BUCKETS; i++) out.literal(",").uinteger(histogram.bucket(i));
+  out.literal("]");
+}
+
+}  // namespace
+
+uint32_t MetricHistogram::count() const {
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < METRIC_BUCKETS; i++) total += bucket(i);
+  return total;
+}
+
+bool Metrics::watchStack(TaskHandle_t task) {
+  if (taskCount_ == METRIC_TASKS || !task) return false;
+  tasks_[taskCount_++] = task;
+  return true;
+}
+
+const char* Metrics::report(MetricsText& out, const MetricsInputs& in) {
+  out.clear().literal("{\"up\":").uinteger(in.uptimeMs).literal(",\"loop\":");
+  appendHistogram(out, loop_);
+  out.literal(",\"cmd\":");
+  appendHistogram(out, command_);
+  out.literal(",\"pub\":[")
+      .uinteger(publishOk_.value() + in.publishOk)
+      .literal(",")
+      .uinteger(publishFailed_.value() + in.publishFailed)
+      .literal("],\"rc\":")
+      .uinteger(in.reconnects)
+      .literal(",\"drop\":")
+      .uinteger(in.queueDrops)
+      .literal(",\"heap\":[")
+      .uinteger(ESP.getFreeHeap())
+      .literal(",")
+      .uinteger(ESP.getMinFreeHeap())
+      .literal(",")
+      .uinteger(ESP.getMaxAllocHeap())
+      .literal("],\"stk\":[");
+  for (uint8_t i = 0; i < taskCount_; i++) {
+    if (i) out.literal(",");
+    out.uinteger(uxTaskGetStackHighWaterMark(tasks_[i]));
+  }
+  return out.literal("]}").c_str();
+}
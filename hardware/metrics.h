@@ -0,0 +1,119 @@
+// Fixed counters and histograms for field diagnostics, published periodically
+// on yolouno/<house>/diagnostics.
+//
+// Updates are made on the hot path (every loop() pass, every command, every
+// publish), so each is a load, an add and a store: no lock, no read-modify-write
+// atomic, no allocation. Every counter has a single writer - loop time and
+// command latency on the actuator side, publishes on the network side - and
+// is read by the report on the network side. A report may miss an update made
+// while it is being built; it never sees a torn value.
+//
+// Histograms count microseconds into METRIC_BUCKETS log2 buckets: bucket 0 is
+// under 2^METRIC_BUCKET_SHIFT us, bucket i under 2^(METRIC_BUCKET_SHIFT + i),
+// and the last one takes everything above. Counts run from boot and wrap at
+// 2^32, so the consumer diffs consecutive reports; the max is per report.
+//
+// One report is one line of JSON:
+//
+//   {"up":<ms>,"loop":[max,b0..b11],"cmd":[max,b0..b11],"pub":[ok,failed],
+//    "rc":<reconnects>,"drop":<queue drops>,"heap":[free,min free,largest block],
+//    "stk":[<stack high-water mark of each watched task, bytes>]}
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "telemetry_format.h"
+
+#define METRIC_BUCKETS 12
+#define METRIC_BUCKET_SHIFT 5    // bucket 0: under 32 us; bucket 11: 32.768 ms and up
+#define METRIC_TASKS 2           // loop task and the network task
+
+// Counter with a single writer. add() compiles to plain loads and stores.
+class MetricCounter {
+ public:
+  void add(uint32_t n = 1) {
+    value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+  uint32_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint32_t> value_{0};
+};
+
+class MetricHistogram {
+ public:
+  void record(uint32_t us) {
+    buckets_[bucketOf(us)].add();
+    if (us > max_.load(std::memory_order_relaxed)) max_.store(us, std::memory_order_relaxed);
+  }
+
+  static uint8_t bucketOf(uint32_t us) {
+    uint32_t scaled = us >> METRIC_BUCKET_SHIFT;
+    uint8_t bucket = scaled ? (uint8_t)(32 - __builtin_clz(scaled)) : 0;
+    return bucket < METRIC_BUCKETS ? bucket : METRIC_BUCKETS - 1;
+  }
+
+  uint32_t bucket(uint8_t index) const { return buckets_[index].value(); }
+  uint32_t count() const;
+  uint32_t max() const { return max_.load(std::memory_order_relaxed); }
+  // Largest value since the last call; starts the next report's window.
+  uint32_t takeMax() { return max_.exchange(0, std::memory_order_relaxed); }
+
+ private:
+  MetricCounter buckets_[METRIC_BUCKETS];
+  std::atomic<uint32_t> max_{0};
+};
+
+// Values owned by other modules, read when a report is built.
+struct MetricsInputs {
+  uint32_t uptimeMs;
+  uint32_t reconnects;     // ConnectionManager::reconnects()
+  uint32_t queueDrops;     // both inter-core queues
+  uint32_t publishOk;      // publishes counted elsewhere (state sync), added to ours
+  uint32_t publishFailed;
+};
+
+constexpr size_t METRIC_HISTOGRAM_TEXT_MAX = (1 + METRIC_BUCKETS) * UINT_TEXT_MAX + METRIC_BUCKETS;
+constexpr size_t METRICS_REPORT_MAX =
+    sizeof("{\"up\":,\"loop\":[],\"cmd\":[],\"pub\":[,],\"rc\":,\"drop\":,\"heap\":[,,],\"stk\":[]}") - 1 +
+    2 * METRIC_HISTOGRAM_TEXT_MAX + 8 * UINT_TEXT_MAX + METRIC_TASKS * (UINT_TEXT_MAX + 1);
+
+typedef TextBuffer<METRICS_REPORT_MAX + 1> MetricsText;
+
+class Metrics {
+ public:
+  void recordLoop(uint32_t us) { loop_.record(us); }
+  // From the command reaching callback() to its actuator being set.
+  void recordCommand(uint32_t us) { command_.record(us); }
+  // Returns ok, so it wraps a publish call.
+  bool countPublish(bool ok) {
+    (ok ? publishOk_ : publishFailed_).add();
+    return ok;
+  }
+
+  // Adds a task to the stack report, in call order. False once METRIC_TASKS
+  // are watched.
+  bool watchStack(TaskHandle_t task);
+
+  // Samples heap and stacks and formats the report; ends the max window.
+  const char* report(MetricsText& out, const MetricsInputs& in);
+
+  const MetricHistogram& loopTime() const { return loop_; }
+  const MetricHistogram& commandLatency() const { return command_; }
+  uint32_t publishOk() const { return publishOk_.value(); }
+  uint32_t publishFailed() const { return publishFailed_.value(); }
+
+ private:
+  MetricHistogram loop_;
+  MetricHistogram command_;
+  MetricCounter publishOk_;
+  MetricCounter publishFailed_;
+  TaskHandle_t tasks_[METRIC_TASKS] = {};
+  uint8_t taskCount_ = 0;
+};
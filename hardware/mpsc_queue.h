@@ -0,0 +1,85 @@
+// Bounded multi-producer single-consumer ring queue.
+//
+// Any number of producers - tasks and interrupt handlers alike - push; one
+// task pops. Nothing blocks or takes a lock, so push() is safe in an ISR. Each
+// slot carries a sequence number (Vyukov's bounded queue): a producer claims
+// a slot by advancing tail_ with compare-and-swap, writes it, then publishes
+// it by storing the slot's sequence with release ordering. The consumer reads
+// the sequence with acquire, so a record is fully written before it is seen.
+//
+// A producer interrupted between claiming and publishing its slot (a task
+// preempted by an ISR that also pushes) holds back the consumer at that slot
+// until it resumes: later records wait, none is lost or reordered.
+//
+// push() is forced inline so a push from an IRAM_ATTR handler runs from IRAM
+// too: an out-of-line copy would sit in flash and fault when an interrupt
+// lands while the cache is off (a LittleFS write). Call it from ISRs only
+// through an IRAM_ATTR function.
+//
+// N must be a power of two. Indexes run freely and wrap at 2^32, as in
+// SpscQueue.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+template <typename T, size_t N>
+class MpscQueue {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "MpscQueue size must be a power of two");
+
+ public:
+  MpscQueue() {
+    for (uint32_t i = 0; i < N; i++) slots_[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  // Any producer. Returns false (and leaves the queue alone) when full.
+  __attribute__((always_inline)) bool push(const T& item) {
+    uint32_t pos = tail_.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+      slot = &slots_[pos & (N - 1)];
+      int32_t lag = (int32_t)(slot->seq.load(std::memory_order_acquire) - pos);
+      if (lag == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (lag < 0) {
+        return false;   // the slot still holds a record N behind: full
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->item = item;
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // The consumer. Returns false when empty, or when the next record is
+  // claimed but not yet published.
+  bool pop(T& out) {
+    uint32_t pos = head_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[pos & (N - 1)];
+    if (slot.seq.load(std::memory_order_acquire) != pos + 1) return false;
+    out = slot.item;
+    slot.seq.store(pos + N, std::memory_order_release);
+    head_.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // A snapshot; counts claimed records that are not yet published.
+  size_t size() const {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+  }
+  bool empty() const { return size() == 0; }
+  static constexpr size_t capacity() { return N; }
+
+ private:
+  struct Slot {
+    std::atomic<uint32_t> seq;
+    T item;
+  };
+
+  Slot slots_[N];
+  alignas(32) std::atomic<uint32_t> head_{0};
+  alignas(32) std::atomic<uint32_t> tail_{0};
+};
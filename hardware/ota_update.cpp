@@ -0,0 +1,100 @@
+#include "ota_update.h"
+
+#include <string.h>
+
+void OtaUpdater::begin(uint32_t nowMs) {
+  running_ = esp_ota_get_running_partition();
+  esp_ota_img_states_t state;
+  onTrial_ = esp_ota_get_state_partition(running_, &state) == ESP_OK &&
+             state == ESP_OTA_IMG_PENDING_VERIFY;
+  trialStartMs_ = nowMs;
+  rolledBack_ = esp_ota_get_last_invalid_partition() != nullptr;
+}
+
+bool OtaUpdater::readBase(void* ctx, uint32_t offset, uint8_t* out, size_t length) {
+  OtaUpdater* self = (OtaUpdater*)ctx;
+  return esp_partition_read(self->running_, offset, out, length) == ESP_OK;
+}
+
+bool OtaUpdater::writeTarget(void* ctx, const uint8_t* data, size_t length) {
+  OtaUpdater* self = (OtaUpdater*)ctx;
+  return esp_ota_write(self->handle_, data, length) == ESP_OK;
+}
+
+bool OtaUpdater::start() {
+  if (handle_) esp_ota_abort(handle_);
+  handle_ = 0;
+  if (!running_) running_ = esp_ota_get_running_partition();
+  next_ = esp_ota_get_next_update_partition(nullptr);
+  if (!next_ || esp_ota_begin(next_, OTA_WITH_SEQUENTIAL_WRITES, &handle_) != ESP_OK) {
+    handle_ = 0;
+    return false;
+  }
+  patcher_.begin(readBase, writeTarget, this);
+  return true;
+}
+
+OtaEvent OtaUpdater::fail(const char* error) {
+  if (handle_) esp_ota_abort(handle_);
+  handle_ = 0;
+  chunkLength_ = chunkUsed_ = 0;
+  offset_ = 0;
+  error_ = error;
+  return OTA_FAILED;
+}
+
+OtaEvent OtaUpdater::receive(const uint8_t* payload, size_t length) {
+  if (length < OTA_CHUNK_HEADER || chunkLength_ > 0) return OTA_NONE;
+  uint32_t offset = (uint32_t)payload[0] | (uint32_t)payload[1] << 8 |
+                    (uint32_t)payload[2] << 16 | (uint32_t)payload[3] << 24;
+  if (offset == 0) {
+    if (!start()) return fail("flash");
+  } else if (!updating()) {
+    return OTA_NONE;      // left over from an update that ended
+  } else if (offset != offset_) {
+    return OTA_NEXT;      // repeat, or one was lost: ask again
+  }
+  size_t taken = length - OTA_CHUNK_HEADER;
+  if (taken > OTA_CHUNK_MAX) taken = OTA_CHUNK_MAX;   // the sender continues at nextOffset()
+  memcpy(chunk_, payload + OTA_CHUNK_HEADER, taken);
+  chunkLength_ = (uint16_t)taken;
+  chunkUsed_ = 0;
+  offset_ = offset + (uint32_t)taken;
+  return taken ? OTA_NONE : OTA_NEXT;
+}
+
+OtaEvent OtaUpdater::step() {
+  if (!pending()) return OTA_NONE;
+  size_t used;
+  DeltaResult result = patcher_.feed(chunk_ + chunkUsed_, chunkLength_ - chunkUsed_, &used,
+                                     OTA_STEP_BYTES);
+  chunkUsed_ += (uint16_t)used;
+  if (result == DELTA_MORE) {
+    if (chunkLength_ == 0 || chunkUsed_ < chunkLength_) return OTA_NONE;
+    // Chunk taken in: ask for the next one while the patcher goes on
+    chunkLength_ = chunkUsed_ = 0;
+    return OTA_NEXT;
+  }
+  if (result != DELTA_DONE) return fail(deltaResultName(result));
+
+  chunkLength_ = chunkUsed_ = 0;
+  esp_err_t err = esp_ota_end(handle_);
+  handle_ = 0;
+  if (err != ESP_OK) return fail("image");
+  if (esp_ota_set_boot_partition(next_) != ESP_OK) return fail("boot");
+  return OTA_APPLIED;
+}
+
+OtaEvent OtaUpdater::checkTrial(bool healthy, uint32_t nowMs) {
+  if (!onTrial_) return OTA_NONE;
+  if (healthy) {
+    onTrial_ = false;
+    esp_ota_mark_app_valid_cancel_rollback();
+    return OTA_CONFIRMED;
+  }
+  if (nowMs - trialStartMs_ < OTA_TRIAL_MS) return OTA_NONE;
+  onTrial_ = false;
+  // Does not return on the device: the previous image boots
+  esp_ota_mark_app_invalid_rollback_and_reboot();
+  return OTA_ROLLBACK;
+}
@@ -0,0 +1,92 @@
+// Firmware updates sent as a binary delta (firmware_delta.h) against the
+// running image, written into the other app slot and kept only once the new
+// image has proven itself.
+//
+// Transfer, stop and wait over MQTT (yolouno/<house>/ota): each message is a
+// u32 (LE) patch offset followed by patch bytes, at most OTA_CHUNK_MAX of
+// them per message. Offset 0 starts an update, dropping any other in
+// progress. Once a chunk is taken in the device asks for the next one
+// ("ota:next:<offset>"), so the sender has one chunk in flight and the device
+// holds one; a copy the last chunk started may still be running, and goes on
+// while the next one travels. After the last chunk the sender waits for
+// "ota:applied" or "ota:failed:<reason>". A chunk at any other offset is a
+// repeat or arrived after a lost one: the device asks again for the offset
+// it needs. Messages that arrive while a chunk is still staged are dropped;
+// the answer follows.
+//
+// A chunk is applied over several scheduler passes, OTA_STEP_BYTES of image
+// each, so flash erases and writes never hold up the loop for long. The slot
+// is written with sequential writes (each 4 KB sector erased as it is
+// reached), never erased up front.
+//
+// Once the image hash matches, esp_ota_end checks the image and the slot
+// becomes the boot slot; the caller restarts. The bootloader starts the new
+// image as PENDING_VERIFY (rollback enabled, see verifyRollbackLater() in
+// main.cpp). checkTrial() then marks it valid once it reaches a healthy MQTT
+// session, or invalid after OTA_TRIAL_MS without one, which reboots into the
+// previous image; so does a crash before that, through the bootloader.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_ota_ops.h>
+
+#include "firmware_delta.h"
+
+#define OTA_CHUNK_HEADER 4          // u32 patch offset
+#define OTA_CHUNK_MAX 960           // patch bytes per message (MQTT_MAX_PACKET_SIZE 1024)
+#define OTA_STEP_BYTES 4096         // image bytes read / written per step()
+#define OTA_TRIAL_MS 120000UL       // new image: time to reach a healthy MQTT session
+
+enum OtaEvent : uint8_t {
+  OTA_NONE,
+  OTA_NEXT,        // ask the sender for nextOffset()
+  OTA_APPLIED,     // new image verified, boots next: restart
+  OTA_FAILED,      // update dropped, error() says why; the running image stays
+  OTA_CONFIRMED,   // this image passed its trial and stays
+  OTA_ROLLBACK,    // trial failed: rebooting into the previous image
+};
+
+class OtaUpdater {
+ public:
+  // At boot: whether this image is on trial, and whether the last one failed.
+  void begin(uint32_t nowMs);
+
+  // One message from the OTA topic. The chunk is copied; step() applies it.
+  OtaEvent receive(const uint8_t* payload, size_t length);
+  // Applies up to OTA_STEP_BYTES of the staged chunk.
+  OtaEvent step();
+  // healthy: connected to MQTT with the state sync done. Call regularly
+  // while onTrial().
+  OtaEvent checkTrial(bool healthy, uint32_t nowMs);
+
+  // step() has work: a staged chunk, or patching that needs no more input.
+  bool pending() const { return chunkLength_ > 0 || (handle_ != 0 && patcher_.busy()); }
+  bool updating() const { return handle_ != 0; }
+  bool onTrial() const { return onTrial_; }
+  // The previous image was rolled back (by checkTrial() or the bootloader).
+  bool rolledBack() const { return rolledBack_; }
+  uint32_t nextOffset() const { return offset_; }
+  const char* error() const { return error_; }
+  const DeltaPatcher& patcher() const { return patcher_; }
+
+ private:
+  static bool readBase(void* ctx, uint32_t offset, uint8_t* out, size_t length);
+  static bool writeTarget(void* ctx, const uint8_t* data, size_t length);
+  bool start();
+  OtaEvent fail(const char* error);
+
+  DeltaPatcher patcher_;
+  const esp_partition_t* running_ = nullptr;
+  const esp_partition_t* next_ = nullptr;
+  esp_ota_handle_t handle_ = 0;
+  const char* error_ = "";
+  bool onTrial_ = false;
+  bool rolledBack_ = false;
+  uint32_t trialStartMs_ = 0;
+  uint32_t offset_ = 0;        // patch offset following the staged chunk
+  uint16_t chunkLength_ = 0;
+  uint16_t chunkUsed_ = 0;
+  uint8_t chunk_[OTA_CHUNK_MAX];
+};
@@ -0,0 +1,71 @@
+#include "power_manager.h"
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <driver/gpio.h>
+#include <esp_sleep.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+void PowerManager::begin(PowerMode mode, uint32_t maxLatencyMs, int wakePin, int wakeLevel) {
+  mode_ = mode;
+  maxLatencyMs_ = maxLatencyMs;
+  wakePin_ = wakePin;
+  wakeLevel_ = wakeLevel;
+  stats_ = PowerStats();
+  if (mode == POWER_ALWAYS_ON) return;
+  WiFi.setSleep(true);   // modem sleep; the Arduino default, made explicit
+  if (mode != POWER_LIGHT_SLEEP) return;
+  esp_sleep_enable_wifi_wakeup();
+  if (wakePin != POWER_NO_WAKE_PIN) {
+    armGpioWake();
+    esp_sleep_enable_gpio_wakeup();
+  }
+}
+
+void PowerManager::armGpioWake() {
+  gpio_wakeup_enable((gpio_num_t)wakePin_, wakeLevel_ ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+}
+
+PowerSleep PowerManager::plan(PowerMode mode, uint32_t idleMs, uint32_t maxLatencyMs,
+                              uint32_t* sleepMs) {
+  uint32_t ms = idleMs < maxLatencyMs ? idleMs : maxLatencyMs;
+  *sleepMs = ms;
+  if (mode == POWER_ALWAYS_ON || ms == 0) return SLEEP_NONE;
+  if (mode == POWER_LIGHT_SLEEP && ms >= POWER_LIGHT_SLEEP_MIN_MS) return SLEEP_LIGHT;
+  return SLEEP_IDLE;
+}
+
+void PowerManager::idle(uint32_t ms) {
+  // A notification from an interrupt (see input_events.h) ends the wait early
+  if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms)) != 0) stats_.eventWakes++;
+  stats_.idles++;
+}
+
+PowerSleep PowerManager::sleep(uint32_t idleMs) {
+  uint32_t ms;
+  PowerSleep kind = plan(mode_, idleMs, maxLatencyMs_, &ms);
+  if (kind == SLEEP_IDLE) {
+    idle(ms);
+  } else if (kind == SLEEP_LIGHT) {
+    esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000ULL);
+    if (esp_light_sleep_start() != ESP_OK) {
+      // Refused (e.g. a wake source is mis-set): wait in modem sleep instead
+      idle(ms);
+      return SLEEP_IDLE;
+    }
+    stats_.lightSleeps++;
+    switch (esp_sleep_get_wakeup_cause()) {
+      case ESP_SLEEP_WAKEUP_WIFI: stats_.wifiWakes++; break;
+      case ESP_SLEEP_WAKEUP_GPIO:
+        // The wakeup is level-triggered: wait for the other level next, or
+        // the pin held at this one would wake every sleep at once.
+        stats_.gpioWakes++;
+        wakeLevel_ = !wakeLevel_;
+        armGpioWake();
+        break;
+      default: stats_.timerWakes++; break;
+    }
+  }
+  return kind;
+}
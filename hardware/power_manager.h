@@ -0,0 +1,80 @@
+// Sleep between scheduled work instead of spinning in loop().
+//
+// After each scheduler pass loop() hands sleep() the time to the next timed
+// task (TaskScheduler::idleMs(false)). The wait is capped at the latency bound,
+// so polled work - the connection state machine, a command that slipped past
+// the wake sources - is never put off longer than that. Then:
+//
+//   POWER_ALWAYS_ON    no sleep: loop() spins as before.
+//   POWER_MODEM_SLEEP  the loop task blocks on its task notification for the
+//                      wait. The CPU idles and WiFi stays in modem sleep
+//                      (radio off between DTIM beacons). An input interrupt
+//                      that notifies the task ends the wait at once.
+//   POWER_LIGHT_SLEEP  light sleep for waits of POWER_LIGHT_SLEEP_MIN_MS or
+//                      more, modem sleep for shorter ones. Light sleep pauses
+//                      the CPU and clocks and keeps the WiFi association. It
+//                      wakes on the timer, on incoming WiFi traffic (the MQTT
+//                      socket) or on the wake GPIO. Input interrupts do not
+//                      run in light sleep: their pins are read again after
+//                      each wake (InputCapture::resync()).
+//
+// Light sleep pauses both cores, so it is only used in one-core mode. In
+// dual-core mode it falls back to modem sleep. Servo PWM (LEDC on the APB
+// clock) also stops in light sleep: a door holds its position by friction
+// alone. Pick modem sleep if the servos need holding torque.
+#pragma once
+
+#include <stdint.h>
+
+#define POWER_LIGHT_SLEEP_MIN_MS 5      // shorter waits do not pay back the wake-up (~0.5 ms)
+#define POWER_NO_WAKE_PIN -1
+
+enum PowerMode : uint8_t {
+  POWER_ALWAYS_ON,
+  POWER_MODEM_SLEEP,
+  POWER_LIGHT_SLEEP,
+};
+
+enum PowerSleep : uint8_t {
+  SLEEP_NONE,    // work is due now
+  SLEEP_IDLE,    // ulTaskNotifyTake(), modem sleep
+  SLEEP_LIGHT,   // light sleep
+};
+
+struct PowerStats {
+  uint32_t idles;
+  uint32_t eventWakes;    // idle waits ended by a task notification
+  uint32_t lightSleeps;
+  uint32_t timerWakes;    // light sleeps ended by the timer...
+  uint32_t wifiWakes;     // ...by incoming WiFi traffic
+  uint32_t gpioWakes;     // ...by a change on the wake GPIO
+};
+
+class PowerManager {
+ public:
+  // wakePin: a GPIO that wakes light sleep at wakeLevel (POWER_NO_WAKE_PIN:
+  // none), then at the other level: every change of the input wakes once.
+  void begin(PowerMode mode, uint32_t maxLatencyMs, int wakePin = POWER_NO_WAKE_PIN,
+             int wakeLevel = 0);
+
+  // How long to wait and how, for idleMs until the next timed task.
+  static PowerSleep plan(PowerMode mode, uint32_t idleMs, uint32_t maxLatencyMs,
+                         uint32_t* sleepMs);
+
+  // Waits per plan(); returns the kind of wait taken.
+  PowerSleep sleep(uint32_t idleMs);
+
+  PowerMode mode() const { return mode_; }
+  uint32_t maxLatencyMs() const { return maxLatencyMs_; }
+  const PowerStats& stats() const { return stats_; }
+
+ private:
+  void armGpioWake();
+  void idle(uint32_t ms);
+
+  PowerMode mode_ = POWER_ALWAYS_ON;
+  uint32_t maxLatencyMs_ = 0;
+  int wakePin_ = POWER_NO_WAKE_PIN;
+  int wakeLevel_ = 0;
+  PowerStats stats_ = {};
+};
@@ -0,0 +1,30 @@
+#include "report_policy.h"
+
+ReportReason ChannelReporter::sample(const ReportPolicy& policy, int32_t value, uint32_t nowMs) {
+  ReportReason reason = REPORT_NONE;
+
+  if (policy.alarmLevel != REPORT_NO_ALARM) {
+    bool above = above_ ? value > policy.alarmLevel - policy.deadband
+                        : value >= policy.alarmLevel;
+    if (above != above_ && reported_) reason = REPORT_ALARM;
+    above_ = above;
+  }
+
+  if (!reported_) {
+    reason = REPORT_FIRST;
+  } else if (reason == REPORT_NONE) {
+    int64_t delta = (int64_t)value - last_;
+    if (delta > policy.deadband || -delta > policy.deadband) {
+      reason = REPORT_DEADBAND;
+    } else if (nowMs - lastAtMs_ >= policy.maxSilenceMs) {
+      reason = REPORT_SILENCE;
+    }
+  }
+
+  if (reason != REPORT_NONE) {
+    last_ = value;
+    lastAtMs_ = nowMs;
+    reported_ = true;
+  }
+  return reason;
+}
@@ -0,0 +1,47 @@
+// Change-driven reporting for one sensor channel.
+//
+// Every sample (fixed-point, in channel units) goes through sample(), which
+// says whether it has to be published now: the first sample, a move of more
+// than the deadband since the last reported value, an alarm level crossed, or
+// maxSilenceMs without a report. Anything else is not sent.
+//
+// The alarm level has a deadband-wide hysteresis, so a value sitting on the
+// threshold does not report on every noisy sample.
+#pragma once
+
+#include <stdint.h>
+
+#define REPORT_NO_ALARM INT32_MAX
+
+struct ReportPolicy {
+  int32_t deadband;        // report when |value - last reported| > deadband
+  uint32_t maxSilenceMs;   // report at least this often
+  int32_t alarmLevel;      // report at once when crossed; REPORT_NO_ALARM for none
+};
+
+enum ReportReason : uint8_t {
+  REPORT_NONE,
+  REPORT_FIRST,
+  REPORT_DEADBAND,
+  REPORT_SILENCE,
+  REPORT_ALARM,
+};
+
+class ChannelReporter {
+ public:
+  // A reason other than REPORT_NONE means value now counts as reported.
+  ReportReason sample(const ReportPolicy& policy, int32_t value, uint32_t nowMs);
+
+  // Forget the last report: the next sample is reported as REPORT_FIRST.
+  void reset() { reported_ = false; }
+
+  bool reported() const { return reported_; }
+  int32_t lastValue() const { return last_; }
+  bool aboveAlarm() const { return above_; }
+
+ private:
+  int32_t last_ = 0;
+  uint32_t lastAtMs_ = 0;
+  bool reported_ = false;
+  bool above_ = false;
+};
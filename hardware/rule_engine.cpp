@@ -0,0 +1,193 @@
+#include "rule_engine.h"
+
+#include <string.h>
+
+namespace {
+
+void putU16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+void putU32(uint8_t* p, uint32_t v) {
+  putU16(p, (uint16_t)v);
+  putU16(p + 2, (uint16_t)(v >> 16));
+}
+
+uint16_t getU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+uint32_t getU32(const uint8_t* p) { return getU16(p) | ((uint32_t)getU16(p + 2) << 16); }
+
+bool entered(const Rule& r, int32_t value) {
+  return r.op == RULE_ABOVE ? value > r.threshold : value < r.threshold;
+}
+
+// In 64 bits: the threshold is any i32 from the blob, and the band around it
+// may reach past the int32 limits.
+bool cleared(const Rule& r, int32_t value) {
+  return r.op == RULE_ABOVE ? value <= (int64_t)r.threshold - r.hysteresis
+                            : value >= (int64_t)r.threshold + r.hysteresis;
+}
+
+}  // namespace
+
+ConfigResult validateRuleSet(const RuleSet& set, const DeviceRegistry* devices) {
+  if (set.count > RULE_MAX) return CONFIG_BAD_FIELD;
+  for (uint8_t i = 0; i < set.count; i++) {
+    const Rule& r = set.rules[i];
+    if (r.channel >= RULE_CHANNELS || (r.op != RULE_ABOVE && r.op != RULE_BELOW) ||
+        (r.flags & ~RULE_REASSERT) || r.holdMs > RULE_HOLD_MAX_MS) {
+      return CONFIG_BAD_FIELD;
+    }
+    switch (r.kind) {
+      case STATUS_DOOR:
+      case STATUS_ALARM:
+      case STATUS_FAN:
+        if (r.target > 1) return CONFIG_BAD_FIELD;
+        break;
+      case STATUS_RGB:
+        if (r.target > 0xFFFFFF) return CONFIG_BAD_FIELD;
+        break;
+      default:
+        return CONFIG_BAD_FIELD;
+    }
+    if (devices && devices->find(r.kind, r.deviceId) < 0) return CONFIG_BAD_FIELD;
+  }
+  return CONFIG_OK;
+}
+
+size_t encodeRuleSet(const RuleSet& set, uint8_t* out, size_t size) {
+  if (validateRuleSet(set) != CONFIG_OK) return 0;
+  size_t length = RULES_HEADER_SIZE + set.count * RULE_RECORD_SIZE + 4;
+  if (length > size) return 0;
+  putU32(out, RULES_MAGIC);
+  out[4] = RULES_VERSION;
+  out[5] = set.count;
+  putU16(out + 6, (uint16_t)length);
+  uint8_t* p = out + RULES_HEADER_SIZE;
+  for (uint8_t i = 0; i < set.count; i++, p += RULE_RECORD_SIZE) {
+    const Rule& r = set.rules[i];
+    p[0] = r.channel;
+    p[1] = r.op;
+    p[2] = r.flags;
+    p[3] = r.kind;
+    p[4] = r.deviceId;
+    p[5] = 0;
+    putU16(p + 6, r.hysteresis);
+    putU32(p + 8, (uint32_t)r.threshold);
+    putU32(p + 12, r.holdMs);
+    putU32(p + 16, r.target);
+  }
+  putU32(p, crc32(out, length - 4));
+  return length;
+}
+
+ConfigResult decodeRuleSet(const uint8_t* data, size_t length, const DeviceRegistry& devices,
+                           RuleSet& out) {
+  if (length < RULES_HEADER_SIZE + 4) return CONFIG_TRUNCATED;
+  if (getU32(data) != RULES_MAGIC) return CONFIG_BAD_MAGIC;
+  if (data[4] != RULES_VERSION) return CONFIG_BAD_VERSION;
+  size_t total = getU16(data + 6);
+  if (total < RULES_HEADER_SIZE + 4 || total > length) return CONFIG_TRUNCATED;
+  if (total < length) return CONFIG_BAD_FIELD;   // trailing bytes
+  if (getU32(data + total - 4) != crc32(data, total - 4)) return CONFIG_BAD_CRC;
+  uint8_t count = data[5];
+  if (count > RULE_MAX || total != RULES_HEADER_SIZE + count * RULE_RECORD_SIZE + 4u) {
+    return CONFIG_BAD_FIELD;
+  }
+
+  // Decoded into a scratch copy so a bad field leaves out untouched.
+  RuleSet set = {};
+  set.count = count;
+  const uint8_t* p = data + RULES_HEADER_SIZE;
+  for (uint8_t i = 0; i < count; i++, p += RULE_RECORD_SIZE) {
+    Rule& r = set.rules[i];
+    r.channel = p[0];
+    r.op = (RuleOp)p[1];
+    r.flags = p[2];
+    r.kind = (StatusTopic)p[3];
+    r.deviceId = p[4];
+    r.hysteresis = getU16(p + 6);
+    r.threshold = (int32_t)getU32(p + 8);
+    r.holdMs = getU32(p + 12);
+    r.target = getU32(p + 16);
+  }
+  ConfigResult result = validateRuleSet(set, &devices);
+  if (result == CONFIG_OK) out = set;
+  return result;
+}
+
+ConfigResult loadRuleSet(fs::FS& fs, const DeviceRegistry& devices, RuleSet& out) {
+  if (!fs.exists(RULES_PATH)) return CONFIG_MISSING;
+  File file = fs.open(RULES_PATH, FILE_READ);
+  if (!file) return CONFIG_IO_ERROR;
+  uint8_t blob[RULES_BLOB_MAX];
+  size_t length = file.read(blob, sizeof(blob));
+  file.close();
+  return decodeRuleSet(blob, length, devices, out);
+}
+
+ConfigResult storeRuleSet(fs::FS& fs, const uint8_t* blob, size_t length,
+                          const DeviceRegistry& devices, RuleSet& decoded) {
+  ConfigResult result = decodeRuleSet(blob, length, devices, decoded);
+  if (result != CONFIG_OK) return result;
+  File file = fs.open(RULES_TMP_PATH, FILE_WRITE);
+  if (!file) return CONFIG_IO_ERROR;
+  bool written = file.write(blob, length) == length;
+  file.close();
+  if (!written || !fs.rename(RULES_TMP_PATH, RULES_PATH)) {
+    fs.remove(RULES_TMP_PATH);
+    return CONFIG_IO_ERROR;
+  }
+  return CONFIG_OK;
+}
+
+size_t RuleEngine::load(const RuleSet& set) {
+  count_ = 0;
+  for (uint8_t i = 0; i < set.count && i < RULE_MAX; i++) {
+    int slot = devices_.find(set.rules[i].kind, set.rules[i].deviceId);
+    if (slot < 0) continue;
+    rules_[count_] = set.rules[i];
+    slot_[count_] = (int8_t)slot;
+    active_[count_] = false;
+    pending_[count_] = false;
+    count_++;
+  }
+  return count_;
+}
+
+size_t RuleEngine::evaluate(const int32_t values[RULE_CHANNELS], uint8_t validMask,
+                            uint32_t nowMs, RuleAction action) {
+  size_t actions = 0;
+  for (uint8_t i = 0; i < count_; i++) {
+    const Rule& r = rules_[i];
+    if (!(validMask & (1u << r.channel))) continue;
+    int32_t value = values[r.channel];
+
+    if (active_[i]) {
+      if (cleared(r, value)) {
+        active_[i] = false;
+        continue;
+      }
+      if (!(r.flags & RULE_REASSERT)) continue;
+    } else {
+      if (!entered(r, value)) {
+        pending_[i] = false;
+        continue;
+      }
+      if (!pending_[i]) {
+        pending_[i] = true;
+        sinceMs_[i] = nowMs;
+      }
+      if (nowMs - sinceMs_[i] < r.holdMs) continue;
+      pending_[i] = false;
+      active_[i] = true;
+      fired_++;
+    }
+    if (devices_.state(slot_[i]) != r.target) {
+      action(slot_[i], r.target);
+      actions++;
+    }
+  }
+  return actions;
+}
@@ -0,0 +1,119 @@
+// Local automations: sensor conditions that drive devices without a broker
+// round trip, so they keep working while MQTT is down.
+//
+// A rule watches one sensor channel (in the firmware's SensorChannel order and
+// units: centi-°C, centi-%RH, raw ADC light) and, when its condition starts to
+// hold, sets one device in the DeviceRegistry to a target state:
+//
+//   ABOVE: enters when value > threshold, clears when value <= threshold - hysteresis
+//   BELOW: enters when value < threshold, clears when value >= threshold + hysteresis
+//
+// The condition has to hold for holdMs before the rule fires. A rule acts
+// once per entry, so a device set by hand afterwards keeps its state, unless
+// RULE_REASSERT is set: then the target is re-applied on every evaluation while
+// the rule is active. Nothing is done if the device already has the target.
+// Turning a device back off is a second rule, e.g. "fan 11 ON above 30.00"
+// with "fan 11 OFF below 28.00".
+//
+// Rules live in a fixed table of RULE_MAX entries; evaluate() is one pass over
+// it with no allocation, bounded by the table size. Rule sets are pushed as a
+// binary blob on yolouno/<house>/rules and stored on flash like the device
+// config (see device_config.h), little-endian, version 1:
+//   u32 magic "SHR1" | u8 version | u8 rule count | u16 total length
+//   per rule: u8 channel, u8 op, u8 flags, u8 device kind, u8 device id,
+//             u8 reserved, u16 hysteresis, i32 threshold, u32 hold ms, u32 target
+//   u32 CRC-32 (IEEE) of everything before it
+#pragma once
+
+#include <FS.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "device_config.h"
+#include "device_registry.h"
+
+#define RULES_MAGIC 0x31524853u         // "SHR1"
+#define RULES_VERSION 1
+#define RULES_PATH "/rules.bin"
+#define RULES_TMP_PATH "/rules.new"
+
+#define RULE_MAX 16
+#define RULE_CHANNELS 5                 // temp, humi, light x3
+#define RULE_HOLD_MAX_MS 86400000UL     // one day
+
+#define RULES_HEADER_SIZE 8
+#define RULE_RECORD_SIZE 20
+#define RULES_BLOB_MAX (RULES_HEADER_SIZE + RULE_MAX * RULE_RECORD_SIZE + 4)
+
+enum RuleOp : uint8_t {
+  RULE_ABOVE,
+  RULE_BELOW,
+};
+
+#define RULE_REASSERT 0x01
+
+struct Rule {
+  uint8_t channel;
+  RuleOp op;
+  uint8_t flags;
+  StatusTopic kind;     // device the rule sets
+  uint8_t deviceId;
+  uint16_t hysteresis;
+  int32_t threshold;
+  uint32_t holdMs;
+  uint32_t target;      // device state, as in DeviceRegistry
+};
+
+struct RuleSet {
+  uint8_t count;
+  Rule rules[RULE_MAX];
+};
+
+// Called for a rule that fires: set the device in slot to target.
+typedef void (*RuleAction)(int slot, uint32_t target);
+
+// Field checks; with devices, every rule must also name a device in the table.
+ConfigResult validateRuleSet(const RuleSet& set, const DeviceRegistry* devices = nullptr);
+
+// Returns the blob length, or 0 if set is invalid or size is too small.
+size_t encodeRuleSet(const RuleSet& set, uint8_t* out, size_t size);
+
+// On anything but CONFIG_OK, out is left unchanged.
+ConfigResult decodeRuleSet(const uint8_t* data, size_t length, const DeviceRegistry& devices,
+                           RuleSet& out);
+
+// Reads and decodes RULES_PATH.
+ConfigResult loadRuleSet(fs::FS& fs, const DeviceRegistry& devices, RuleSet& out);
+
+// Decodes blob and, if it is valid, atomically replaces RULES_PATH with it.
+ConfigResult storeRuleSet(fs::FS& fs, const uint8_t* blob, size_t length,
+                          const DeviceRegistry& devices, RuleSet& decoded);
+
+class RuleEngine {
+ public:
+  explicit RuleEngine(const DeviceRegistry& devices) : devices_(devices) {}
+
+  // Replaces the rules and forgets all rule state. Rules naming a device that
+  // is not in the table are dropped; returns the number kept.
+  size_t load(const RuleSet& set);
+
+  // One pass over the rules. values[c] is channel c; rules on channels not in
+  // validMask (e.g. a failed climate read) keep their state. Returns the
+  // number of actions taken.
+  size_t evaluate(const int32_t values[RULE_CHANNELS], uint8_t validMask, uint32_t nowMs,
+                  RuleAction action);
+
+  size_t count() const { return count_; }
+  bool active(size_t index) const { return active_[index]; }
+  uint32_t fired() const { return fired_; }
+
+ private:
+  const DeviceRegistry& devices_;
+  uint8_t count_ = 0;
+  Rule rules_[RULE_MAX];
+  int8_t slot_[RULE_MAX];
+  bool active_[RULE_MAX] = {};
+  bool pending_[RULE_MAX] = {};     // condition holds, waiting out holdMs
+  uint32_t sinceMs_[RULE_MAX] = {};
+  uint32_t fired_ = 0;
+};
@@ -0,0 +1,101 @@
+#include "sample_buffer.h"
+
+bool SampleBuffer::beginSpill(fs::FS& fs) {
+  spill_ = fs.open(SAMPLE_SPILL_PATH, "w+");
+  if (!spill_) return false;
+  // Reserve the whole ring now so flash use is known and never grows later.
+  uint8_t zeros[SAMPLE_SPILL_CHUNK * SENSOR_FRAME_SIZE] = {0};
+  for (uint16_t slot = 0; slot < SAMPLE_SPILL_CAPACITY; slot += SAMPLE_SPILL_CHUNK) {
+    if (spill_.write(zeros, sizeof(zeros)) != sizeof(zeros)) {
+      spill_.close();
+      return false;
+    }
+  }
+  spill_.flush();
+  spillHead_ = spillCount_ = 0;
+  return true;
+}
+
+bool SampleBuffer::writeSlots(uint16_t slot, const uint8_t* data, uint16_t count) {
+  size_t bytes = (size_t)count * SENSOR_FRAME_SIZE;
+  return spill_.seek((uint32_t)slot * SENSOR_FRAME_SIZE) && spill_.write(data, bytes) == bytes;
+}
+
+bool SampleBuffer::spillOldest() {
+  if (!spill_) return false;
+
+  uint8_t chunk[SAMPLE_SPILL_CHUNK * SENSOR_FRAME_SIZE];
+  uint16_t count = ramCount_ < SAMPLE_SPILL_CHUNK ? ramCount_ : SAMPLE_SPILL_CHUNK;
+  for (uint16_t i = 0; i < count; i++) {
+    encodeSensorFrame(ram_[(ramHead_ + i) % SAMPLE_RAM_CAPACITY], chunk + i * SENSOR_FRAME_SIZE,
+                      SENSOR_FRAME_SIZE);
+  }
+
+  // Make room by dropping the oldest spilled samples.
+  if (spillCount_ + count > SAMPLE_SPILL_CAPACITY) {
+    uint16_t excess = spillCount_ + count - SAMPLE_SPILL_CAPACITY;
+    spillHead_ = (spillHead_ + excess) % SAMPLE_SPILL_CAPACITY;
+    spillCount_ -= excess;
+    dropped_ += excess;
+  }
+
+  uint16_t tail = (spillHead_ + spillCount_) % SAMPLE_SPILL_CAPACITY;
+  uint16_t first = SAMPLE_SPILL_CAPACITY - tail < count ? SAMPLE_SPILL_CAPACITY - tail : count;
+  if (!writeSlots(tail, chunk, first) ||
+      (first < count && !writeSlots(0, chunk + first * SENSOR_FRAME_SIZE, count - first))) {
+    return false;
+  }
+  spill_.flush();
+
+  spillCount_ += count;
+  ramHead_ = (ramHead_ + count) % SAMPLE_RAM_CAPACITY;
+  ramCount_ -= count;
+  return true;
+}
+
+void SampleBuffer::push(const SensorFrame& frame) {
+  if (ramCount_ == SAMPLE_RAM_CAPACITY && !spillOldest()) {
+    ramHead_ = (ramHead_ + 1) % SAMPLE_RAM_CAPACITY;
+    ramCount_--;
+    dropped_++;
+  }
+  ram_[(ramHead_ + ramCount_) % SAMPLE_RAM_CAPACITY] = frame;
+  ramCount_++;
+}
+
+size_t SampleBuffer::peek(SensorFrame* out, size_t max) {
+  size_t n = 0;
+  uint16_t i = 0;
+  while (n < max && i < spillCount_) {
+    uint8_t bytes[SENSOR_FRAME_SIZE];
+    uint16_t slot = (spillHead_ + i) % SAMPLE_SPILL_CAPACITY;
+    if (spill_.seek((uint32_t)slot * SENSOR_FRAME_SIZE) &&
+        spill_.read(bytes, sizeof(bytes)) == sizeof(bytes) &&
+        decodeSensorFrame(bytes, sizeof(bytes), out[n])) {
+      n++;
+      i++;
+    } else if (n == 0) {
+      // Unreadable slot at the head: drop it rather than stall the drain.
+      spillHead_ = (spillHead_ + 1) % SAMPLE_SPILL_CAPACITY;
+      spillCount_--;
+      dropped_++;
+    } else {
+      return n;
+    }
+  }
+  for (uint16_t r = 0; n < max && r < ramCount_; r++) {
+    out[n++] = ram_[(ramHead_ + r) % SAMPLE_RAM_CAPACITY];
+  }
+  return n;
+}
+
+void SampleBuffer::pop(size_t count) {
+  uint16_t fromSpill = count < spillCount_ ? (uint16_t)count : spillCount_;
+  spillHead_ = (spillHead_ + fromSpill) % SAMPLE_SPILL_CAPACITY;
+  spillCount_ -= fromSpill;
+  count -= fromSpill;
+
+  uint16_t fromRam = count < ramCount_ ? (uint16_t)count : ramCount_;
+  ramHead_ = (ramHead_ + fromRam) % SAMPLE_RAM_CAPACITY;
+  ramCount_ -= fromRam;
+}
@@ -0,0 +1,55 @@
+// Offline store for sensor samples taken while MQTT is down.
+//
+// A fixed ring of SAMPLE_RAM_CAPACITY frames in RAM. Once spill is enabled,
+// a full RAM ring moves its oldest SAMPLE_SPILL_CHUNK frames into a pre-sized
+// ring file on flash instead of dropping them. Frames always come out oldest
+// first (flash, then RAM); when both are full the oldest sample is dropped and
+// counted in dropped().
+//
+// Memory is fixed at compile time: SAMPLE_RAM_CAPACITY * sizeof(SensorFrame)
+// bytes of RAM and SAMPLE_SPILL_CAPACITY * SENSOR_FRAME_SIZE bytes of flash.
+// The flash ring's indexes live in RAM, so spilled samples do not survive a
+// reboot.
+#pragma once
+
+#include <FS.h>
+
+#include "sensor_frame.h"
+
+#define SAMPLE_RAM_CAPACITY 64        // 16 min of 15 s samples
+#define SAMPLE_SPILL_CAPACITY 2048    // 8.5 h more on flash, 36 KiB
+#define SAMPLE_SPILL_CHUNK 16         // frames per flash write
+#define SAMPLE_SPILL_PATH "/samples.bin"
+
+class SampleBuffer {
+ public:
+  // Creates the spill file at its full size. Without it (or if it fails) a
+  // full RAM ring overwrites its oldest sample.
+  bool beginSpill(fs::FS& fs);
+
+  void push(const SensorFrame& frame);
+
+  // Copies up to max of the oldest frames without removing them; pop() them
+  // once they are delivered.
+  size_t peek(SensorFrame* out, size_t max);
+  void pop(size_t count);
+
+  size_t size() const { return ramCount_ + spillCount_; }
+  bool empty() const { return size() == 0; }
+  size_t spilled() const { return spillCount_; }
+  uint32_t dropped() const { return dropped_; }
+
+ private:
+  bool spillOldest();
+  bool writeSlots(uint16_t slot, const uint8_t* data, uint16_t count);
+
+  SensorFrame ram_[SAMPLE_RAM_CAPACITY];
+  uint16_t ramHead_ = 0;
+  uint16_t ramCount_ = 0;
+
+  fs::File spill_;
+  uint16_t spillHead_ = 0;
+  uint16_t spillCount_ = 0;
+
+  uint32_t dropped_ = 0;
+};
@@ -0,0 +1,111 @@
+#include "sensor_frame.h"
+
+#include <math.h>
+
+static void put16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  put16(p, (uint16_t)v);
+  put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+static uint32_t get32(const uint8_t* p) { return get16(p) | ((uint32_t)get16(p + 2) << 16); }
+
+void setSensorFrameClimate(SensorFrame& frame, float temperature, float humidity) {
+  if (isnan(temperature) || isnan(humidity)) {
+    frame.flags &= ~SENSOR_FRAME_FLAG_CLIMATE_VALID;
+    frame.tempCenti = 0;
+    frame.humiCenti = 0;
+    return;
+  }
+  long t = lroundf(temperature * 100.0f);
+  long h = lroundf(humidity * 100.0f);
+  frame.tempCenti = (int16_t)(t < -32768 ? -32768 : t > 32767 ? 32767 : t);
+  frame.humiCenti = (uint16_t)(h < 0 ? 0 : h > 10000 ? 10000 : h);
+  frame.flags |= SENSOR_FRAME_FLAG_CLIMATE_VALID;
+}
+
+size_t encodeSensorFrame(const SensorFrame& frame, uint8_t* out, size_t capacity) {
+  if (capacity < SENSOR_FRAME_SIZE) return 0;
+  out[0] = SENSOR_FRAME_VERSION;
+  out[1] = frame.flags;
+  put16(out + 2, frame.seq);
+  put32(out + 4, frame.timestampMs);
+  put16(out + 8, (uint16_t)frame.tempCenti);
+  put16(out + 10, frame.humiCenti);
+  for (int i = 0; i < SENSOR_FRAME_LIGHTS; i++) put16(out + 12 + 2 * i, frame.light[i]);
+  return SENSOR_FRAME_SIZE;
+}
+
+bool decodeSensorFrame(const uint8_t* data, size_t length, SensorFrame& frame) {
+  if (length != SENSOR_FRAME_SIZE || data[0] != SENSOR_FRAME_VERSION) return false;
+  frame.flags = data[1];
+  frame.seq = get16(data + 2);
+  frame.timestampMs = get32(data + 4);
+  frame.tempCenti = (int16_t)get16(data + 8);
+  frame.humiCenti = get16(data + 10);
+  for (int i = 0; i < SENSOR_FRAME_LIGHTS; i++) frame.light[i] = get16(data + 12 + 2 * i);
+  return true;
+}
+
+size_t encodeSensorBacklog(const SensorFrame* frames, size_t count, uint32_t sentAtMs,
+                           uint8_t* out, size_t capacity) {
+  size_t total = SENSOR_BACKLOG_HEADER_SIZE + count * SENSOR_FRAME_SIZE;
+  if (count > 255 || capacity < total) return 0;
+  out[0] = SENSOR_BACKLOG_VERSION;
+  out[1] = (uint8_t)count;
+  put32(out + 2, sentAtMs);
+  for (size_t i = 0; i < count; i++) {
+    encodeSensorFrame(frames[i], out + SENSOR_BACKLOG_HEADER_SIZE + i * SENSOR_FRAME_SIZE,
+                      SENSOR_FRAME_SIZE);
+  }
+  return total;
+}
+
+static int16_t clamp16(int32_t v) {
+  return (int16_t)(v < -32768 ? -32768 : v > 32767 ? 32767 : v);
+}
+
+size_t encodeSensorRollup(const RollupRecord& record, uint8_t* out, size_t capacity) {
+  size_t total = SENSOR_ROLLUP_HEADER_SIZE + record.channels * SENSOR_ROLLUP_CHANNEL_SIZE;
+  if (record.channels > ROLLUP_MAX_CHANNELS || capacity < total) return 0;
+  out[0] = SENSOR_ROLLUP_VERSION;
+  out[1] = record.channels;
+  put32(out + 2, record.startMs);
+  put32(out + 6, record.lengthMs);
+  for (uint8_t c = 0; c < record.channels; c++) {
+    const RollupStats& s = record.stats[c];
+    uint8_t* p = out + SENSOR_ROLLUP_HEADER_SIZE + c * SENSOR_ROLLUP_CHANNEL_SIZE;
+    put16(p, (uint16_t)clamp16(s.min));
+    put16(p + 2, (uint16_t)clamp16(s.max));
+    put16(p + 4, (uint16_t)clamp16(s.mean));
+    put16(p + 6, (uint16_t)(s.count > 65535 ? 65535 : s.count));
+  }
+  return total;
+}
+
+bool decodeSensorRollup(const uint8_t* data, size_t length, RollupRecord& record) {
+  if (length < SENSOR_ROLLUP_HEADER_SIZE || data[0] != SENSOR_ROLLUP_VERSION) return false;
+  uint8_t channels = data[1];
+  if (channels > ROLLUP_MAX_CHANNELS ||
+      length != SENSOR_ROLLUP_HEADER_SIZE + (size_t)channels * SENSOR_ROLLUP_CHANNEL_SIZE) {
+    return false;
+  }
+  record.channels = channels;
+  record.startMs = get32(data + 2);
+  record.lengthMs = get32(data + 6);
+  for (uint8_t c = 0; c < channels; c++) {
+    const uint8_t* p = data + SENSOR_ROLLUP_HEADER_SIZE + c * SENSOR_ROLLUP_CHANNEL_SIZE;
+    RollupStats& s = record.stats[c];
+    s.min = (int16_t)get16(p);
+    s.max = (int16_t)get16(p + 2);
+    s.mean = (int16_t)get16(p + 4);
+    s.count = get16(p + 6);
+  }
+  return true;
+}
@@ -0,0 +1,82 @@
+// Compact binary sensor frame: one PUBLISH per cycle on
+// yolouno/<house>/sensors/frame instead of ten text publishes.
+//
+// Layout v1, little-endian, 18 bytes:
+//   0  u8   version (SENSOR_FRAME_VERSION)
+//   1  u8   flags (SENSOR_FRAME_FLAG_*)
+//   2  u16  sequence number, wraps
+//   4  u32  timestamp, millis() at sampling
+//   8  i16  temperature, centi-degrees C
+//  10  u16  humidity, centi-percent
+//  12  u16  light[3], raw ADC for LIGHT_ID_MIN..LIGHT_ID_MIN+2
+//
+// Samples taken while offline are replayed in batches on
+// yolouno/<house>/sensors/backlog:
+//   0  u8   version (SENSOR_BACKLOG_VERSION)
+//   1  u8   frame count n
+//   2  u32  millis() when the batch was sent, to date the frames against
+//   6  n x 18-byte frames as above, oldest first
+//
+// Windowed statistics (see sensor_rollup.h), one record per closed window
+// on yolouno/<house>/sensors/rollup:
+//   0  u8   version (SENSOR_ROLLUP_VERSION)
+//   1  u8   channel count n
+//   2  u32  millis() when the window opened
+//   6  u32  window length, ms
+//  10  n x 8 bytes, one per channel in frame order (temperature, humidity,
+//      light[3]): i16 min, i16 max, i16 mean, u16 sample count. A count of
+//      0 means no sample in that window; the three values are then 0.
+//
+// The temperature/humidity pair is the single DHT20 reading that the text
+// topics repeat for TEMP_HUMI_ID_MIN..MAX.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sensor_rollup.h"
+
+#define SENSOR_FRAME_VERSION 1
+#define SENSOR_FRAME_LIGHTS 3
+#define SENSOR_FRAME_SIZE 18
+
+#define SENSOR_FRAME_FLAG_CLIMATE_VALID 0x01
+
+#define SENSOR_BACKLOG_VERSION 1
+#define SENSOR_BACKLOG_HEADER_SIZE 6
+
+#define SENSOR_ROLLUP_VERSION 1
+#define SENSOR_ROLLUP_HEADER_SIZE 10
+#define SENSOR_ROLLUP_CHANNEL_SIZE 8
+#define SENSOR_ROLLUP_MAX_SIZE \
+  (SENSOR_ROLLUP_HEADER_SIZE + ROLLUP_MAX_CHANNELS * SENSOR_ROLLUP_CHANNEL_SIZE)
+
+struct SensorFrame {
+  uint8_t flags;
+  uint16_t seq;
+  uint32_t timestampMs;
+  int16_t tempCenti;
+  uint16_t humiCenti;
+  uint16_t light[SENSOR_FRAME_LIGHTS];
+};
+
+// Fills tempCenti/humiCenti from floats, rounding and clamping to the field range.
+void setSensorFrameClimate(SensorFrame& frame, float temperature, float humidity);
+
+// Returns the encoded size, or 0 if capacity < SENSOR_FRAME_SIZE.
+size_t encodeSensorFrame(const SensorFrame& frame, uint8_t* out, size_t capacity);
+
+// Rejects wrong length or unknown version.
+bool decodeSensorFrame(const uint8_t* data, size_t length, SensorFrame& frame);
+
+// Returns the encoded size, or 0 if the batch does not fit in capacity or
+// count exceeds 255.
+size_t encodeSensorBacklog(const SensorFrame* frames, size_t count, uint32_t sentAtMs,
+                           uint8_t* out, size_t capacity);
+
+// Values clamp to the i16 range and the count to 65535. Returns the encoded
+// size, or 0 if it does not fit in capacity.
+size_t encodeSensorRollup(const RollupRecord& record, uint8_t* out, size_t capacity);
+
+// Rejects wrong length, unknown version or more than ROLLUP_MAX_CHANNELS.
+bool decodeSensorRollup(const uint8_t* data, size_t length, RollupRecord& record);
@@ -0,0 +1,81 @@
+#include "sensor_rollup.h"
+
+void WindowedRollup::clear(Window& w) {
+  for (int c = 0; c < ROLLUP_MAX_CHANNELS; c++) {
+    w.acc[c].sum = 0;
+    w.acc[c].min = INT32_MAX;
+    w.acc[c].max = INT32_MIN;
+    w.acc[c].count = 0;
+  }
+}
+
+bool WindowedRollup::begin(const uint32_t* windowMs, uint8_t windows, uint8_t channels,
+                           uint32_t nowMs) {
+  windowCount_ = 0;
+  channels_ = 0;
+  if (windows > ROLLUP_MAX_WINDOWS || channels > ROLLUP_MAX_CHANNELS) return false;
+  for (uint8_t i = 0; i < windows; i++) {
+    if (windowMs[i] == 0) return false;
+  }
+  for (uint8_t i = 0; i < windows; i++) {
+    // Shortest first, so close() hands them out in that order
+    uint8_t at = i;
+    while (at > 0 && windows_[at - 1].lengthMs > windowMs[i]) {
+      windows_[at] = windows_[at - 1];
+      at--;
+    }
+    windows_[at].lengthMs = windowMs[i];
+    windows_[at].startMs = nowMs;
+    clear(windows_[at]);
+  }
+  windowCount_ = windows;
+  channels_ = channels;
+  return true;
+}
+
+void WindowedRollup::add(uint8_t channel, int32_t value) {
+  if (channel >= channels_) return;
+  for (uint8_t i = 0; i < windowCount_; i++) {
+    Accumulator& a = windows_[i].acc[channel];
+    a.sum += value;
+    if (value < a.min) a.min = value;
+    if (value > a.max) a.max = value;
+    a.count++;
+  }
+}
+
+static int32_t roundedMean(int64_t sum, uint32_t count) {
+  if (sum >= 0) return (int32_t)((sum + count / 2) / count);
+  return (int32_t)-((-sum + count / 2) / count);
+}
+
+bool WindowedRollup::close(uint32_t nowMs, RollupRecord& out) {
+  for (uint8_t i = 0; i < windowCount_; i++) {
+    Window& w = windows_[i];
+    uint32_t elapsed = nowMs - w.startMs;
+    if (elapsed < w.lengthMs) continue;
+
+    bool any = false;
+    out.startMs = w.startMs;
+    out.lengthMs = w.lengthMs;
+    out.channels = channels_;
+    for (uint8_t c = 0; c < channels_; c++) {
+      const Accumulator& a = w.acc[c];
+      RollupStats& s = out.stats[c];
+      s.count = a.count;
+      if (a.count == 0) {
+        s.min = s.max = s.mean = 0;
+        continue;
+      }
+      any = true;
+      s.min = a.min;
+      s.max = a.max;
+      s.mean = roundedMean(a.sum, a.count);
+    }
+    // Stay on the grid: windows slept through are skipped, not replayed
+    w.startMs += elapsed / w.lengthMs * w.lengthMs;
+    clear(w);
+    if (any) return true;
+  }
+  return false;
+}
@@ -0,0 +1,71 @@
+// Windowed statistics per sensor channel: min, max, mean and count over fixed
+// windows (e.g. 1 min and 15 min), so the backend gets one small record per
+// window instead of every sample.
+//
+// Samples are integers in channel units (centi-degrees, centi-percent, raw
+// ADC). Each window keeps one accumulator per channel: an exact 64-bit sum,
+// min, max and count, so the mean is exact up to its final rounding however
+// many samples go in, and memory is fixed (no sample is stored). Channels
+// are sampled at their own rates; each one's count says how many it had.
+//
+// Every window length runs on the same grid from begin(), so a 15 min window
+// closes together with the 1 min one that ends it. close() hands out each
+// window that has ended, shortest first; a window in which no channel had a
+// sample (the device was busy or asleep through it) is dropped, not sent
+// empty. Call close() until it returns false before add() so that a sample
+// lands in the window its time belongs to.
+#pragma once
+
+#include <stdint.h>
+
+#define ROLLUP_MAX_CHANNELS 5
+#define ROLLUP_MAX_WINDOWS 2
+
+struct RollupStats {
+  int32_t min;
+  int32_t max;
+  int32_t mean;     // rounded half away from zero
+  uint32_t count;   // 0: no sample, the rest is meaningless
+};
+
+struct RollupRecord {
+  uint32_t startMs;    // millis() when the window opened
+  uint32_t lengthMs;
+  uint8_t channels;
+  RollupStats stats[ROLLUP_MAX_CHANNELS];
+};
+
+class WindowedRollup {
+ public:
+  // False (and no windows) if there are too many windows or channels, or a
+  // length of 0.
+  bool begin(const uint32_t* windowMs, uint8_t windows, uint8_t channels, uint32_t nowMs);
+
+  // One sample into every open window.
+  void add(uint8_t channel, int32_t value);
+
+  // The next window that has ended by nowMs; false if none has.
+  bool close(uint32_t nowMs, RollupRecord& out);
+
+  uint8_t windows() const { return windowCount_; }
+  uint8_t channels() const { return channels_; }
+
+ private:
+  struct Accumulator {
+    int64_t sum;
+    int32_t min;
+    int32_t max;
+    uint32_t count;
+  };
+  struct Window {
+    uint32_t lengthMs;
+    uint32_t startMs;
+    Accumulator acc[ROLLUP_MAX_CHANNELS];
+  };
+
+  static void clear(Window& w);
+
+  Window windows_[ROLLUP_MAX_WINDOWS] = {};
+  uint8_t windowCount_ = 0;
+  uint8_t channels_ = 0;
+};
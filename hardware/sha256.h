@@ -0,0 +1,27 @@
+// SHA-256 (FIPS 180-4), fed incrementally: the OTA patcher hashes the image
+// it writes as it goes, without holding it in RAM. Plain C++ so the same code
+// runs on the host; 104 bytes of state.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_SIZE 32
+
+class Sha256 {
+ public:
+  Sha256() { begin(); }
+
+  void begin();
+  void update(const uint8_t* data, size_t length);
+  void finish(uint8_t out[SHA256_SIZE]);   // begin() again before reuse
+
+  static void hash(const uint8_t* data, size_t length, uint8_t out[SHA256_SIZE]);
+
+ private:
+  void block(const uint8_t* data);
+
+  uint32_t state_[8];
+  uint64_t bytes_ = 0;
+  uint8_t buffer_[64];
+};
@@ -0,0 +1,54 @@
+// Bounded single-producer single-consumer ring queue.
+//
+// One task pushes, one other task pops; neither ever blocks or takes a lock.
+// head_ is written only by the consumer and tail_ only by the producer, each
+// published with release ordering and read with acquire, so a record is fully
+// written before the other side can see it. Works across the two ESP32-S3
+// cores and across std::threads on the host build.
+//
+// N must be a power of two. All N slots are usable: the indexes run freely and
+// wrap at 2^32, and the slot is the index masked by N - 1.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+template <typename T, size_t N>
+class SpscQueue {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+ public:
+  // Producer side. Returns false (and leaves the queue alone) when full.
+  bool push(const T& item) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == N) return false;
+    slots_[tail & (N - 1)] = item;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false when empty.
+  bool pop(T& out) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+    out = slots_[head & (N - 1)];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // A snapshot; exact only when called from one of the two sides while the
+  // other is idle.
+  size_t size() const {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+  }
+  bool empty() const { return size() == 0; }
+  static constexpr size_t capacity() { return N; }
+
+ private:
+  T slots_[N];
+  // Kept on separate cache lines so the two cores do not fight over one.
+  alignas(32) std::atomic<uint32_t> head_{0};
+  alignas(32) std::atomic<uint32_t> tail_{0};
+};
@@ -0,0 +1,66 @@
+#include "state_sync.h"
+
+#include <string.h>
+
+static_assert(DEVICE_MAX <= 32, "visited_ has one bit per device slot");
+
+void StateSync::begin(unsigned long nowMs, unsigned long windowMs) {
+  devices_.forgetAcks();
+
+  // One filter per actuator kind in the table; sensors are never echoed back.
+  uint8_t kinds = 0;
+  for (size_t slot = 0; slot < devices_.count(); slot++) kinds |= 1u << devices_.kind(slot);
+  for (int kind = 0; kind < STATUS_KIND_COUNT; kind++) {
+    char filter[96];
+    if ((kinds & (1u << kind)) && topics_.statusFilter((StatusTopic)kind, filter, sizeof(filter))) {
+      client_.subscribe(filter, 1);
+    }
+  }
+
+  startAt_ = nowMs + (windowMs ? (unsigned long)random((long)windowMs) : 0);
+  visited_ = 0;
+  syncing_ = true;
+}
+
+bool StateSync::onMessage(const char* topic, const uint8_t* payload, unsigned int length) {
+  StatusTopic kind;
+  int id;
+  if (!topics_.findStatus(topic, &kind, &id)) return false;
+  int slot = devices_.find(kind, id);
+  if (slot < 0) return true;
+
+  // Read the version first: a change racing with this check leaves the slot
+  // unacked rather than acking a state the broker never saw.
+  uint16_t version = devices_.version(slot);
+  char text[DEVICE_STATE_TEXT_MAX];
+  size_t len = devices_.formatState(slot, text, sizeof(text));
+  if (len == length && memcmp(text, payload, len) == 0) devices_.acknowledge(slot, version);
+  return true;
+}
+
+size_t StateSync::service(unsigned long nowMs) {
+  if (!syncing_ || (long)(nowMs - startAt_) < 0) return 0;
+
+  size_t sent = 0;
+  for (size_t slot = 0; slot < devices_.count(); slot++) {
+    uint32_t bit = 1u << slot;
+    if (visited_ & bit) continue;
+    if (!devices_.unacked(slot)) {
+      visited_ |= bit;
+      skipped_++;
+      continue;
+    }
+    if (sent == STATE_SYNC_BURST) return sent;
+    char text[DEVICE_STATE_TEXT_MAX];
+    devices_.formatState(slot, text, sizeof(text));
+    if (!client_.publish(topics_.status(devices_.kind(slot), devices_.id(slot)), text, true)) {
+      failed_++;
+      return sent;   // connection gone: begin() starts over on the next connect
+    }
+    visited_ |= bit;
+    published_++;
+    sent++;
+  }
+  syncing_ = false;
+  return sent;
+}
@@ -0,0 +1,62 @@
+// Reconnect-time delta sync of actuator states against the broker.
+//
+// Device status topics are published retained, and the house subscribes to
+// its own actuator status topics. Whatever the broker sends back on those
+// topics - the retained copies right after subscribing, then the echo of each
+// of our own publishes - acknowledges a device's state when the payload
+// matches it: the broker provably holds that version (DeviceRegistry::
+// acknowledge()). PubSubClient only publishes at QoS 0, so this echo stands in
+// for a QoS 1 PUBACK and also covers a broker that lost its retained store.
+//
+// On every (re)connect begin() forgets all acks, subscribes, and picks a
+// random start inside the sync window. By then the retained copies have come
+// back; service() then publishes only the devices still unacknowledged, a few
+// per pass. A fleet reconnecting after a broker restart therefore sends
+// nothing for states the broker kept, and spreads the rest over the window
+// instead of every house bursting its full snapshot at once.
+#pragma once
+
+#include <PubSubClient.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "device_registry.h"
+#include "topic_table.h"
+
+#define STATE_SYNC_WINDOW_MS 5000UL    // sync starts at a random point in this window
+#define STATE_SYNC_BURST 2             // devices published per service() pass
+
+class StateSync {
+ public:
+  StateSync(DeviceRegistry& devices, const TopicTable& topics, PubSubClient& client)
+      : devices_(devices), topics_(topics), client_(client) {}
+
+  // Right after each broker connect.
+  void begin(unsigned long nowMs, unsigned long windowMs = STATE_SYNC_WINDOW_MS);
+
+  // Feed every incoming message; true if it was one of our status topics
+  // (acknowledged or not) and needs no further handling.
+  bool onMessage(const char* topic, const uint8_t* payload, unsigned int length);
+
+  // Publishes up to STATE_SYNC_BURST unacknowledged devices once the start
+  // time has passed. Returns how many it published.
+  size_t service(unsigned long nowMs);
+
+  bool syncing() const { return syncing_; }
+  unsigned long startAtMs() const { return startAt_; }
+  uint32_t published() const { return published_; }   // sync publishes, all connects
+  uint32_t skipped() const { return skipped_; }       // already acked at sync time
+  uint32_t failed() const { return failed_; }         // publishes refused by the client
+
+ private:
+  DeviceRegistry& devices_;
+  const TopicTable& topics_;
+  PubSubClient& client_;
+
+  bool syncing_ = false;
+  unsigned long startAt_ = 0;
+  uint32_t visited_ = 0;        // bit per slot: dealt with in this sync
+  uint32_t published_ = 0;
+  uint32_t skipped_ = 0;
+  uint32_t failed_ = 0;
+};
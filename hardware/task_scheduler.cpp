@@ -0,0 +1,94 @@
+#include "task_scheduler.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+static bool reached(uint32_t now, uint32_t deadline) { return (int32_t)(now - deadline) >= 0; }
+
+int TaskScheduler::add(const char* name, TaskFn fn, uint32_t periodMs, uint8_t priority,
+                       uint32_t firstDelayMs) {
+  if (count_ == SCHED_MAX_TASKS || !fn) return -1;
+  int id = count_++;
+  Task& t = tasks_[id];
+  t.name = name;
+  t.fn = fn;
+  t.periodMs = periodMs;
+  t.dueMs = firstDelayMs;   // made absolute on the first run()
+  t.priority = priority;
+  t.enabled = true;
+  t.started = false;
+  t.stats = TaskStats();
+
+  // Insert into the priority order; equal priorities keep registration order.
+  int pos = id;
+  while (pos > 0 && tasks_[order_[pos - 1]].priority < priority) {
+    order_[pos] = order_[pos - 1];
+    pos--;
+  }
+  order_[pos] = (uint8_t)id;
+  return id;
+}
+
+void TaskScheduler::run() {
+  for (uint8_t i = 0; i < count_; i++) {
+    Task& t = tasks_[order_[i]];
+    if (!t.enabled) continue;
+    uint32_t now = millis();
+    if (!t.started) {
+      t.dueMs += now;
+      t.started = true;
+    }
+    if (t.periodMs != SCHED_EVERY_PASS && !reached(now, t.dueMs)) continue;
+
+    if (t.periodMs != SCHED_EVERY_PASS) {
+      uint32_t late = now - t.dueMs;
+      if (late > t.stats.maxLateMs) t.stats.maxLateMs = late;
+      // Keep the cadence, but do not run back-to-back to catch up.
+      t.dueMs = late >= t.periodMs ? now + t.periodMs : t.dueMs + t.periodMs;
+    }
+    uint32_t start = micros();
+    t.fn();
+    uint32_t took = micros() - start;
+    if (took > t.stats.maxRunUs) t.stats.maxRunUs = took;
+    t.stats.runs++;
+  }
+}
+
+void TaskScheduler::runAfter(int id, uint32_t delayMs) {
+  if (id < 0 || id >= count_) return;
+  tasks_[id].dueMs = millis() + delayMs;
+  tasks_[id].started = true;
+}
+
+void TaskScheduler::setPeriod(int id, uint32_t periodMs) {
+  if (id < 0 || id >= count_) return;
+  tasks_[id].periodMs = periodMs;
+  runAfter(id, periodMs);
+}
+
+void TaskScheduler::setEnabled(int id, bool enabled) {
+  if (id >= 0 && id < count_) tasks_[id].enabled = enabled;
+}
+
+int TaskScheduler::find(const char* name) const {
+  for (int id = 0; id < count_; id++) {
+    if (strcmp(tasks_[id].name, name) == 0) return id;
+  }
+  return -1;
+}
+
+uint32_t TaskScheduler::idleMs(bool everyPass) const {
+  uint32_t now = millis();
+  uint32_t idle = UINT32_MAX;
+  for (int id = 0; id < count_; id++) {
+    const Task& t = tasks_[id];
+    if (!t.enabled) continue;
+    if (t.periodMs == SCHED_EVERY_PASS) {
+      if (everyPass) return 0;
+      continue;
+    }
+    if (!t.started || reached(now, t.dueMs)) return 0;
+    if (t.dueMs - now < idle) idle = t.dueMs - now;
+  }
+  return idle;
+}
@@ -0,0 +1,70 @@
+// Fixed-capacity cooperative scheduler for loop().
+//
+// Tasks are plain functions registered once in setup() with a period and a
+// priority. run() is called from every loop() pass and runs each task that is
+// due, highest priority first; a period of SCHED_EVERY_PASS runs the task on
+// every pass. Tasks must return quickly: anything that waits on hardware is
+// split into phases with runAfter().
+//
+// The table holds SCHED_MAX_TASKS entries and never allocates. With this few
+// tasks a linear scan per pass is cheaper than keeping a heap of deadlines.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCHED_MAX_TASKS 16
+#define SCHED_EVERY_PASS 0
+
+typedef void (*TaskFn)();
+
+struct TaskStats {
+  uint32_t runs;
+  uint32_t maxRunUs;    // longest single run
+  uint32_t maxLateMs;   // longest delay past the deadline
+};
+
+class TaskScheduler {
+ public:
+  // Returns the task id, or -1 if the table is full. The first run is
+  // firstDelayMs after the first run() call.
+  int add(const char* name, TaskFn fn, uint32_t periodMs, uint8_t priority,
+          uint32_t firstDelayMs = 0);
+
+  void run();
+
+  // Next run of task id in delayMs, instead of one period after this run.
+  // Called from inside a task, it overrides that task's normal reschedule.
+  void runAfter(int id, uint32_t delayMs);
+  void setPeriod(int id, uint32_t periodMs);
+  void setEnabled(int id, bool enabled);
+
+  int find(const char* name) const;   // -1 if no such task
+  size_t count() const { return count_; }
+  const char* name(int id) const { return tasks_[id].name; }
+  uint32_t period(int id) const { return tasks_[id].periodMs; }
+  const TaskStats& stats(int id) const { return tasks_[id].stats; }
+
+  // Milliseconds until the earliest deadline; 0 if a task is due or runs
+  // every pass. With everyPass false, tasks that run every pass do not count:
+  // they poll for events (socket data, link state) that a sleeping loop() is
+  // woken for, or revisits within its latency bound (see power_manager.h).
+  // UINT32_MAX if nothing is scheduled.
+  uint32_t idleMs(bool everyPass = true) const;
+
+ private:
+  struct Task {
+    const char* name;
+    TaskFn fn;
+    uint32_t periodMs;
+    uint32_t dueMs;
+    uint8_t priority;
+    bool enabled;
+    bool started;
+    TaskStats stats;
+  };
+
+  Task tasks_[SCHED_MAX_TASKS];
+  uint8_t order_[SCHED_MAX_TASKS];   // task ids by descending priority
+  uint8_t count_ = 0;
+};
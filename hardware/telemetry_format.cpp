@@ -0,0 +1,59 @@
+#include "telemetry_format.h"
+
+namespace {
+
+// Digits of value, most significant first; returns the count. No NUL.
+size_t writeDigits(char* out, uint32_t value, size_t minDigits = 1) {
+  char reversed[10];
+  size_t n = 0;
+  do {
+    reversed[n++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  while (n < minDigits) reversed[n++] = '0';
+  for (size_t i = 0; i < n; i++) out[i] = reversed[n - 1 - i];
+  return n;
+}
+
+// |value| without overflow for INT32_MIN.
+uint32_t magnitude(int32_t value) {
+  return value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+}
+
+}  // namespace
+
+size_t formatInt(char* out, int32_t value) {
+  size_t len = 0;
+  if (value < 0) out[len++] = '-';
+  len += writeDigits(out + len, magnitude(value));
+  out[len] = '\0';
+  return len;
+}
+
+size_t formatUint(char* out, uint32_t value) {
+  size_t len = writeDigits(out, value);
+  out[len] = '\0';
+  return len;
+}
+
+size_t formatFixedScaled(char* out, int32_t scaled, int decimals) {
+  uint32_t scale = (uint32_t)pow10i(decimals);
+  uint32_t abs = magnitude(scaled);
+  size_t len = 0;
+  if (scaled < 0) out[len++] = '-';
+  len += writeDigits(out + len, abs / scale);
+  out[len++] = '.';
+  len += writeDigits(out + len, abs % scale, (size_t)decimals);
+  out[len] = '\0';
+  return len;
+}
+
+size_t formatRgb(char* out, uint32_t rgb) {
+  size_t len = writeDigits(out, (rgb >> 16) & 0xFF);
+  out[len++] = ',';
+  len += writeDigits(out + len, (rgb >> 8) & 0xFF);
+  out[len++] = ',';
+  len += writeDigits(out + len, rgb & 0xFF);
+  out[len] = '\0';
+  return len;
+}
@@ -0,0 +1,115 @@
+// Allocation-free text for the values the firmware publishes and shows:
+// fixed-point temperature and humidity, integer light levels, "r,g,b"
+// triplets and the JSON sensor summary.
+//
+// Values are integers scaled by 10^Decimals (centi-°C is formatFixed<2>), so
+// no float ever reaches printf: dtostrf()/"%f" pull newlib's float formatter
+// into the image and cost microseconds per call on the ESP32. Every field has
+// a constexpr worst-case length, so a TextBuffer sized for a layout is checked
+// at compile time (static_assert) and the writes themselves never fail.
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+constexpr size_t INT_TEXT_MAX = 11;     // "-2147483648"
+constexpr size_t UINT_TEXT_MAX = 10;    // "4294967295"
+constexpr size_t FIXED_TEXT_MAX = 13;   // "-21474836.48": the point and a leading "0" at most
+constexpr size_t RGB_TEXT_MAX = 11;     // "255,255,255"
+
+constexpr int32_t pow10i(int exponent) { return exponent == 0 ? 1 : 10 * pow10i(exponent - 1); }
+
+// Each returns the length written and NUL-terminates; out must hold the
+// field's *_TEXT_MAX + 1 bytes.
+size_t formatInt(char* out, int32_t value);
+size_t formatUint(char* out, uint32_t value);
+size_t formatFixedScaled(char* out, int32_t scaled, int decimals);
+size_t formatRgb(char* out, uint32_t rgb);   // 0xRRGGBB -> "r,g,b"
+
+template <int Decimals>
+size_t formatFixed(char* out, int32_t scaled) {
+  static_assert(Decimals > 0 && Decimals <= 4, "1 to 4 decimals");
+  return formatFixedScaled(out, scaled, Decimals);
+}
+
+// value * 10^Decimals, rounded half away from zero (as dtostrf rounds).
+template <int Decimals>
+int32_t toFixed(float value) {
+  return (int32_t)lroundf(value * (float)pow10i(Decimals));
+}
+
+// Appends fields into one fixed buffer. Size N for the longest layout it is
+// used for; each append checks its worst case and, if that would not fit,
+// marks the buffer failed and leaves it unchanged.
+template <size_t N>
+class TextBuffer {
+ public:
+  static constexpr size_t capacity = N;
+
+  TextBuffer& clear() {
+    len_ = 0;
+    ok_ = true;
+    buf_[0] = '\0';
+    return *this;
+  }
+
+  template <size_t L>
+  TextBuffer& literal(const char (&text)[L]) {
+    if (!room(L - 1)) return *this;
+    memcpy(buf_ + len_, text, L);
+    len_ += L - 1;
+    return *this;
+  }
+  TextBuffer& integer(int32_t value) {
+    if (room(INT_TEXT_MAX)) len_ += formatInt(buf_ + len_, value);
+    return *this;
+  }
+  TextBuffer& uinteger(uint32_t value) {
+    if (room(UINT_TEXT_MAX)) len_ += formatUint(buf_ + len_, value);
+    return *this;
+  }
+  template <int Decimals>
+  TextBuffer& fixed(int32_t scaled) {
+    if (room(FIXED_TEXT_MAX)) len_ += formatFixed<Decimals>(buf_ + len_, scaled);
+    return *this;
+  }
+  TextBuffer& rgb(uint32_t value) {
+    if (room(RGB_TEXT_MAX)) len_ += formatRgb(buf_ + len_, value);
+    return *this;
+  }
+
+  const char* c_str() const { return buf_; }
+  size_t length() const { return len_; }
+  bool ok() const { return ok_; }
+
+ private:
+  bool room(size_t worst) {
+    if (len_ + worst >= N) ok_ = false;
+    return ok_;
+  }
+
+  char buf_[N] = {};
+  size_t len_ = 0;
+  bool ok_ = true;
+};
+
+// {"temp":27.50,"humi":65.30,"light":512}
+constexpr size_t SENSOR_SUMMARY_MAX = sizeof("{\"temp\":,\"humi\":,\"light\":}") - 1 +
+                                      2 * FIXED_TEXT_MAX + INT_TEXT_MAX;
+
+template <size_t N>
+const char* formatSensorSummary(TextBuffer<N>& out, int32_t tempCenti, int32_t humiCenti,
+                                int32_t light) {
+  static_assert(N > SENSOR_SUMMARY_MAX, "buffer too small for the sensor summary");
+  return out.clear()
+      .literal("{\"temp\":")
+      .template fixed<2>(tempCenti)
+      .literal(",\"humi\":")
+      .template fixed<2>(humiCenti)
+      .literal(",\"light\":")
+      .integer(light)
+      .literal("}")
+      .c_str();
+}
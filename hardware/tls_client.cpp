@@ -0,0 +1,286 @@
+#include "tls_client.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+#include "device_config.h"
+
+static void put16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint16_t get16(const uint8_t* p) { return (uint16_t)(p[0] | p[1] << 8); }
+
+static uint32_t get32(const uint8_t* p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint32_t hostCrc(const char* host) { return crc32((const uint8_t*)host, strlen(host)); }
+
+// ---- TlsSessionCache -----------------------------------------------------------
+
+void TlsSessionCache::begin(fs::FS* fs) {
+  fs_ = fs;
+  length_ = 0;
+  if (!fs_ || !fs_->exists(TLS_SESSION_PATH)) return;
+  File file = fs_->open(TLS_SESSION_PATH, FILE_READ);
+  if (!file) return;
+  uint8_t header[TLS_SESSION_HEADER_SIZE];
+  uint8_t crc[4];
+  bool ok = file.read(header, sizeof(header)) == sizeof(header) &&
+            get32(header) == TLS_SESSION_MAGIC;
+  uint16_t length = ok ? get16(header + 6) : 0;
+  ok = ok && length > 0 && length <= TLS_SESSION_MAX &&
+       file.read(session_, length) == length && file.read(crc, 4) == 4 &&
+       get32(crc) == crc32(session_, length, crc32(header, sizeof(header)));
+  file.close();
+  if (!ok) return;
+  port_ = get16(header + 4);
+  hostCrc_ = get32(header + 8);
+  length_ = length;
+  sessionCrc_ = crc32(session_, length_);
+}
+
+bool TlsSessionCache::load(const char* host, uint16_t port, mbedtls_ssl_session* out) const {
+  if (length_ == 0 || port != port_ || hostCrc(host) != hostCrc_) return false;
+  return mbedtls_ssl_session_load(out, session_, length_) == 0;
+}
+
+void TlsSessionCache::store(const char* host, uint16_t port, const mbedtls_ssl_session* session) {
+  uint16_t oldLength = length_;
+  uint16_t oldPort = port_;
+  uint32_t oldHost = hostCrc_;
+  uint32_t oldCrc = sessionCrc_;
+  size_t length = 0;
+  // Serialized in place: a session that does not fit (or was not issued a
+  // ticket) leaves nothing to offer next time.
+  if (mbedtls_ssl_session_save(session, session_, sizeof(session_), &length) != 0) {
+    forget();
+    return;
+  }
+  length_ = (uint16_t)length;
+  port_ = port;
+  hostCrc_ = hostCrc(host);
+  sessionCrc_ = crc32(session_, length_);
+  if (length_ == oldLength && port_ == oldPort && hostCrc_ == oldHost && sessionCrc_ == oldCrc) {
+    return;
+  }
+  save();
+}
+
+void TlsSessionCache::forget() {
+  length_ = 0;
+  if (fs_ && fs_->exists(TLS_SESSION_PATH)) fs_->remove(TLS_SESSION_PATH);
+}
+
+void TlsSessionCache::save() {
+  if (!fs_) return;
+  uint8_t header[TLS_SESSION_HEADER_SIZE];
+  put32(header, TLS_SESSION_MAGIC);
+  put16(header + 4, port_);
+  put16(header + 6, length_);
+  put32(header + 8, hostCrc_);
+  uint8_t crc[4];
+  put32(crc, crc32(session_, length_, crc32(header, sizeof(header))));
+  // Same write-then-rename as the config: a power cut keeps the old file.
+  File file = fs_->open(TLS_SESSION_TMP_PATH, FILE_WRITE);
+  if (!file) return;
+  bool written = file.write(header, sizeof(header)) == sizeof(header) &&
+                 file.write(session_, length_) == length_ && file.write(crc, 4) == 4;
+  file.close();
+  if (!written || !fs_->rename(TLS_SESSION_TMP_PATH, TLS_SESSION_PATH)) {
+    fs_->remove(TLS_SESSION_TMP_PATH);
+    return;
+  }
+  flashWrites_++;
+}
+
+// ---- TlsClient -----------------------------------------------------------------
+
+int TlsClient::sendCallback(void* ctx, const unsigned char* buf, size_t len) {
+  Client& transport = ((TlsClient*)ctx)->transport_;
+  if (!transport.connected()) return MBEDTLS_ERR_NET_CONN_RESET;
+  size_t sent = transport.write(buf, len);
+  return sent > 0 ? (int)sent : MBEDTLS_ERR_SSL_WANT_WRITE;
+}
+
+int TlsClient::recvCallback(void* ctx, unsigned char* buf, size_t len) {
+  Client& transport = ((TlsClient*)ctx)->transport_;
+  int waiting = transport.available();
+  if (waiting <= 0) {
+    return transport.connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+  }
+  int got = transport.read(buf, len < (size_t)waiting ? len : (size_t)waiting);
+  return got > 0 ? got : MBEDTLS_ERR_NET_RECV_FAILED;
+}
+
+int TlsClient::fail(int error) {
+  stop();
+  lastError_ = error;
+  return 0;
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port) {
+  (void)ip;
+  (void)port;
+  handshakeMs_ = 0;
+  offeredSession_ = false;
+  return fail(MBEDTLS_ERR_SSL_BAD_INPUT_DATA);
+}
+
+int TlsClient::connect(const char* host, uint16_t port) {
+  stop();
+  lastError_ = 0;
+  offeredSession_ = false;
+  unsigned long startMs = millis();
+  handshakeMs_ = 0;
+  if (!host || !*host || !caPem_) return fail(MBEDTLS_ERR_SSL_BAD_INPUT_DATA);
+  if (!transport_.connect(host, port)) {
+    handshakeMs_ = millis() - startMs;
+    return fail(MBEDTLS_ERR_NET_CONN_RESET);
+  }
+
+  mbedtls_ssl_init(&ssl_);
+  mbedtls_ssl_config_init(&conf_);
+  mbedtls_x509_crt_init(&ca_);
+  mbedtls_ctr_drbg_init(&drbg_);
+  mbedtls_entropy_init(&entropy_);
+  initialized_ = true;
+  int err = mbedtls_ctr_drbg_seed(&drbg_, mbedtls_entropy_func, &entropy_, nullptr, 0);
+  if (!err) {
+    err = mbedtls_x509_crt_parse(&ca_, (const unsigned char*)caPem_, strlen(caPem_) + 1);
+  }
+  if (!err) {
+    err = mbedtls_ssl_config_defaults(&conf_, MBEDTLS_SSL_IS_CLIENT,
+                                      MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+  }
+  if (!err) {
+    mbedtls_ssl_conf_authmode(&conf_, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&conf_, &ca_, nullptr);
+    mbedtls_ssl_conf_rng(&conf_, mbedtls_ctr_drbg_random, &drbg_);
+    mbedtls_ssl_conf_session_tickets(&conf_, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+    err = mbedtls_ssl_setup(&ssl_, &conf_);
+  }
+  if (!err) err = mbedtls_ssl_set_hostname(&ssl_, host);
+  if (err) {
+    handshakeMs_ = millis() - startMs;
+    return fail(err);
+  }
+  mbedtls_ssl_set_bio(&ssl_, this, sendCallback, recvCallback, nullptr);
+
+  if (cache_) {
+    mbedtls_ssl_session saved;
+    mbedtls_ssl_session_init(&saved);
+    if (cache_->load(host, port, &saved)) {
+      offeredSession_ = mbedtls_ssl_set_session(&ssl_, &saved) == 0;
+    }
+    mbedtls_ssl_session_free(&saved);
+  }
+
+  while ((err = mbedtls_ssl_handshake(&ssl_)) != 0) {
+    if (err != MBEDTLS_ERR_SSL_WANT_READ && err != MBEDTLS_ERR_SSL_WANT_WRITE) break;
+    if (millis() - startMs >= TLS_HANDSHAKE_TIMEOUT_MS) {
+      err = MBEDTLS_ERR_SSL_TIMEOUT;
+      break;
+    }
+    delay(1);
+  }
+  handshakeMs_ = millis() - startMs;
+  if (err) return fail(err);
+
+  if (cache_) {
+    mbedtls_ssl_session negotiated;
+    mbedtls_ssl_session_init(&negotiated);
+    if (mbedtls_ssl_get_session(&ssl_, &negotiated) == 0) cache_->store(host, port, &negotiated);
+    mbedtls_ssl_session_free(&negotiated);
+  }
+  open_ = true;
+  return 1;
+}
+
+size_t TlsClient::write(const uint8_t* buf, size_t size) {
+  if (!open_) return 0;
+  size_t done = 0;
+  unsigned long startMs = millis();
+  while (done < size) {
+    int n = mbedtls_ssl_write(&ssl_, buf + done, size - done);
+    if (n > 0) {
+      done += (size_t)n;
+      continue;
+    }
+    if (n == MBEDTLS_ERR_SSL_WANT_READ || n == MBEDTLS_ERR_SSL_WANT_WRITE) {
+      if (millis() - startMs < TLS_WRITE_TIMEOUT_MS) {
+        delay(1);
+        continue;
+      }
+      n = MBEDTLS_ERR_SSL_TIMEOUT;
+    }
+    lastError_ = n;
+    open_ = false;
+    break;
+  }
+  return done;
+}
+
+int TlsClient::available() {
+  if (!open_) return peeked_ >= 0 ? 1 : 0;
+  // A zero-length read pulls the next record in so its bytes count.
+  int err = mbedtls_ssl_read(&ssl_, nullptr, 0);
+  if (err < 0 && err != MBEDTLS_ERR_SSL_WANT_READ && err != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    lastError_ = err == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY ? 0 : err;
+    open_ = false;
+  }
+  return (int)mbedtls_ssl_get_bytes_avail(&ssl_) + (peeked_ >= 0 ? 1 : 0);
+}
+
+int TlsClient::read() {
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int TlsClient::read(uint8_t* buf, size_t size) {
+  if (size == 0) return 0;
+  int got = 0;
+  if (peeked_ >= 0) {
+    buf[got++] = (uint8_t)peeked_;
+    peeked_ = -1;
+    if (size == 1) return got;
+  }
+  if (!open_) return got > 0 ? got : -1;
+  int n = mbedtls_ssl_read(&ssl_, buf + got, size - got);
+  if (n > 0) return got + n;
+  return got > 0 ? got : -1;
+}
+
+int TlsClient::peek() {
+  if (peeked_ < 0 && open_) {
+    uint8_t b;
+    if (mbedtls_ssl_read(&ssl_, &b, 1) == 1) peeked_ = b;
+  }
+  return peeked_;
+}
+
+void TlsClient::stop() {
+  if (initialized_) {
+    if (open_) mbedtls_ssl_close_notify(&ssl_);
+    mbedtls_ssl_free(&ssl_);
+    mbedtls_ssl_config_free(&conf_);
+    mbedtls_x509_crt_free(&ca_);
+    mbedtls_ctr_drbg_free(&drbg_);
+    mbedtls_entropy_free(&entropy_);
+    initialized_ = false;
+  }
+  open_ = false;
+  peeked_ = -1;
+  transport_.stop();
+}
+
+uint8_t TlsClient::connected() {
+  if (open_ && !transport_.connected() && available() == 0) open_ = false;
+  return open_ ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+// MQTT over TLS with session resumption, so a WiFi blip does not cost a full
+// handshake.
+//
+// TlsClient is an Arduino Client that runs mbedtls over another Client (the
+// WiFiClient's TCP socket), for PubSubClient to use in its place. The broker
+// certificate must verify against the CA given to setCACert(); there is no
+// insecure fallback, and without a CA connect() fails.
+//
+// A full handshake (ECDHE key exchange and certificate chain verification)
+// takes over a second of CPU on the ESP32 and a ~20 KB heap spike on top of
+// the record buffers; resuming a session from its ticket takes one round
+// trip and almost nothing. After each handshake the session is saved into
+// TlsSessionCache, which keeps the latest one in RAM and on flash, and the
+// next connect() to the same host and port offers it. The server decides:
+// a ticket it no longer accepts (expired, or its key changed on a restart)
+// just means a full handshake, and the new session replaces the old one.
+//
+// Session file, little-endian:
+//   u32 magic "TLS1" | u16 port | u16 length | u32 CRC-32 of the host name
+//   length bytes: mbedtls_ssl_session_save() output
+//   u32 CRC-32 (IEEE) of everything before it
+// A file that does not check out is ignored. The saved session holds the
+// session secrets; it stays in the device's own flash like the WiFi password
+// in the config.
+#pragma once
+
+#include <FS.h>
+#include <WiFi.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/x509_crt.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TLS_CA_PATH "/mqtt_ca.pem"      // broker CA, PEM
+#define TLS_CA_MAX 4096
+#define TLS_SESSION_MAGIC 0x31534C54u   // "TLS1"
+#define TLS_SESSION_PATH "/tls_session.bin"
+#define TLS_SESSION_TMP_PATH "/tls_session.new"
+// Secrets, ticket and the broker's certificate (MBEDTLS_SSL_KEEP_PEER_CERTIFICATE).
+#define TLS_SESSION_MAX 2048
+#define TLS_SESSION_HEADER_SIZE 12
+#define TLS_HANDSHAKE_TIMEOUT_MS 10000UL
+// A record the socket would not take in this long closes the connection
+// (a cut record leaves nothing to resume) instead of blocking the loop.
+#define TLS_WRITE_TIMEOUT_MS 5000UL
+
+class TlsSessionCache {
+ public:
+  // Loads the session a previous boot left on fs; null keeps it in RAM only.
+  void begin(fs::FS* fs);
+
+  // The saved session for host:port into out; false if there is none.
+  bool load(const char* host, uint16_t port, mbedtls_ssl_session* out) const;
+  // Replaces the saved session. Flash is only written when the bytes change,
+  // so resuming the same ticket again and again costs no flash wear.
+  void store(const char* host, uint16_t port, const mbedtls_ssl_session* session);
+  void forget();
+
+  size_t size() const { return length_; }
+  uint32_t flashWrites() const { return flashWrites_; }
+
+ private:
+  void save();
+
+  fs::FS* fs_ = nullptr;
+  uint8_t session_[TLS_SESSION_MAX];
+  uint16_t length_ = 0;   // 0: none
+  uint16_t port_ = 0;
+  uint32_t hostCrc_ = 0;
+  uint32_t sessionCrc_ = 0;
+  uint32_t flashWrites_ = 0;
+};
+
+class TlsClient : public Client {
+ public:
+  explicit TlsClient(Client& transport) : transport_(transport) {}
+  ~TlsClient() override { stop(); }
+
+  // PEM, NUL-terminated; kept by pointer, as WiFiClientSecure does.
+  void setCACert(const char* pem) { caPem_ = pem; }
+  void setSessionCache(TlsSessionCache* cache) { cache_ = cache; }
+
+  // Certificate verification needs the host name, so a bare IP is refused.
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t* buf, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return connected() != 0; }
+
+  // The last connect(): how long the TCP + TLS part took, whether a saved
+  // session was offered, and the mbedtls error if it failed (0 if not).
+  uint32_t handshakeMs() const { return handshakeMs_; }
+  bool offeredSession() const { return offeredSession_; }
+  int lastError() const { return lastError_; }
+
+ private:
+  static int sendCallback(void* ctx, const unsigned char* buf, size_t len);
+  static int recvCallback(void* ctx, unsigned char* buf, size_t len);
+  int fail(int error);
+
+  Client& transport_;
+  const char* caPem_ = nullptr;
+  TlsSessionCache* cache_ = nullptr;
+
+  mbedtls_ssl_context ssl_;
+  mbedtls_ssl_config conf_;
+  mbedtls_x509_crt ca_;
+  mbedtls_ctr_drbg_context drbg_;
+  mbedtls_entropy_context entropy_;
+  bool initialized_ = false;   // the contexts above need freeing
+  bool open_ = false;
+  int peeked_ = -1;
+
+  uint32_t handshakeMs_ = 0;
+  bool offeredSession_ = false;
+  int lastError_ = 0;
+};
@@ -0,0 +1,162 @@
+#include "topic_table.h"
+
+#include <string.h>
+
+static const char* const statusSegments[STATUS_KIND_COUNT] = {
+  "door", "alarm", "fan", "rgb", "temp", "humi", "light",
+};
+
+static size_t decimalDigits(int id) {
+  size_t n = 1;
+  while (id >= 10) {
+    id /= 10;
+    n++;
+  }
+  return n;
+}
+
+// Appends "yolouno/<house>/<tail><id>" (no id when id < 0) as slot slotIndex.
+bool TopicTable::append(int slotIndex, const char* house, const char* tail, int id) {
+  if (slotIndex >= TOPIC_MAX_SLOTS) return false;
+
+  char idText[12];
+  size_t idLen = id >= 0 ? decimalDigits(id) : 0;
+  for (size_t i = idLen; i > 0; i--) {
+    idText[i - 1] = (char)('0' + id % 10);
+    id /= 10;
+  }
+
+  const char* parts[] = {"yolouno/", house, "/", tail};
+  size_t total = idLen + 1;
+  for (const char* p : parts) total += strlen(p);
+  if (used_ + total > TOPIC_ARENA_SIZE) return false;
+
+  char* out = arena_ + used_;
+  offset_[slotIndex] = used_;
+  for (const char* p : parts) {
+    size_t n = strlen(p);
+    memcpy(out, p, n);
+    out += n;
+  }
+  memcpy(out, idText, idLen);
+  out[idLen] = '\0';
+  used_ += (uint16_t)total;
+  return true;
+}
+
+bool TopicTable::build(const char* houseId, const TopicIdRange ranges[STATUS_KIND_COUNT]) {
+  used_ = 0;
+  bool ok = append(SLOT_CONTROLS, houseId, "controls", -1) &&
+            append(SLOT_SENSORS, houseId, "sensors", -1) &&
+            append(SLOT_DEVICE, houseId, "status/device", -1) &&
+            append(SLOT_SENSOR_FRAME, houseId, "sensors/frame", -1) &&
+            append(SLOT_SENSOR_BACKLOG, houseId, "sensors/backlog", -1) &&
+            append(SLOT_SENSOR_ROLLUP, houseId, "sensors/rollup", -1) &&
+            append(SLOT_SENSOR_STREAM, houseId, "sensors/stream", -1) &&
+            append(SLOT_CONFIG, houseId, "config", -1) &&
+            append(SLOT_ACKS, houseId, "acks", -1) &&
+            append(SLOT_RULES, houseId, "rules", -1) &&
+            append(SLOT_DIAGNOSTICS, houseId, "diagnostics", -1) &&
+            append(SLOT_OTA, houseId, "ota", -1);
+  controlsLen_ = ok ? (uint16_t)strlen(controls()) : 0;
+
+  int next = SLOT_FIRST_STATUS;
+  for (int kind = 0; ok && kind < STATUS_KIND_COUNT; kind++) {
+    char tail[16] = "status/";
+    strcat(tail, statusSegments[kind]);
+    strcat(tail, "/");
+    ranges_[kind] = ranges[kind];
+    base_[kind] = (uint8_t)next;
+    for (int id = ranges[kind].idMin; ok && id <= ranges[kind].idMax; id++) {
+      ok = append(next++, houseId, tail, id);
+    }
+  }
+
+  if (!ok) {
+    // Leave every lookup pointing at an empty string rather than a partial topic.
+    used_ = 0;
+    arena_[0] = '\0';
+    memset(offset_, 0, sizeof(offset_));
+    for (int kind = 0; kind < STATUS_KIND_COUNT; kind++) ranges_[kind] = TopicIdRange{0, -1};
+    controlsLen_ = 0;
+  }
+  return ok;
+}
+
+bool TopicTable::isControlTopic(const char* topic) const {
+  if (controlsLen_ == 0) return false;
+  return strncmp(topic, controls(), controlsLen_ + 1) == 0;
+}
+
+bool TopicTable::isConfigTopic(const char* topic) const {
+  return used_ != 0 && strcmp(topic, config()) == 0;
+}
+
+bool TopicTable::isRulesTopic(const char* topic) const {
+  return used_ != 0 && strcmp(topic, rules()) == 0;
+}
+
+bool TopicTable::isOtaTopic(const char* topic) const {
+  return used_ != 0 && strcmp(topic, ota()) == 0;
+}
+
+bool TopicTable::isSensorStreamTopic(const char* topic) const {
+  return used_ != 0 && strcmp(topic, sensorStream()) == 0;
+}
+
+size_t TopicTable::statusPrefixLen() const {
+  if (used_ == 0) return 0;
+  return strlen(deviceStatus()) - strlen("device");
+}
+
+bool TopicTable::findStatus(const char* topic, StatusTopic* kind, int* deviceId) const {
+  size_t prefix = statusPrefixLen();
+  if (prefix == 0 || strncmp(topic, deviceStatus(), prefix) != 0) return false;
+  const char* rest = topic + prefix;
+  for (int k = 0; k < STATUS_KIND_COUNT; k++) {
+    size_t n = strlen(statusSegments[k]);
+    if (strncmp(rest, statusSegments[k], n) != 0 || rest[n] != '/') continue;
+    const char* digits = rest + n + 1;
+    int id = 0;
+    size_t count = 0;
+    for (; digits[count] >= '0' && digits[count] <= '9' && count < 4; count++) {
+      id = id * 10 + (digits[count] - '0');
+    }
+    if (count == 0 || digits[count] != '\0' || status((StatusTopic)k, id) == nullptr) {
+      return false;
+    }
+    *kind = (StatusTopic)k;
+    *deviceId = id;
+    return true;
+  }
+  return false;
+}
+
+bool TopicTable::statusFilter(StatusTopic kind, char* out, size_t size) const {
+  size_t prefix = statusPrefixLen();
+  size_t seg = strlen(statusSegments[kind]);
+  if (prefix == 0 || prefix + seg + 3 > size) return false;
+  memcpy(out, deviceStatus(), prefix);
+  memcpy(out + prefix, statusSegments[kind], seg);
+  memcpy(out + prefix + seg, "/+", 3);
+  return true;
+}
+
+bool TopicTable::fits(const char* houseId, const TopicIdRange ranges[STATUS_KIND_COUNT]) {
+  // "yolouno/" + house + "/" + tail + id + NUL, as in append()
+  size_t prefix = 8 + strlen(houseId) + 1 + 1;
+  size_t bytes = 0;
+  int slots = SLOT_FIRST_STATUS;
+  const char* const fixedTails[] = {"controls", "sensors", "status/device", "sensors/frame",
+                                    "sensors/backlog", "sensors/rollup", "sensors/stream",
+                                    "config", "acks", "rules",
+                                    "diagnostics", "ota"};
+  for (const char* tail : fixedTails) bytes += prefix + strlen(tail);
+  for (int kind = 0; kind < STATUS_KIND_COUNT; kind++) {
+    for (int id = ranges[kind].idMin; id <= ranges[kind].idMax; id++) {
+      if (id < 0 || ++slots > TOPIC_MAX_SLOTS) return false;
+      bytes += prefix + 8 + strlen(statusSegments[kind]) + decimalDigits(id);   // "status/<seg>/"
+    }
+  }
+  return bytes <= TOPIC_ARENA_SIZE;
+}
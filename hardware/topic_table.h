@@ -0,0 +1,91 @@
+// MQTT topics for this house, formatted once at boot.
+//
+// Every status/sensor topic for every configured device ID lives in one fixed
+// arena and is looked up by (kind, device id) with two array reads, so the
+// publish paths never call sprintf. build() refuses a house ID that does not
+// fit instead of truncating it.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Status topic kinds: yolouno/<house>/status/<segment>/<id>
+enum StatusTopic : uint8_t {
+  STATUS_DOOR,
+  STATUS_ALARM,
+  STATUS_FAN,
+  STATUS_RGB,
+  STATUS_TEMP,
+  STATUS_HUMI,
+  STATUS_LIGHT,
+  STATUS_KIND_COUNT
+};
+
+struct TopicIdRange {
+  int idMin;
+  int idMax;
+};
+
+#define TOPIC_MAX_SLOTS 48
+#define TOPIC_ARENA_SIZE 2048
+
+class TopicTable {
+ public:
+  // ranges[kind] gives the device IDs to generate for each StatusTopic.
+  bool build(const char* houseId, const TopicIdRange ranges[STATUS_KIND_COUNT]);
+
+  const char* controls() const { return slot(SLOT_CONTROLS); }      // yolouno/<house>/controls
+  const char* sensors() const { return slot(SLOT_SENSORS); }        // yolouno/<house>/sensors
+  const char* deviceStatus() const { return slot(SLOT_DEVICE); }    // yolouno/<house>/status/device
+  const char* sensorFrame() const { return slot(SLOT_SENSOR_FRAME); } // yolouno/<house>/sensors/frame
+  const char* sensorBacklog() const { return slot(SLOT_SENSOR_BACKLOG); } // yolouno/<house>/sensors/backlog
+  const char* sensorRollup() const { return slot(SLOT_SENSOR_ROLLUP); } // yolouno/<house>/sensors/rollup
+  const char* sensorStream() const { return slot(SLOT_SENSOR_STREAM); } // yolouno/<house>/sensors/stream
+  const char* config() const { return slot(SLOT_CONFIG); }          // yolouno/<house>/config
+  const char* acks() const { return slot(SLOT_ACKS); }              // yolouno/<house>/acks
+  const char* rules() const { return slot(SLOT_RULES); }            // yolouno/<house>/rules
+  const char* diagnostics() const { return slot(SLOT_DIAGNOSTICS); } // yolouno/<house>/diagnostics
+  const char* ota() const { return slot(SLOT_OTA); }                // yolouno/<house>/ota
+
+  // nullptr if deviceId is outside the range the table was built with.
+  const char* status(StatusTopic kind, int deviceId) const {
+    int index = deviceId - ranges_[kind].idMin;
+    if (index < 0 || deviceId > ranges_[kind].idMax) return nullptr;
+    return slot(base_[kind] + index);
+  }
+
+  bool isControlTopic(const char* topic) const;
+  bool isConfigTopic(const char* topic) const;
+  bool isRulesTopic(const char* topic) const;
+  bool isOtaTopic(const char* topic) const;
+  bool isSensorStreamTopic(const char* topic) const;
+
+  // Reverse of status(): the kind and device ID of one of this house's status
+  // topics. False for any other topic, or an ID outside the built ranges.
+  bool findStatus(const char* topic, StatusTopic* kind, int* deviceId) const;
+
+  // Subscription filter for every ID of one kind: yolouno/<house>/status/<kind>/+
+  // Formatted on demand (once per connect); false if it does not fit in size.
+  bool statusFilter(StatusTopic kind, char* out, size_t size) const;
+
+  // Whether build() would succeed with these arguments, without building.
+  static bool fits(const char* houseId, const TopicIdRange ranges[STATUS_KIND_COUNT]);
+
+  size_t arenaUsed() const { return used_; }
+
+ private:
+  enum { SLOT_CONTROLS, SLOT_SENSORS, SLOT_DEVICE, SLOT_SENSOR_FRAME, SLOT_SENSOR_BACKLOG,
+         SLOT_SENSOR_ROLLUP, SLOT_SENSOR_STREAM, SLOT_CONFIG, SLOT_ACKS, SLOT_RULES, SLOT_DIAGNOSTICS, SLOT_OTA, SLOT_FIRST_STATUS };
+
+  const char* slot(int index) const { return arena_ + offset_[index]; }
+  bool append(int slotIndex, const char* house, const char* tail, int id);
+  // Length of "yolouno/<house>/status/", 0 before a successful build().
+  size_t statusPrefixLen() const;
+
+  char arena_[TOPIC_ARENA_SIZE] = {0};
+  uint16_t offset_[TOPIC_MAX_SLOTS] = {0};
+  uint8_t base_[STATUS_KIND_COUNT] = {0};
+  TopicIdRange ranges_[STATUS_KIND_COUNT] = {};
+  uint16_t controlsLen_ = 0;
+  uint16_t used_ = 0;
+};